@@ -0,0 +1,925 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <glm/geometric.hpp>
+#include <glm/gtx/transform.hpp>
+#include <spdlog/spdlog.h>
+
+#include <allocator.hpp>
+#include <context.hpp>
+#include <cpu/renderer.hpp>
+#include <cpu/scene.hpp>
+#include <cpu_features.hpp>
+#include <memory_report.hpp>
+#include <pipelines.hpp>
+#include <procedural.hpp>
+#include <ray_stats.hpp>
+#include <readback.hpp>
+#include <scene.hpp>
+#include <task_system.hpp>
+#include <transform.hpp>
+#include <util.hpp>
+
+using namespace prism;
+
+// Measures every stage of getting a mesh on the screen: loading PLY files, assembling the scene, uploading it, building
+// the acceleration structures and tracing rays (with the CPU backend and the Vulkan one). Every benchmark is run a
+// number of times after a few warmup runs, the samples and their statistics are written to a JSON file so that runs
+// can be compared with each other.
+//
+// Uses a generated sphere unless a PLY file is passed. Larger scenes can be generated with the --triangles,
+// --instances, --meshes, --mesh-groups, --meshes-per-group, --shape (sphere/grid) and --layout (grid/random) options
+// (see createProceduralScene), which is how we find out where the builds stop scaling. The Vulkan benchmarks are
+// skipped (and marked as such in the results) if there is no device with ray tracing support.
+
+// Every kernel traces the same rays:
+constexpr uint32_t RAY_GRID_SIZE = 1024;
+constexpr size_t   NUM_RAYS      = RAY_GRID_SIZE * RAY_GRID_SIZE;
+
+// The generated sphere has ~260k triangles:
+constexpr uint32_t SPHERE_RINGS    = 256;
+constexpr uint32_t SPHERE_SEGMENTS = 512;
+
+constexpr uint32_t       NUM_INSTANCES  = 10000;
+constexpr size_t         NUM_TRANSFORMS = 1 << 20;
+constexpr vk::DeviceSize UPLOAD_SIZE    = 64 << 20;
+
+constexpr uint32_t RENDER_WIDTH  = 1920;
+constexpr uint32_t RENDER_HEIGHT = 1080;
+
+struct Options
+{
+    std::optional<std::string>          meshPath;
+    std::optional<ProceduralSceneParam> proceduralScene;
+    std::string                jsonPath    = "bench_results.json";
+    uint32_t                   warmup      = 1;
+    uint32_t                   repetitions = 10;
+    bool                       cpuOnly     = false;
+    bool                       pinThreads  = false;
+};
+
+static Options parseOptions(const int argc, const char** const argv)
+{
+    Options options;
+
+    const auto parseValue = [&](int& i, const std::string_view name) {
+        if (++i == argc) {
+            throw std::runtime_error(std::string(name) + " requires a value");
+        }
+        return std::string_view(argv[i]);
+    };
+    const auto parseCount = [&](int& i, const std::string_view name) {
+        return static_cast<uint32_t>(std::stoul(std::string(parseValue(i, name))));
+    };
+    const auto parseLargeCount = [&](int& i, const std::string_view name) {
+        return static_cast<uint64_t>(std::stoull(std::string(parseValue(i, name))));
+    };
+
+    // Any of the procedural scene options replaces the default scene:
+    const auto procedural = [&]() -> ProceduralSceneParam& {
+        if (!options.proceduralScene) {
+            options.proceduralScene.emplace();
+        }
+        return *options.proceduralScene;
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if (arg == "--json") {
+            options.jsonPath = parseValue(i, arg);
+        } else if (arg == "--warmup") {
+            options.warmup = parseCount(i, arg);
+        } else if (arg == "--repetitions") {
+            options.repetitions = parseCount(i, arg);
+        } else if (arg == "--cpu-only") {
+            options.cpuOnly = true;
+        } else if (arg == "--pin-threads") {
+            options.pinThreads = true;
+        } else if (arg == "--triangles") {
+            procedural().numTriangles = parseLargeCount(i, arg);
+        } else if (arg == "--instances") {
+            procedural().numInstances = parseLargeCount(i, arg);
+        } else if (arg == "--meshes") {
+            procedural().numMeshes = parseCount(i, arg);
+        } else if (arg == "--mesh-groups") {
+            procedural().numMeshGroups = parseCount(i, arg);
+        } else if (arg == "--meshes-per-group") {
+            procedural().meshesPerGroup = parseCount(i, arg);
+        } else if (arg == "--shape") {
+            const auto shape   = parseValue(i, arg);
+            procedural().shape = shape == "grid" ? ProceduralShape::eGrid : ProceduralShape::eSphere;
+        } else if (arg == "--layout") {
+            const auto layout   = parseValue(i, arg);
+            procedural().layout = layout == "random" ? InstanceLayout::eRandom : InstanceLayout::eGrid;
+        } else if (arg == "--write-ply") {
+            procedural().plyPath = parseValue(i, arg);
+        } else if (!options.meshPath) {
+            options.meshPath = std::string(arg);
+        } else {
+            throw std::runtime_error("Unexpected argument: " + std::string(arg));
+        }
+    }
+
+    if (options.repetitions == 0) {
+        throw std::runtime_error("At least one repetition is required");
+    }
+    if (options.meshPath && options.proceduralScene) {
+        throw std::runtime_error("Either a mesh or a procedural scene can be benchmarked, not both");
+    }
+    return options;
+}
+
+//
+// Results:
+
+struct BenchResult
+{
+    std::string         name;
+    std::vector<double> samples;    // In milliseconds
+    std::string         skipReason; // Set if the benchmark couldn't be run
+
+    // What a single run processes (e.g. megabytes or rays), which is used to compute the throughput. An empty unit
+    // means that there is no throughput:
+    double      workPerRun = 0.0;
+    std::string workUnit;
+
+    // Anything else that is worth keeping track of (e.g. the number of hits):
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+struct Statistics
+{
+    double min, mean, p50, p90, p99, max, stddev;
+};
+
+// Linearly interpolates between the closest ranks:
+static double percentile(const std::span<const double> sorted, const double fraction)
+{
+    const double rank  = fraction * (sorted.size() - 1);
+    const size_t lower = static_cast<size_t>(rank);
+    const size_t upper = std::min(lower + 1, sorted.size() - 1);
+    return sorted[lower] + (rank - lower) * (sorted[upper] - sorted[lower]);
+}
+
+static Statistics computeStatistics(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    double sum = 0.0;
+    for (const double sample : samples) {
+        sum += sample;
+    }
+    const double mean = sum / samples.size();
+
+    double sumSquares = 0.0;
+    for (const double sample : samples) {
+        sumSquares += (sample - mean) * (sample - mean);
+    }
+
+    return Statistics{
+        .min    = samples.front(),
+        .mean   = mean,
+        .p50    = percentile(samples, 0.5),
+        .p90    = percentile(samples, 0.9),
+        .p99    = percentile(samples, 0.99),
+        .max    = samples.back(),
+        .stddev = samples.size() > 1 ? std::sqrt(sumSquares / (samples.size() - 1)) : 0.0,
+    };
+}
+
+// Based on the median, so that a single slow run doesn't skew it:
+static double throughput(const BenchResult& result, const Statistics& statistics)
+{
+    return result.workPerRun / (statistics.p50 * 1e-3);
+}
+
+static void logResult(const BenchResult& result)
+{
+    if (!result.skipReason.empty()) {
+        spdlog::warn("{}: skipped ({})", result.name, result.skipReason);
+        return;
+    }
+
+    const auto statistics = computeStatistics(result.samples);
+    if (result.workUnit.empty()) {
+        spdlog::info("{}: median {:.3f} ms (min {:.3f} ms, p90 {:.3f} ms)", result.name, statistics.p50,
+                     statistics.min, statistics.p90);
+    } else {
+        spdlog::info("{}: median {:.3f} ms (min {:.3f} ms, p90 {:.3f} ms), {:.4g} {}/s", result.name, statistics.p50,
+                     statistics.min, statistics.p90, throughput(result, statistics), result.workUnit);
+    }
+}
+
+// The metadata values have to be valid JSON already (see jsonEscape):
+static void writeJson(const std::string& path, const std::span<const std::pair<std::string, std::string>> metadata,
+                      const std::span<const BenchResult> results)
+{
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open the results file at: " + path);
+    }
+    file << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+    file << "{\n  \"metadata\": {";
+    for (size_t i = 0; i < metadata.size(); ++i) {
+        file << (i > 0 ? ",\n    " : "\n    ") << jsonEscape(metadata[i].first) << ": " << metadata[i].second;
+    }
+    file << "\n  },\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        file << (i > 0 ? ",\n    {" : "\n    {") << "\"name\": " << jsonEscape(result.name);
+
+        if (!result.skipReason.empty()) {
+            file << ", \"skipped\": " << jsonEscape(result.skipReason) << "}";
+            continue;
+        }
+
+        const auto statistics = computeStatistics(result.samples);
+        file << ", \"minMs\": " << statistics.min << ", \"meanMs\": " << statistics.mean
+             << ", \"p50Ms\": " << statistics.p50 << ", \"p90Ms\": " << statistics.p90
+             << ", \"p99Ms\": " << statistics.p99 << ", \"maxMs\": " << statistics.max
+             << ", \"stddevMs\": " << statistics.stddev;
+        if (!result.workUnit.empty()) {
+            file << ", \"workPerRun\": " << result.workPerRun << ", \"workUnit\": " << jsonEscape(result.workUnit)
+                 << ", \"throughputPerSecond\": " << throughput(result, statistics);
+        }
+        for (const auto& [counterName, value] : result.counters) {
+            file << ", " << jsonEscape(counterName) << ": " << value;
+        }
+
+        file << ", \"samplesMs\": [";
+        for (size_t j = 0; j < result.samples.size(); ++j) {
+            file << (j > 0 ? ", " : "") << result.samples[j];
+        }
+        file << "]}";
+    }
+    file << "\n  ]\n}\n";
+
+    if (!file) {
+        throw std::runtime_error("Failed to write the results file at: " + path);
+    }
+}
+
+//
+// Measuring:
+
+template <typename F>
+static double timeMilliseconds(F&& func)
+{
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+    return duration.count();
+}
+
+// Runs func for the warmup runs and then once for every repetition. func returns the time it took in milliseconds, so
+// that it can leave out any setup that shouldn't be measured (e.g. with timeMilliseconds):
+template <typename F>
+static std::vector<double> sample(const Options& options, F&& func)
+{
+    for (uint32_t i = 0; i < options.warmup; ++i) {
+        func();
+    }
+
+    std::vector<double> samples;
+    samples.reserve(options.repetitions);
+    for (uint32_t i = 0; i < options.repetitions; ++i) {
+        samples.push_back(func());
+    }
+    return samples;
+}
+
+//
+// Rays:
+
+// An orthographic grid of rays along +z covering the scene, similar to the rays of the renderer's camera:
+static std::vector<cpu::Ray> createCoherentRays(const BBox3f& bounds)
+{
+    const glm::vec3 extent = bounds.diagonal();
+
+    std::vector<cpu::Ray> rays;
+    rays.reserve(NUM_RAYS);
+    for (uint32_t y = 0; y < RAY_GRID_SIZE; ++y) {
+        for (uint32_t x = 0; x < RAY_GRID_SIZE; ++x) {
+            const float u = (x + 0.5f) / RAY_GRID_SIZE;
+            const float v = (y + 0.5f) / RAY_GRID_SIZE;
+            rays.emplace_back(cpu::Ray{
+                .origin = glm::vec3(bounds.pmin.x + u * extent.x, bounds.pmin.y + v * extent.y, bounds.pmin.z - 1.f),
+                .tmin   = 0.f,
+                .dir    = glm::vec3(0.f, 0.f, 1.f),
+                .tmax   = std::numeric_limits<float>::infinity(),
+            });
+        }
+    }
+    return rays;
+}
+
+// Rays starting on a sphere around the scene going through random points inside of it, which is closer to what
+// secondary bounces look like:
+static std::vector<cpu::Ray> createIncoherentRays(const BBox3f& bounds)
+{
+    std::mt19937                          rng(42);
+    std::normal_distribution<float>       normal;
+    std::uniform_real_distribution<float> uniform;
+
+    const glm::vec3 center = bounds.center();
+    const float     radius = glm::length(bounds.diagonal());
+
+    std::vector<cpu::Ray> rays;
+    rays.reserve(NUM_RAYS);
+    for (size_t i = 0; i < NUM_RAYS; ++i) {
+        const glm::vec3 origin = center + radius * glm::normalize(glm::vec3(normal(rng), normal(rng), normal(rng)));
+        const glm::vec3 target = bounds.pmin + glm::vec3(uniform(rng), uniform(rng), uniform(rng)) * bounds.diagonal();
+        rays.emplace_back(cpu::Ray{
+            .origin = origin,
+            .tmin   = 0.f,
+            .dir    = target - origin,
+            .tmax   = std::numeric_limits<float>::infinity(),
+        });
+    }
+    return rays;
+}
+
+enum class TraceMode
+{
+    eSingleRays,
+    ePackets8,
+    ePackets16,
+    eStream, // Always uses all of the threads
+};
+
+struct TraceResult
+{
+    double milliseconds;
+    size_t numHits; // Should be the same for all of the kernels and modes
+};
+
+static size_t traceSingleRays(const cpu::Scene& scene, const std::span<const cpu::Ray> rays)
+{
+    size_t numHits = 0;
+    for (cpu::Ray ray : rays) {
+        cpu::Hit hit;
+        numHits += scene.intersect(ray, hit) ? 1 : 0;
+    }
+    return numHits;
+}
+
+// Consecutive rays are traced together (neighbouring pixels of the same row for the coherent rays):
+template <size_t K>
+static size_t tracePackets(const cpu::Scene& scene, const std::span<const cpu::Ray> rays)
+{
+    size_t numHits = 0;
+    for (size_t first = 0; first < rays.size(); first += K) {
+        cpu::RayPacket<K> packet{};
+        uint32_t          activeMask = 0;
+        for (uint32_t lane = 0; lane < K && first + lane < rays.size(); ++lane) {
+            packet.setRay(lane, rays[first + lane]);
+            activeMask |= 1u << lane;
+        }
+
+        std::array<cpu::Hit, K> hits;
+        numHits += std::popcount(scene.intersect(packet, hits, activeMask));
+    }
+    return numHits;
+}
+
+static TraceResult traceRays(const cpu::Scene& scene, const std::span<const cpu::Ray> rays, const TraceMode mode,
+                             const bool multithreaded)
+{
+    const auto traceRange = [&](const std::span<const cpu::Ray> range) {
+        switch (mode) {
+        case TraceMode::ePackets8:
+            return tracePackets<8>(scene, range);
+        case TraceMode::ePackets16:
+            return tracePackets<16>(scene, range);
+        default:
+            return traceSingleRays(scene, range);
+        }
+    };
+
+    // A multiple of every packet size:
+    constexpr size_t CHUNK_SIZE = 1 << 12;
+
+    // Streams modify the rays, so they get a fresh copy every time (which isn't measured):
+    std::vector<cpu::Ray> streamRays;
+    std::vector<cpu::Hit> streamHits;
+    std::vector<uint8_t>  streamIsHit;
+    if (mode == TraceMode::eStream) {
+        streamRays.assign(rays.begin(), rays.end());
+        streamHits.resize(rays.size());
+        streamIsHit.resize(rays.size());
+    }
+
+    std::atomic<size_t> numHits      = 0;
+    const double        milliseconds = timeMilliseconds([&]() {
+        if (mode == TraceMode::eStream) {
+            scene.intersectStream(streamRays, streamHits, streamIsHit);
+        } else if (multithreaded) {
+            const size_t numChunks = (rays.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+            parallelFor(numChunks, 1, [&](const size_t begin, const size_t end) {
+                const size_t first = begin * CHUNK_SIZE;
+                numHits += traceRange(rays.subspan(first, std::min(end * CHUNK_SIZE, rays.size()) - first));
+            });
+        } else {
+            numHits = traceRange(rays);
+        }
+    });
+
+    if (mode == TraceMode::eStream) {
+        numHits = std::count(streamIsHit.begin(), streamIsHit.end(), uint8_t(1));
+    }
+
+    return TraceResult{.milliseconds = milliseconds, .numHits = numHits};
+}
+
+//
+// CPU benchmarks:
+
+// Loading a mesh includes adding it to the scene builder, which is what happens when loading a scene:
+static BenchResult benchLoadMesh(const Options& options, std::string name, const std::string& path)
+{
+    BenchResult result{
+        .name       = std::move(name),
+        .workPerRun = std::filesystem::file_size(path) * 1e-6,
+        .workUnit   = "MB",
+    };
+    result.samples = sample(options, [&]() {
+        SceneBuilder sceneBuilder;
+        return timeMilliseconds([&]() { sceneBuilder.createMesh(path); });
+    });
+    return result;
+}
+
+// A mesh group with the mesh placed twice that is instanced on a grid:
+static BenchResult benchSceneAssembly(const Options& options, const MeshData& mesh)
+{
+    BenchResult result{
+        .name       = "scene builder assembly",
+        .workPerRun = NUM_INSTANCES,
+        .workUnit   = "instances",
+    };
+    result.samples = sample(options, [&]() {
+        SceneBuilder sceneBuilder;
+        return timeMilliseconds([&]() {
+            const auto meshIdx      = sceneBuilder.createMesh(mesh.positions, mesh.faces);
+            const auto transformIdx = sceneBuilder.createTransform(Transform(glm::scale(glm::vec3(0.5f))));
+            const auto meshGroupIdx = sceneBuilder.createMeshGroup(std::to_array({
+                PlacedMesh{.meshIdx = meshIdx},
+                PlacedMesh{.meshIdx = meshIdx, .transformIdx = transformIdx},
+            }));
+
+            for (uint32_t i = 0; i < NUM_INSTANCES; ++i) {
+                sceneBuilder.createInstance(Instance{
+                    .customId     = i,
+                    .mask         = 1,
+                    .hitGroupId   = 1,
+                    .meshGroupIdx = meshGroupIdx,
+                    .transform    = Transform(glm::translate(glm::vec3(2.f * (i % 100), 2.f * (i / 100), 0.f))),
+                });
+            }
+        });
+    });
+    return result;
+}
+
+static BenchResult benchTransformConversion(const Options& options)
+{
+    std::mt19937                          rng(42);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+
+    std::vector<Transform> transforms;
+    transforms.reserve(NUM_TRANSFORMS);
+    for (size_t i = 0; i < NUM_TRANSFORMS; ++i) {
+        const glm::vec3 translation(uniform(rng), uniform(rng), uniform(rng));
+        const glm::vec3 axis(uniform(rng), uniform(rng), 1.f);
+        transforms.emplace_back(glm::translate(translation) * glm::rotate(uniform(rng), glm::normalize(axis)) *
+                                glm::scale(glm::vec3(1.f + 0.5f * uniform(rng))));
+    }
+
+    BenchResult result{
+        .name       = "transform conversion",
+        .workPerRun = NUM_TRANSFORMS,
+        .workUnit   = "transforms",
+    };
+
+    std::vector<vk::TransformMatrixKHR> converted(NUM_TRANSFORMS);
+    result.samples = sample(options, [&]() {
+        return timeMilliseconds([&]() {
+            for (size_t i = 0; i < NUM_TRANSFORMS; ++i) {
+                converted[i] = static_cast<vk::TransformMatrixKHR>(transforms[i]);
+            }
+        });
+    });
+
+    // Keeps the conversions from being optimized away:
+    double checksum = 0.0;
+    for (const auto& transform : converted) {
+        checksum += transform.matrix[0][3];
+    }
+    result.counters.emplace_back("checksum", checksum);
+
+    return result;
+}
+
+static BenchResult benchCpuBuild(const Options& options, std::string name, const SceneBuilder& sceneBuilder,
+                                 const cpu::TraversalKernel kernel)
+{
+    BenchResult result{.name = std::move(name)};
+    result.samples = sample(options, [&]() {
+        std::optional<cpu::Scene> scene;
+        return timeMilliseconds([&]() { scene.emplace(sceneBuilder, cpu::SceneParam{.kernel = kernel}); });
+    });
+    return result;
+}
+
+static BenchResult benchCpuTrace(const Options& options, std::string name, const cpu::Scene& scene,
+                                 const std::span<const cpu::Ray> rays, const TraceMode mode, const bool multithreaded)
+{
+    BenchResult result{
+        .name       = std::move(name),
+        .workPerRun = static_cast<double>(rays.size()),
+        .workUnit   = "rays",
+    };
+
+    size_t numHits = 0;
+    result.samples = sample(options, [&]() {
+        const auto trace = traceRays(scene, rays, mode, multithreaded);
+        numHits          = trace.numHits;
+        return trace.milliseconds;
+    });
+    result.counters.emplace_back("hits", static_cast<double>(numHits));
+
+    return result;
+}
+
+static BenchResult benchCpuRender(const Options& options, const cpu::Scene& scene)
+{
+    BenchResult result{
+        .name       = "cpu/render",
+        .workPerRun = static_cast<double>(RENDER_WIDTH) * RENDER_HEIGHT,
+        .workUnit   = "pixels",
+    };
+    result.samples = sample(options, [&]() {
+        cpu::RenderOutput output;
+        return timeMilliseconds(
+            [&]() { output = cpu::render(scene, {.outputWidth = RENDER_WIDTH, .outputHeight = RENDER_HEIGHT}); });
+    });
+    return result;
+}
+
+//
+// Vulkan benchmarks:
+
+static const auto GPU_BENCHMARK_NAMES = std::to_array<std::string_view>({
+    "gpu/staging upload",
+    "gpu/scene upload",
+    "gpu/blas build",
+    "gpu/tlas build",
+    "gpu/scene build",
+    "gpu/render",
+});
+
+// Records the commands, submits them and waits for them to finish:
+template <typename F>
+static double timeSubmission(const Context& context, const vk::CommandPool& commandPool, F&& recordCommands)
+{
+    return timeMilliseconds([&]() {
+        const auto commandBuffers = context.device().allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{
+            .commandPool        = commandPool,
+            .level              = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = 1,
+        });
+        const auto& commandBuffer = commandBuffers[0];
+
+        commandBuffer->begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+        recordCommands(*commandBuffer);
+        submitAndWait(context, *commandBuffer, "Benchmarking");
+    });
+}
+
+// The same way the scene uploads its buffers, so this includes allocating and filling the staging buffer:
+static BenchResult benchStagingUpload(const Options& options, const Context& context, const GPUAllocator& allocator,
+                                      const vk::CommandPool& commandPool)
+{
+    const std::vector<std::byte> data(UPLOAD_SIZE);
+    const auto                   dstBuffer =
+        allocator.allocateBuffer(UPLOAD_SIZE, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    BenchResult result{
+        .name       = "gpu/staging upload",
+        .workPerRun = UPLOAD_SIZE * 1e-6,
+        .workUnit   = "MB",
+    };
+    result.samples = sample(options, [&]() {
+        UniqueBuffer stagingBuffer;
+        return timeSubmission(context, commandPool, [&](const vk::CommandBuffer& commandBuffer) {
+            stagingBuffer = addCopyToBufferCommand(commandBuffer, allocator, dstBuffer, data);
+        });
+    });
+    return result;
+}
+
+// The stages are timed by the scene itself:
+static std::vector<BenchResult> benchSceneBuild(const Options& options, const Context& context,
+                                                const GPUAllocator& allocator, const SceneBuilder& sceneBuilder)
+{
+    std::vector<SceneBuildTimings> timings;
+    for (uint32_t i = 0; i < options.warmup + options.repetitions; ++i) {
+        const Scene scene({}, context, allocator, sceneBuilder);
+        if (i >= options.warmup) {
+            timings.push_back(scene.buildTimings());
+        }
+    }
+
+    std::vector<BenchResult> results{
+        {.name = "gpu/scene upload", .workPerRun = timings.front().uploadSize * 1e-6, .workUnit = "MB"},
+        {.name = "gpu/blas build"},
+        {.name = "gpu/tlas build"},
+        {.name = "gpu/scene build"},
+    };
+    for (const auto& timing : timings) {
+        results[0].samples.push_back(timing.uploadMs);
+        results[1].samples.push_back(timing.blasMs);
+        results[2].samples.push_back(timing.tlasMs);
+        results[3].samples.push_back(timing.totalMs);
+    }
+    return results;
+}
+
+// Traces one ray per pixel from the raygen shader's camera:
+static BenchResult benchGpuRender(const Options& options, const Context& context, const GPUAllocator& allocator,
+                                  const vk::CommandPool& commandPool, const Scene& scene)
+{
+    const Pipelines pipeline({.outputWidth = RENDER_WIDTH, .outputHeight = RENDER_HEIGHT}, context, allocator, scene);
+
+    BenchResult result{
+        .name       = "gpu/render",
+        .workPerRun = static_cast<double>(RENDER_WIDTH) * RENDER_HEIGHT,
+        .workUnit   = "pixels",
+    };
+    result.samples = sample(options, [&]() {
+        return timeSubmission(context, commandPool, [&](const vk::CommandBuffer& commandBuffer) {
+            pipeline.addBindRTPipelineCmd(commandBuffer, {.width = RENDER_WIDTH, .height = RENDER_HEIGHT});
+        });
+    });
+
+    //
+    // The shader counters come from a separate pipeline, so that they don't slow down the timed launches:
+
+    std::optional<Pipelines> statsPipeline;
+    try {
+        statsPipeline.emplace(
+            PipelineParam{.outputWidth = RENDER_WIDTH, .outputHeight = RENDER_HEIGHT, .enableRayStats = true},
+            context, allocator, scene);
+    } catch (const std::exception& e) {
+        spdlog::warn("gpu/render: no ray stats ({})", e.what());
+        return result;
+    }
+
+    RayStats   stats{};
+    const auto statsSize = std::to_array<vk::DeviceSize>({sizeof(RayStats)});
+    const auto statsSrc  = std::to_array({statsPipeline->getRayStatsBuffer()});
+    Readback   readback(context, allocator, statsSize, 1);
+
+    readback.submit(
+        [&](const vk::CommandBuffer& commandBuffer) {
+            statsPipeline->addBindRTPipelineCmd(commandBuffer, {.width = RENDER_WIDTH, .height = RENDER_HEIGHT});
+        },
+        statsSrc, [&](std::span<const std::span<const std::byte>> data) { stats = readRayStats(data[0]); });
+    readback.wait();
+
+    // The throughput is based on the median of the timed launches:
+    const double medianMs = computeStatistics(result.samples).p50;
+    result.counters.emplace_back("rays", stats.raysTraced);
+    result.counters.emplace_back("hits", stats.hits);
+    result.counters.emplace_back("misses", stats.misses);
+    result.counters.emplace_back("laneUtilization", laneUtilization(stats));
+    result.counters.emplace_back("mraysPerSecond", mraysPerSecond(stats, medianMs));
+    return result;
+}
+
+int main(const int argc, const char** const argv)
+{
+    try {
+        const auto options = parseOptions(argc, argv);
+
+        // Has to happen before anything uses the task system:
+        initTaskSystem({.pinThreads = options.pinThreads});
+
+        std::vector<BenchResult> results;
+        const auto               addResult = [&](BenchResult result) {
+            logResult(result);
+            results.push_back(std::move(result));
+        };
+
+        //
+        // Loading and assembling the scene:
+
+        const auto sphere = generateSphere(SPHERE_RINGS, SPHERE_SEGMENTS);
+        {
+            // The same mesh in both formats, so that the two can be compared:
+            const auto tempDir    = std::filesystem::temp_directory_path();
+            const auto asciiPath  = tempDir / "vkprism_bench_ascii.ply";
+            const auto binaryPath = tempDir / "vkprism_bench_binary.ply";
+            writePly(asciiPath, sphere, false);
+            writePly(binaryPath, sphere, true);
+
+            addResult(benchLoadMesh(options, "ply load/ascii", asciiPath.string()));
+            addResult(benchLoadMesh(options, "ply load/binary", binaryPath.string()));
+
+            std::error_code ec;
+            std::filesystem::remove(asciiPath, ec);
+            std::filesystem::remove(binaryPath, ec);
+        }
+        if (options.meshPath) {
+            const auto fileName = std::filesystem::path(*options.meshPath).filename().string();
+            addResult(benchLoadMesh(options, "ply load/" + fileName, *options.meshPath));
+        }
+
+        addResult(benchSceneAssembly(options, sphere));
+        addResult(benchTransformConversion(options));
+
+        // Everything else is measured on the procedural scene or a single instance of the mesh:
+        SceneBuilder sceneBuilder;
+
+        std::optional<ProceduralSceneInfo> proceduralInfo;
+        double                             proceduralMs = 0.0;
+        if (options.proceduralScene) {
+            proceduralMs = timeMilliseconds(
+                [&]() { proceduralInfo = createProceduralScene(sceneBuilder, *options.proceduralScene); });
+            spdlog::info("Generated a scene with {} unique and {} instanced triangles in {:.2f} ms",
+                         proceduralInfo->numUniqueTriangles, proceduralInfo->numInstancedTriangles, proceduralMs);
+        } else {
+            const auto meshIdx      = options.meshPath ? sceneBuilder.createMesh(*options.meshPath)
+                                                       : sceneBuilder.createMesh(sphere.positions, sphere.faces);
+            const auto meshGroupIdx = sceneBuilder.createMeshGroup(std::to_array({PlacedMesh{.meshIdx = meshIdx}}));
+            sceneBuilder.createInstance(Instance{
+                .customId     = 0,
+                .mask         = 1,
+                .hitGroupId   = 1,
+                .meshGroupIdx = meshGroupIdx,
+                .transform    = Transform(glm::mat4(1.f)),
+            });
+        }
+
+        //
+        // CPU backend:
+
+        const auto& features = cpuFeatures();
+        spdlog::info("CPU features: SSE4.2: {}, AVX2: {}, FMA: {}, {} threads", features.sse42, features.avx2,
+                     features.fma, taskSystem().numThreads());
+
+        std::vector<std::pair<const char*, cpu::TraversalKernel>> kernels{{"scalar", cpu::TraversalKernel::eScalar}};
+        if (features.sse42) {
+            kernels.emplace_back("sse4.2", cpu::TraversalKernel::eSSE42);
+        }
+        if (features.avx2 && features.fma) {
+            kernels.emplace_back("avx2", cpu::TraversalKernel::eAVX2);
+        }
+
+        std::vector<cpu::Ray> coherentRays;
+        std::vector<cpu::Ray> incoherentRays;
+
+        for (const auto& [kernelName, kernel] : kernels) {
+            addResult(benchCpuBuild(options, "cpu/bvh build/" + std::string(kernelName), sceneBuilder, kernel));
+
+            const cpu::Scene scene(sceneBuilder, {.kernel = kernel});
+
+            // The bounds are the same for every kernel:
+            if (coherentRays.empty()) {
+                coherentRays   = createCoherentRays(scene.bounds());
+                incoherentRays = createIncoherentRays(scene.bounds());
+            }
+
+            const auto rayTypes = {std::pair{"coherent", std::span<const cpu::Ray>(coherentRays)},
+                                   std::pair{"incoherent", std::span<const cpu::Ray>(incoherentRays)}};
+
+            // Packets and streams are always traced through the binary BVHs, so they only have to be measured once:
+            std::vector<std::pair<std::string, TraceMode>> modes{{kernelName, TraceMode::eSingleRays}};
+            if (kernel == cpu::TraversalKernel::eScalar) {
+                modes.emplace_back("8 ray packets", TraceMode::ePackets8);
+                modes.emplace_back("16 ray packets", TraceMode::ePackets16);
+            }
+
+            for (const auto& [raysName, rays] : rayTypes) {
+                for (const auto& [modeName, mode] : modes) {
+                    for (const bool multithreaded : {false, true}) {
+                        const std::string name = "cpu/trace/" + modeName + "/" + raysName + "/" +
+                                                 (multithreaded ? "all threads" : "single thread");
+                        addResult(benchCpuTrace(options, name, scene, rays, mode, multithreaded));
+                    }
+                }
+
+                if (kernel == cpu::TraversalKernel::eScalar) {
+                    const std::string name = "cpu/trace/stream/" + std::string(raysName) + "/all threads";
+                    addResult(benchCpuTrace(options, name, scene, rays, TraceMode::eStream, true));
+                }
+            }
+        }
+
+        addResult(benchCpuRender(options, cpu::Scene(sceneBuilder)));
+
+        //
+        // Vulkan backend:
+
+        std::optional<Context>      context;
+        std::optional<GPUAllocator> allocator;
+
+        std::string gpuSkipReason = "--cpu-only was passed";
+        if (!options.cpuOnly) {
+            try {
+                context.emplace(ContextParam{});
+                allocator.emplace(*context);
+            } catch (const std::exception& e) {
+                gpuSkipReason = "couldn't create a context: " + std::string(e.what());
+                context.reset();
+            }
+        }
+
+        if (context) {
+            const auto commandPool = context->device().createCommandPoolUnique(vk::CommandPoolCreateInfo{
+                .flags            = vk::CommandPoolCreateFlagBits::eTransient,
+                .queueFamilyIndex = context->queueFamilyIndex()});
+
+            addResult(benchStagingUpload(options, *context, *allocator, *commandPool));
+            for (auto& result : benchSceneBuild(options, *context, *allocator, sceneBuilder)) {
+                addResult(std::move(result));
+            }
+
+            const Scene scene({}, *context, *allocator, sceneBuilder);
+            addResult(benchGpuRender(options, *context, *allocator, *commandPool, scene));
+        } else {
+            for (const auto name : GPU_BENCHMARK_NAMES) {
+                addResult(BenchResult{.name = std::string(name), .skipReason = gpuSkipReason});
+            }
+        }
+
+        //
+        // Write out the results:
+
+        const auto jsonBool = [](const bool value) { return std::string(value ? "true" : "false"); };
+
+        std::string deviceName = "null";
+        if (context) {
+            const auto& properties = context->properties().get<vk::PhysicalDeviceProperties2>().properties;
+            deviceName             = jsonEscape(properties.deviceName.data());
+        }
+
+        std::vector<std::pair<std::string, std::string>> metadata{
+            {"mesh", jsonEscape(options.meshPath ? *options.meshPath : "generated sphere")},
+            {"warmup", std::to_string(options.warmup)},
+            {"repetitions", std::to_string(options.repetitions)},
+            {"threads", std::to_string(taskSystem().numThreads())},
+            {"renderResolution", jsonEscape(std::to_string(RENDER_WIDTH) + "x" + std::to_string(RENDER_HEIGHT))},
+            {"pinThreads", jsonBool(options.pinThreads)},
+            {"sse42", jsonBool(features.sse42)},
+            {"avx2", jsonBool(features.avx2)},
+            {"fma", jsonBool(features.fma)},
+            {"device", deviceName},
+        };
+        if (options.proceduralScene) {
+            const auto& param = *options.proceduralScene;
+
+            metadata[0] = {"mesh", jsonEscape(param.shape == ProceduralShape::eGrid ? "procedural grids"
+                                                                                     : "procedural spheres")};
+            metadata.emplace_back("layout", jsonEscape(param.layout == InstanceLayout::eGrid ? "grid" : "random"));
+            metadata.emplace_back("meshes", std::to_string(param.numMeshes));
+            metadata.emplace_back("meshGroups", std::to_string(param.numMeshGroups));
+            metadata.emplace_back("meshesPerGroup", std::to_string(param.meshesPerGroup));
+            metadata.emplace_back("instances", std::to_string(param.numInstances));
+            metadata.emplace_back("trianglesPerMesh", std::to_string(proceduralInfo->numTrianglesPerMesh));
+            metadata.emplace_back("uniqueTriangles", std::to_string(proceduralInfo->numUniqueTriangles));
+            metadata.emplace_back("instancedTriangles", std::to_string(proceduralInfo->numInstancedTriangles));
+            metadata.emplace_back("generationMs", std::to_string(proceduralMs));
+        }
+
+        // Peaks over every benchmark (e.g. the scratch buffers of the largest build):
+        MemoryReport memoryReport     = allocator ? allocator->memoryReport() : MemoryReport{};
+        memoryReport.host             = sceneBuilder.hostMemoryUsage();
+        memoryReport.processPeakBytes = processPeakMemory();
+        metadata.emplace_back("memory", memoryReportJson(memoryReport));
+        writeJson(options.jsonPath, metadata, results);
+        spdlog::info("Wrote the results to {}", options.jsonPath);
+
+    } catch (const std::exception& e) {
+        spdlog::error("Caught exception: {}", e.what());
+        return 1;
+    }
+}
\ No newline at end of file
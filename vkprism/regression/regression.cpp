@@ -0,0 +1,529 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/gtx/transform.hpp>
+#include <spdlog/spdlog.h>
+
+#include <allocator.hpp>
+#include <aov.hpp>
+#include <context.hpp>
+#include <cpu/renderer.hpp>
+#include <cpu/scene.hpp>
+#include <framebuffer.hpp>
+#include <image.hpp>
+#include <pipelines.hpp>
+#include <procedural.hpp>
+#include <readback.hpp>
+#include <scene.hpp>
+#include <tiled.hpp>
+
+using namespace prism;
+
+// Renders a set of scenes with both the Vulkan and the CPU backends and compares the results. Since the CPU backend
+// mirrors the raytrace.* shaders, any divergence is a bug in one of the two. Exits with 1 if any of the comparisons
+// fail.
+//
+// The Vulkan renders are skipped if there is no device with ray tracing support (unless --require-gpu is passed), in
+// which case nothing was compared and it exits with SKIPPED_EXIT_CODE. To run them on a software implementation
+// instead, point the Vulkan loader at its ICD (VK_ICD_FILENAMES).
+
+constexpr uint32_t OUTPUT_WIDTH    = 512;
+constexpr uint32_t OUTPUT_HEIGHT   = 512;
+constexpr int      NUM_REPETITIONS = 3; // The best time is reported
+
+// What CTest treats as a skipped test (see SKIP_RETURN_CODE in CMakeLists.txt):
+constexpr int SKIPPED_EXIT_CODE = 77;
+
+// Pixels on silhouettes may legitimately differ as the device's triangle test isn't exactly the same as ours, so a
+// small fraction of outliers is allowed:
+constexpr float  OUTLIER_THRESHOLD    = 1e-3f; // Relative error
+constexpr double MAX_OUTLIER_FRACTION = 1e-3;
+constexpr double MAX_RMSE             = 0.1;
+
+//
+// Scenes:
+
+struct TestScene
+{
+    std::string  name;
+    SceneBuilder sceneBuilder;
+    glm::mat4    cameraToWorld = glm::mat4(1.f);
+};
+
+static void addInstance(SceneBuilder& sceneBuilder, const MeshGroupIndex meshGroupIdx, const glm::mat4& transform)
+{
+    sceneBuilder.createInstance(Instance{
+        .customId     = 0,
+        .mask         = 1,
+        .hitGroupId   = 1,
+        .meshGroupIdx = meshGroupIdx,
+        .transform    = Transform(transform),
+    });
+}
+
+// The camera looks along +z and covers [-1, 1] on x and y (see raytrace.rgen):
+static TestScene createTriangleScene()
+{
+    TestScene scene{.name = "triangle"};
+
+    const auto positions = std::to_array({glm::vec3(-0.8f, -0.8f, 2.f), glm::vec3(0.8f, -0.6f, 2.5f),
+                                          glm::vec3(0.f, 0.8f, 3.f)});
+    const auto faces     = std::to_array({glm::u32vec3(0, 1, 2)});
+
+    const auto meshIdx      = scene.sceneBuilder.createMesh(positions, faces);
+    const auto meshGroupIdx = scene.sceneBuilder.createMeshGroup(std::to_array({PlacedMesh{.meshIdx = meshIdx}}));
+    addInstance(scene.sceneBuilder, meshGroupIdx, glm::mat4(1.f));
+
+    return scene;
+}
+
+// A wavy grid, so that the depth and the normals vary smoothly over the whole image:
+static TestScene createHeightfieldScene()
+{
+    TestScene scene{.name = "heightfield"};
+
+    constexpr uint32_t RESOLUTION = 64;
+
+    std::vector<glm::vec3> positions;
+    for (uint32_t y = 0; y <= RESOLUTION; ++y) {
+        for (uint32_t x = 0; x <= RESOLUTION; ++x) {
+            const float u = 1.8f * x / RESOLUTION - 0.9f;
+            const float v = 1.8f * y / RESOLUTION - 0.9f;
+            positions.emplace_back(u, v, 2.f + 0.15f * std::sin(4.f * u) * std::cos(3.f * v));
+        }
+    }
+
+    std::vector<glm::u32vec3> faces;
+    for (uint32_t y = 0; y < RESOLUTION; ++y) {
+        for (uint32_t x = 0; x < RESOLUTION; ++x) {
+            const uint32_t i = y * (RESOLUTION + 1) + x;
+            faces.emplace_back(i, i + 1, i + RESOLUTION + 1);
+            faces.emplace_back(i + 1, i + RESOLUTION + 2, i + RESOLUTION + 1);
+        }
+    }
+
+    const auto meshIdx      = scene.sceneBuilder.createMesh(positions, faces);
+    const auto meshGroupIdx = scene.sceneBuilder.createMeshGroup(std::to_array({PlacedMesh{.meshIdx = meshIdx}}));
+    addInstance(scene.sceneBuilder, meshGroupIdx, glm::mat4(1.f));
+
+    return scene;
+}
+
+// A grid of rotated and scaled instances of a mesh group with two spheres, one of them with a transform of its own:
+static TestScene createInstancesScene()
+{
+    TestScene scene{.name = "instances"};
+
+    const auto sphere = generateSphere(16, 32);
+
+    auto&      sceneBuilder = scene.sceneBuilder;
+    const auto meshIdx      = sceneBuilder.createMesh(sphere.positions, sphere.faces);
+    const auto transformIdx = sceneBuilder.createTransform(
+        Transform(glm::translate(glm::vec3(1.2f, 1.2f, -0.5f)) * glm::scale(glm::vec3(0.4f))));
+    const auto meshGroupIdx = sceneBuilder.createMeshGroup(std::to_array({
+        PlacedMesh{.meshIdx = meshIdx},
+        PlacedMesh{.meshIdx = meshIdx, .transformIdx = transformIdx},
+    }));
+
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            const float angle = 0.4f * (x + 3 * y);
+            addInstance(sceneBuilder, meshGroupIdx,
+                        glm::translate(glm::vec3(0.6f * x, 0.6f * y, 2.f + 0.1f * x)) *
+                            glm::rotate(angle, glm::vec3(0.3f, 1.f, 0.2f)) * glm::scale(glm::vec3(0.1f + 0.02f * y)));
+        }
+    }
+
+    return scene;
+}
+
+// The instances seen from a camera that orbits their center, so that the camera transform is covered as well:
+static TestScene createOrbitingCameraScene()
+{
+    TestScene scene = createInstancesScene();
+    scene.name      = "orbiting_camera";
+
+    const glm::vec3 center(0.f, 0.f, 2.f);
+    scene.cameraToWorld = glm::translate(center) * glm::rotate(0.5f, glm::vec3(0.2f, 1.f, 0.f)) *
+                          glm::translate(-center) * glm::scale(glm::vec3(1.2f));
+    return scene;
+}
+
+// A few of the generated spheres in random orientations, scaled down to fit into the view:
+static TestScene createRandomInstancesScene()
+{
+    TestScene scene{.name = "random_instances"};
+    const ProceduralSceneParam param{
+        .numTriangles   = 2000,
+        .numMeshes      = 2,
+        .numMeshGroups  = 2,
+        .meshesPerGroup = 2,
+        .numInstances   = 64,
+        .layout         = InstanceLayout::eRandom,
+        .sceneTransform = glm::translate(glm::vec3(0.f, 0.f, 3.f)) * glm::scale(glm::vec3(0.12f)),
+    };
+    createProceduralScene(scene.sceneBuilder, param);
+
+    return scene;
+}
+
+// Any meshes passed on the command line are rendered as a single instance without a transform:
+static TestScene createMeshScene(const std::string_view path)
+{
+    TestScene scene{.name = std::filesystem::path(path).stem().string()};
+
+    const auto meshIdx      = scene.sceneBuilder.createMesh(path);
+    const auto meshGroupIdx = scene.sceneBuilder.createMeshGroup(std::to_array({PlacedMesh{.meshIdx = meshIdx}}));
+    addInstance(scene.sceneBuilder, meshGroupIdx, glm::mat4(1.f));
+
+    return scene;
+}
+
+//
+// Rendering:
+
+struct RenderResult
+{
+    std::vector<glm::vec3> beauty;
+    std::vector<float>     depth;
+    std::vector<glm::vec3> normals;
+
+    double milliseconds = std::numeric_limits<double>::infinity();
+};
+
+constexpr size_t NUM_PIXELS = size_t(OUTPUT_WIDTH) * OUTPUT_HEIGHT;
+
+static AovSet outputAovs()
+{
+    AovSet aovs{};
+    aovs[aovDEPTH]  = true;
+    aovs[aovNORMAL] = true;
+    return aovs;
+}
+
+// Converts the AOVs from the format the shaders write them in:
+static void decodeAovs(RenderResult& result, const std::span<const std::byte> depth,
+                       const std::span<const std::byte> normals)
+{
+    result.depth.resize(NUM_PIXELS);
+    std::memcpy(result.depth.data(), depth.data(), NUM_PIXELS * sizeof(float));
+
+    result.normals.resize(NUM_PIXELS);
+    decodeOctahedralNormals(normals, result.normals);
+}
+
+// Runs func NUM_REPETITIONS times and returns the best time:
+static double bestTime(const std::function<void()>& func)
+{
+    double best = std::numeric_limits<double>::infinity();
+    for (int repetition = 0; repetition < NUM_REPETITIONS; ++repetition) {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+        best = std::min(best, duration.count());
+    }
+    return best;
+}
+
+static RenderResult renderCpu(const TestScene& testScene)
+{
+    const cpu::Scene scene(testScene.sceneBuilder);
+
+    RenderResult      result;
+    cpu::RenderOutput output;
+    result.milliseconds = bestTime([&]() {
+        output = cpu::render(scene, {
+                                        .outputWidth   = OUTPUT_WIDTH,
+                                        .outputHeight  = OUTPUT_HEIGHT,
+                                        .aovs          = outputAovs(),
+                                        .cameraToWorld = testScene.cameraToWorld,
+                                    });
+    });
+
+    result.beauty = std::move(output.beauty);
+    decodeAovs(result, output.aovs[aovDEPTH], output.aovs[aovNORMAL]);
+    return result;
+}
+
+// The timings include the copies back to the host, the results are decoded after the last repetition:
+static RenderResult renderGpu(const Context& context, const GPUAllocator& allocator, const TestScene& testScene)
+{
+    const Scene     scene({}, context, allocator, testScene.sceneBuilder);
+    const Pipelines pipeline(
+        {
+            .outputWidth  = OUTPUT_WIDTH,
+            .outputHeight = OUTPUT_HEIGHT,
+            .aovs         = outputAovs(),
+            .beautyFormat = BeautyFormat::eRGB32F,
+        },
+        context, allocator, scene);
+
+    const auto readbackSizes = std::to_array<vk::DeviceSize>({
+        beautyPixelSize(pipeline.getBeautyFormat()) * NUM_PIXELS,
+        aovPixelSize(aovDEPTH) * NUM_PIXELS,
+        aovPixelSize(aovNORMAL) * NUM_PIXELS,
+    });
+    const auto readbackSrcs  = std::to_array({
+        pipeline.getBeautyBuffer(),
+        pipeline.getAovBuffer(aovDEPTH),
+        pipeline.getAovBuffer(aovNORMAL),
+    });
+
+    Readback readback(context, allocator, readbackSizes);
+
+    RenderResult result;
+    result.milliseconds = bestTime([&]() {
+        readback.submit(
+            [&](const vk::CommandBuffer& commandBuffer) {
+                pipeline.addBindRTPipelineCmd(commandBuffer, {
+                                                                 .width         = OUTPUT_WIDTH,
+                                                                 .height        = OUTPUT_HEIGHT,
+                                                                 .cameraToWorld = testScene.cameraToWorld,
+                                                             });
+            },
+            readbackSrcs,
+            [&](std::span<const std::span<const std::byte>> data) {
+                result.beauty.resize(NUM_PIXELS);
+                decodeBeauty(data[0], pipeline.getBeautyFormat(), result.beauty);
+                decodeAovs(result, data[1], data[2]);
+            });
+        readback.wait();
+    });
+
+    return result;
+}
+
+// Tiles that don't divide the output, so that the partial tiles along the right and bottom edges are covered as well:
+constexpr uint32_t TILE_WIDTH  = 200;
+constexpr uint32_t TILE_HEIGHT = 120;
+
+// Renders into an EXR with renderTiled, untiled pipelines are rendered as a single tile the size of the output:
+static std::filesystem::path renderGpuToExr(const Context& context, const GPUAllocator& allocator, const Scene& scene,
+                                            const std::string& name, const bool tiled)
+{
+    const Pipelines pipeline(
+        {
+            .outputWidth  = OUTPUT_WIDTH,
+            .outputHeight = OUTPUT_HEIGHT,
+            .aovs         = outputAovs(),
+            .beautyFormat = BeautyFormat::eRGB32F,
+            .tileWidth    = tiled ? TILE_WIDTH : 0,
+            .tileHeight   = tiled ? TILE_HEIGHT : 0,
+        },
+        context, allocator, scene);
+
+    const auto path = std::filesystem::temp_directory_path() / (name + (tiled ? "_tiled.exr" : "_untiled.exr"));
+    renderTiled({.outputPath = path}, context, allocator, pipeline);
+    return path;
+}
+
+static std::vector<char> readFile(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not open the file at: " + path.string());
+    }
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Tiling only changes which launch a pixel is traced by, not its ray, so both files have to be identical (the EXRs are
+// uncompressed with the same layout). Returns true if they are:
+static bool compareTiled(const Context& context, const GPUAllocator& allocator, const TestScene& testScene)
+{
+    const Scene scene({}, context, allocator, testScene.sceneBuilder);
+
+    const auto untiledPath = renderGpuToExr(context, allocator, scene, testScene.name, false);
+    const auto tiledPath   = renderGpuToExr(context, allocator, scene, testScene.name, true);
+
+    const auto untiled = readFile(untiledPath);
+    const auto tiled   = readFile(tiledPath);
+
+    // Bytes missing from either file count as different:
+    size_t numDifferentBytes = std::max(untiled.size(), tiled.size()) - std::min(untiled.size(), tiled.size());
+    for (size_t i = 0; i < std::min(untiled.size(), tiled.size()); ++i) {
+        numDifferentBytes += untiled[i] != tiled[i] ? 1 : 0;
+    }
+    const bool passed = numDifferentBytes == 0;
+
+    spdlog::log(passed ? spdlog::level::info : spdlog::level::err, "{} tiled ({}x{}): {} of {} bytes differ: {}",
+                testScene.name, TILE_WIDTH, TILE_HEIGHT, numDifferentBytes, untiled.size(),
+                passed ? "passed" : "FAILED");
+
+    // Both files are kept to make it easier to see what went wrong:
+    if (passed) {
+        std::filesystem::remove(untiledPath);
+        std::filesystem::remove(tiledPath);
+    }
+    return passed;
+}
+
+//
+// Comparison:
+
+template <typename T>
+static std::span<const float> asFloats(const std::vector<T>& values)
+{
+    static_assert(sizeof(T) % sizeof(float) == 0, "Only float based types can be compared.");
+    return std::span(reinterpret_cast<const float*>(values.data()), values.size() * sizeof(T) / sizeof(float));
+}
+
+// Returns true if the outputs match closely enough:
+static bool compareOutput(const std::string& sceneName, const char* outputName, const std::span<const float> cpu,
+                          const std::span<const float> gpu)
+{
+    const auto   difference      = compareImages(gpu, cpu, OUTLIER_THRESHOLD);
+    const double outlierFraction = static_cast<double>(difference.numOutliers) / gpu.size();
+    const bool   passed          = difference.rmse <= MAX_RMSE && outlierFraction <= MAX_OUTLIER_FRACTION;
+
+    spdlog::log(passed ? spdlog::level::info : spdlog::level::err,
+                "{} {}: RMSE {:.3g}, mean relative error {:.3g}, max relative error {:.3g}, {:.4f}% outliers: {}",
+                sceneName, outputName, difference.rmse, difference.meanRelativeError, difference.maxRelativeError,
+                100.0 * outlierFraction, passed ? "passed" : "FAILED");
+
+    return passed;
+}
+
+struct Options
+{
+    bool                          cpuOnly    = false;
+    bool                          requireGpu = false;
+    std::optional<std::string>    timingsPath; // Timings are appended to this CSV file
+    std::vector<std::string_view> meshPaths;
+};
+
+static Options parseOptions(const int argc, const char** const argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if (arg == "--cpu-only") {
+            options.cpuOnly = true;
+        } else if (arg == "--require-gpu") {
+            options.requireGpu = true;
+        } else if (arg == "--timings") {
+            if (++i == argc) {
+                throw std::runtime_error("--timings requires a path");
+            }
+            options.timingsPath = argv[i];
+        } else {
+            options.meshPaths.push_back(arg);
+        }
+    }
+    return options;
+}
+
+int main(const int argc, const char** const argv)
+{
+    try {
+        const auto options = parseOptions(argc, argv);
+
+        std::vector<TestScene> scenes;
+        scenes.push_back(createTriangleScene());
+        scenes.push_back(createHeightfieldScene());
+        scenes.push_back(createInstancesScene());
+        scenes.push_back(createOrbitingCameraScene());
+        scenes.push_back(createRandomInstancesScene());
+        for (const auto path : options.meshPaths) {
+            scenes.push_back(createMeshScene(path));
+        }
+
+        // The device is only created once for all of the scenes:
+        std::optional<Context>      context;
+        std::optional<GPUAllocator> allocator;
+        if (!options.cpuOnly) {
+            try {
+                context.emplace(ContextParam{.enableValidation = true, .enableCallback = true});
+                allocator.emplace(*context);
+            } catch (const std::exception& e) {
+                if (options.requireGpu) {
+                    throw;
+                }
+                spdlog::warn("Skipping the Vulkan renders, couldn't create a context: {}", e.what());
+            }
+        }
+
+        std::ofstream timingsFile;
+        if (options.timingsPath) {
+            const bool writeHeader = !std::filesystem::exists(*options.timingsPath);
+            timingsFile.open(*options.timingsPath, std::ios::app);
+            if (!timingsFile.is_open()) {
+                throw std::runtime_error("Could not open the timings file at: " + *options.timingsPath);
+            }
+            if (writeHeader) {
+                timingsFile << "scene,cpu_ms,gpu_ms,passed\n";
+            }
+        }
+
+        bool allPassed = true;
+        for (const auto& scene : scenes) {
+            const auto cpuResult = renderCpu(scene);
+            if (!context) {
+                spdlog::info("{}: CPU {:.2f} ms", scene.name, cpuResult.milliseconds);
+                if (timingsFile.is_open()) {
+                    timingsFile << scene.name << "," << cpuResult.milliseconds << ",,\n";
+                }
+                continue;
+            }
+
+            const auto gpuResult = renderGpu(*context, *allocator, scene);
+            spdlog::info("{}: CPU {:.2f} ms, Vulkan {:.2f} ms", scene.name, cpuResult.milliseconds,
+                         gpuResult.milliseconds);
+
+            // The Vulkan output is used as the reference:
+            const bool beautyPassed =
+                compareOutput(scene.name, "beauty", asFloats(cpuResult.beauty), asFloats(gpuResult.beauty));
+            const bool depthPassed =
+                compareOutput(scene.name, "depth", asFloats(cpuResult.depth), asFloats(gpuResult.depth));
+            const bool normalPassed =
+                compareOutput(scene.name, "normal", asFloats(cpuResult.normals), asFloats(gpuResult.normals));
+            const bool passed = beautyPassed && depthPassed && normalPassed;
+
+            // Both renders are written out to make it easier to see what went wrong:
+            if (!passed) {
+                const glm::uvec2 resolution(OUTPUT_WIDTH, OUTPUT_HEIGHT);
+                writePNG(scene.name + "_cpu.png", toneMap(cpuResult.beauty, resolution));
+                writePNG(scene.name + "_gpu.png", toneMap(gpuResult.beauty, resolution));
+            }
+
+            if (timingsFile.is_open()) {
+                timingsFile << scene.name << "," << cpuResult.milliseconds << "," << gpuResult.milliseconds << ","
+                            << (passed ? 1 : 0) << "\n";
+            }
+            allPassed = allPassed && passed;
+        }
+
+        // The tiled path is only checked on one of the scenes, it doesn't depend on the geometry:
+        if (context) {
+            allPassed = compareTiled(*context, *allocator, scenes[1]) && allPassed;
+        }
+
+        if (!allPassed) {
+            spdlog::error("The CPU and Vulkan renders diverged (or the tiled and untiled renders did)");
+            return 1;
+        }
+        if (!context && !options.cpuOnly) {
+            spdlog::warn("Only the CPU renders ran, nothing was compared");
+            return SKIPPED_EXIT_CODE;
+        }
+    } catch (const std::exception& e) {
+        spdlog::error("Caught exception: {}", e.what());
+        return 1;
+    }
+
+    std::cout << "Done!\n";
+    return 0;
+}
\ No newline at end of file
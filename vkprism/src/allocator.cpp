@@ -1,5 +1,7 @@
 #include "allocator.hpp"
 
+#include <array>
+
 namespace prism {
 
 GPUAllocator::UniqueVmaAllocator GPUAllocator::createVmaAllocator(const Context& context)
@@ -56,19 +58,27 @@ GPUAllocator::UniqueVmaAllocator GPUAllocator::createVmaAllocator(const Context&
 GPUAllocator::GPUAllocator(const Context& context) : m_vmaAllocator(createVmaAllocator(context)) {}
 
 UniqueBuffer GPUAllocator::allocateBuffer(const vk::BufferCreateInfo&    bufferCreateInfo,
-                                          const VmaAllocationCreateInfo& allocCreateInfo) const
+                                          const VmaAllocationCreateInfo& allocCreateInfo,
+                                          const MemoryCategory           category) const
 {
     const VkBufferCreateInfo& convBufferCreateInfo = bufferCreateInfo;
 
-    VkBuffer      buffer;
-    VmaAllocation allocation;
-    vmaCreateBuffer(m_vmaAllocator.get(), &convBufferCreateInfo, &allocCreateInfo, &buffer, &allocation, nullptr);
+    VkBuffer          buffer;
+    VmaAllocation     allocation;
+    VmaAllocationInfo allocationInfo{};
+    vmaCreateBuffer(m_vmaAllocator.get(), &convBufferCreateInfo, &allocCreateInfo, &buffer, &allocation,
+                    &allocationInfo);
+
+    // The allocation may be larger than the buffer (alignment), which is what ends up in the budget:
+    if (buffer) {
+        m_memoryTracker.add(category, allocationInfo.size);
+    }
 
-    return UniqueBuffer(buffer, allocation, m_vmaAllocator.get());
+    return UniqueBuffer(buffer, allocation, m_vmaAllocator.get(), &m_memoryTracker, category, allocationInfo.size);
 }
 
-UniqueBuffer GPUAllocator::allocateBuffer(size_t size, vk::BufferUsageFlags bufferUsage,
-                                          VmaMemoryUsage memoryUsage) const
+UniqueBuffer GPUAllocator::allocateBuffer(size_t size, vk::BufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage,
+                                          const MemoryCategory category) const
 {
     return allocateBuffer(
         vk::BufferCreateInfo{
@@ -77,7 +87,53 @@ UniqueBuffer GPUAllocator::allocateBuffer(size_t size, vk::BufferUsageFlags buff
         },
         VmaAllocationCreateInfo{
             .usage = memoryUsage,
+        },
+        category);
+}
+
+MemoryReport GPUAllocator::memoryReport() const
+{
+    MemoryReport report;
+
+    for (uint32_t i = 0; i < NUM_MEMORY_CATEGORIES; ++i) {
+        const auto category = static_cast<MemoryCategory>(i);
+        report.gpu.push_back(MemoryUsage{
+            .name         = std::string(memoryCategoryName(category)),
+            .currentBytes = m_memoryTracker.current(category),
+            .peakBytes    = m_memoryTracker.peak(category),
         });
+    }
+    report.gpu.push_back(MemoryUsage{
+        .name         = "total",
+        .currentBytes = m_memoryTracker.currentTotal(),
+        .peakBytes    = m_memoryTracker.peakTotal(),
+    });
+
+    // Walks every allocation, which is fine for a report but shouldn't be done every frame:
+    VmaStats stats{};
+    vmaCalculateStats(m_vmaAllocator.get(), &stats);
+    report.gpuBlockCount      = stats.total.blockCount;
+    report.gpuAllocationCount = stats.total.allocationCount;
+    report.gpuUnusedBytes     = stats.total.unusedBytes;
+
+    const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+    vmaGetMemoryProperties(m_vmaAllocator.get(), &memoryProperties);
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+    vmaGetBudget(m_vmaAllocator.get(), budgets.data());
+
+    for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; ++i) {
+        report.heaps.push_back(MemoryHeapUsage{
+            .heapIdx         = i,
+            .deviceLocal     = (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+            .blockBytes      = budgets[i].blockBytes,
+            .allocationBytes = budgets[i].allocationBytes,
+            .usage           = budgets[i].usage,
+            .budget          = budgets[i].budget,
+        });
+    }
+
+    return report;
 }
 
 } // namespace prism
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <vulkan/vulkan.hpp>
 
 #include <context.hpp>
+#include <memory_report.hpp>
 
 namespace prism {
 
@@ -19,7 +20,12 @@ class UniqueBuffer
     UniqueBuffer() = default;
 
     UniqueBuffer(UniqueBuffer&& other) noexcept :
-        m_buffer(other.m_buffer), m_allocation(other.m_allocation), m_allocator(other.m_allocator)
+        m_buffer(other.m_buffer),
+        m_allocation(other.m_allocation),
+        m_allocator(other.m_allocator),
+        m_tracker(other.m_tracker),
+        m_category(other.m_category),
+        m_size(other.m_size)
     {
         // After moving, the object should be in a valid state (due to destructors...).
         // In most cases, the compiler should be able to optimize this out (when returning a UniqueBuffer from a
@@ -33,9 +39,15 @@ class UniqueBuffer
             return *this;
         }
 
+        // The buffer that is overwritten has to be released first:
+        destroy();
+
         m_buffer       = other.m_buffer;
         m_allocation   = other.m_allocation;
         m_allocator    = other.m_allocator;
+        m_tracker      = other.m_tracker;
+        m_category     = other.m_category;
+        m_size         = other.m_size;
         other.m_buffer = VK_NULL_HANDLE;
         return *this;
     }
@@ -43,17 +55,13 @@ class UniqueBuffer
     UniqueBuffer(const UniqueBuffer&) = delete;
     UniqueBuffer& operator=(const UniqueBuffer&) = delete;
 
-    ~UniqueBuffer()
-    {
-        if (m_buffer) {
-            vmaDestroyBuffer(m_allocator, m_buffer, m_allocation);
-        }
-    }
+    ~UniqueBuffer() { destroy(); }
 
     vk::Buffer operator*() const { return get(); }
                operator bool() const { return m_buffer; }
 
     vk::Buffer        get() const { return m_buffer; }
+    vk::DeviceSize    allocationSize() const { return m_size; }
     vk::DeviceAddress deviceAddress(const vk::Device& device) const
     {
         return device.getBufferAddress(vk::BufferDeviceAddressInfo{
@@ -71,15 +79,44 @@ class UniqueBuffer
 
     void unmap() const { vmaUnmapMemory(m_allocator, m_allocation); }
 
+    // Required before reading mapped memory written by the device if it isn't host coherent (no-op otherwise):
+    void invalidate(vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE) const
+    {
+        vkCall(vmaInvalidateAllocation(m_allocator, m_allocation, offset, size));
+    }
+    // Required after writing to mapped memory read by the device if it isn't host coherent (no-op otherwise):
+    void flush(vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE) const
+    {
+        vkCall(vmaFlushAllocation(m_allocator, m_allocation, offset, size));
+    }
+
   private:
     friend class GPUAllocator;
-    UniqueBuffer(VkBuffer buffer, VmaAllocation allocation, VmaAllocator allocator) :
-        m_buffer(buffer), m_allocation(allocation), m_allocator(allocator)
+    UniqueBuffer(VkBuffer buffer, VmaAllocation allocation, VmaAllocator allocator, MemoryTracker* tracker,
+                 MemoryCategory category, vk::DeviceSize size) :
+        m_buffer(buffer),
+        m_allocation(allocation),
+        m_allocator(allocator),
+        m_tracker(tracker),
+        m_category(category),
+        m_size(size)
     {}
 
-    vk::Buffer    m_buffer;
-    VmaAllocation m_allocation = nullptr;
-    VmaAllocator  m_allocator  = nullptr;
+    void destroy()
+    {
+        if (m_buffer) {
+            vmaDestroyBuffer(m_allocator, m_buffer, m_allocation);
+            m_tracker->remove(m_category, m_size);
+            m_buffer = VK_NULL_HANDLE;
+        }
+    }
+
+    vk::Buffer     m_buffer;
+    VmaAllocation  m_allocation = nullptr;
+    VmaAllocator   m_allocator  = nullptr;
+    MemoryTracker* m_tracker    = nullptr;
+    MemoryCategory m_category   = MemoryCategory::eOther;
+    vk::DeviceSize m_size       = 0;
 };
 
 class GPUAllocator
@@ -89,9 +126,16 @@ class GPUAllocator
     GPUAllocator(const GPUAllocator&) = delete;
     GPUAllocator(GPUAllocator&&)      = delete;
 
+    // The category is only used to account for the memory in memoryReport:
     UniqueBuffer allocateBuffer(const vk::BufferCreateInfo&    bufferCreateInfo,
-                                const VmaAllocationCreateInfo& allocCreateInfo) const;
-    UniqueBuffer allocateBuffer(size_t size, vk::BufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage) const;
+                                const VmaAllocationCreateInfo& allocCreateInfo,
+                                MemoryCategory                 category = MemoryCategory::eOther) const;
+    UniqueBuffer allocateBuffer(size_t size, vk::BufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage,
+                                MemoryCategory category = MemoryCategory::eOther) const;
+
+    // Device memory of every category (current and peak), along with the statistics and budgets VMA has for every
+    // heap. The host entries are left for the caller to fill in:
+    MemoryReport memoryReport() const;
 
   private:
     using UniqueVmaAllocator = CustomUniquePtr<std::remove_pointer_t<VmaAllocator>, vmaDestroyAllocator>;
@@ -99,6 +143,8 @@ class GPUAllocator
     static UniqueVmaAllocator createVmaAllocator(const Context& context);
 
     UniqueVmaAllocator m_vmaAllocator;
+
+    mutable MemoryTracker m_memoryTracker;
 };
 
 // Adds the copy to buffer command, returning the temporary buffer used so that we can properly deallocate it when
@@ -110,8 +156,8 @@ template <typename T>
 {
     const auto srcSize = srcData.size() * sizeof(T::value_type);
 
-    auto stagingBuffer =
-        gpuAllocator.allocateBuffer(srcSize, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY);
+    auto stagingBuffer = gpuAllocator.allocateBuffer(srcSize, vk::BufferUsageFlagBits::eTransferSrc,
+                                                     VMA_MEMORY_USAGE_CPU_ONLY, MemoryCategory::eStaging);
 
     // Copy data to the staging buffer:
     std::ranges::copy(srcData, stagingBuffer.map<T::value_type>());
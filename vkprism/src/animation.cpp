@@ -0,0 +1,106 @@
+#include "animation.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#include <glm/common.hpp>
+
+#include <profiler.hpp>
+#include <util.hpp>
+
+namespace prism {
+
+//
+// TransformTrack
+//
+
+void TransformTrack::addKeyframe(const float time, const Transform& transform)
+{
+    const TransformKeyframe keyframe{.time = time, .trs = transform.decompose()};
+
+    const auto itr = std::ranges::lower_bound(m_keyframes, time, {}, &TransformKeyframe::time);
+    if (itr != m_keyframes.end() && itr->time == time) {
+        *itr = keyframe;
+    } else {
+        m_keyframes.insert(itr, keyframe);
+    }
+}
+
+Transform TransformTrack::evaluate(const float time) const
+{
+    if (m_keyframes.empty()) {
+        throw std::runtime_error("Can't evaluate a transform track without any keyframes");
+    }
+
+    // The first keyframe after the time:
+    const auto next = std::ranges::upper_bound(m_keyframes, time, {}, &TransformKeyframe::time);
+    if (next == m_keyframes.begin()) {
+        return Transform(next->trs);
+    }
+    const auto prev = std::prev(next);
+    if (next == m_keyframes.end() || m_interpolation == Interpolation::eStep) {
+        return Transform(prev->trs);
+    }
+
+    const float t = (time - prev->time) / (next->time - prev->time);
+
+    // Takes the shortest path between the two rotations:
+    const glm::quat nextRotation =
+        glm::dot(prev->trs.rotation, next->trs.rotation) < 0.f ? -next->trs.rotation : next->trs.rotation;
+
+    return Transform(TRS{
+        .translation = glm::mix(prev->trs.translation, next->trs.translation, t),
+        .rotation    = m_interpolation == Interpolation::eSlerp
+                           ? glm::slerp(prev->trs.rotation, nextRotation, t)
+                           : glm::normalize(glm::lerp(prev->trs.rotation, nextRotation, t)),
+        .scale       = glm::mix(prev->trs.scale, next->trs.scale, t),
+    });
+}
+
+//
+// Animation
+//
+
+void Animation::setInstanceTrack(const InstanceIndex instanceIdx, TransformTrack track)
+{
+    const auto itr = std::ranges::find_if(m_instanceTracks, [&](const auto& instanceTrack) {
+        return static_cast<uint32_t>(instanceTrack.first) == static_cast<uint32_t>(instanceIdx);
+    });
+    if (itr != m_instanceTracks.end()) {
+        itr->second = std::move(track);
+    } else {
+        m_instanceTracks.emplace_back(instanceIdx, std::move(track));
+    }
+}
+
+void Animation::applyInstances(const float time, Scene& scene) const
+{
+    PRISM_PROFILE_SCOPE("animation/apply_instances");
+
+    // Every instance has at most one track, so no two tasks set the same instance:
+    parallelFor(m_instanceTracks.size(), 256, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const auto& [instanceIdx, track] = m_instanceTracks[i];
+            if (!track.empty()) {
+                scene.setInstanceTransform(instanceIdx, track.evaluate(time));
+            }
+        }
+    });
+}
+
+glm::mat4 Animation::cameraToWorld(const float time) const
+{
+    return m_cameraTrack && !m_cameraTrack->empty() ? m_cameraTrack->evaluate(time).matrix() : glm::mat4(1.f);
+}
+
+float Animation::endTime() const
+{
+    float endTime = m_cameraTrack ? m_cameraTrack->endTime() : 0.f;
+    for (const auto& [_, track] : m_instanceTracks) {
+        endTime = std::max(endTime, track.endTime());
+    }
+    return endTime;
+}
+
+} // namespace prism
\ No newline at end of file
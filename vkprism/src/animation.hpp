@@ -0,0 +1,76 @@
+#pragma once
+
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+#include <scene.hpp>
+#include <transform.hpp>
+
+namespace prism {
+
+// How a track interpolates between two keyframes. The translation and the scale are always interpolated linearly, the
+// rotation either linearly (followed by a normalization, which doesn't have a constant angular velocity but is cheaper)
+// or spherically:
+enum class Interpolation
+{
+    eStep,   // Holds the previous keyframe
+    eLinear, // Normalized linear interpolation of the rotation
+    eSlerp,  // Spherical linear interpolation of the rotation
+};
+
+struct TransformKeyframe
+{
+    float time; // In seconds
+    TRS   trs;
+};
+
+// A keyframed transform. Before the first and after the last keyframe the transform is held constant:
+class TransformTrack
+{
+  public:
+    TransformTrack(Interpolation interpolation = Interpolation::eSlerp) : m_interpolation(interpolation) {}
+
+    // Keyframes can be added in any order, adding one at the time of an existing keyframe replaces it. Throws if the
+    // transform can't be decomposed (see Transform::decompose):
+    void addKeyframe(float time, const Transform& transform);
+
+    // Throws if the track doesn't have any keyframes:
+    Transform evaluate(float time) const;
+
+    bool  empty() const { return m_keyframes.empty(); }
+    float startTime() const { return m_keyframes.empty() ? 0.f : m_keyframes.front().time; }
+    float endTime() const { return m_keyframes.empty() ? 0.f : m_keyframes.back().time; }
+
+  private:
+    Interpolation                  m_interpolation;
+    std::vector<TransformKeyframe> m_keyframes; // Sorted by time
+};
+
+// The tracks of every animated instance and of the camera. Instances without a track keep whatever transform they have
+// in the scene.
+class Animation
+{
+  public:
+    // Replaces the existing track of the instance:
+    void setInstanceTrack(InstanceIndex instanceIdx, TransformTrack track);
+    void setCameraTrack(TransformTrack track) { m_cameraTrack = std::move(track); }
+
+    // Evaluates the tracks of every animated instance and sets their transforms (split across the task system). The
+    // TLAS isn't touched until Scene::update is called:
+    void applyInstances(float time, Scene& scene) const;
+
+    // Identity if there isn't a camera track:
+    glm::mat4 cameraToWorld(float time) const;
+
+    // The time of the last keyframe of any track:
+    float endTime() const;
+
+  private:
+    std::vector<std::pair<InstanceIndex, TransformTrack>> m_instanceTracks;
+    std::optional<TransformTrack>                         m_cameraTrack;
+};
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "aov.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include <image.hpp>
+#include <shaders/octahedral.hpp>
+#include <util.hpp>
+
+namespace prism {
+
+uint32_t encodeOctahedralNormal(const glm::vec3 n)
+{
+    return shader::packSnorm2x16(shader::octahedral_encode(n));
+}
+
+glm::vec3 decodeOctahedralNormal(const uint32_t packed)
+{
+    return shader::octahedral_decode(shader::unpackSnorm2x16(packed));
+}
+
+void decodeOctahedralNormals(const std::span<const std::byte> packed, const std::span<glm::vec3> dst)
+{
+    parallelFor(dst.size(), 1 << 14, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t bits;
+            std::memcpy(&bits, packed.data() + i * sizeof(uint32_t), sizeof(uint32_t));
+            dst[i] = decodeOctahedralNormal(bits);
+        }
+    });
+}
+
+std::vector<ExrChannel> aovExrChannels(const AovSet& aovs, const glm::vec3* beauty,
+                                       const std::array<const std::byte*, TOTAL_NUM_AOVS>& aovData)
+{
+    const auto* beautyPtr = reinterpret_cast<const std::byte*>(beauty);
+
+    // Pointers are only offset if the data was actually provided:
+    const auto offset = [](const std::byte* data, const size_t offset) { return data ? data + offset : nullptr; };
+
+    std::vector<ExrChannel> channels;
+    const auto addChannel = [&](const char* name, const ExrPixelType type, const std::byte* data, const size_t stride) {
+        channels.emplace_back(ExrChannel{.name = name, .type = type, .data = data, .stride = stride});
+    };
+
+    addChannel("R", ExrPixelType::eFloat, beautyPtr, sizeof(glm::vec3));
+    addChannel("G", ExrPixelType::eFloat, offset(beautyPtr, 4), sizeof(glm::vec3));
+    addChannel("B", ExrPixelType::eFloat, offset(beautyPtr, 8), sizeof(glm::vec3));
+
+    if (aovs[aovDEPTH]) {
+        addChannel("depth.Z", ExrPixelType::eFloat, aovData[aovDEPTH], sizeof(float));
+    }
+    // EXR has no notion of octahedral normals, so these are expected to be decoded already:
+    if (aovs[aovNORMAL]) {
+        const auto* normals = aovData[aovNORMAL];
+        addChannel("normal.X", ExrPixelType::eFloat, normals, sizeof(glm::vec3));
+        addChannel("normal.Y", ExrPixelType::eFloat, offset(normals, 4), sizeof(glm::vec3));
+        addChannel("normal.Z", ExrPixelType::eFloat, offset(normals, 8), sizeof(glm::vec3));
+    }
+    // Albedo is already stored as RGBA16F, which EXR supports directly:
+    if (aovs[aovALBEDO]) {
+        const auto* albedo = aovData[aovALBEDO];
+        addChannel("albedo.R", ExrPixelType::eHalf, albedo, aovPixelSize(aovALBEDO));
+        addChannel("albedo.G", ExrPixelType::eHalf, offset(albedo, 2), aovPixelSize(aovALBEDO));
+        addChannel("albedo.B", ExrPixelType::eHalf, offset(albedo, 4), aovPixelSize(aovALBEDO));
+    }
+    if (aovs[aovINSTANCE_ID]) {
+        addChannel("instanceId.id", ExrPixelType::eUint, aovData[aovINSTANCE_ID], sizeof(uint32_t));
+    }
+    if (aovs[aovPRIMITIVE_ID]) {
+        addChannel("primitiveId.id", ExrPixelType::eUint, aovData[aovPRIMITIVE_ID], sizeof(uint32_t));
+    }
+    if (aovs[aovSAMPLE_COUNT]) {
+        addChannel("sampleCount.count", ExrPixelType::eUint, aovData[aovSAMPLE_COUNT], sizeof(uint32_t));
+    }
+
+    return channels;
+}
+
+void writeAovEXR(const std::filesystem::path& path, const glm::uvec2 resolution,
+                 const std::span<const glm::vec3>                    beauty,
+                 const std::array<const std::byte*, TOTAL_NUM_AOVS>& aovs)
+{
+    const size_t numPixels = size_t(resolution.x) * resolution.y;
+
+    AovSet aovSet{};
+    for (uint32_t aov = 0; aov < TOTAL_NUM_AOVS; ++aov) {
+        aovSet[aov] = aovs[aov] != nullptr;
+    }
+
+    auto                   aovData = aovs;
+    std::vector<glm::vec3> normals;
+    if (aovs[aovNORMAL]) {
+        normals.resize(numPixels);
+        decodeOctahedralNormals(std::span(aovs[aovNORMAL], numPixels * aovPixelSize(aovNORMAL)), normals);
+        aovData[aovNORMAL] = reinterpret_cast<const std::byte*>(normals.data());
+    }
+
+    writeEXR(path, resolution, aovExrChannels(aovSet, beauty.data(), aovData));
+}
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <image.hpp>
+#include <shaders/aov.hpp>
+
+namespace prism {
+
+// The AOVs (arbitrary output variables) that can be rendered on top of the beauty output:
+enum AovType : uint32_t
+{
+    aovDEPTH,
+    aovNORMAL,
+    aovALBEDO,
+    aovINSTANCE_ID,
+    aovPRIMITIVE_ID,
+    aovSAMPLE_COUNT,
+    TOTAL_NUM_AOVS
+};
+
+// The binding of the AOV in the output buffer descriptor, which is also the id of the specialization constant:
+constexpr uint32_t aovBinding(const AovType aov) { return aov + 1; }
+
+static_assert(aovBinding(aovDEPTH) == AOV_DEPTH && aovBinding(aovNORMAL) == AOV_NORMAL &&
+                  aovBinding(aovALBEDO) == AOV_ALBEDO && aovBinding(aovINSTANCE_ID) == AOV_INSTANCE_ID &&
+                  aovBinding(aovPRIMITIVE_ID) == AOV_PRIMITIVE_ID && aovBinding(aovSAMPLE_COUNT) == AOV_SAMPLE_COUNT,
+              "AovType doesn't match the AOV definitions in the shaders.");
+
+// The size of a single pixel of the AOV as written by the shaders:
+constexpr size_t aovPixelSize(const AovType aov)
+{
+    switch (aov) {
+    case aovALBEDO:
+        return 2 * sizeof(uint32_t); // RGBA16F
+    case aovDEPTH:                   // float
+    case aovNORMAL:                  // Octahedral 2x16-bit SNORM
+    case aovINSTANCE_ID:             // R32UI
+    case aovPRIMITIVE_ID:            // R32UI
+    case aovSAMPLE_COUNT:            // R32UI
+    default:
+        return sizeof(uint32_t);
+    }
+}
+
+// Which AOVs are enabled. Buffers are only allocated (and only written by the shaders) for the enabled AOVs.
+using AovSet = std::array<bool, TOTAL_NUM_AOVS>;
+
+// Encodes a direction the same way the shaders do (see shaders/octahedral.hpp), which is also how the normals and
+// tangents of compact vertices are stored:
+uint32_t encodeOctahedralNormal(glm::vec3 n);
+// Decodes an octahedral direction as written by the shaders (two SNORM16 values packed in a uint):
+glm::vec3 decodeOctahedralNormal(uint32_t packed);
+
+// Decodes a whole buffer of octahedral normals (split across all of the hardware threads):
+void decodeOctahedralNormals(std::span<const std::byte> packed, std::span<glm::vec3> dst);
+
+// The EXR channels of the beauty output followed by every enabled AOV. The beauty output is expected as linear RGB and
+// normals as decoded vec3s, every other AOV is in the format the shaders write it in. Data pointers are left null for
+// any buffer that isn't provided (which is enough to describe the channels of a MappedEXR).
+std::vector<ExrChannel> aovExrChannels(const AovSet& aovs, const glm::vec3* beauty = nullptr,
+                                       const std::array<const std::byte*, TOTAL_NUM_AOVS>& aovData = {});
+
+// Writes the beauty output and every AOV that isn't null into a single multi-layer EXR file. AOVs are expected to be in
+// the format the shaders write them in (which is also the format they are read back in).
+void writeAovEXR(const std::filesystem::path& path, glm::uvec2 resolution, std::span<const glm::vec3> beauty,
+                 const std::array<const std::byte*, TOTAL_NUM_AOVS>& aovs);
+
+} // namespace prism
\ No newline at end of file
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <limits>
 #include <numeric>
 
+#include <glm/common.hpp>
 #include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
 
 namespace prism {
 
@@ -22,4 +25,47 @@ using BBox2f = BBox2<float>;
 using BBox2i = BBox2<int>;
 using BBox2u = BBox2<unsigned>;
 
+template <typename T>
+struct BBox3
+{
+    // Starts out empty (inverted), so extending it with anything results in a valid box:
+    BBox3() : pmin(std::numeric_limits<T>::max()), pmax(std::numeric_limits<T>::lowest()) {}
+    BBox3(const glm::tvec3<T>& p0, const glm::tvec3<T>& p1) : pmin(glm::min(p0, p1)), pmax(glm::max(p0, p1)) {}
+
+    void extend(const glm::tvec3<T>& p)
+    {
+        pmin = glm::min(pmin, p);
+        pmax = glm::max(pmax, p);
+    }
+    void extend(const BBox3& bbox)
+    {
+        pmin = glm::min(pmin, bbox.pmin);
+        pmax = glm::max(pmax, bbox.pmax);
+    }
+
+    bool          empty() const { return pmin.x > pmax.x || pmin.y > pmax.y || pmin.z > pmax.z; }
+    glm::tvec3<T> diagonal() const { return pmax - pmin; }
+    glm::tvec3<T> center() const { return (pmin + pmax) / T(2); }
+
+    T surfaceArea() const
+    {
+        if (empty()) {
+            return T(0);
+        }
+        const auto d = diagonal();
+        return T(2) * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    // The axis with the largest extent:
+    int maxExtent() const
+    {
+        const auto d = diagonal();
+        return d.x > d.y && d.x > d.z ? 0 : (d.y > d.z ? 1 : 2);
+    }
+
+    glm::tvec3<T> pmin, pmax;
+};
+
+using BBox3f = BBox3<float>;
+
 } // namespace prism
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include <vulkan/vulkan.hpp>
 
 #include <configure.hpp>
+#include <gpu_profiler.hpp>
 #include <util.hpp>
 
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
@@ -213,6 +214,11 @@ Context::PhysicalDeviceInfo::PhysicalDeviceInfo(const vk::PhysicalDevice& physic
     if (bufferDeviceAddress != VK_TRUE) {
         throw std::runtime_error("bufferDeviceAddress isn't supported by the chosen physcial device.");
     }
+
+    // The hit shaders read the faces of small meshes with 16 bit indices:
+    if (features.get<vk::PhysicalDeviceVulkan11Features>().storageBuffer16BitAccess != VK_TRUE) {
+        throw std::runtime_error("storageBuffer16BitAccess isn't supported by the chosen physical device.");
+    }
 }
 
 Context::Context(const ContextParam& param) :
@@ -224,7 +230,14 @@ Context::Context(const ContextParam& param) :
     m_physDevInfo(createPhysicalDeviceInfo(*m_instance, param, m_reqDeviceExtensions)),
     m_device(createDevice(*m_instance, m_physDevInfo, m_reqDeviceExtensions)),
     m_queueInfo(createQueueInfo(*m_device, m_physDevInfo))
-{}
+{
+#ifdef PRISM_ENABLE_PROFILING
+    m_gpuProfiler = std::make_unique<GpuProfiler>(*this);
+#endif
+}
+
+// Defined here, where GpuProfiler is complete:
+Context::~Context() = default;
 
 void submitAndWait(const Context& context, vk::ArrayProxy<const vk::CommandBuffer> commandBuffers,
                    std::string_view description, uint64_t timeout)
@@ -252,4 +265,4 @@ void submitAndWait(const Context& context, vk::ArrayProxy<const vk::CommandBuffe
     }
 }
 
-} // namespace prism
+} // namespace prism
\ No newline at end of file
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include <functional>
+#include <memory>
 #include <optional>
 #include <span>
 #include <vector>
@@ -12,13 +13,15 @@
 
 namespace prism {
 
+class GpuProfiler;
+
 #define DEVICE_FEATURES_STRUCTURE                                                                                      \
     vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan12Features,               \
         vk::PhysicalDeviceAccelerationStructureFeaturesKHR, vk::PhysicalDeviceRayTracingPipelineFeaturesKHR
 
 #define DEVICE_PROPERTIES_STRUCTURE                                                                                    \
     vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan11Properties, vk::PhysicalDeviceVulkan12Properties,         \
-        vk::PhysicalDeviceRayTracingPipelinePropertiesKHR
+        vk::PhysicalDeviceRayTracingPipelinePropertiesKHR, vk::PhysicalDeviceAccelerationStructurePropertiesKHR
 
 using PhysicalDeviceFeatures   = vk::StructureChain<DEVICE_FEATURES_STRUCTURE>;
 using PhysicalDeviceProperties = vk::StructureChain<DEVICE_PROPERTIES_STRUCTURE>;
@@ -38,6 +41,7 @@ class Context
     explicit Context(const ContextParam& param);
     Context(const Context&) = delete;
     Context(Context&&)      = delete;
+    ~Context();
 
     const vk::Instance&       instance() const { return *m_instance; }
     const vk::PhysicalDevice& physicalDevice() const { return m_physDevInfo.physicalDevice; }
@@ -48,6 +52,9 @@ class Context
     const PhysicalDeviceFeatures&   features() const { return m_physDevInfo.features; }
     const PhysicalDeviceProperties& properties() const { return m_physDevInfo.properties; }
 
+    // Null unless the profiler was compiled in (PRISM_ENABLE_PROFILING):
+    GpuProfiler* gpuProfiler() const { return m_gpuProfiler.get(); }
+
   private:
     struct PhysicalDeviceInfo
     {
@@ -93,6 +100,9 @@ class Context
     vk::UniqueDevice   m_device;
 
     QueueInfo m_queueInfo;
+
+    // Uses the device, so it has to be destroyed first:
+    std::unique_ptr<GpuProfiler> m_gpuProfiler;
 };
 
 // The default fence timeout of 1 minute (not sure how long this should be...)
@@ -101,4 +111,4 @@ constexpr uint64_t FENCE_TIMEOUT = 6e+10;
 void submitAndWait(const Context& context, vk::ArrayProxy<const vk::CommandBuffer> commandBuffers,
                    std::string_view description = {}, uint64_t timeout = FENCE_TIMEOUT);
 
-} // namespace prism
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <task_system.hpp>
+
+namespace prism {
+namespace cpu {
+
+//
+// Building happens in two steps: a pointer based tree is built first (subtrees can be built in parallel that way) and
+// is then flattened into depth first order.
+
+struct BuildNode
+{
+    BBox3f   bounds;
+    uint32_t firstPrim = 0;
+    uint32_t numPrims  = 0;
+    uint8_t  axis      = 0;
+
+    std::unique_ptr<BuildNode> children[2];
+};
+
+struct BuildContext
+{
+    const BvhBuildParam&    param;
+    std::span<const BBox3f> primBounds;
+    std::span<uint32_t>     primIndices;
+};
+
+// Cost of traversing a node relative to intersecting a primitive:
+constexpr float TRAVERSAL_COST = 1.f;
+// The builder stops splitting at this depth, which bounds the traversal stack:
+constexpr uint32_t MAX_DEPTH = 60;
+
+static std::unique_ptr<BuildNode> buildRecursive(const BuildContext& context, const uint32_t begin, const uint32_t end,
+                                                 const uint32_t depth)
+{
+    auto node = std::make_unique<BuildNode>();
+
+    BBox3f centroidBounds;
+    for (uint32_t i = begin; i < end; ++i) {
+        const auto& bounds = context.primBounds[context.primIndices[i]];
+        node->bounds.extend(bounds);
+        centroidBounds.extend(bounds.center());
+    }
+
+    const uint32_t numPrims = end - begin;
+    const auto     makeLeaf = [&]() {
+        if (numPrims > std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error("BVH leaf with " + std::to_string(numPrims) + " primitives is too large.");
+        }
+        node->firstPrim = begin;
+        node->numPrims  = numPrims;
+        return std::move(node);
+    };
+
+    const int   axis       = centroidBounds.maxExtent();
+    const float axisExtent = centroidBounds.pmax[axis] - centroidBounds.pmin[axis];
+    if (numPrims == 1 || depth >= MAX_DEPTH || !(axisExtent > 0.f)) {
+        return makeLeaf();
+    }
+
+    //
+    // Bin the primitives by their centroids and evaluate the SAH at every bin boundary:
+
+    struct Bin
+    {
+        BBox3f   bounds;
+        uint32_t count = 0;
+    };
+
+    const uint32_t   numBins = std::max(2u, context.param.numBins);
+    std::vector<Bin> bins(numBins);
+
+    const float binScale   = numBins / axisExtent;
+    const auto  binIndexOf = [&](const uint32_t primIdx) {
+        const float centroid = context.primBounds[primIdx].center()[axis];
+        return std::min(numBins - 1, static_cast<uint32_t>((centroid - centroidBounds.pmin[axis]) * binScale));
+    };
+
+    for (uint32_t i = begin; i < end; ++i) {
+        auto& bin = bins[binIndexOf(context.primIndices[i])];
+        bin.bounds.extend(context.primBounds[context.primIndices[i]]);
+        ++bin.count;
+    }
+
+    // Sweep from the right first, so that the left sweep can evaluate the cost directly:
+    std::vector<float>    rightAreas(numBins);
+    std::vector<uint32_t> rightCounts(numBins);
+    {
+        BBox3f   bounds;
+        uint32_t count = 0;
+        for (uint32_t i = numBins - 1; i > 0; --i) {
+            bounds.extend(bins[i].bounds);
+            count += bins[i].count;
+            rightAreas[i]  = bounds.surfaceArea();
+            rightCounts[i] = count;
+        }
+    }
+
+    float    bestCost  = std::numeric_limits<float>::infinity();
+    uint32_t bestSplit = 0;
+    {
+        BBox3f   bounds;
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < numBins - 1; ++i) {
+            bounds.extend(bins[i].bounds);
+            count += bins[i].count;
+
+            const float cost = count * bounds.surfaceArea() + rightCounts[i + 1] * rightAreas[i + 1];
+            if (cost < bestCost) {
+                bestCost  = cost;
+                bestSplit = i + 1;
+            }
+        }
+    }
+
+    // Both costs are relative to the surface area of the node:
+    const float splitCost = TRAVERSAL_COST + bestCost / node->bounds.surfaceArea();
+    const float leafCost  = static_cast<float>(numPrims);
+    if (numPrims <= context.param.maxLeafSize && leafCost <= splitCost) {
+        return makeLeaf();
+    }
+
+    const auto midItr = std::partition(context.primIndices.begin() + begin, context.primIndices.begin() + end,
+                                       [&](const uint32_t primIdx) { return binIndexOf(primIdx) < bestSplit; });
+    auto       mid    = static_cast<uint32_t>(midItr - context.primIndices.begin());
+
+    // Every centroid ended up in the same bin (can only happen due to floating point precision), split in the middle:
+    if (mid == begin || mid == end) {
+        mid = begin + numPrims / 2;
+        std::nth_element(context.primIndices.begin() + begin, context.primIndices.begin() + mid,
+                         context.primIndices.begin() + end, [&](const uint32_t a, const uint32_t b) {
+                             return context.primBounds[a].center()[axis] < context.primBounds[b].center()[axis];
+                         });
+    }
+
+    node->axis = static_cast<uint8_t>(axis);
+
+    // Large subtrees are handed to the task system while this thread builds the other one:
+    if (numPrims >= context.param.parallelThreshold) {
+        TaskGroup group;
+        group.run([&]() { node->children[0] = buildRecursive(context, begin, mid, depth + 1); });
+        node->children[1] = buildRecursive(context, mid, end, depth + 1);
+        group.wait();
+    } else {
+        node->children[0] = buildRecursive(context, begin, mid, depth + 1);
+        node->children[1] = buildRecursive(context, mid, end, depth + 1);
+    }
+
+    return node;
+}
+
+static uint32_t flatten(const BuildNode& buildNode, std::vector<BvhNode>& nodes)
+{
+    const auto nodeIdx = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back(BvhNode{
+        .bounds   = buildNode.bounds,
+        .offset   = buildNode.firstPrim,
+        .numPrims = static_cast<uint16_t>(buildNode.numPrims),
+        .axis     = buildNode.axis,
+    });
+
+    if (buildNode.numPrims == 0) {
+        flatten(*buildNode.children[0], nodes);
+        nodes[nodeIdx].offset = flatten(*buildNode.children[1], nodes);
+    }
+
+    return nodeIdx;
+}
+
+Bvh::Bvh(const std::span<const BBox3f> primBounds, const BvhBuildParam& param)
+{
+    if (primBounds.empty()) {
+        return;
+    }
+
+    m_primIndices.resize(primBounds.size());
+    for (uint32_t i = 0; i < m_primIndices.size(); ++i) {
+        m_primIndices[i] = i;
+    }
+
+    const BuildContext context{.param = param, .primBounds = primBounds, .primIndices = m_primIndices};
+    const auto         root = buildRecursive(context, 0, static_cast<uint32_t>(m_primIndices.size()), 0);
+
+    // A binary tree with n leaves has 2n - 1 nodes:
+    m_nodes.reserve(2 * primBounds.size() - 1);
+    flatten(*root, m_nodes);
+}
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
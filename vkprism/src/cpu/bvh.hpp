@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include <bbox.hpp>
+
+namespace prism {
+namespace cpu {
+
+struct Ray
+{
+    glm::vec3 origin;
+    float     tmin;
+    glm::vec3 dir;
+    float     tmax;
+};
+
+struct BvhBuildParam
+{
+    uint32_t maxLeafSize = 4;  // Leaves are only created above this size if splitting isn't worth it
+    uint32_t numBins     = 16; // Number of bins used to evaluate the SAH along each axis
+    // Subtrees with at least this many primitives are built as separate tasks:
+    size_t parallelThreshold = 1 << 12;
+};
+
+// A node of the flattened BVH. The nodes are stored depth first, so the first child of an interior node is always the
+// node right after it.
+struct BvhNode
+{
+    BBox3f bounds;
+    // The first primitive (index into primIndices) for leaves and the second child for interior nodes:
+    uint32_t offset;
+    uint16_t numPrims; // 0 for interior nodes
+    uint8_t  axis;     // The split axis of interior nodes, used for front to back traversal
+    uint8_t  pad;
+};
+
+// A binary BVH over arbitrary primitives, built with a binned SAH (surface area heuristic). Only the bounds of the
+// primitives are needed to build it, intersecting the primitives themselves is left to the user during traversal.
+class Bvh
+{
+  public:
+    Bvh() = default;
+    explicit Bvh(std::span<const BBox3f> primBounds, const BvhBuildParam& param = {});
+
+    const BBox3f& bounds() const
+    {
+        static const BBox3f emptyBounds;
+        return m_nodes.empty() ? emptyBounds : m_nodes.front().bounds;
+    }
+
+    std::span<const BvhNode>  nodes() const { return m_nodes; }
+    std::span<const uint32_t> primIndices() const { return m_primIndices; }
+
+    // Calls intersectPrim(primIdx, ray) for every primitive whose leaf the ray overlaps. intersectPrim should shrink
+    // ray.tmax when it finds a closer hit (and return true), which is what allows the traversal to cull other nodes.
+    // Returns true if any primitive was hit.
+    template <typename F>
+    bool traverse(Ray& ray, F&& intersectPrim) const;
+
+  private:
+    std::vector<BvhNode>  m_nodes;
+    std::vector<uint32_t> m_primIndices;
+};
+
+//
+// Traversal:
+
+// The reciprocal of the ray direction for slab tests. Tiny components are clamped, which avoids infinities (and NaNs
+// from 0 * inf) in the slab test:
+inline glm::vec3 safeReciprocal(const glm::vec3& dir)
+{
+    constexpr float EPSILON = 1e-18f;
+
+    glm::vec3 invDir;
+    for (int axis = 0; axis < 3; ++axis) {
+        invDir[axis] = 1.f / (std::abs(dir[axis]) > EPSILON ? dir[axis] : std::copysign(EPSILON, dir[axis]));
+    }
+    return invDir;
+}
+
+// Slab test against the bounds of a node (invDir is the reciprocal of the ray direction):
+inline bool intersectBounds(const BBox3f& bounds, const Ray& ray, const glm::vec3& invDir)
+{
+    const glm::vec3 t0 = (bounds.pmin - ray.origin) * invDir;
+    const glm::vec3 t1 = (bounds.pmax - ray.origin) * invDir;
+
+    const glm::vec3 tnear = glm::min(t0, t1);
+    const glm::vec3 tfar  = glm::max(t0, t1);
+
+    const float tmin = std::max(std::max(tnear.x, tnear.y), std::max(tnear.z, ray.tmin));
+    const float tmax = std::min(std::min(tfar.x, tfar.y), std::min(tfar.z, ray.tmax));
+    return tmin <= tmax;
+}
+
+template <typename F>
+bool Bvh::traverse(Ray& ray, F&& intersectPrim) const
+{
+    if (m_nodes.empty()) {
+        return false;
+    }
+
+    const glm::vec3           invDir = safeReciprocal(ray.dir);
+    const std::array<bool, 3> dirIsNeg{invDir.x < 0.f, invDir.y < 0.f, invDir.z < 0.f};
+
+    // The depth of the BVH is bounded by the builder, 64 entries is more than enough:
+    std::array<uint32_t, 64> stack;
+    uint32_t                 stackSize = 0;
+    uint32_t                 nodeIdx   = 0;
+
+    bool hit = false;
+    while (true) {
+        const auto& node = m_nodes[nodeIdx];
+        if (intersectBounds(node.bounds, ray, invDir)) {
+            if (node.numPrims > 0) {
+                for (uint32_t i = 0; i < node.numPrims; ++i) {
+                    hit |= intersectPrim(m_primIndices[node.offset + i], ray);
+                }
+            } else {
+                // Visit the closer child first:
+                if (dirIsNeg[node.axis]) {
+                    stack[stackSize++] = nodeIdx + 1;
+                    nodeIdx            = node.offset;
+                } else {
+                    stack[stackSize++] = node.offset;
+                    nodeIdx            = nodeIdx + 1;
+                }
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        nodeIdx = stack[--stackSize];
+    }
+
+    return hit;
+}
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
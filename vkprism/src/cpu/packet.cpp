@@ -0,0 +1,173 @@
+#include "packet.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cpu/scene.hpp>
+#include <morton.hpp>
+#include <util.hpp>
+
+namespace prism {
+namespace cpu {
+
+// Same as transformPoint and transformVector in scene.cpp (including the order of the operations) for every ray:
+template <size_t K>
+static void transformPacket(const glm::mat4& mat, const RayPacket<K>& src, RayPacket<K>& dst)
+{
+    for (int row = 0; row < 3; ++row) {
+        for (uint32_t i = 0; i < K; ++i) {
+            const float ox = src.origin[0][i], oy = src.origin[1][i], oz = src.origin[2][i];
+            const float dx = src.dir[0][i], dy = src.dir[1][i], dz = src.dir[2][i];
+
+            dst.origin[row][i] = (mat[0][row] * ox + mat[1][row] * oy) + (mat[2][row] * oz + mat[3][row]);
+            dst.dir[row][i]    = (mat[0][row] * dx + mat[1][row] * dy) + (mat[2][row] * dz + mat[3][row] * 0.f);
+        }
+    }
+
+    std::copy(std::begin(src.tmin), std::end(src.tmin), std::begin(dst.tmin));
+    std::copy(std::begin(src.tmax), std::end(src.tmax), std::begin(dst.tmax));
+}
+
+template <size_t K>
+uint32_t Scene::tracePacket(RayPacket<K>& packet, Hit* const hits, const uint32_t activeMask,
+                            const uint32_t cullMask) const
+{
+    const bool anyHit = hits == nullptr;
+
+    const auto intersectInstance = [&](const uint32_t instanceIdx, RayPacket<K>& worldPacket, const uint32_t mask) {
+        const auto& instance = m_instances[instanceIdx];
+        if ((instance.mask & cullMask & 0xFF) == 0) {
+            return 0u;
+        }
+
+        // The directions aren't normalized, so distances along the object space rays are the same as in world space:
+        RayPacket<K> objectPacket;
+        transformPacket(instance.worldToObject, worldPacket, objectPacket);
+
+        const auto& meshGroup = m_meshGroups[instance.meshGroupIdx];
+
+        const auto intersectTriangle = [&](const uint32_t triangleIdx, RayPacket<K>& trianglePacket,
+                                           const uint32_t triangleMask) {
+            alignas(32) float u[K], v[K];
+
+            const uint32_t hitMask =
+                intersectTrianglePacket(meshGroup.triangles[triangleIdx], trianglePacket, triangleMask, u, v);
+            if (hits) {
+                const auto& triangleId = meshGroup.triangleIds[triangleIdx];
+                forEachBit(hitMask, [&](const uint32_t i) {
+                    hits[i] = Hit{
+                        .t            = trianglePacket.tmax[i],
+                        .barycentrics = glm::vec2(u[i], v[i]),
+                        .instanceIdx  = instanceIdx,
+                        .geometryIdx  = triangleId.geometryIdx,
+                        .primitiveIdx = triangleId.primitiveIdx,
+                    };
+                });
+            }
+            return hitMask;
+        };
+
+        const uint32_t hitMask = traversePacket(meshGroup.bvh, objectPacket, mask, anyHit, intersectTriangle);
+        forEachBit(hitMask, [&](const uint32_t i) { worldPacket.tmax[i] = objectPacket.tmax[i]; });
+        return hitMask;
+    };
+
+    return traversePacket(m_topLevelBvh, packet, activeMask, anyHit, intersectInstance);
+}
+
+template <size_t K>
+uint32_t Scene::intersect(RayPacket<K>& packet, std::array<Hit, K>& hits, const uint32_t activeMask,
+                          const uint32_t cullMask) const
+{
+    return tracePacket(packet, hits.data(), activeMask, cullMask);
+}
+
+template <size_t K>
+uint32_t Scene::occluded(const RayPacket<K>& packet, const uint32_t activeMask, const uint32_t cullMask) const
+{
+    // Traversal shrinks tmax, which the caller most likely still needs:
+    auto shadowPacket = packet;
+    return tracePacket(shadowPacket, nullptr, activeMask, cullMask);
+}
+
+template uint32_t Scene::intersect<8>(RayPacket<8>&, std::array<Hit, 8>&, uint32_t, uint32_t) const;
+template uint32_t Scene::intersect<16>(RayPacket<16>&, std::array<Hit, 16>&, uint32_t, uint32_t) const;
+template uint32_t Scene::occluded<8>(const RayPacket<8>&, uint32_t, uint32_t) const;
+template uint32_t Scene::occluded<16>(const RayPacket<16>&, uint32_t, uint32_t) const;
+
+//
+// Streams:
+
+constexpr uint32_t STREAM_PACKET_SIZE = 8;
+
+// The octant of the direction in the upper bits followed by a 30 bit Morton code of the origin within the bounds:
+static uint64_t streamSortKey(const Ray& ray, const BBox3f& bounds)
+{
+    const glm::vec3 extent = bounds.diagonal();
+
+    uint64_t octant = 0;
+    uint32_t morton = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        octant |= uint64_t(ray.dir[axis] < 0.f) << axis;
+
+        const float relative  = extent[axis] > 0.f ? (ray.origin[axis] - bounds.pmin[axis]) / extent[axis] : 0.f;
+        const auto  quantized = static_cast<uint32_t>(std::clamp(relative, 0.f, 1.f) * 1023.f);
+        morton |= expandBits(quantized) << (2 - axis);
+    }
+    return (octant << 30) | morton;
+}
+
+void Scene::intersectStream(const std::span<Ray> rays, const std::span<Hit> hits, const std::span<uint8_t> isHit,
+                            const uint32_t cullMask) const
+{
+    // The 33 bit sort key in the upper and the index of the ray in the lower 31 bits (ties keep the order of the rays):
+    constexpr uint32_t INDEX_BITS = 31;
+    if (rays.size() > (size_t(1) << INDEX_BITS)) {
+        throw std::runtime_error("Can't sort a stream of " + std::to_string(rays.size()) + " rays, at most 2^" +
+                                 std::to_string(INDEX_BITS) + " are supported");
+    }
+
+    std::vector<uint64_t> sortedRays(rays.size());
+    parallelFor(rays.size(), 1 << 14, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            sortedRays[i] = (streamSortKey(rays[i], bounds()) << INDEX_BITS) | i;
+        }
+    });
+    radixSort(sortedRays, INDEX_BITS, 33);
+    const auto rayIndex = [&](const size_t sortedIdx) {
+        return static_cast<uint32_t>(sortedRays[sortedIdx] & ((uint64_t(1) << INDEX_BITS) - 1));
+    };
+
+    const size_t numPackets = (rays.size() + STREAM_PACKET_SIZE - 1) / STREAM_PACKET_SIZE;
+    parallelFor(numPackets, 64, [&](const size_t packetsBegin, const size_t packetsEnd) {
+        for (size_t packetIdx = packetsBegin; packetIdx < packetsEnd; ++packetIdx) {
+            const size_t first    = packetIdx * STREAM_PACKET_SIZE;
+            const size_t numLanes = std::min<size_t>(STREAM_PACKET_SIZE, rays.size() - first);
+
+            // Unused lanes are all zeros, so that they don't produce any NaNs or denormals:
+            RayPacket<STREAM_PACKET_SIZE>       packet{};
+            std::array<Hit, STREAM_PACKET_SIZE> packetHits;
+            uint32_t                            activeMask = 0;
+            for (uint32_t lane = 0; lane < numLanes; ++lane) {
+                packet.setRay(lane, rays[rayIndex(first + lane)]);
+                activeMask |= 1u << lane;
+            }
+
+            const uint32_t hitMask = intersect(packet, packetHits, activeMask, cullMask);
+
+            for (uint32_t lane = 0; lane < numLanes; ++lane) {
+                const uint32_t rayIdx = rayIndex(first + lane);
+                rays[rayIdx].tmax     = packet.tmax[lane];
+                isHit[rayIdx]         = (hitMask >> lane) & 1;
+                if (isHit[rayIdx]) {
+                    hits[rayIdx] = packetHits[lane];
+                }
+            }
+        }
+    });
+}
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
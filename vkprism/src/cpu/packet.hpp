@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include <glm/vec3.hpp>
+
+#include <cpu/bvh.hpp>
+#include <cpu/triangle.hpp>
+
+namespace prism {
+namespace cpu {
+
+// K rays in SoA layout that are traced together. Coherent rays (neighbouring camera rays, shadow rays towards the same
+// light) mostly visit the same nodes, so a packet only needs a single traversal. Which rays of a packet are used is
+// given by a bit mask.
+//
+// The per ray loops below are written so that the compiler can vectorize them for whatever instruction set is being
+// targeted (which is also why K should be a multiple of 4).
+template <size_t K>
+struct RayPacket
+{
+    static_assert(K <= 32, "Ray masks are 32 bits");
+
+    alignas(32) float origin[3][K];
+    alignas(32) float dir[3][K];
+    alignas(32) float tmin[K];
+    alignas(32) float tmax[K];
+
+    void setRay(const uint32_t i, const Ray& ray)
+    {
+        for (int axis = 0; axis < 3; ++axis) {
+            origin[axis][i] = ray.origin[axis];
+            dir[axis][i]    = ray.dir[axis];
+        }
+        tmin[i] = ray.tmin;
+        tmax[i] = ray.tmax;
+    }
+};
+
+// Calls func(i) for every set bit i of the mask:
+template <typename F>
+inline void forEachBit(uint32_t mask, F&& func)
+{
+    for (; mask != 0; mask &= mask - 1) {
+        func(static_cast<uint32_t>(std::countr_zero(mask)));
+    }
+}
+
+// Everything about the packet that is needed for the node tests:
+template <size_t K>
+struct PacketTraversalData
+{
+    alignas(32) float invDir[3][K];
+
+    // Used to decide which child to visit first (the direction of the first ray):
+    std::array<bool, 3> dirIsNeg;
+
+    // If every ray points into the same octant, the whole packet can be culled at once using interval arithmetic
+    // (see "Large Ray Packets for Real-Time Whitted Ray Tracing" by Overbeck et al.):
+    bool      commonOctant;
+    glm::vec3 originMin, originMax;
+    glm::vec3 invDirMin, invDirMax;
+    float     tminMin;
+
+    PacketTraversalData(const RayPacket<K>& packet, const uint32_t activeMask)
+    {
+        for (uint32_t i = 0; i < K; ++i) {
+            const auto inv = safeReciprocal(glm::vec3(packet.dir[0][i], packet.dir[1][i], packet.dir[2][i]));
+            for (int axis = 0; axis < 3; ++axis) {
+                invDir[axis][i] = inv[axis];
+            }
+        }
+
+        const uint32_t first = std::countr_zero(activeMask);
+        for (int axis = 0; axis < 3; ++axis) {
+            dirIsNeg[axis] = invDir[axis][first] < 0.f;
+        }
+
+        commonOctant = true;
+        originMin    = glm::vec3(std::numeric_limits<float>::max());
+        originMax    = glm::vec3(std::numeric_limits<float>::lowest());
+        invDirMin    = originMin;
+        invDirMax    = originMax;
+        tminMin      = std::numeric_limits<float>::max();
+        forEachBit(activeMask, [&](const uint32_t i) {
+            for (int axis = 0; axis < 3; ++axis) {
+                commonOctant    = commonOctant && (invDir[axis][i] < 0.f) == dirIsNeg[axis];
+                originMin[axis] = std::min(originMin[axis], packet.origin[axis][i]);
+                originMax[axis] = std::max(originMax[axis], packet.origin[axis][i]);
+                invDirMin[axis] = std::min(invDirMin[axis], invDir[axis][i]);
+                invDirMax[axis] = std::max(invDirMax[axis], invDir[axis][i]);
+            }
+            tminMin = std::min(tminMin, packet.tmin[i]);
+        });
+    }
+
+    // Conservative: returns true only if none of the rays can hit the bounds.
+    bool missesFrustum(const BBox3f& bounds) const
+    {
+        // Bounds of the product of two intervals:
+        const auto lowerProduct = [](const float a0, const float a1, const float b0, const float b1) {
+            return std::min(std::min(a0 * b0, a0 * b1), std::min(a1 * b0, a1 * b1));
+        };
+        const auto upperProduct = [](const float a0, const float a1, const float b0, const float b1) {
+            return std::max(std::max(a0 * b0, a0 * b1), std::max(a1 * b0, a1 * b1));
+        };
+
+        // Every ray enters after latestEntry and leaves before earliestExit:
+        float latestEntry  = tminMin;
+        float earliestExit = std::numeric_limits<float>::max();
+        for (int axis = 0; axis < 3; ++axis) {
+            const float nearPlane = dirIsNeg[axis] ? bounds.pmax[axis] : bounds.pmin[axis];
+            const float farPlane  = dirIsNeg[axis] ? bounds.pmin[axis] : bounds.pmax[axis];
+
+            latestEntry  = std::max(latestEntry, lowerProduct(nearPlane - originMax[axis], nearPlane - originMin[axis],
+                                                              invDirMin[axis], invDirMax[axis]));
+            earliestExit = std::min(earliestExit, upperProduct(farPlane - originMax[axis], farPlane - originMin[axis],
+                                                               invDirMin[axis], invDirMax[axis]));
+        }
+        return latestEntry > earliestExit;
+    }
+
+    // Returns the mask of the active rays that hit the bounds:
+    uint32_t intersectBounds(const BBox3f& bounds, const RayPacket<K>& packet, const uint32_t activeMask) const
+    {
+        if (commonOctant && missesFrustum(bounds)) {
+            return 0;
+        }
+
+        std::array<bool, K> isHit;
+        for (uint32_t i = 0; i < K; ++i) {
+            const float t0x = (bounds.pmin.x - packet.origin[0][i]) * invDir[0][i];
+            const float t1x = (bounds.pmax.x - packet.origin[0][i]) * invDir[0][i];
+            const float t0y = (bounds.pmin.y - packet.origin[1][i]) * invDir[1][i];
+            const float t1y = (bounds.pmax.y - packet.origin[1][i]) * invDir[1][i];
+            const float t0z = (bounds.pmin.z - packet.origin[2][i]) * invDir[2][i];
+            const float t1z = (bounds.pmax.z - packet.origin[2][i]) * invDir[2][i];
+
+            const float tnear = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)),
+                                         std::max(std::min(t0z, t1z), packet.tmin[i]));
+            const float tfar  = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)),
+                                         std::min(std::max(t0z, t1z), packet.tmax[i]));
+            isHit[i] = tnear <= tfar;
+        }
+
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < K; ++i) {
+            mask |= static_cast<uint32_t>(isHit[i]) << i;
+        }
+        return mask & activeMask;
+    }
+};
+
+// Traverses the BVH with all of the active rays of the packet. Every node that at least one of the rays hits is visited
+// once for the whole packet, only the rays that hit the node stay active below it. intersectPrim(primIdx, packet,
+// mask) has to intersect the primitive with the rays in the mask, shrink their tmax on a hit and return the mask of
+// the rays that hit it.
+//
+// If anyHit is set, rays are deactivated as soon as they hit anything (which is all that shadow rays need). Returns the
+// mask of the rays that hit anything.
+template <size_t K, typename F>
+uint32_t traversePacket(const Bvh& bvh, RayPacket<K>& packet, const uint32_t activeMask, const bool anyHit,
+                        F&& intersectPrim)
+{
+    const auto nodes       = bvh.nodes();
+    const auto primIndices = bvh.primIndices();
+    if (nodes.empty() || activeMask == 0) {
+        return 0;
+    }
+
+    const PacketTraversalData<K> data(packet, activeMask);
+
+    struct StackEntry
+    {
+        uint32_t nodeIdx;
+        uint32_t activeMask; // The rays that hit the parent
+    };
+
+    // The depth of the BVH is bounded by the builder, 64 entries is more than enough:
+    std::array<StackEntry, 64> stack;
+    uint32_t                   stackSize = 0;
+    StackEntry                 current{.nodeIdx = 0, .activeMask = activeMask};
+
+    uint32_t hitMask = 0;
+    while (true) {
+        const uint32_t mask = anyHit ? current.activeMask & ~hitMask : current.activeMask;
+        const auto&    node = nodes[current.nodeIdx];
+
+        const uint32_t nodeMask = mask != 0 ? data.intersectBounds(node.bounds, packet, mask) : 0;
+        if (nodeMask != 0) {
+            if (node.numPrims > 0) {
+                for (uint32_t i = 0; i < node.numPrims; ++i) {
+                    const uint32_t primMask = anyHit ? nodeMask & ~hitMask : nodeMask;
+                    hitMask |= intersectPrim(primIndices[node.offset + i], packet, primMask);
+                }
+                if (anyHit && hitMask == activeMask) {
+                    break;
+                }
+            } else {
+                // Visit the child that is closer for the first ray first:
+                const uint32_t nearChild = data.dirIsNeg[node.axis] ? node.offset : current.nodeIdx + 1;
+                const uint32_t farChild  = data.dirIsNeg[node.axis] ? current.nodeIdx + 1 : node.offset;
+
+                stack[stackSize++] = {.nodeIdx = farChild, .activeMask = nodeMask};
+                current            = {.nodeIdx = nearChild, .activeMask = nodeMask};
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        current = stack[--stackSize];
+    }
+
+    return hitMask;
+}
+
+// Same as intersectTriangle for every ray in the mask. Returns the mask of the rays that hit the triangle and writes
+// their barycentrics:
+template <size_t K>
+uint32_t intersectTrianglePacket(const Triangle& triangle, RayPacket<K>& packet, const uint32_t activeMask, float* u,
+                                 float* v)
+{
+    std::array<bool, K> isHit;
+    alignas(32) float   t[K];
+    for (uint32_t i = 0; i < K; ++i) {
+        const float dx = packet.dir[0][i], dy = packet.dir[1][i], dz = packet.dir[2][i];
+
+        // The operations are in the exact same order as glm's cross and dot, so the results are the same as for single
+        // rays:
+        const float px  = dy * triangle.e2.z - triangle.e2.y * dz;
+        const float py  = dz * triangle.e2.x - triangle.e2.z * dx;
+        const float pz  = dx * triangle.e2.y - triangle.e2.x * dy;
+        const float det = triangle.e1.x * px + triangle.e1.y * py + triangle.e1.z * pz;
+
+        const float invDet = 1.f / det;
+        const float sx     = packet.origin[0][i] - triangle.v0.x;
+        const float sy     = packet.origin[1][i] - triangle.v0.y;
+        const float sz     = packet.origin[2][i] - triangle.v0.z;
+        u[i]               = (sx * px + sy * py + sz * pz) * invDet;
+
+        const float qx = sy * triangle.e1.z - triangle.e1.y * sz;
+        const float qy = sz * triangle.e1.x - triangle.e1.z * sx;
+        const float qz = sx * triangle.e1.y - triangle.e1.x * sy;
+        v[i]           = (dx * qx + dy * qy + dz * qz) * invDet;
+        t[i]           = (triangle.e2.x * qx + triangle.e2.y * qy + triangle.e2.z * qz) * invDet;
+
+        isHit[i] = det != 0.f && !(u[i] < 0.f || u[i] > 1.f) && !(v[i] < 0.f || u[i] + v[i] > 1.f) &&
+                   t[i] > packet.tmin[i] && t[i] < packet.tmax[i];
+    }
+
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < K; ++i) {
+        mask |= static_cast<uint32_t>(isHit[i]) << i;
+    }
+    mask &= activeMask;
+
+    forEachBit(mask, [&](const uint32_t i) { packet.tmax[i] = t[i]; });
+    return mask;
+}
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
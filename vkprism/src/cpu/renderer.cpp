@@ -0,0 +1,248 @@
+#include "renderer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/vec4.hpp>
+
+#include <profiler.hpp>
+#include <shaders/aov.hpp>
+#include <task_system.hpp>
+
+namespace prism {
+namespace cpu {
+
+//
+// The values the shaders write (see raytrace.rgen, raytrace.rchit and raytrace.rmiss):
+
+constexpr float     RAY_TMIN  = 0.001f;
+constexpr float     RAY_TMAX  = 10000.f;
+constexpr glm::vec3 HIT_VALUE(0.5f);
+constexpr glm::vec3 MISS_VALUE(0.1f);
+constexpr glm::vec3 HIT_ALBEDO(0.5f); // No materials yet
+
+// Same as GLSL's packHalf2x16 for a single value (round to nearest even):
+static uint16_t floatToHalf(const float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(float));
+
+    const uint32_t sign     = (bits >> 16) & 0x8000;
+    const int32_t  exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+    const uint32_t mantissa = bits & 0x7FFFFF;
+
+    // Rounds value >> shift to the nearest even:
+    const auto roundShift = [](const uint32_t value, const uint32_t shift) {
+        const uint32_t result    = value >> shift;
+        const uint32_t remainder = value & ((1u << shift) - 1);
+        const uint32_t halfway   = 1u << (shift - 1);
+        return result + ((remainder > halfway || (remainder == halfway && (result & 1))) ? 1 : 0);
+    };
+
+    // NaN and infinity:
+    if (((bits >> 23) & 0xFF) == 0xFF) {
+        return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+    // Overflows to infinity:
+    if (exponent >= 0x1F) {
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+    // Denormals (or zero):
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        return static_cast<uint16_t>(sign | roundShift(mantissa | 0x800000, 14 - exponent));
+    }
+
+    // Rounding may carry into the exponent (even up to infinity), which is exactly what we want:
+    return static_cast<uint16_t>(sign | ((static_cast<uint32_t>(exponent) << 10) + roundShift(mantissa, 13)));
+}
+
+template <typename T>
+static void writeAov(std::vector<std::byte>& aov, const size_t pixelIdx, const T& value)
+{
+    std::memcpy(aov.data() + pixelIdx * sizeof(T), &value, sizeof(T));
+}
+
+// Camera rays are traced in packets of horizontally neighbouring pixels:
+constexpr uint32_t PACKET_SIZE = 8;
+
+// Same orthographic camera as raytrace.rgen:
+static Ray createCameraRay(const uint32_t x, const uint32_t y, const glm::uvec2 resolution,
+                           const glm::mat4& cameraToWorld)
+{
+    const glm::vec2 pixelCenter   = glm::vec2(float(x), float(y)) + glm::vec2(0.5f);
+    const glm::vec2 pixelCenterUV = pixelCenter / glm::vec2(float(resolution.x), float(resolution.y));
+    const glm::vec2 origin        = pixelCenterUV * 2.f - glm::vec2(1.f);
+
+    return Ray{
+        .origin = glm::vec3(cameraToWorld * glm::vec4(origin.x, origin.y, 0.f, 1.f)),
+        .tmin   = RAY_TMIN,
+        .dir    = glm::normalize(glm::mat3(cameraToWorld) * glm::vec3(0.f, 0.f, 1.f)),
+        .tmax   = RAY_TMAX,
+    };
+}
+
+static void writePixel(const Scene& scene, const RenderParam& param, RenderOutput& output, const size_t pixelIdx,
+                       const bool isHit, const Hit& hit)
+{
+    output.beauty[pixelIdx] = isHit ? HIT_VALUE : MISS_VALUE;
+
+    if (param.aovs[aovDEPTH]) {
+        writeAov(output.aovs[aovDEPTH], pixelIdx, isHit ? hit.t : -1.f);
+    }
+    if (param.aovs[aovNORMAL]) {
+        const auto normal = isHit ? scene.shadingNormal(hit) : glm::vec3(0.f, 0.f, 1.f);
+        writeAov(output.aovs[aovNORMAL], pixelIdx, encodeOctahedralNormal(normal));
+    }
+    if (param.aovs[aovALBEDO]) {
+        const auto albedo = isHit ? HIT_ALBEDO : glm::vec3(0.f);
+        writeAov(
+            output.aovs[aovALBEDO], pixelIdx,
+            std::to_array({floatToHalf(albedo.r), floatToHalf(albedo.g), floatToHalf(albedo.b), floatToHalf(1.f)}));
+    }
+    if (param.aovs[aovINSTANCE_ID]) {
+        writeAov(output.aovs[aovINSTANCE_ID], pixelIdx, isHit ? hit.instanceIdx : uint32_t(NO_HIT_ID));
+    }
+    if (param.aovs[aovPRIMITIVE_ID]) {
+        writeAov(output.aovs[aovPRIMITIVE_ID], pixelIdx, isHit ? hit.primitiveIdx : uint32_t(NO_HIT_ID));
+    }
+    if (param.aovs[aovSAMPLE_COUNT]) {
+        writeAov(output.aovs[aovSAMPLE_COUNT], pixelIdx, uint32_t(1));
+    }
+}
+
+// Index of the tile on a Hilbert curve covering a size x size grid (size has to be a power of two):
+static uint64_t hilbertIndex(const uint32_t size, uint32_t x, uint32_t y)
+{
+    uint64_t idx = 0;
+    for (uint32_t s = size / 2; s > 0; s /= 2) {
+        const uint32_t rx = (x & s) != 0 ? 1 : 0;
+        const uint32_t ry = (y & s) != 0 ? 1 : 0;
+        idx += uint64_t(s) * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant so that the curve inside of it has the right orientation:
+        if (ry == 0) {
+            if (rx == 1) {
+                x = size - 1 - x;
+                y = size - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return idx;
+}
+
+// The tiles (in tile coordinates) ordered along a Hilbert curve:
+static std::vector<glm::uvec2> hilbertOrderedTiles(const glm::uvec2 numTiles)
+{
+    const uint32_t gridSize = std::bit_ceil(std::max(numTiles.x, numTiles.y));
+
+    std::vector<std::pair<uint64_t, glm::uvec2>> keyedTiles;
+    keyedTiles.reserve(size_t(numTiles.x) * numTiles.y);
+    for (uint32_t y = 0; y < numTiles.y; ++y) {
+        for (uint32_t x = 0; x < numTiles.x; ++x) {
+            keyedTiles.emplace_back(hilbertIndex(gridSize, x, y), glm::uvec2(x, y));
+        }
+    }
+    std::sort(keyedTiles.begin(), keyedTiles.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<glm::uvec2> tiles;
+    tiles.reserve(keyedTiles.size());
+    for (const auto& [key, tile] : keyedTiles) {
+        tiles.push_back(tile);
+    }
+    return tiles;
+}
+
+static void renderTile(const Scene& scene, const RenderParam& param, RenderOutput& output, const glm::uvec2 tileMin,
+                       const glm::uvec2 tileMax)
+{
+    PRISM_PROFILE_SCOPE("cpu/tile");
+
+    for (uint32_t y = tileMin.y; y < tileMax.y; ++y) {
+        for (uint32_t x = tileMin.x; x < tileMax.x; x += PACKET_SIZE) {
+            const uint32_t numLanes = std::min(PACKET_SIZE, tileMax.x - x);
+
+            RayPacket<PACKET_SIZE> packet{};
+            uint32_t               activeMask = 0;
+            for (uint32_t lane = 0; lane < numLanes; ++lane) {
+                packet.setRay(lane, createCameraRay(x + lane, y, output.resolution, param.cameraToWorld));
+                activeMask |= 1u << lane;
+            }
+
+            std::array<Hit, PACKET_SIZE> hits;
+            const uint32_t               hitMask = scene.intersect(packet, hits, activeMask);
+
+            for (uint32_t lane = 0; lane < numLanes; ++lane) {
+                const size_t pixelIdx = size_t(y) * output.resolution.x + x + lane;
+                writePixel(scene, param, output, pixelIdx, (hitMask >> lane) & 1, hits[lane]);
+            }
+        }
+    }
+}
+
+RenderOutput render(const Scene& scene, const RenderParam& param)
+{
+    PRISM_PROFILE_SCOPE("cpu/render");
+
+    if (param.tileSize == 0) {
+        throw std::runtime_error("The tile size of a CPU render can't be 0");
+    }
+
+    const glm::uvec2 resolution(param.outputWidth, param.outputHeight);
+    const size_t     numPixels = size_t(resolution.x) * resolution.y;
+
+    RenderOutput output{
+        .resolution = resolution,
+        .beauty     = std::vector<glm::vec3>(numPixels),
+    };
+    for (uint32_t aov = 0; aov < TOTAL_NUM_AOVS; ++aov) {
+        if (param.aovs[aov]) {
+            output.aovs[aov].resize(numPixels * aovPixelSize(AovType(aov)));
+        }
+    }
+
+    const glm::uvec2 numTiles = (resolution + glm::uvec2(param.tileSize - 1)) / param.tileSize;
+    const auto       tiles    = hilbertOrderedTiles(numTiles);
+    const auto       total    = static_cast<uint32_t>(tiles.size());
+
+    // Also makes sure that the progress callback is never called concurrently:
+    std::mutex progressMutex;
+    uint32_t   numFinished = 0;
+
+    TaskGroup group;
+    for (const glm::uvec2 tile : tiles) {
+        group.run([&, tile]() {
+            if (param.stopToken.stop_requested()) {
+                group.cancel();
+                return;
+            }
+
+            const glm::uvec2 tileMin = tile * param.tileSize;
+            renderTile(scene, param, output, tileMin, glm::min(tileMin + param.tileSize, resolution));
+
+            std::lock_guard lock(progressMutex);
+            ++numFinished;
+            if (param.progressCallback) {
+                param.progressCallback(numFinished, total);
+            }
+        });
+    }
+    group.wait();
+
+    output.cancelled = numFinished != total;
+    return output;
+}
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
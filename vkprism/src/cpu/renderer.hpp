@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stop_token>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <aov.hpp>
+#include <cpu/scene.hpp>
+
+namespace prism {
+namespace cpu {
+
+struct RenderParam
+{
+    uint32_t outputWidth;
+    uint32_t outputHeight;
+
+    AovSet aovs{};
+
+    // The (orthographic) camera looks down +z in camera space, same as RTPipelineParam::cameraToWorld:
+    glm::mat4 cameraToWorld = glm::mat4(1.f);
+
+    // The output is split into square tiles, which are rendered as separate tasks in the order of a Hilbert curve (so
+    // tiles that are being rendered at the same time are close to each other):
+    uint32_t tileSize = 32;
+
+    // Called after every finished tile with the number of finished tiles and the total number of tiles. Can be called
+    // from any thread, but never concurrently.
+    std::function<void(uint32_t, uint32_t)> progressCallback;
+
+    // Tiles that haven't started yet are skipped once a stop is requested:
+    std::stop_token stopToken;
+};
+
+// The output of a CPU render. The AOVs are stored in the exact same format the shaders write them in (see
+// aovPixelSize), so everything that consumes a GPU readback can consume these as well.
+struct RenderOutput
+{
+    glm::uvec2                                          resolution;
+    std::vector<glm::vec3>                              beauty;
+    std::array<std::vector<std::byte>, TOTAL_NUM_AOVS> aovs; // Empty if the AOV wasn't requested
+
+    bool cancelled = false; // Skipped tiles are left as they were initialized (all zeros)
+};
+
+// Renders the scene the same way the raytrace.* shaders do (same camera, hit and miss behavior) using the task system.
+RenderOutput render(const Scene& scene, const RenderParam& param);
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include "scene.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#include <cpu_features.hpp>
+#include <profiler.hpp>
+#include <util.hpp>
+
+namespace prism {
+namespace cpu {
+
+// The transforms are converted to Vulkan's row major 3x4 layout by the SceneBuilder, so we convert them back:
+static glm::mat4 toMat4(const vk::TransformMatrixKHR& transform)
+{
+    glm::mat4 mat(1.f);
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            mat[col][row] = transform.matrix[row][col];
+        }
+    }
+    return mat;
+}
+
+static glm::vec3 transformPoint(const glm::mat4& mat, const glm::vec3& p)
+{
+    return glm::vec3(mat * glm::vec4(p, 1.f));
+}
+
+static glm::vec3 transformVector(const glm::mat4& mat, const glm::vec3& v)
+{
+    return glm::vec3(mat * glm::vec4(v, 0.f));
+}
+
+TraversalKernel Scene::selectKernel(const TraversalKernel kernel)
+{
+    const auto& features = cpuFeatures();
+    switch (kernel) {
+    case TraversalKernel::eAuto:
+        if (features.avx2 && features.fma) {
+            return TraversalKernel::eAVX2;
+        }
+        return features.sse42 ? TraversalKernel::eSSE42 : TraversalKernel::eScalar;
+    case TraversalKernel::eSSE42:
+        if (!features.sse42) {
+            throw std::runtime_error("The CPU doesn't support SSE4.2, which the traversal kernel requires.");
+        }
+        return kernel;
+    case TraversalKernel::eAVX2:
+        if (!features.avx2 || !features.fma) {
+            throw std::runtime_error("The CPU doesn't support AVX2 and FMA, which the traversal kernel requires.");
+        }
+        return kernel;
+    default:
+        return kernel;
+    }
+}
+
+std::vector<Scene::MeshGroup> Scene::createMeshGroups(const SceneBuilder& sceneBuilder, const BvhBuildParam& bvhParam,
+                                                      const TraversalKernel kernel)
+{
+    PRISM_PROFILE_SCOPE("cpu/blas");
+
+    const auto             builderMeshGroups = sceneBuilder.meshGroups();
+    std::vector<MeshGroup> meshGroups(builderMeshGroups.size());
+
+    // Every mesh group is independent (large BVH builds are also parallel on their own):
+    parallelFor(meshGroups.size(), 1, [&](const size_t begin, const size_t end) {
+        for (size_t groupIdx = begin; groupIdx < end; ++groupIdx) {
+            const auto  placedMeshes = builderMeshGroups[groupIdx];
+            auto&       meshGroup    = meshGroups[groupIdx];
+
+            for (uint32_t geometryIdx = 0; geometryIdx < placedMeshes.size(); ++geometryIdx) {
+                const auto& [meshIdx, transformIdx] = placedMeshes[geometryIdx];
+                const auto& mesh                    = sceneBuilder.m_meshes[meshIdx];
+
+                const auto transform =
+                    transformIdx.isNone() ? glm::mat4(1.f) : toMat4(sceneBuilder.m_transforms[transformIdx]);
+
+                meshGroup.geometries.emplace_back(Geometry{
+                    .verticesOffset  = mesh.verticesOffset,
+                    .facesOffset     = mesh.facesOffset,
+                    .indices16       = mesh.indices16,
+                    .hasTransform    = !transformIdx.isNone(),
+                    .normalTransform = glm::transpose(glm::inverse(glm::mat3(transform))),
+                });
+
+                for (uint32_t primitiveIdx = 0; primitiveIdx < mesh.numFaces; ++primitiveIdx) {
+                    const auto  face     = sceneBuilder.face(mesh, primitiveIdx);
+                    const auto* vertices = sceneBuilder.m_vertices.data() + mesh.verticesOffset;
+
+                    const auto v0 = transformPoint(transform, vertices[face.x].pos);
+                    const auto v1 = transformPoint(transform, vertices[face.y].pos);
+                    const auto v2 = transformPoint(transform, vertices[face.z].pos);
+
+                    meshGroup.triangles.emplace_back(Triangle{.v0 = v0, .e1 = v1 - v0, .e2 = v2 - v0});
+                    meshGroup.triangleIds.emplace_back(
+                        TriangleId{.geometryIdx = geometryIdx, .primitiveIdx = primitiveIdx});
+                }
+            }
+
+            std::vector<BBox3f> primBounds;
+            primBounds.reserve(meshGroup.triangles.size());
+            for (const auto& triangle : meshGroup.triangles) {
+                BBox3f bounds(triangle.v0, triangle.v0 + triangle.e1);
+                bounds.extend(triangle.v0 + triangle.e2);
+                primBounds.emplace_back(bounds);
+            }
+
+            meshGroup.bvh = Bvh(primBounds, bvhParam);
+
+            if (kernel == TraversalKernel::eSSE42) {
+                meshGroup.bvh4 = Bvh4(meshGroup.bvh, meshGroup.triangles);
+            } else if (kernel == TraversalKernel::eAVX2) {
+                meshGroup.bvh8 = Bvh8(meshGroup.bvh, meshGroup.triangles);
+            }
+        }
+    });
+
+    return meshGroups;
+}
+
+std::vector<Scene::Instance> Scene::createInstances(const SceneBuilder& sceneBuilder)
+{
+    std::vector<Instance> instances;
+    instances.reserve(sceneBuilder.m_instances.size());
+
+    for (const auto& instance : sceneBuilder.m_instances) {
+        const auto objectToWorld = toMat4(static_cast<vk::TransformMatrixKHR>(instance.transform));
+        instances.emplace_back(Instance{
+            .objectToWorld = objectToWorld,
+            .worldToObject = glm::inverse(objectToWorld),
+            .meshGroupIdx  = instance.meshGroupIdx,
+            .mask          = instance.mask,
+        });
+    }
+
+    return instances;
+}
+
+Bvh Scene::createTopLevelBvh(const std::span<const Instance> instances, const std::span<const MeshGroup> meshGroups,
+                             const BvhBuildParam& bvhParam)
+{
+    PRISM_PROFILE_SCOPE("cpu/tlas");
+
+    // The world space bounds of an instance are the transformed corners of its mesh group's bounds:
+    std::vector<BBox3f> instanceBounds;
+    instanceBounds.reserve(instances.size());
+    for (const auto& instance : instances) {
+        const auto& groupBounds = meshGroups[instance.meshGroupIdx].bvh.bounds();
+
+        BBox3f bounds;
+        if (!groupBounds.empty()) {
+            for (int corner = 0; corner < 8; ++corner) {
+                const glm::vec3 p((corner & 1) ? groupBounds.pmax.x : groupBounds.pmin.x,
+                                  (corner & 2) ? groupBounds.pmax.y : groupBounds.pmin.y,
+                                  (corner & 4) ? groupBounds.pmax.z : groupBounds.pmin.z);
+                bounds.extend(transformPoint(instance.objectToWorld, p));
+            }
+        }
+        instanceBounds.emplace_back(bounds);
+    }
+
+    return Bvh(instanceBounds, bvhParam);
+}
+
+Scene::Scene(const SceneBuilder& sceneBuilder, const SceneParam& param) :
+    m_kernel(selectKernel(param.kernel)),
+    m_vertices(sceneBuilder.m_vertices),
+    m_faces(sceneBuilder.m_faces),
+    m_faces16(sceneBuilder.m_faces16),
+    m_meshGroups(createMeshGroups(sceneBuilder, param.bvh, m_kernel)),
+    m_instances(createInstances(sceneBuilder)),
+    m_topLevelBvh(createTopLevelBvh(m_instances, m_meshGroups, param.bvh))
+{}
+
+bool Scene::intersectMeshGroup(const MeshGroup& meshGroup, Ray& ray, Hit& hit) const
+{
+    TriangleHit triangleHit;
+    bool        isHit = false;
+
+    switch (m_kernel) {
+    case TraversalKernel::eSSE42:
+        isHit = intersectBvh4SSE42(meshGroup.bvh4, ray, triangleHit);
+        break;
+    case TraversalKernel::eAVX2:
+        isHit = intersectBvh8AVX2(meshGroup.bvh8, ray, triangleHit);
+        break;
+    default:
+        isHit = meshGroup.bvh.traverse(ray, [&](const uint32_t triangleIdx, Ray& bvhRay) {
+            if (intersectTriangle(meshGroup.triangles[triangleIdx], bvhRay, triangleHit.barycentrics)) {
+                triangleHit.triangleIdx = triangleIdx;
+                return true;
+            }
+            return false;
+        });
+        break;
+    }
+
+    if (isHit) {
+        const auto& triangleId = meshGroup.triangleIds[triangleHit.triangleIdx];
+
+        hit.t            = ray.tmax;
+        hit.barycentrics = triangleHit.barycentrics;
+        hit.geometryIdx  = triangleId.geometryIdx;
+        hit.primitiveIdx = triangleId.primitiveIdx;
+    }
+    return isHit;
+}
+
+bool Scene::intersect(Ray& ray, Hit& hit, const uint32_t cullMask) const
+{
+    return m_topLevelBvh.traverse(ray, [&](const uint32_t instanceIdx, Ray& worldRay) {
+        const auto& instance = m_instances[instanceIdx];
+        if ((instance.mask & cullMask & 0xFF) == 0) {
+            return false;
+        }
+
+        // The direction isn't normalized, so distances along the object space ray are the same as in world space:
+        Ray objectRay{
+            .origin = transformPoint(instance.worldToObject, worldRay.origin),
+            .tmin   = worldRay.tmin,
+            .dir    = transformVector(instance.worldToObject, worldRay.dir),
+            .tmax   = worldRay.tmax,
+        };
+
+        const bool hitGroup = intersectMeshGroup(m_meshGroups[instance.meshGroupIdx], objectRay, hit);
+
+        if (hitGroup) {
+            worldRay.tmax   = objectRay.tmax;
+            hit.instanceIdx = instanceIdx;
+        }
+        return hitGroup;
+    });
+}
+
+glm::vec3 Scene::shadingNormal(const Hit& hit) const
+{
+    const auto& instance = m_instances[hit.instanceIdx];
+    const auto& geometry = m_meshGroups[instance.meshGroupIdx].geometries[hit.geometryIdx];
+
+    const auto  faceIdx = geometry.facesOffset + hit.primitiveIdx;
+    const auto  face    = geometry.indices16 ? glm::u32vec3(m_faces16[faceIdx]) : m_faces[faceIdx];
+    const auto& v0      = m_vertices[geometry.verticesOffset + face.x];
+    const auto& v1      = m_vertices[geometry.verticesOffset + face.y];
+    const auto& v2      = m_vertices[geometry.verticesOffset + face.z];
+
+    const glm::vec3 bary(1.f - hit.barycentrics.x - hit.barycentrics.y, hit.barycentrics.x, hit.barycentrics.y);
+    glm::vec3       normal = v0.nrm * bary.x + v1.nrm * bary.y + v2.nrm * bary.z;
+
+    // Meshes without normals have them set to zero, so we fall back to the geometric normal:
+    if (glm::dot(normal, normal) == 0.f) {
+        normal = glm::cross(v1.pos - v0.pos, v2.pos - v0.pos);
+    }
+
+    if (geometry.hasTransform) {
+        normal = geometry.normalTransform * normal;
+    }
+
+    // The inverse transpose of the object to world matrix:
+    return glm::normalize(normal * glm::mat3(instance.worldToObject));
+}
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <cpu/bvh.hpp>
+#include <cpu/packet.hpp>
+#include <cpu/triangle.hpp>
+#include <cpu/wide_bvh.hpp>
+#include <scene.hpp>
+
+namespace prism {
+namespace cpu {
+
+// Everything about the closest hit of a ray, mirroring what the hit shaders have access to:
+struct Hit
+{
+    float     t;
+    glm::vec2 barycentrics; // Weights of the second and third vertex (like hitAttributeEXT)
+    uint32_t  instanceIdx;  // gl_InstanceID
+    uint32_t  geometryIdx;  // gl_GeometryIndexEXT
+    uint32_t  primitiveIdx; // gl_PrimitiveID
+};
+
+// How the mesh group BVHs are traversed. eAuto picks the widest kernel the CPU supports:
+enum class TraversalKernel
+{
+    eAuto,
+    eScalar, // Binary BVH, portable
+    eSSE42,  // BVH4
+    eAVX2,   // BVH8 (also requires FMA)
+};
+
+struct SceneParam
+{
+    BvhBuildParam   bvh{};
+    TraversalKernel kernel = TraversalKernel::eAuto;
+};
+
+// The CPU equivalent of prism::Scene. It consumes the same SceneBuilder data, but instead of building BLASes and a
+// TLAS on the device, it builds a BVH for every mesh group and a top level BVH over the instances. Like the BLASes, the
+// transforms of the placed meshes are baked into the mesh group BVHs.
+class Scene
+{
+  public:
+    explicit Scene(const SceneBuilder& sceneBuilder, const SceneParam& param = {});
+    Scene(const Scene&) = delete;
+    Scene(Scene&&)      = default;
+
+    // Finds the closest hit along the ray (ignoring instances that don't pass the cull mask). On a hit, ray.tmax is set
+    // to the distance of the hit.
+    bool intersect(Ray& ray, Hit& hit, uint32_t cullMask = 0xFF) const;
+
+    // The same for the active rays of a packet (K is either 8 or 16), returns the mask of the rays that hit something.
+    // Packets are always traced through the binary BVHs:
+    template <size_t K>
+    uint32_t intersect(RayPacket<K>& packet, std::array<Hit, K>& hits, uint32_t activeMask,
+                       uint32_t cullMask = 0xFF) const;
+
+    // Returns the mask of the active rays that hit anything at all, which is faster and all that shadow rays need:
+    template <size_t K>
+    uint32_t occluded(const RayPacket<K>& packet, uint32_t activeMask, uint32_t cullMask = 0xFF) const;
+
+    // Traces a large batch of rays (like a wavefront queue) as packets. The rays are sorted by their octant and the
+    // position of their origin first, so that the packets are as coherent as possible. isHit[i] is set to whether
+    // rays[i] hit anything, hits[i] is only written on a hit.
+    void intersectStream(std::span<Ray> rays, std::span<Hit> hits, std::span<uint8_t> isHit,
+                         uint32_t cullMask = 0xFF) const;
+
+    // The world space shading normal at the hit (same as getShadingNormal in raytrace.rchit):
+    glm::vec3 shadingNormal(const Hit& hit) const;
+
+    const BBox3f&   bounds() const { return m_topLevelBvh.bounds(); }
+    TraversalKernel traversalKernel() const { return m_kernel; }
+
+  private:
+    struct TriangleId
+    {
+        uint32_t geometryIdx;
+        uint32_t primitiveIdx;
+    };
+
+    struct Geometry
+    {
+        uint32_t verticesOffset;
+        uint32_t facesOffset; // Into m_faces or m_faces16, like in the scene builder
+        bool     indices16;
+
+        bool      hasTransform;
+        glm::mat3 normalTransform; // Inverse transpose of the placed mesh's transform
+    };
+
+    // The triangles are stored with their placed mesh's transform applied. Only the BVH used by the traversal kernel
+    // is collapsed into a wide BVH:
+    struct MeshGroup
+    {
+        std::vector<Geometry>   geometries;
+        std::vector<Triangle>   triangles;
+        std::vector<TriangleId> triangleIds;
+        Bvh                     bvh;
+        Bvh4                    bvh4;
+        Bvh8                    bvh8;
+    };
+
+    struct Instance
+    {
+        glm::mat4 objectToWorld;
+        glm::mat4 worldToObject;
+        uint32_t  meshGroupIdx;
+        uint32_t  mask;
+    };
+
+  private:
+    static TraversalKernel        selectKernel(TraversalKernel kernel);
+    static std::vector<MeshGroup> createMeshGroups(const SceneBuilder& sceneBuilder, const BvhBuildParam& bvhParam,
+                                                   TraversalKernel kernel);
+    static std::vector<Instance>  createInstances(const SceneBuilder& sceneBuilder);
+    static Bvh createTopLevelBvh(std::span<const Instance> instances, std::span<const MeshGroup> meshGroups,
+                                 const BvhBuildParam& bvhParam);
+
+    bool intersectMeshGroup(const MeshGroup& meshGroup, Ray& ray, Hit& hit) const;
+
+    // Hits are only written if they aren't null (for occlusion queries):
+    template <size_t K>
+    uint32_t tracePacket(RayPacket<K>& packet, Hit* hits, uint32_t activeMask, uint32_t cullMask) const;
+
+  private:
+    TraversalKernel m_kernel;
+
+    std::vector<Vertex>       m_vertices;
+    std::vector<glm::u32vec3> m_faces;
+    std::vector<glm::u16vec3> m_faces16;
+
+    std::vector<MeshGroup> m_meshGroups;
+    std::vector<Instance>  m_instances;
+    Bvh                    m_topLevelBvh;
+};
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <cpu/bvh.hpp>
+
+namespace prism {
+namespace cpu {
+
+// Triangles are stored with their vertices (instead of indices) to avoid indirections during traversal:
+struct Triangle
+{
+    glm::vec3 v0;
+    glm::vec3 e1; // v1 - v0
+    glm::vec3 e2; // v2 - v0
+};
+
+// Möller-Trumbore. Triangles are two sided as the instances are created with eTriangleFacingCullDisable. On a hit,
+// ray.tmax is set to the distance of the hit and the barycentrics are the weights of the second and third vertex:
+inline bool intersectTriangle(const Triangle& triangle, Ray& ray, glm::vec2& barycentrics)
+{
+    const glm::vec3 p   = glm::cross(ray.dir, triangle.e2);
+    const float     det = glm::dot(triangle.e1, p);
+    if (det == 0.f) {
+        return false;
+    }
+
+    const float     invDet = 1.f / det;
+    const glm::vec3 s      = ray.origin - triangle.v0;
+    const float     u      = glm::dot(s, p) * invDet;
+    if (u < 0.f || u > 1.f) {
+        return false;
+    }
+
+    const glm::vec3 q = glm::cross(s, triangle.e1);
+    const float     v = glm::dot(ray.dir, q) * invDet;
+    if (v < 0.f || u + v > 1.f) {
+        return false;
+    }
+
+    const float t = glm::dot(triangle.e2, q) * invDet;
+    if (!(t > ray.tmin && t < ray.tmax)) {
+        return false;
+    }
+
+    ray.tmax     = t;
+    barycentrics = glm::vec2(u, v);
+    return true;
+}
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "wide_bvh.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace prism {
+namespace cpu {
+
+template <uint32_t N>
+static void quantizeChildBounds(WideBvhNode<N>& node, const BBox3f& bounds, const std::span<const BBox3f> childBounds)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        const float origin = bounds.pmin[axis];
+        float       scale  = (bounds.pmax[axis] - origin) / 255.f;
+
+        // Make sure that the grid covers the whole node despite any rounding:
+        while (origin + 255.f * scale < bounds.pmax[axis]) {
+            scale = std::nextafter(scale, std::numeric_limits<float>::infinity());
+        }
+
+        node.origin[axis] = origin;
+        node.scale[axis]  = scale;
+
+        // Everything is flat along this axis, so every child has the exact bounds of the node:
+        if (scale == 0.f) {
+            continue;
+        }
+
+        // The lower bounds are rounded down and the upper bounds up, corrected for rounding errors afterwards:
+        for (size_t i = 0; i < childBounds.size(); ++i) {
+            const float childMin = childBounds[i].pmin[axis];
+            const float childMax = childBounds[i].pmax[axis];
+
+            int lower = std::clamp(static_cast<int>(std::floor((childMin - origin) / scale)), 0, 255);
+            while (lower > 0 && origin + lower * scale > childMin) {
+                --lower;
+            }
+
+            int upper = std::clamp(static_cast<int>(std::ceil((childMax - origin) / scale)), 0, 255);
+            while (upper < 255 && origin + upper * scale < childMax) {
+                ++upper;
+            }
+
+            node.lower[axis][i] = static_cast<uint8_t>(lower);
+            node.upper[axis][i] = static_cast<uint8_t>(upper);
+        }
+    }
+}
+
+template <uint32_t N>
+WideBvh<N>::WideBvh(const Bvh& bvh, const std::span<const Triangle> triangles)
+{
+    const auto binaryNodes = bvh.nodes();
+    if (binaryNodes.empty()) {
+        return;
+    }
+
+    m_nodes.emplace_back();
+
+    // The root itself may be a leaf if there are only a few triangles:
+    const auto& root = binaryNodes.front();
+    if (root.numPrims > 0) {
+        collapse(bvh, triangles, std::to_array({0u}), 0);
+    } else {
+        collapse(bvh, triangles, std::to_array({1u, root.offset}), 0);
+    }
+}
+
+template <uint32_t N>
+void WideBvh<N>::collapse(const Bvh& bvh, const std::span<const Triangle> triangles,
+                          const std::span<const uint32_t> binaryChildren, const uint32_t nodeIdx)
+{
+    const auto binaryNodes = bvh.nodes();
+
+    // Keep replacing the inner child with the largest surface area by its children until the node is full:
+    std::array<uint32_t, N> children{};
+    uint32_t                numChildren = static_cast<uint32_t>(binaryChildren.size());
+    std::copy(binaryChildren.begin(), binaryChildren.end(), children.begin());
+
+    while (numChildren < N) {
+        uint32_t bestChild = N;
+        float    bestArea  = -1.f;
+        for (uint32_t i = 0; i < numChildren; ++i) {
+            const auto& binaryNode = binaryNodes[children[i]];
+            if (binaryNode.numPrims == 0 && binaryNode.bounds.surfaceArea() > bestArea) {
+                bestChild = i;
+                bestArea  = binaryNode.bounds.surfaceArea();
+            }
+        }
+
+        if (bestChild == N) {
+            break;
+        }
+
+        const uint32_t opened   = children[bestChild];
+        children[bestChild]     = opened + 1;
+        children[numChildren++] = binaryNodes[opened].offset;
+    }
+
+    BBox3f                bounds;
+    std::array<BBox3f, N> childBounds;
+    for (uint32_t i = 0; i < numChildren; ++i) {
+        childBounds[i] = binaryNodes[children[i]].bounds;
+        bounds.extend(childBounds[i]);
+    }
+
+    quantizeChildBounds(m_nodes[nodeIdx], bounds, std::span(childBounds.data(), numChildren));
+    m_nodes[nodeIdx].numChildren = numChildren;
+
+    // Nodes may be reallocated while adding the children, so they are only ever accessed through their index:
+    for (uint32_t i = 0; i < numChildren; ++i) {
+        const auto& binaryChild = binaryNodes[children[i]];
+        if (binaryChild.numPrims > 0) {
+            addLeaf(bvh, triangles, binaryChild, nodeIdx, i);
+            continue;
+        }
+
+        const auto childNodeIdx       = static_cast<uint32_t>(m_nodes.size());
+        m_nodes[nodeIdx].children[i]  = childNodeIdx;
+        m_nodes[nodeIdx].numBlocks[i] = 0;
+        m_nodes.emplace_back();
+
+        collapse(bvh, triangles, std::to_array({children[i] + 1, binaryChild.offset}), childNodeIdx);
+    }
+}
+
+template <uint32_t N>
+void WideBvh<N>::addLeaf(const Bvh& bvh, const std::span<const Triangle> triangles, const BvhNode& binaryLeaf,
+                         const uint32_t nodeIdx, const uint32_t childIdx)
+{
+    const auto primIndices = bvh.primIndices().subspan(binaryLeaf.offset, binaryLeaf.numPrims);
+
+    // Leaves have at most 2^16 - 1 triangles, so the number of blocks always fits:
+    m_nodes[nodeIdx].children[childIdx]  = static_cast<uint32_t>(m_blocks.size());
+    m_nodes[nodeIdx].numBlocks[childIdx] = static_cast<uint16_t>((primIndices.size() + N - 1) / N);
+
+    for (size_t first = 0; first < primIndices.size(); first += N) {
+        auto& block = m_blocks.emplace_back();
+
+        const size_t numLanes = std::min<size_t>(N, primIndices.size() - first);
+        for (size_t lane = 0; lane < numLanes; ++lane) {
+            const uint32_t triangleIdx = primIndices[first + lane];
+            const auto&    triangle    = triangles[triangleIdx];
+
+            for (int axis = 0; axis < 3; ++axis) {
+                block.v0[axis][lane] = triangle.v0[axis];
+                block.e1[axis][lane] = triangle.e1[axis];
+                block.e2[axis][lane] = triangle.e2[axis];
+            }
+            block.triangleIndices[lane] = triangleIdx;
+        }
+    }
+}
+
+template class WideBvh<4>;
+template class WideBvh<8>;
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
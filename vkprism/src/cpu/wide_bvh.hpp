@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <cpu/bvh.hpp>
+#include <cpu/triangle.hpp>
+
+namespace prism {
+namespace cpu {
+
+// A node with up to N children whose bounds are stored in SoA layout, so that a single SIMD slab test covers all of
+// them. The child bounds are quantized to 8 bits per plane on a grid relative to the node's bounds (always rounded
+// outwards, so they stay conservative): bounds = origin + q * scale.
+template <uint32_t N>
+struct alignas(32) WideBvhNode
+{
+    glm::vec3 origin;
+    glm::vec3 scale;
+    uint8_t   lower[3][N];
+    uint8_t   upper[3][N];
+    uint32_t  children[N];  // Node index for inner children and the first triangle block for leaves
+    uint16_t  numBlocks[N]; // Number of triangle blocks of leaf children, 0 for inner children
+    uint32_t  numChildren;  // The used children always come first
+};
+
+// N triangles in SoA layout for intersecting them all at once. Unused lanes are degenerate triangles (all zeros),
+// which can never be hit.
+template <uint32_t N>
+struct alignas(32) TriangleBlock
+{
+    float    v0[3][N];
+    float    e1[3][N];
+    float    e2[3][N];
+    uint32_t triangleIndices[N];
+};
+
+// A BVH with N wide nodes, created by collapsing a binary BVH over triangles. The triangles of every leaf are copied
+// into triangle blocks, so traversal never has to touch the original triangles.
+template <uint32_t N>
+class WideBvh
+{
+  public:
+    static constexpr uint32_t WIDTH = N;
+
+    WideBvh() = default;
+    WideBvh(const Bvh& bvh, std::span<const Triangle> triangles);
+
+    std::span<const WideBvhNode<N>>   nodes() const { return m_nodes; }
+    std::span<const TriangleBlock<N>> blocks() const { return m_blocks; }
+
+  private:
+    void collapse(const Bvh& bvh, std::span<const Triangle> triangles, std::span<const uint32_t> binaryChildren,
+                  uint32_t nodeIdx);
+    void addLeaf(const Bvh& bvh, std::span<const Triangle> triangles, const BvhNode& binaryLeaf, uint32_t nodeIdx,
+                 uint32_t childIdx);
+
+  private:
+    std::vector<WideBvhNode<N>>   m_nodes;
+    std::vector<TriangleBlock<N>> m_blocks;
+};
+
+using Bvh4 = WideBvh<4>;
+using Bvh8 = WideBvh<8>;
+
+//
+// Traversal kernels, only call these if cpuFeatures() reports support for the instruction set:
+
+struct TriangleHit
+{
+    glm::vec2 barycentrics;
+    uint32_t  triangleIdx; // Index into the triangles the BVH was built from
+};
+
+// Both find the closest hit and set ray.tmax to its distance:
+bool intersectBvh4SSE42(const Bvh4& bvh, Ray& ray, TriangleHit& hit);
+bool intersectBvh8AVX2(const Bvh8& bvh, Ray& ray, TriangleHit& hit);
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
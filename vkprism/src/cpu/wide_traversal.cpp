@@ -0,0 +1,411 @@
+#include "wide_bvh.hpp"
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <util.hpp>
+
+#ifdef PRISM_X86
+#include <immintrin.h>
+#endif
+
+namespace prism {
+namespace cpu {
+
+#ifdef PRISM_X86
+
+//
+// Scalar parts shared by all of the kernels:
+
+// Nodes and leaves are pushed together with their entry distance, so that they can be skipped once a closer hit has
+// been found:
+struct StackEntry
+{
+    uint32_t child;
+    uint32_t numBlocks; // 0 for inner nodes
+    float    tnear;
+};
+
+// At most N - 1 entries are pushed per level and the BVH is at most 60 levels deep (limited by the binary builder):
+constexpr uint32_t STACK_SIZE = 64 * 8;
+
+// Rounding errors in the slab test can cause rays to miss boxes they graze, so the exit distance is scaled up slightly
+// (see "Robust BVH Ray Traversal" by Thiago Ize):
+constexpr float TFAR_SCALE = 1.0000004f;
+
+struct TraversalRay
+{
+    glm::vec3           origin;
+    glm::vec3           dir;
+    glm::vec3           invDir;
+    std::array<bool, 3> dirIsNeg;
+
+    explicit TraversalRay(const Ray& ray) : origin(ray.origin), dir(ray.dir), invDir(safeReciprocal(ray.dir))
+    {
+        for (int axis = 0; axis < 3; ++axis) {
+            dirIsNeg[axis] = invDir[axis] < 0.f;
+        }
+    }
+};
+
+// Pushes the children that were hit onto the stack (farthest first) and returns the closest one in next:
+template <uint32_t N>
+static bool selectChildren(const WideBvhNode<N>& node, uint32_t mask, const float* tnear, StackEntry* stack,
+                           uint32_t& stackSize, StackEntry& next)
+{
+    if (mask == 0) {
+        return false;
+    }
+
+    const auto makeEntry = [&](const uint32_t i) {
+        return StackEntry{.child = node.children[i], .numBlocks = node.numBlocks[i], .tnear = tnear[i]};
+    };
+
+    // The most common case is hitting a single child, which doesn't need any sorting:
+    const uint32_t first = std::countr_zero(mask);
+    mask &= mask - 1;
+    if (mask == 0) {
+        next = makeEntry(first);
+        return true;
+    }
+
+    // Insertion sort by descending distance:
+    std::array<StackEntry, N> hits;
+    uint32_t                  numHits = 0;
+    for (hits[numHits++] = makeEntry(first); mask != 0; mask &= mask - 1) {
+        const auto entry = makeEntry(std::countr_zero(mask));
+
+        uint32_t i = numHits++;
+        for (; i > 0 && hits[i - 1].tnear < entry.tnear; --i) {
+            hits[i] = hits[i - 1];
+        }
+        hits[i] = entry;
+    }
+
+    for (uint32_t i = 0; i < numHits - 1; ++i) {
+        stack[stackSize++] = hits[i];
+    }
+    next = hits[numHits - 1];
+    return true;
+}
+
+// Pops the next entry that can still contain a closer hit:
+static bool popStack(const StackEntry* stack, uint32_t& stackSize, const float tmax, StackEntry& next)
+{
+    while (stackSize > 0) {
+        next = stack[--stackSize];
+        if (next.tnear <= tmax) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Finds the closest of the valid lanes and records the hit:
+template <uint32_t N>
+static bool recordClosestHit(const TriangleBlock<N>& block, uint32_t valid, const float* t, const float* u,
+                             const float* v, Ray& ray, TriangleHit& hit)
+{
+    if (valid == 0) {
+        return false;
+    }
+
+    uint32_t closest = std::countr_zero(valid);
+    for (valid &= valid - 1; valid != 0; valid &= valid - 1) {
+        const uint32_t lane = std::countr_zero(valid);
+        if (t[lane] < t[closest]) {
+            closest = lane;
+        }
+    }
+
+    ray.tmax         = t[closest];
+    hit.barycentrics = glm::vec2(u[closest], v[closest]);
+    hit.triangleIdx  = block.triangleIndices[closest];
+    return true;
+}
+
+//
+// SSE4.2 and BVH4:
+
+struct RaySSE
+{
+    __m128 origin[3];
+    __m128 dir[3];
+};
+
+PRISM_TARGET_SSE42 static inline __m128 loadQuantizedSSE42(const uint8_t* quantized)
+{
+    int32_t bits;
+    std::memcpy(&bits, quantized, sizeof(bits));
+    return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bits)));
+}
+
+PRISM_TARGET_SSE42 static inline __m128 dotSSE42(const __m128* a, const __m128* b)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+}
+
+PRISM_TARGET_SSE42 static inline uint32_t intersectChildrenSSE42(const WideBvhNode<4>& node, const TraversalRay& ray,
+                                                                 const float tmin, const float tmax, float* tnear)
+{
+    __m128 tentry = _mm_set1_ps(tmin);
+    __m128 texit  = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    for (int axis = 0; axis < 3; ++axis) {
+        // The dequantization is folded into the slab test: t = q * (scale / dir) + (origin - rayOrigin) / dir
+        const __m128 scale  = _mm_set1_ps(node.scale[axis] * ray.invDir[axis]);
+        const __m128 offset = _mm_set1_ps((node.origin[axis] - ray.origin[axis]) * ray.invDir[axis]);
+
+        const uint8_t* nearPlanes = ray.dirIsNeg[axis] ? node.upper[axis] : node.lower[axis];
+        const uint8_t* farPlanes  = ray.dirIsNeg[axis] ? node.lower[axis] : node.upper[axis];
+
+        tentry = _mm_max_ps(tentry, _mm_add_ps(_mm_mul_ps(loadQuantizedSSE42(nearPlanes), scale), offset));
+        texit  = _mm_min_ps(texit, _mm_add_ps(_mm_mul_ps(loadQuantizedSSE42(farPlanes), scale), offset));
+    }
+    texit = _mm_min_ps(_mm_mul_ps(texit, _mm_set1_ps(TFAR_SCALE)), _mm_set1_ps(tmax));
+
+    _mm_storeu_ps(tnear, tentry);
+    return _mm_movemask_ps(_mm_cmple_ps(tentry, texit)) & ((1u << node.numChildren) - 1);
+}
+
+PRISM_TARGET_SSE42 static inline bool intersectBlockSSE42(const TriangleBlock<4>& block, const RaySSE& raySSE, Ray& ray,
+                                                          TriangleHit& hit)
+{
+    const __m128 e1[3] = {_mm_load_ps(block.e1[0]), _mm_load_ps(block.e1[1]), _mm_load_ps(block.e1[2])};
+    const __m128 e2[3] = {_mm_load_ps(block.e2[0]), _mm_load_ps(block.e2[1]), _mm_load_ps(block.e2[2])};
+    const __m128 s[3]  = {_mm_sub_ps(raySSE.origin[0], _mm_load_ps(block.v0[0])),
+                         _mm_sub_ps(raySSE.origin[1], _mm_load_ps(block.v0[1])),
+                         _mm_sub_ps(raySSE.origin[2], _mm_load_ps(block.v0[2]))};
+    const auto&  d     = raySSE.dir;
+
+    // Same as the scalar Möller-Trumbore in triangle.hpp, for 4 triangles at once:
+    const __m128 p[3] = {_mm_sub_ps(_mm_mul_ps(d[1], e2[2]), _mm_mul_ps(d[2], e2[1])),
+                         _mm_sub_ps(_mm_mul_ps(d[2], e2[0]), _mm_mul_ps(d[0], e2[2])),
+                         _mm_sub_ps(_mm_mul_ps(d[0], e2[1]), _mm_mul_ps(d[1], e2[0]))};
+    const __m128 q[3] = {_mm_sub_ps(_mm_mul_ps(s[1], e1[2]), _mm_mul_ps(s[2], e1[1])),
+                         _mm_sub_ps(_mm_mul_ps(s[2], e1[0]), _mm_mul_ps(s[0], e1[2])),
+                         _mm_sub_ps(_mm_mul_ps(s[0], e1[1]), _mm_mul_ps(s[1], e1[0]))};
+
+    const __m128 det    = dotSSE42(e1, p);
+    const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.f), det);
+    const __m128 u      = _mm_mul_ps(dotSSE42(s, p), invDet);
+    const __m128 v      = _mm_mul_ps(dotSSE42(d, q), invDet);
+    const __m128 t      = _mm_mul_ps(dotSSE42(e2, q), invDet);
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one  = _mm_set1_ps(1.f);
+
+    __m128 valid = _mm_cmpneq_ps(det, zero);
+    valid        = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+    valid        = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+    valid        = _mm_and_ps(valid, _mm_cmpgt_ps(t, _mm_set1_ps(ray.tmin)));
+    valid        = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(ray.tmax)));
+
+    const uint32_t validMask = _mm_movemask_ps(valid);
+    if (validMask == 0) {
+        return false;
+    }
+
+    alignas(16) float tLanes[4], uLanes[4], vLanes[4];
+    _mm_store_ps(tLanes, t);
+    _mm_store_ps(uLanes, u);
+    _mm_store_ps(vLanes, v);
+    return recordClosestHit(block, validMask, tLanes, uLanes, vLanes, ray, hit);
+}
+
+PRISM_TARGET_SSE42 bool intersectBvh4SSE42(const Bvh4& bvh, Ray& ray, TriangleHit& hit)
+{
+    const auto nodes  = bvh.nodes();
+    const auto blocks = bvh.blocks();
+    if (nodes.empty()) {
+        return false;
+    }
+
+    const TraversalRay traversalRay(ray);
+
+    RaySSE raySSE;
+    for (int axis = 0; axis < 3; ++axis) {
+        raySSE.origin[axis] = _mm_set1_ps(ray.origin[axis]);
+        raySSE.dir[axis]    = _mm_set1_ps(ray.dir[axis]);
+    }
+
+    std::array<StackEntry, STACK_SIZE> stack;
+    uint32_t                           stackSize = 0;
+    StackEntry                         current{.child = 0, .numBlocks = 0, .tnear = ray.tmin};
+
+    bool isHit = false;
+    while (true) {
+        if (current.numBlocks == 0) {
+            const auto& node = nodes[current.child];
+
+            alignas(16) float tnear[4];
+            const uint32_t    mask = intersectChildrenSSE42(node, traversalRay, ray.tmin, ray.tmax, tnear);
+            if (selectChildren(node, mask, tnear, stack.data(), stackSize, current)) {
+                continue;
+            }
+        } else {
+            for (uint32_t i = 0; i < current.numBlocks; ++i) {
+                isHit |= intersectBlockSSE42(blocks[current.child + i], raySSE, ray, hit);
+            }
+        }
+
+        if (!popStack(stack.data(), stackSize, ray.tmax, current)) {
+            break;
+        }
+    }
+
+    return isHit;
+}
+
+//
+// AVX2 and BVH8:
+
+struct RayAVX
+{
+    __m256 origin[3];
+    __m256 dir[3];
+};
+
+PRISM_TARGET_AVX2 static inline __m256 loadQuantizedAVX2(const uint8_t* quantized)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(quantized))));
+}
+
+PRISM_TARGET_AVX2 static inline __m256 dotAVX2(const __m256* a, const __m256* b)
+{
+    const __m256 xy = _mm256_add_ps(_mm256_mul_ps(a[0], b[0]), _mm256_mul_ps(a[1], b[1]));
+    return _mm256_add_ps(xy, _mm256_mul_ps(a[2], b[2]));
+}
+
+PRISM_TARGET_AVX2 static inline uint32_t intersectChildrenAVX2(const WideBvhNode<8>& node, const TraversalRay& ray,
+                                                               const float tmin, const float tmax, float* tnear)
+{
+    __m256 tentry = _mm256_set1_ps(tmin);
+    __m256 texit  = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    for (int axis = 0; axis < 3; ++axis) {
+        // The dequantization is folded into the slab test: t = q * (scale / dir) + (origin - rayOrigin) / dir
+        const __m256 scale  = _mm256_set1_ps(node.scale[axis] * ray.invDir[axis]);
+        const __m256 offset = _mm256_set1_ps((node.origin[axis] - ray.origin[axis]) * ray.invDir[axis]);
+
+        const uint8_t* nearPlanes = ray.dirIsNeg[axis] ? node.upper[axis] : node.lower[axis];
+        const uint8_t* farPlanes  = ray.dirIsNeg[axis] ? node.lower[axis] : node.upper[axis];
+
+        tentry = _mm256_max_ps(tentry, _mm256_fmadd_ps(loadQuantizedAVX2(nearPlanes), scale, offset));
+        texit  = _mm256_min_ps(texit, _mm256_fmadd_ps(loadQuantizedAVX2(farPlanes), scale, offset));
+    }
+    texit = _mm256_min_ps(_mm256_mul_ps(texit, _mm256_set1_ps(TFAR_SCALE)), _mm256_set1_ps(tmax));
+
+    _mm256_storeu_ps(tnear, tentry);
+    return _mm256_movemask_ps(_mm256_cmp_ps(tentry, texit, _CMP_LE_OQ)) & ((1u << node.numChildren) - 1);
+}
+
+PRISM_TARGET_AVX2 static inline bool intersectBlockAVX2(const TriangleBlock<8>& block, const RayAVX& rayAVX, Ray& ray,
+                                                        TriangleHit& hit)
+{
+    const __m256 e1[3] = {_mm256_load_ps(block.e1[0]), _mm256_load_ps(block.e1[1]), _mm256_load_ps(block.e1[2])};
+    const __m256 e2[3] = {_mm256_load_ps(block.e2[0]), _mm256_load_ps(block.e2[1]), _mm256_load_ps(block.e2[2])};
+    const __m256 s[3]  = {_mm256_sub_ps(rayAVX.origin[0], _mm256_load_ps(block.v0[0])),
+                         _mm256_sub_ps(rayAVX.origin[1], _mm256_load_ps(block.v0[1])),
+                         _mm256_sub_ps(rayAVX.origin[2], _mm256_load_ps(block.v0[2]))};
+    const auto&  d     = rayAVX.dir;
+
+    // Same as the scalar Möller-Trumbore in triangle.hpp, for 8 triangles at once. FMAs aren't used on purpose, so that
+    // the results are exactly the same as the other kernels' (even for rays that graze the edges):
+    const __m256 p[3] = {_mm256_sub_ps(_mm256_mul_ps(d[1], e2[2]), _mm256_mul_ps(d[2], e2[1])),
+                         _mm256_sub_ps(_mm256_mul_ps(d[2], e2[0]), _mm256_mul_ps(d[0], e2[2])),
+                         _mm256_sub_ps(_mm256_mul_ps(d[0], e2[1]), _mm256_mul_ps(d[1], e2[0]))};
+    const __m256 q[3] = {_mm256_sub_ps(_mm256_mul_ps(s[1], e1[2]), _mm256_mul_ps(s[2], e1[1])),
+                         _mm256_sub_ps(_mm256_mul_ps(s[2], e1[0]), _mm256_mul_ps(s[0], e1[2])),
+                         _mm256_sub_ps(_mm256_mul_ps(s[0], e1[1]), _mm256_mul_ps(s[1], e1[0]))};
+
+    const __m256 det    = dotAVX2(e1, p);
+    const __m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.f), det);
+    const __m256 u      = _mm256_mul_ps(dotAVX2(s, p), invDet);
+    const __m256 v      = _mm256_mul_ps(dotAVX2(d, q), invDet);
+    const __m256 t      = _mm256_mul_ps(dotAVX2(e2, q), invDet);
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one  = _mm256_set1_ps(1.f);
+
+    __m256 valid = _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ);
+    valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+    valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ),
+                                               _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(ray.tmin), _CMP_GT_OQ));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(ray.tmax), _CMP_LT_OQ));
+
+    const uint32_t validMask = _mm256_movemask_ps(valid);
+    if (validMask == 0) {
+        return false;
+    }
+
+    alignas(32) float tLanes[8], uLanes[8], vLanes[8];
+    _mm256_store_ps(tLanes, t);
+    _mm256_store_ps(uLanes, u);
+    _mm256_store_ps(vLanes, v);
+    return recordClosestHit(block, validMask, tLanes, uLanes, vLanes, ray, hit);
+}
+
+PRISM_TARGET_AVX2 bool intersectBvh8AVX2(const Bvh8& bvh, Ray& ray, TriangleHit& hit)
+{
+    const auto nodes  = bvh.nodes();
+    const auto blocks = bvh.blocks();
+    if (nodes.empty()) {
+        return false;
+    }
+
+    const TraversalRay traversalRay(ray);
+
+    RayAVX rayAVX;
+    for (int axis = 0; axis < 3; ++axis) {
+        rayAVX.origin[axis] = _mm256_set1_ps(ray.origin[axis]);
+        rayAVX.dir[axis]    = _mm256_set1_ps(ray.dir[axis]);
+    }
+
+    std::array<StackEntry, STACK_SIZE> stack;
+    uint32_t                           stackSize = 0;
+    StackEntry                         current{.child = 0, .numBlocks = 0, .tnear = ray.tmin};
+
+    bool isHit = false;
+    while (true) {
+        if (current.numBlocks == 0) {
+            const auto& node = nodes[current.child];
+
+            alignas(32) float tnear[8];
+            const uint32_t    mask = intersectChildrenAVX2(node, traversalRay, ray.tmin, ray.tmax, tnear);
+            if (selectChildren(node, mask, tnear, stack.data(), stackSize, current)) {
+                continue;
+            }
+        } else {
+            for (uint32_t i = 0; i < current.numBlocks; ++i) {
+                isHit |= intersectBlockAVX2(blocks[current.child + i], rayAVX, ray, hit);
+            }
+        }
+
+        if (!popStack(stack.data(), stackSize, ray.tmax, current)) {
+            break;
+        }
+    }
+
+    return isHit;
+}
+
+#else
+
+bool intersectBvh4SSE42(const Bvh4& bvh, Ray& ray, TriangleHit& hit)
+{
+    throw std::runtime_error("The SSE4.2 traversal kernel is only available on x86.");
+}
+
+bool intersectBvh8AVX2(const Bvh8& bvh, Ray& ray, TriangleHit& hit)
+{
+    throw std::runtime_error("The AVX2 traversal kernel is only available on x86.");
+}
+
+#endif
+
+} // namespace cpu
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "cpu_features.hpp"
+
+#include <cstdint>
+
+#include <util.hpp>
+
+#ifdef PRISM_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace prism {
+
+#ifdef PRISM_X86
+
+struct CpuidRegisters
+{
+    uint32_t eax, ebx, ecx, edx;
+};
+
+static CpuidRegisters cpuid(const uint32_t leaf, const uint32_t subleaf)
+{
+    CpuidRegisters regs{};
+#ifdef _MSC_VER
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+    regs = {uint32_t(values[0]), uint32_t(values[1]), uint32_t(values[2]), uint32_t(values[3])};
+#else
+    __cpuid_count(leaf, subleaf, regs.eax, regs.ebx, regs.ecx, regs.edx);
+#endif
+    return regs;
+}
+
+// The state components the OS saves on context switches (XCR0):
+static uint64_t xgetbv()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (uint64_t(edx) << 32) | eax;
+#endif
+}
+
+static CpuFeatures queryCpuFeatures()
+{
+    CpuFeatures features{};
+
+    const uint32_t maxLeaf = cpuid(0, 0).eax;
+    if (maxLeaf < 1) {
+        return features;
+    }
+
+    const auto leaf1 = cpuid(1, 0);
+    features.sse42   = (leaf1.ecx & (1u << 19)) && (leaf1.ecx & (1u << 20));
+
+    // AVX instructions are only usable if the OS saves the XMM and YMM registers:
+    const bool osxsave = leaf1.ecx & (1u << 27);
+    const bool avx     = (leaf1.ecx & (1u << 28)) && osxsave && (xgetbv() & 0x6) == 0x6;
+    if (!avx) {
+        return features;
+    }
+
+    features.fma = leaf1.ecx & (1u << 12);
+    if (maxLeaf >= 7) {
+        features.avx2 = cpuid(7, 0).ebx & (1u << 5);
+    }
+
+    return features;
+}
+
+#else
+
+static CpuFeatures queryCpuFeatures()
+{
+    return {};
+}
+
+#endif
+
+const CpuFeatures& cpuFeatures()
+{
+    static const CpuFeatures features = queryCpuFeatures();
+    return features;
+}
+
+} // namespace prism
\ No newline at end of file
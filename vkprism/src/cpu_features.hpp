@@ -0,0 +1,17 @@
+#pragma once
+
+namespace prism {
+
+// Instruction sets beyond the x86 baseline that we have specialized code paths for. Everything is false on other
+// architectures.
+struct CpuFeatures
+{
+    bool sse42 = false; // Including SSE4.1
+    bool avx2  = false; // Including AVX and OS support for saving the YMM registers
+    bool fma   = false;
+};
+
+// Queried once using CPUID:
+const CpuFeatures& cpuFeatures();
+
+} // namespace prism
\ No newline at end of file
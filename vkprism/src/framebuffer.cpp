@@ -0,0 +1,114 @@
+#include "framebuffer.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+#include <util.hpp>
+
+#ifdef PRISM_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace prism {
+
+static float halfToFloat(const uint16_t half)
+{
+    const uint32_t sign     = static_cast<uint32_t>(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FF;
+
+    if (exponent == 0x1F) {
+        return std::bit_cast<float>(sign | 0x7F800000 | (mantissa << 13)); // Inf or NaN
+    }
+    // Scaling by 2^112 takes care of the exponent bias and denormals at the same time:
+    return std::bit_cast<float>(sign | std::bit_cast<uint32_t>(
+                                           std::bit_cast<float>((exponent << 23) | (mantissa << 13)) * 0x1p112f));
+}
+
+static glm::vec3 decodeRGB9E5(const uint32_t packed)
+{
+    const float scale = std::bit_cast<float>(((packed >> 27) + 127 - 24) << 23); // 2^(exponent - 15 - 9)
+    return glm::vec3(float(packed & 0x1FF), float((packed >> 9) & 0x1FF), float((packed >> 18) & 0x1FF)) * scale;
+}
+
+#ifdef PRISM_SSE2
+// Converts the halfs stored in the lower 16 bits of every lane to floats:
+static __m128 halfToFloatSSE2(const __m128i half)
+{
+    const __m128i expMant  = _mm_and_si128(half, _mm_set1_epi32(0x7FFF));
+    const __m128i sign     = _mm_slli_epi32(_mm_xor_si128(half, expMant), 16);
+    const __m128  scaled   = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expMant, 13)), _mm_set1_ps(0x1p112f));
+    const __m128i wasInfNan = _mm_cmpgt_epi32(expMant, _mm_set1_epi32(0x7BFF));
+    const __m128i infNanExp = _mm_and_si128(wasInfNan, _mm_set1_epi32(0x7F800000));
+    return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNanExp)));
+}
+#endif
+
+void decodeBeauty(const std::span<const std::byte> src, const BeautyFormat format, const std::span<glm::vec3> dst)
+{
+    const size_t numPixels = dst.size();
+    if (src.size() < numPixels * beautyPixelSize(format)) {
+        throw std::runtime_error("Beauty buffer is too small for the number of pixels being decoded.");
+    }
+
+    if (format == BeautyFormat::eRGB32F) {
+        std::memcpy(dst.data(), src.data(), numPixels * sizeof(glm::vec3));
+        return;
+    }
+
+    float* const out = reinterpret_cast<float*>(dst.data());
+
+    parallelFor(numPixels, 1 << 14, [&](const size_t begin, const size_t end) {
+        size_t i = begin;
+
+        if (format == BeautyFormat::eRGBA16F) {
+#ifdef PRISM_SSE2
+            // Two pixels per iteration. Every pixel is stored as 4 floats (the last one overlaps with the next pixel
+            // and is overwritten after), so we stop one pixel early to not write past the end of our range.
+            for (; i + 2 < end; i += 2) {
+                const __m128i halfs =
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.data() + i * beautyPixelSize(format)));
+                const __m128 p0 = halfToFloatSSE2(_mm_unpacklo_epi16(halfs, _mm_setzero_si128()));
+                const __m128 p1 = halfToFloatSSE2(_mm_unpackhi_epi16(halfs, _mm_setzero_si128()));
+                _mm_storeu_ps(out + 3 * i, p0);
+                _mm_storeu_ps(out + 3 * i + 3, p1);
+            }
+#endif
+            for (; i < end; ++i) {
+                std::array<uint16_t, 4> rgba;
+                std::memcpy(rgba.data(), src.data() + i * beautyPixelSize(format), sizeof(rgba));
+                dst[i] = glm::vec3(halfToFloat(rgba[0]), halfToFloat(rgba[1]), halfToFloat(rgba[2]));
+            }
+        } else {
+#ifdef PRISM_SSE2
+            // Four pixels per iteration, decoded as SoA and then interleaved when storing:
+            alignas(16) std::array<float, 4> r, g, b;
+            for (; i + 4 <= end; i += 4) {
+                const __m128i packed   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.data() + i * 4));
+                const __m128i mantMask = _mm_set1_epi32(0x1FF);
+                const __m128  scale    = _mm_castsi128_ps(
+                    _mm_slli_epi32(_mm_add_epi32(_mm_srli_epi32(packed, 27), _mm_set1_epi32(127 - 24)), 23));
+
+                _mm_store_ps(r.data(), _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(packed, mantMask)), scale));
+                _mm_store_ps(g.data(),
+                             _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 9), mantMask)), scale));
+                _mm_store_ps(b.data(),
+                             _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 18), mantMask)), scale));
+
+                for (size_t k = 0; k < 4; ++k) {
+                    dst[i + k] = glm::vec3(r[k], g[k], b[k]);
+                }
+            }
+#endif
+            for (; i < end; ++i) {
+                uint32_t packed;
+                std::memcpy(&packed, src.data() + i * sizeof(uint32_t), sizeof(uint32_t));
+                dst[i] = decodeRGB9E5(packed);
+            }
+        }
+    });
+}
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <glm/vec3.hpp>
+
+#include <shaders/framebuffer.hpp>
+
+namespace prism {
+
+// The format the beauty output is stored in on the GPU (and read back in):
+enum class BeautyFormat : uint32_t
+{
+    eRGB32F  = BEAUTY_FORMAT_RGB32F,
+    eRGBA16F = BEAUTY_FORMAT_RGBA16F,
+    eRGB9E5  = BEAUTY_FORMAT_RGB9E5,
+};
+
+constexpr size_t beautyPixelSize(const BeautyFormat format)
+{
+    switch (format) {
+    case BeautyFormat::eRGBA16F:
+        return 4 * sizeof(uint16_t);
+    case BeautyFormat::eRGB9E5:
+        return sizeof(uint32_t);
+    case BeautyFormat::eRGB32F:
+    default:
+        return sizeof(glm::vec3);
+    }
+}
+
+// Decodes a beauty buffer that was read back in the given format into linear float RGB. The work is split across all
+// of the hardware threads and uses SSE2 where available. The source can be a mapped readback buffer.
+void decodeBeauty(std::span<const std::byte> src, BeautyFormat format, std::span<glm::vec3> dst);
+
+} // namespace prism
\ No newline at end of file
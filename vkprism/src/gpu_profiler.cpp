@@ -0,0 +1,181 @@
+#include "gpu_profiler.hpp"
+
+#include <array>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+#include <context.hpp>
+
+namespace prism {
+
+// Every scope has a query for its start and one for its end:
+static uint32_t beginQuery(const GpuScopeId scopeId) { return 2 * scopeId; }
+static uint32_t endQuery(const GpuScopeId scopeId) { return 2 * scopeId + 1; }
+
+GpuProfiler::GpuProfiler(const Context& context, const uint32_t maxScopes) : m_context(context)
+{
+    const auto& device = context.device();
+
+    const uint32_t timestampValidBits =
+        context.physicalDevice().getQueueFamilyProperties()[context.queueFamilyIndex()].timestampValidBits;
+    if (timestampValidBits == 0) {
+        spdlog::warn("The queue doesn't support timestamps, GPU profiling is disabled.");
+        return;
+    }
+    // The queries are reset from the host, so that the scopes don't need a reset command in the command buffers:
+    if (!context.features().get<vk::PhysicalDeviceVulkan12Features>().hostQueryReset) {
+        spdlog::warn("The device doesn't support resetting queries from the host, GPU profiling is disabled.");
+        return;
+    }
+
+    m_timestampPeriod = context.properties().get<vk::PhysicalDeviceProperties2>().properties.limits.timestampPeriod;
+    m_timestampMask   = timestampValidBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << timestampValidBits) - 1;
+
+    m_queryPool = device.createQueryPoolUnique(vk::QueryPoolCreateInfo{
+        .queryType  = vk::QueryType::eTimestamp,
+        .queryCount = 2 * maxScopes,
+    });
+    device.resetQueryPool(*m_queryPool, 0, 2 * maxScopes);
+
+    m_scopes.resize(maxScopes);
+    // Handed out from the back, so the lowest ids are used first:
+    for (uint32_t i = 0; i < maxScopes; ++i) {
+        m_freeScopes.push_back(maxScopes - 1 - i);
+    }
+
+    //
+    // Line up the GPU clock with the CPU clock by writing a single timestamp and assuming that it was written halfway
+    // between the submission and the end of the wait:
+
+    const auto commandPool = device.createCommandPoolUnique(vk::CommandPoolCreateInfo{
+        .flags            = vk::CommandPoolCreateFlagBits::eTransient,
+        .queueFamilyIndex = context.queueFamilyIndex(),
+    });
+    const auto commandBuffer = std::move(device.allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{
+        .commandPool        = *commandPool,
+        .level              = vk::CommandBufferLevel::ePrimary,
+        .commandBufferCount = 1,
+    })[0]);
+
+    commandBuffer->begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    commandBuffer->writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *m_queryPool, 0);
+
+    const int64_t submitNs = profiler().now();
+    submitAndWait(context, *commandBuffer, "calibrating the GPU timestamps");
+    const int64_t waitNs = profiler().now();
+
+    uint64_t   timestamp = 0;
+    const auto result    = device.getQueryPoolResults(*m_queryPool, 0, 1, sizeof(timestamp), &timestamp,
+                                                      sizeof(timestamp), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to read the calibration timestamp of the GPU profiler.");
+    }
+    device.resetQueryPool(*m_queryPool, 0, 1);
+
+    m_offsetNs = (submitNs + waitNs) / 2 - static_cast<int64_t>((timestamp & m_timestampMask) * m_timestampPeriod);
+
+    m_collectFnId = profiler().addCollectFn([this]() { collect(); });
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    // Any scope that is still in flight is lost:
+    if (m_queryPool) {
+        profiler().removeCollectFn(m_collectFnId);
+    }
+}
+
+int64_t GpuProfiler::toProfilerNs(const uint64_t timestamp) const
+{
+    return static_cast<int64_t>((timestamp & m_timestampMask) * m_timestampPeriod) + m_offsetNs;
+}
+
+GpuScopeId GpuProfiler::beginScope(const vk::CommandBuffer& commandBuffer, const char* name)
+{
+    if (!m_queryPool) {
+        return INVALID_SCOPE;
+    }
+
+    std::lock_guard lock(m_mutex);
+    if (m_freeScopes.empty()) {
+        if (!m_warnedFull) {
+            spdlog::warn("Too many GPU scopes are in flight, the new ones are dropped until the profiler catches up.");
+            m_warnedFull = true;
+        }
+        return INVALID_SCOPE;
+    }
+
+    const GpuScopeId scopeId = m_freeScopes.back();
+    m_freeScopes.pop_back();
+    m_scopes[scopeId] = Scope{.name = name, .frame = profiler().frame(), .ended = false};
+    m_pendingScopes.push_back(scopeId);
+
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *m_queryPool, beginQuery(scopeId));
+    return scopeId;
+}
+
+void GpuProfiler::endScope(const vk::CommandBuffer& commandBuffer, const GpuScopeId scopeId)
+{
+    if (scopeId == INVALID_SCOPE) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_scopes[scopeId].ended = true;
+    }
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *m_queryPool, endQuery(scopeId));
+}
+
+void GpuProfiler::collect()
+{
+    std::lock_guard lock(m_mutex);
+
+    std::erase_if(m_pendingScopes, [&](const GpuScopeId scopeId) {
+        const auto& scope = m_scopes[scopeId];
+        if (!scope.ended) {
+            return false;
+        }
+
+        // Without the wait flag this returns eNotReady until both timestamps have been written:
+        std::array<uint64_t, 2> timestamps{};
+        const auto              result = m_context.device().getQueryPoolResults(
+            *m_queryPool, beginQuery(scopeId), 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+            vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess) {
+            return false;
+        }
+
+        const int64_t startNs    = toProfilerNs(timestamps[0]);
+        const int64_t durationNs = toProfilerNs(timestamps[1]) - startNs;
+        profiler().record(ProfileEvent{
+            .name       = scope.name,
+            .track      = ProfileTrack::eGpu,
+            .threadIdx  = 0,
+            .frame      = scope.frame,
+            .startNs    = startNs,
+            .durationNs = durationNs,
+        });
+        m_lastDurationsMs[scope.name] = static_cast<double>(durationNs) * 1e-6;
+
+        m_context.device().resetQueryPool(*m_queryPool, beginQuery(scopeId), 2);
+        m_freeScopes.push_back(scopeId);
+        return true;
+    });
+
+    if (m_warnedFull && m_freeScopes.size() == m_scopes.size()) {
+        m_warnedFull = false;
+    }
+}
+
+std::optional<double> GpuProfiler::lastDurationMs(const std::string_view name)
+{
+    collect();
+
+    std::lock_guard lock(m_mutex);
+    const auto      it = m_lastDurationsMs.find(name);
+    return it != m_lastDurationsMs.end() ? std::optional(it->second) : std::nullopt;
+}
+
+} // namespace prism
\ No newline at end of file
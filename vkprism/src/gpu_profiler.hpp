@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include <profiler.hpp>
+
+namespace prism {
+
+class Context;
+
+// Index of a GPU scope in the query pool (INVALID if the scope was dropped):
+using GpuScopeId = uint32_t;
+
+// Measures GPU time with timestamp queries. Every scope writes a timestamp at its start and at its end, the results are
+// read without blocking whenever the profiler collects its events (so a scope shows up once the GPU has finished it).
+// The timestamps are converted to the CPU clock with an offset measured at construction, which is good enough to line
+// up the submissions with the CPU scopes that recorded them (but drifts over long runs).
+class GpuProfiler
+{
+  public:
+    static constexpr GpuScopeId INVALID_SCOPE = std::numeric_limits<GpuScopeId>::max();
+
+    // At most maxScopes can be in flight at the same time, any scope beyond that is dropped:
+    explicit GpuProfiler(const Context& context, uint32_t maxScopes = 1024);
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler(GpuProfiler&&)      = delete;
+    ~GpuProfiler();
+
+    // False if the device can't do timestamps (or can't reset queries from the host), every scope is dropped then:
+    bool isSupported() const { return static_cast<bool>(m_queryPool); }
+
+    // The timestamps of a scope may be written to different command buffers, as long as they are submitted to the same
+    // queue in the right order:
+    GpuScopeId beginScope(const vk::CommandBuffer& commandBuffer, const char* name);
+    void       endScope(const vk::CommandBuffer& commandBuffer, GpuScopeId scopeId);
+
+    // Records every finished scope to profiler() (called by it):
+    void collect();
+
+    // The duration of the last finished scope with this name, collects the finished scopes first. Empty if there is
+    // none yet (e.g. the scope was dropped or is still running):
+    std::optional<double> lastDurationMs(std::string_view name);
+
+  private:
+    struct Scope
+    {
+        const char* name;
+        uint64_t    frame;
+        bool        ended;
+    };
+
+  private:
+    int64_t toProfilerNs(uint64_t timestamp) const;
+
+  private:
+    const Context& m_context;
+
+    vk::UniqueQueryPool m_queryPool;
+    double              m_timestampPeriod = 1.0; // Nanoseconds per tick
+    uint64_t            m_timestampMask   = 0;
+    int64_t             m_offsetNs        = 0; // From the GPU clock (in nanoseconds) to the clock of the profiler
+
+    std::mutex              m_mutex;
+    std::vector<Scope>      m_scopes;
+    std::vector<GpuScopeId> m_freeScopes;
+    std::vector<GpuScopeId> m_pendingScopes;
+    bool                    m_warnedFull = false;
+
+    // By the name of the scopes (which are string literals, like the names of the CPU scopes):
+    std::unordered_map<std::string_view, double> m_lastDurationsMs;
+
+    uint64_t m_collectFnId = 0;
+};
+
+// Null profilers (i.e. GPU profiling is disabled) are allowed:
+inline GpuScopeId beginGpuScope(GpuProfiler* gpuProfiler, const vk::CommandBuffer& commandBuffer, const char* name)
+{
+    return gpuProfiler ? gpuProfiler->beginScope(commandBuffer, name) : GpuProfiler::INVALID_SCOPE;
+}
+
+inline void endGpuScope(GpuProfiler* gpuProfiler, const vk::CommandBuffer& commandBuffer, const GpuScopeId scopeId)
+{
+    if (gpuProfiler) {
+        gpuProfiler->endScope(commandBuffer, scopeId);
+    }
+}
+
+// Ends the scope when it goes out of scope, so the command buffer has to still be recording by then:
+class GpuProfileScope
+{
+  public:
+    GpuProfileScope(GpuProfiler* gpuProfiler, const vk::CommandBuffer& commandBuffer, const char* name) :
+        m_gpuProfiler(gpuProfiler),
+        m_commandBuffer(commandBuffer),
+        m_scopeId(beginGpuScope(gpuProfiler, commandBuffer, name))
+    {}
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    ~GpuProfileScope() { endGpuScope(m_gpuProfiler, m_commandBuffer, m_scopeId); }
+
+  private:
+    GpuProfiler*      m_gpuProfiler;
+    vk::CommandBuffer m_commandBuffer;
+    GpuScopeId        m_scopeId;
+};
+
+} // namespace prism
+
+// The scoped version is for command buffers that are still recording at the end of the block, the begin and end
+// macros are for everything else (e.g. scopes that end right before submitAndWait, or that span command buffers):
+#ifdef PRISM_ENABLE_PROFILING
+#define PRISM_PROFILE_GPU_SCOPE(gpuProfiler, commandBuffer, name)                                                      \
+    const ::prism::GpuProfileScope PRISM_PROFILE_CONCAT(prismGpuScope, __LINE__)(gpuProfiler, commandBuffer, name)
+#define PRISM_PROFILE_GPU_BEGIN(scopeId, gpuProfiler, commandBuffer, name)                                             \
+    const ::prism::GpuScopeId scopeId = ::prism::beginGpuScope(gpuProfiler, commandBuffer, name)
+#define PRISM_PROFILE_GPU_END(scopeId, gpuProfiler, commandBuffer)                                                     \
+    ::prism::endGpuScope(gpuProfiler, commandBuffer, scopeId)
+#else
+#define PRISM_PROFILE_GPU_SCOPE(gpuProfiler, commandBuffer, name)          ((void)0)
+#define PRISM_PROFILE_GPU_BEGIN(scopeId, gpuProfiler, commandBuffer, name) ((void)0)
+#define PRISM_PROFILE_GPU_END(scopeId, gpuProfiler, commandBuffer)         ((void)0)
+#endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "hash.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <vector>
+
+#include <util.hpp>
+
+namespace prism {
+
+//
+// XXH64 (see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md), assumes a little endian host:
+
+static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+template <typename T>
+static T read(const std::byte* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+static uint64_t xxhRound(uint64_t acc, const uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = std::rotl(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static uint64_t mergeRound(uint64_t acc, const uint64_t value)
+{
+    acc ^= xxhRound(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t hash64(const std::span<const std::byte> data, const uint64_t seed)
+{
+    const std::byte* ptr = data.data();
+    const std::byte* end = ptr + data.size();
+
+    uint64_t hash;
+    if (data.size() >= 32) {
+        // Four independent lanes over 32 byte stripes:
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        for (; ptr + 32 <= end; ptr += 32) {
+            v1 = xxhRound(v1, read<uint64_t>(ptr));
+            v2 = xxhRound(v2, read<uint64_t>(ptr + 8));
+            v3 = xxhRound(v3, read<uint64_t>(ptr + 16));
+            v4 = xxhRound(v4, read<uint64_t>(ptr + 24));
+        }
+
+        hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    } else {
+        hash = seed + PRIME64_5;
+    }
+
+    hash += data.size();
+
+    // The remaining (up to 31) bytes:
+    for (; ptr + 8 <= end; ptr += 8) {
+        hash ^= xxhRound(0, read<uint64_t>(ptr));
+        hash = std::rotl(hash, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (ptr + 4 <= end) {
+        hash ^= read<uint32_t>(ptr) * PRIME64_1;
+        hash = std::rotl(hash, 23) * PRIME64_2 + PRIME64_3;
+        ptr += 4;
+    }
+    for (; ptr < end; ++ptr) {
+        hash ^= static_cast<uint64_t>(*ptr) * PRIME64_5;
+        hash = std::rotl(hash, 11) * PRIME64_1;
+    }
+
+    // Avalanche:
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t parallelHash64(const std::span<const std::byte> data, const uint64_t seed)
+{
+    // Large enough that the tasks are worth it:
+    constexpr size_t CHUNK_SIZE = size_t(1) << 20;
+
+    if (data.size() <= CHUNK_SIZE) {
+        return hash64(data, seed);
+    }
+
+    std::vector<uint64_t> chunkHashes((data.size() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    parallelFor(chunkHashes.size(), 1, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            chunkHashes[i] = hash64(data.subspan(i * CHUNK_SIZE, std::min(CHUNK_SIZE, data.size() - i * CHUNK_SIZE)),
+                                    seed);
+        }
+    });
+
+    return hash64(std::as_bytes(std::span(chunkHashes)), seed + data.size());
+}
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace prism {
+
+// XXH64 of the bytes. Fast (several GB/s on a single core) and good enough to identify content, but not
+// cryptographically secure, so matches still have to be compared when a collision would be a problem:
+uint64_t hash64(std::span<const std::byte> data, uint64_t seed = 0);
+
+// Large inputs are split into chunks that are hashed in parallel, followed by a hash of the chunk hashes. Note that the
+// result isn't the same as the one of hash64:
+uint64_t parallelHash64(std::span<const std::byte> data, uint64_t seed = 0);
+
+template <typename T>
+uint64_t hashValues(std::span<const T> values, const uint64_t seed = 0)
+{
+    return parallelHash64(std::as_bytes(values), seed);
+}
+
+} // namespace prism
\ No newline at end of file
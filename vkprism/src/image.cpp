@@ -0,0 +1,615 @@
+#include "image.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <util.hpp>
+
+#ifdef PRISM_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace prism {
+
+//
+// Helper functions for writing binary data:
+
+// Appends the raw bytes of the value to the buffer (all of the formats we write are little endian, except for PNG):
+template <typename T>
+static void appendRaw(std::string& buffer, const T& value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void appendBigEndian(std::string& buffer, uint32_t value)
+{
+    buffer.push_back(static_cast<char>((value >> 24) & 0xFF));
+    buffer.push_back(static_cast<char>((value >> 16) & 0xFF));
+    buffer.push_back(static_cast<char>((value >> 8) & 0xFF));
+    buffer.push_back(static_cast<char>(value & 0xFF));
+}
+
+static std::ofstream openImageFile(const std::filesystem::path& path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open image file for writing at: " + path.string());
+    }
+    return file;
+}
+
+ImageFileFormat imageFileFormatFromPath(const std::filesystem::path& path)
+{
+    auto extension = path.extension().string();
+    std::ranges::transform(extension, extension.begin(), [](char c) { return std::tolower(c); });
+
+    if (extension == ".ppm") {
+        return ImageFileFormat::ePPM;
+    }
+    if (extension == ".png") {
+        return ImageFileFormat::ePNG;
+    }
+    if (extension == ".pfm") {
+        return ImageFileFormat::ePFM;
+    }
+    if (extension == ".exr") {
+        return ImageFileFormat::eEXR;
+    }
+    throw std::runtime_error("Unsupported image file extension for: " + path.string());
+}
+
+//
+// Tone mapping:
+
+// Values are quantized to 12 bits before going through the transfer function LUT, which is more than enough precision
+// for an 8-bit output and avoids calling pow for every channel.
+constexpr uint32_t TRANSFER_LUT_SIZE = 4096;
+
+using TransferLut = std::array<uint8_t, TRANSFER_LUT_SIZE>;
+
+static TransferLut createTransferLut(const bool srgb)
+{
+    TransferLut lut;
+    for (uint32_t i = 0; i < TRANSFER_LUT_SIZE; ++i) {
+        const float linear = static_cast<float>(i) / (TRANSFER_LUT_SIZE - 1);
+        const float encoded =
+            !srgb ? linear : (linear <= 0.0031308f ? 12.92f * linear : 1.055f * std::pow(linear, 1.f / 2.4f) - 0.055f);
+        lut[i] = static_cast<uint8_t>(std::clamp(encoded, 0.f, 1.f) * 255.f + 0.5f);
+    }
+    return lut;
+}
+
+static const TransferLut& getTransferLut(const bool srgb)
+{
+    static const TransferLut srgbLut   = createTransferLut(true);
+    static const TransferLut linearLut = createTransferLut(false);
+    return srgb ? srgbLut : linearLut;
+}
+
+LdrImage toneMap(const std::span<const glm::vec3> pixels, const glm::uvec2 resolution, const ToneMapParam& param)
+{
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 is expected to be tightly packed.");
+
+    const size_t numValues = size_t(resolution.x) * resolution.y * 3;
+    if (pixels.size() * 3 < numValues) {
+        throw std::runtime_error("Not enough pixels provided for the tone mapping resolution.");
+    }
+
+    LdrImage image{.resolution = resolution, .data = std::vector<uint8_t>(numValues)};
+
+    // Every channel goes through the exact same operations, so we can treat the image as a flat array of floats:
+    const float* const src = reinterpret_cast<const float*>(pixels.data());
+    uint8_t* const     dst = image.data.data();
+    const TransferLut& lut = getTransferLut(param.srgb);
+
+    parallelFor(numValues, 1 << 16, [&](const size_t begin, const size_t end) {
+        size_t i = begin;
+#ifdef PRISM_SSE2
+        const __m128 exposure = _mm_set1_ps(param.exposure);
+        const __m128 zero     = _mm_setzero_ps();
+        const __m128 one      = _mm_set1_ps(1.f);
+        const __m128 lutScale = _mm_set1_ps(TRANSFER_LUT_SIZE - 1);
+        const __m128 half     = _mm_set1_ps(0.5f);
+
+        alignas(16) std::array<int32_t, 4> lutIdx;
+        for (; i + 4 <= end; i += 4) {
+            __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), exposure);
+            if (param.reinhard) {
+                v = _mm_div_ps(v, _mm_add_ps(v, one));
+            }
+            // max returns the second operand when the first one is NaN, so NaNs end up as zero:
+            v = _mm_min_ps(_mm_max_ps(v, zero), one);
+            _mm_store_si128(reinterpret_cast<__m128i*>(lutIdx.data()),
+                            _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, lutScale), half)));
+
+            dst[i + 0] = lut[lutIdx[0]];
+            dst[i + 1] = lut[lutIdx[1]];
+            dst[i + 2] = lut[lutIdx[2]];
+            dst[i + 3] = lut[lutIdx[3]];
+        }
+#endif
+        for (; i < end; ++i) {
+            float v = src[i] * param.exposure;
+            if (param.reinhard) {
+                v = v / (v + 1.f);
+            }
+            v      = v > 0.f ? std::min(v, 1.f) : 0.f; // Also takes care of NaNs
+            dst[i] = lut[static_cast<uint32_t>(v * (TRANSFER_LUT_SIZE - 1) + 0.5f)];
+        }
+    });
+
+    return image;
+}
+
+ImageDifference compareImages(const std::span<const float> reference, const std::span<const float> test,
+                              const float outlierThreshold)
+{
+    if (reference.size() != test.size()) {
+        throw std::runtime_error("Can't compare images with " + std::to_string(reference.size()) + " and " +
+                                 std::to_string(test.size()) + " values");
+    }
+    if (reference.empty()) {
+        return {.rmse = 0.0, .maxRelativeError = 0.0, .meanRelativeError = 0.0, .numOutliers = 0};
+    }
+
+    // Keeps the relative error of two zeros at zero:
+    constexpr float MIN_DENOMINATOR = std::numeric_limits<float>::min();
+
+    std::mutex mutex;
+    double     sumSquared  = 0.0;
+    double     sumRelative = 0.0;
+    float      maxRelative = 0.f;
+    size_t     numOutliers = 0;
+
+    parallelFor(reference.size(), 1 << 16, [&](const size_t begin, const size_t end) {
+        double rangeSumSquared  = 0.0;
+        double rangeSumRelative = 0.0;
+        float  rangeMaxRelative = 0.f;
+        size_t rangeNumOutliers = 0;
+
+        size_t i = begin;
+#ifdef PRISM_SSE2
+        const __m128 absMask        = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        const __m128 minDenominator = _mm_set1_ps(MIN_DENOMINATOR);
+        const __m128 threshold      = _mm_set1_ps(outlierThreshold);
+
+        // The sums are accumulated in double, the number of values can be huge:
+        __m128d sumSquaredV  = _mm_setzero_pd();
+        __m128d sumRelativeV = _mm_setzero_pd();
+        __m128  maxRelativeV = _mm_setzero_ps();
+        for (; i + 4 <= end; i += 4) {
+            const __m128 a = _mm_loadu_ps(reference.data() + i);
+            const __m128 b = _mm_loadu_ps(test.data() + i);
+
+            const __m128 diff        = _mm_sub_ps(b, a);
+            const __m128 denominator = _mm_max_ps(_mm_max_ps(_mm_and_ps(a, absMask), _mm_and_ps(b, absMask)),
+                                                  minDenominator);
+            const __m128 relative    = _mm_div_ps(_mm_and_ps(diff, absMask), denominator);
+
+            const __m128d diffLow      = _mm_cvtps_pd(diff);
+            const __m128d diffHigh     = _mm_cvtps_pd(_mm_movehl_ps(diff, diff));
+            const __m128d relativeLow  = _mm_cvtps_pd(relative);
+            const __m128d relativeHigh = _mm_cvtps_pd(_mm_movehl_ps(relative, relative));
+
+            sumSquaredV  = _mm_add_pd(sumSquaredV, _mm_mul_pd(diffLow, diffLow));
+            sumSquaredV  = _mm_add_pd(sumSquaredV, _mm_mul_pd(diffHigh, diffHigh));
+            sumRelativeV = _mm_add_pd(sumRelativeV, _mm_add_pd(relativeLow, relativeHigh));
+
+            // max returns the second operand for NaNs, which keeps them out of the maximum (they still end up in the
+            // sums). The not-less-or-equal comparison on the other hand is true for NaNs, so they count as outliers:
+            maxRelativeV = _mm_max_ps(relative, maxRelativeV);
+            rangeNumOutliers += std::popcount(uint32_t(_mm_movemask_ps(_mm_cmpnle_ps(relative, threshold))));
+        }
+
+        alignas(16) std::array<double, 2> sums;
+        _mm_store_pd(sums.data(), sumSquaredV);
+        rangeSumSquared += sums[0] + sums[1];
+        _mm_store_pd(sums.data(), sumRelativeV);
+        rangeSumRelative += sums[0] + sums[1];
+
+        alignas(16) std::array<float, 4> maxima;
+        _mm_store_ps(maxima.data(), maxRelativeV);
+        rangeMaxRelative = std::max(std::max(maxima[0], maxima[1]), std::max(maxima[2], maxima[3]));
+#endif
+        for (; i < end; ++i) {
+            const float diff     = test[i] - reference[i];
+            const float relative = std::abs(diff) / std::max(std::max(std::abs(reference[i]), std::abs(test[i])),
+                                                             MIN_DENOMINATOR);
+
+            rangeSumSquared += double(diff) * diff;
+            rangeSumRelative += relative;
+            if (relative > rangeMaxRelative) {
+                rangeMaxRelative = relative;
+            }
+            if (!(relative <= outlierThreshold)) {
+                ++rangeNumOutliers;
+            }
+        }
+
+        std::lock_guard lock(mutex);
+        sumSquared += rangeSumSquared;
+        sumRelative += rangeSumRelative;
+        maxRelative = std::max(maxRelative, rangeMaxRelative);
+        numOutliers += rangeNumOutliers;
+    });
+
+    const double numValues = static_cast<double>(reference.size());
+    return {
+        .rmse              = std::sqrt(sumSquared / numValues),
+        .maxRelativeError  = maxRelative,
+        .meanRelativeError = sumRelative / numValues,
+        .numOutliers       = numOutliers,
+    };
+}
+
+//
+// LDR formats:
+
+void writePPM(const std::filesystem::path& path, const LdrImage& image)
+{
+    auto file = openImageFile(path);
+
+    file << "P6\n" << image.resolution.x << " " << image.resolution.y << "\n255\n";
+    file.write(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+}
+
+static uint32_t crc32(const std::string_view data, uint32_t crc = 0)
+{
+    static const auto table = []() {
+        std::array<uint32_t, 256> table;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return table;
+    }();
+
+    crc = ~crc;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void writePNGChunk(std::ofstream& file, const std::string_view type, const std::string_view data)
+{
+    std::string header;
+    appendBigEndian(header, static_cast<uint32_t>(data.size()));
+    header.append(type);
+
+    std::string footer;
+    appendBigEndian(footer, crc32(data, crc32(type)));
+
+    file.write(header.data(), header.size());
+    file.write(data.data(), data.size());
+    file.write(footer.data(), footer.size());
+}
+
+void writePNG(const std::filesystem::path& path, const LdrImage& image)
+{
+    // We don't have a deflate implementation, so the image data is written using stored (uncompressed) deflate blocks.
+    // The file ends up slightly larger than a binary PPM, but every viewer can open it.
+
+    const size_t rowSize = size_t(image.resolution.x) * 3;
+
+    // Every row is prefixed with its filter type (0, no filtering):
+    std::string rawData;
+    rawData.reserve((rowSize + 1) * image.resolution.y);
+    for (uint32_t y = 0; y < image.resolution.y; ++y) {
+        rawData.push_back(0);
+        rawData.append(reinterpret_cast<const char*>(image.data.data() + y * rowSize), rowSize);
+    }
+
+    std::string zlibData;
+    zlibData.reserve(rawData.size() + (rawData.size() / 0xFFFF + 1) * 5 + 6);
+    zlibData.push_back(0x78); // Deflate with a 32K window
+    zlibData.push_back(0x01); // No preset dictionary, fastest compression level (makes the header checksum valid)
+
+    for (size_t offset = 0; offset < rawData.size(); offset += 0xFFFF) {
+        const auto blockSize = static_cast<uint16_t>(std::min<size_t>(0xFFFF, rawData.size() - offset));
+
+        zlibData.push_back(offset + blockSize == rawData.size() ? 1 : 0); // BFINAL bit on the last block
+        appendRaw(zlibData, blockSize);
+        appendRaw(zlibData, static_cast<uint16_t>(~blockSize));
+        zlibData.append(rawData, offset, blockSize);
+    }
+
+    // Adler-32 of the uncompressed data (we can defer the modulo for 5552 bytes without overflowing):
+    uint32_t a = 1, b = 0;
+    for (size_t offset = 0; offset < rawData.size(); offset += 5552) {
+        const size_t end = std::min(rawData.size(), offset + 5552);
+        for (size_t i = offset; i < end; ++i) {
+            a += static_cast<uint8_t>(rawData[i]);
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    appendBigEndian(zlibData, (b << 16) | a);
+
+    std::string ihdr;
+    appendBigEndian(ihdr, image.resolution.x);
+    appendBigEndian(ihdr, image.resolution.y);
+    ihdr.push_back(8); // Bit depth
+    ihdr.push_back(2); // Truecolor (RGB)
+    ihdr.push_back(0); // Compression method
+    ihdr.push_back(0); // Filter method
+    ihdr.push_back(0); // No interlacing
+
+    auto file = openImageFile(path);
+
+    constexpr std::string_view signature("\x89PNG\r\n\x1A\n", 8);
+    file.write(signature.data(), signature.size());
+
+    writePNGChunk(file, "IHDR", ihdr);
+    writePNGChunk(file, "IDAT", zlibData);
+    writePNGChunk(file, "IEND", {});
+}
+
+//
+// HDR formats:
+
+void writePFM(const std::filesystem::path& path, const HdrImage& image)
+{
+    auto file = openImageFile(path);
+
+    // A negative scale signifies little endian data:
+    file << "PF\n" << image.resolution.x << " " << image.resolution.y << "\n-1.0\n";
+
+    // PFM stores the bottom row first:
+    const size_t rowSize = size_t(image.resolution.x) * sizeof(glm::vec3);
+    for (uint32_t y = image.resolution.y; y-- > 0;) {
+        file.write(reinterpret_cast<const char*>(image.data.data() + size_t(y) * image.resolution.x), rowSize);
+    }
+}
+
+static size_t exrPixelTypeSize(const ExrPixelType type) { return type == ExrPixelType::eHalf ? 2 : 4; }
+
+static void appendExrAttribute(std::string& header, const std::string_view name, const std::string_view type,
+                               const std::string_view value)
+{
+    header.append(name);
+    header.push_back('\0');
+    header.append(type);
+    header.push_back('\0');
+    appendRaw(header, static_cast<int32_t>(value.size()));
+    header.append(value);
+}
+
+// Everything needed to write an uncompressed EXR file. Without compression every scanline is its own chunk of a fixed
+// size, so the whole layout (including the offset table at the end of the header) is known up front:
+struct ExrLayout
+{
+    std::string                    header;
+    std::vector<const ExrChannel*> sortedChannels;
+    size_t                         lineSize;
+    size_t                         chunkSize;
+};
+
+static ExrLayout createExrLayout(const glm::uvec2 resolution, const std::span<const ExrChannel> channels)
+{
+    ExrLayout layout;
+
+    // The EXR specification requires the channels to be stored in alphabetical order:
+    layout.sortedChannels.reserve(channels.size());
+    for (const auto& channel : channels) {
+        layout.sortedChannels.emplace_back(&channel);
+    }
+    std::ranges::sort(layout.sortedChannels, {}, &ExrChannel::name);
+
+    //
+    // Construct the header:
+
+    auto& header = layout.header;
+    appendRaw(header, int32_t(20000630)); // Magic number
+    appendRaw(header, int32_t(2));        // Version 2, single part scanline file
+
+    std::string chlist;
+    for (const auto* channel : layout.sortedChannels) {
+        chlist.append(channel->name);
+        chlist.push_back('\0');
+        appendRaw(chlist, static_cast<int32_t>(channel->type));
+        appendRaw(chlist, uint32_t(0)); // pLinear and reserved bytes
+        appendRaw(chlist, int32_t(1));  // xSampling
+        appendRaw(chlist, int32_t(1));  // ySampling
+    }
+    chlist.push_back('\0');
+
+    std::string box;
+    appendRaw(box, int32_t(0));
+    appendRaw(box, int32_t(0));
+    appendRaw(box, static_cast<int32_t>(resolution.x) - 1);
+    appendRaw(box, static_cast<int32_t>(resolution.y) - 1);
+
+    std::string screenWindowCenter;
+    appendRaw(screenWindowCenter, 0.f);
+    appendRaw(screenWindowCenter, 0.f);
+
+    appendExrAttribute(header, "channels", "chlist", chlist);
+    appendExrAttribute(header, "compression", "compression", std::string_view("\0", 1)); // NO_COMPRESSION
+    appendExrAttribute(header, "dataWindow", "box2i", box);
+    appendExrAttribute(header, "displayWindow", "box2i", box);
+    appendExrAttribute(header, "lineOrder", "lineOrder", std::string_view("\0", 1)); // INCREASING_Y
+    appendExrAttribute(header, "pixelAspectRatio", "float", std::string_view("\0\0\x80\x3F", 4)); // 1.0f
+    appendExrAttribute(header, "screenWindowCenter", "v2f", screenWindowCenter);
+    appendExrAttribute(header, "screenWindowWidth", "float", std::string_view("\0\0\x80\x3F", 4));
+    header.push_back('\0');
+
+    //
+    // Calculate all of the chunk offsets:
+
+    layout.lineSize = 0;
+    for (const auto* channel : layout.sortedChannels) {
+        layout.lineSize += exrPixelTypeSize(channel->type) * resolution.x;
+    }
+    layout.chunkSize = 2 * sizeof(int32_t) + layout.lineSize;
+
+    uint64_t chunkOffset = header.size() + sizeof(uint64_t) * resolution.y;
+    for (uint32_t y = 0; y < resolution.y; ++y) {
+        appendRaw(header, chunkOffset);
+        chunkOffset += layout.chunkSize;
+    }
+
+    return layout;
+}
+
+void writeEXR(const std::filesystem::path& path, const glm::uvec2 resolution, const std::span<const ExrChannel> channels)
+{
+    const auto layout = createExrLayout(resolution, channels);
+
+    auto file = openImageFile(path);
+    file.write(layout.header.data(), layout.header.size());
+
+    std::string chunk;
+    chunk.reserve(layout.chunkSize);
+    for (uint32_t y = 0; y < resolution.y; ++y) {
+        chunk.clear();
+        appendRaw(chunk, static_cast<int32_t>(y));
+        appendRaw(chunk, static_cast<int32_t>(layout.lineSize));
+
+        // Channels are stored one after the other for each scanline:
+        for (const auto* channel : layout.sortedChannels) {
+            const size_t pixelSize = exrPixelTypeSize(channel->type);
+            for (uint32_t x = 0; x < resolution.x; ++x) {
+                const size_t pixelIdx = size_t(y) * resolution.x + x;
+                chunk.append(reinterpret_cast<const char*>(channel->data + pixelIdx * channel->stride), pixelSize);
+            }
+        }
+
+        file.write(chunk.data(), chunk.size());
+    }
+}
+
+void writeEXR(const std::filesystem::path& path, const HdrImage& image)
+{
+    const auto* data = reinterpret_cast<const std::byte*>(image.data.data());
+
+    const auto channels = std::to_array({
+        ExrChannel{.name = "R", .type = ExrPixelType::eFloat, .data = data, .stride = sizeof(glm::vec3)},
+        ExrChannel{.name = "G", .type = ExrPixelType::eFloat, .data = data + sizeof(float), .stride = sizeof(glm::vec3)},
+        ExrChannel{.name = "B", .type = ExrPixelType::eFloat, .data = data + 2 * sizeof(float), .stride = sizeof(glm::vec3)},
+    });
+
+    writeEXR(path, image.resolution, channels);
+}
+
+//
+// Memory mapped EXR files:
+
+MappedEXR::Layout MappedEXR::createLayout(const glm::uvec2 resolution, const std::span<const ExrChannel> channels)
+{
+    auto exrLayout = createExrLayout(resolution, channels);
+
+    Layout layout{
+        .headerSize = exrLayout.header.size(),
+        .lineSize   = exrLayout.lineSize,
+        .chunkSize  = exrLayout.chunkSize,
+        .header     = std::move(exrLayout.header),
+    };
+
+    // Where every channel starts in a scanline, in the order the channels were given in:
+    layout.channelOffsets.resize(channels.size());
+    size_t lineOffset = 0;
+    for (const auto* channel : exrLayout.sortedChannels) {
+        layout.channelOffsets[channel - channels.data()] = lineOffset;
+        lineOffset += exrPixelTypeSize(channel->type) * resolution.x;
+    }
+
+    layout.channelTypes.reserve(channels.size());
+    for (const auto& channel : channels) {
+        layout.channelTypes.emplace_back(channel.type);
+    }
+
+    return layout;
+}
+
+MappedEXR::MappedEXR(const std::filesystem::path& path, const glm::uvec2 resolution,
+                     const std::span<const ExrChannel> channels) :
+    m_resolution(resolution),
+    m_layout(createLayout(resolution, channels)),
+    m_file(path, m_layout.headerSize + m_layout.chunkSize * resolution.y)
+{
+    std::memcpy(m_file.data(), m_layout.header.data(), m_layout.headerSize);
+    m_layout.header = {};
+
+    // The pixel data is filled in later, but the scanline headers are already known:
+    for (uint32_t y = 0; y < resolution.y; ++y) {
+        std::byte* chunk = m_file.data() + m_layout.headerSize + m_layout.chunkSize * y;
+
+        const auto lineIdx  = static_cast<int32_t>(y);
+        const auto lineSize = static_cast<int32_t>(m_layout.lineSize);
+        std::memcpy(chunk, &lineIdx, sizeof(int32_t));
+        std::memcpy(chunk + sizeof(int32_t), &lineSize, sizeof(int32_t));
+    }
+}
+
+void MappedEXR::writeRegion(const glm::uvec2 offset, const glm::uvec2 size, const std::span<const ExrChannel> channels)
+{
+    if (channels.size() != m_layout.channelTypes.size()) {
+        throw std::runtime_error("Region has " + std::to_string(channels.size()) + " channels, but the file has " +
+                                 std::to_string(m_layout.channelTypes.size()) + ".");
+    }
+    if (offset.x + size.x > m_resolution.x || offset.y + size.y > m_resolution.y) {
+        throw std::runtime_error("Region doesn't fit in the EXR file.");
+    }
+
+    for (size_t c = 0; c < channels.size(); ++c) {
+        const auto&  channel   = channels[c];
+        const size_t pixelSize = exrPixelTypeSize(m_layout.channelTypes[c]);
+        if (channel.type != m_layout.channelTypes[c]) {
+            throw std::runtime_error("Type of channel " + channel.name + " doesn't match the EXR file.");
+        }
+
+        for (uint32_t y = 0; y < size.y; ++y) {
+            std::byte* dst = m_file.data() + m_layout.headerSize + m_layout.chunkSize * (offset.y + y) +
+                             2 * sizeof(int32_t) + m_layout.channelOffsets[c] + pixelSize * offset.x;
+
+            for (uint32_t x = 0; x < size.x; ++x) {
+                const size_t pixelIdx = size_t(y) * size.x + x;
+                std::memcpy(dst + x * pixelSize, channel.data + pixelIdx * channel.stride, pixelSize);
+            }
+        }
+    }
+}
+
+//
+// Asynchronous writing:
+
+void writeImageAsync(TaskGroup& group, std::filesystem::path path, LdrImage image)
+{
+    const auto format = imageFileFormatFromPath(path);
+    if (format != ImageFileFormat::ePPM && format != ImageFileFormat::ePNG) {
+        throw std::runtime_error("LDR images can only be written as PPM or PNG: " + path.string());
+    }
+
+    group.run([format, path = std::move(path), image = std::move(image)]() {
+        format == ImageFileFormat::ePPM ? writePPM(path, image) : writePNG(path, image);
+    });
+}
+
+void writeImageAsync(TaskGroup& group, std::filesystem::path path, HdrImage image)
+{
+    const auto format = imageFileFormatFromPath(path);
+    if (format != ImageFileFormat::ePFM && format != ImageFileFormat::eEXR) {
+        throw std::runtime_error("HDR images can only be written as PFM or EXR: " + path.string());
+    }
+
+    group.run([format, path = std::move(path), image = std::move(image)]() {
+        format == ImageFileFormat::ePFM ? writePFM(path, image) : writeEXR(path, image);
+    });
+}
+
+} // namespace prism
\ No newline at end of file
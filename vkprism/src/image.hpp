@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <mapped_file.hpp>
+#include <task_system.hpp>
+
+namespace prism {
+
+// Handles writing rendered images to disk. LDR formats (PPM and PNG) go through a tone mapping and quantization pass
+// first while the HDR formats (PFM and EXR) store the raw linear values.
+
+enum class ImageFileFormat
+{
+    ePPM, // Binary (P6) PPM
+    ePNG, // Uncompressed PNG
+    ePFM, // Portable float map
+    eEXR, // Uncompressed scanline OpenEXR
+};
+
+// Returns the file format based on the extension of the path (throws if it isn't supported):
+ImageFileFormat imageFileFormatFromPath(const std::filesystem::path& path);
+
+struct ToneMapParam
+{
+    float exposure = 1.f;   // Linear scale applied to every channel before anything else
+    bool  reinhard = false; // Compresses the range with x / (1 + x) before the transfer function
+    bool  srgb     = true;  // Uses the sRGB transfer function, otherwise the values are only clamped
+};
+
+// An 8-bit RGB image that has already been tone mapped and quantized:
+struct LdrImage
+{
+    glm::uvec2           resolution;
+    std::vector<uint8_t> data; // Interleaved RGB, top row first
+};
+
+// A linear floating point RGB image:
+struct HdrImage
+{
+    glm::uvec2             resolution;
+    std::vector<glm::vec3> data; // Top row first
+};
+
+// Tone maps, applies the transfer function and quantizes the pixels. The pass is split across all hardware threads and
+// is safe to run directly on a mapped readback buffer.
+LdrImage toneMap(std::span<const glm::vec3> pixels, glm::uvec2 resolution, const ToneMapParam& param = {});
+
+// How much a test image differs from a reference image. Both are treated as flat arrays of values, so any number of
+// channels works as long as they line up:
+struct ImageDifference
+{
+    double rmse;              // Root mean square of the differences
+    double maxRelativeError;  // |test - reference| / max(|test|, |reference|), NaNs are ignored
+    double meanRelativeError; // NaN if any of the values is NaN
+    size_t numOutliers;       // Values whose relative error is above the threshold (or NaN)
+};
+
+// The comparison is split across all hardware threads and uses SSE2 where available:
+ImageDifference compareImages(std::span<const float> reference, std::span<const float> test, float outlierThreshold);
+
+//
+// EXR supports an arbitrary number of channels (used for the AOVs), so it gets a more general interface:
+
+enum class ExrPixelType : uint32_t
+{
+    eUint  = 0,
+    eHalf  = 1,
+    eFloat = 2,
+};
+
+// A single channel of an EXR file. Every pixel is read from data + i * stride, which allows interleaved buffers to be
+// written without having to split them up first.
+struct ExrChannel
+{
+    std::string      name;
+    ExrPixelType     type;
+    const std::byte* data;
+    size_t           stride;
+};
+
+void writePPM(const std::filesystem::path& path, const LdrImage& image);
+void writePNG(const std::filesystem::path& path, const LdrImage& image);
+void writePFM(const std::filesystem::path& path, const HdrImage& image);
+void writeEXR(const std::filesystem::path& path, glm::uvec2 resolution, std::span<const ExrChannel> channels);
+void writeEXR(const std::filesystem::path& path, const HdrImage& image);
+
+// An uncompressed EXR file that is memory mapped and filled in one region at a time (i.e. when rendering in tiles), so
+// the full image never has to be kept in memory. The scanline chunks have a fixed size, which means every region can be
+// written directly at its final location in the file.
+class MappedEXR
+{
+  public:
+    // Only the name and type of the channels are used:
+    MappedEXR(const std::filesystem::path& path, glm::uvec2 resolution, std::span<const ExrChannel> channels);
+    MappedEXR(const MappedEXR&) = delete;
+    MappedEXR(MappedEXR&&)      = delete;
+
+    // The channels have to line up with the ones the file was created with. Pixel i (row major within the region) is
+    // read from data + i * stride. Regions that don't overlap can be written concurrently.
+    void writeRegion(glm::uvec2 offset, glm::uvec2 size, std::span<const ExrChannel> channels);
+
+    void flush() const { m_file.flush(); }
+
+  private:
+    struct Layout
+    {
+        size_t headerSize;
+        size_t lineSize;  // Size of the pixel data of a scanline
+        size_t chunkSize; // Size of a scanline including its header
+
+        std::string               header;         // Only kept until it's written to the file
+        std::vector<size_t>       channelOffsets; // Offset of every channel in the scanline's pixel data
+        std::vector<ExrPixelType> channelTypes;
+    };
+
+    static Layout createLayout(glm::uvec2 resolution, std::span<const ExrChannel> channels);
+
+  private:
+    glm::uvec2 m_resolution;
+    Layout     m_layout;
+    MappedFile m_file;
+};
+
+// Writes the image as a task of the group. The image is moved into the task, so the caller is free to reuse any buffers
+// (like the readback buffer) as soon as this returns. Any error is rethrown by TaskGroup::wait.
+void writeImageAsync(TaskGroup& group, std::filesystem::path path, LdrImage image);
+void writeImageAsync(TaskGroup& group, std::filesystem::path path, HdrImage image);
+
+} // namespace prism
\ No newline at end of file
@@ -1,101 +1,326 @@
 ﻿#include "main.hpp"
 
-#include <iostream>
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include <glm/gtx/transform.hpp>
 #include <spdlog/spdlog.h>
 
 #include <allocator.hpp>
+#include <animation.hpp>
+#include <aov.hpp>
 #include <context.hpp>
+#include <cpu/renderer.hpp>
+#include <cpu/scene.hpp>
+#include <framebuffer.hpp>
+#include <image.hpp>
+#include <memory_report.hpp>
 #include <scene.hpp>
 #include <pipelines.hpp>
+#include <profiler.hpp>
+#include <ray_stats.hpp>
+#include <readback.hpp>
+#include <sequence.hpp>
+#include <task_system.hpp>
+#include <tiled.hpp>
 
 using namespace prism;
 
 int main(const int argc, const char** const argv)
 {
+    // The mesh can be passed as the first argument that isn't a flag (or the value of one):
+    const char*                meshArg = nullptr;
+    std::optional<std::string> tracePath;
+    std::optional<std::string> memoryReportPath;
+    uint32_t                   numFrames          = 0; // Renders a sequence of the instance spinning around if set
+    bool                       compactVertices    = false;
+    bool                       generateAttributes = false;
+    bool                       reorderMeshes      = false;
+    std::optional<glm::uvec2>  tileSize; // Renders in tiles of this size into temp.exr if set (--tile WxH)
+    for (int i = 1; i < argc; ++i) {
+        if (std::string_view(argv[i]) == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (std::string_view(argv[i]) == "--memory-report" && i + 1 < argc) {
+            memoryReportPath = argv[++i];
+        } else if (std::string_view(argv[i]) == "--frames" && i + 1 < argc) {
+            numFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (std::string_view(argv[i]) == "--compact-vertices") {
+            compactVertices = true;
+        } else if (std::string_view(argv[i]) == "--generate-attributes") {
+            generateAttributes = true;
+        } else if (std::string_view(argv[i]) == "--reorder-meshes") {
+            reorderMeshes = true;
+        } else if (std::string_view(argv[i]) == "--tile" && i + 1 < argc) {
+            const std::string_view value(argv[++i]);
+            const size_t           separator = value.find('x');
+            if (separator == std::string_view::npos) {
+                spdlog::error("--tile expects the tile size as WxH, got: {}", value);
+                return 1;
+            }
+            tileSize = glm::uvec2(std::stoul(std::string(value.substr(0, separator))),
+                                  std::stoul(std::string(value.substr(separator + 1))));
+        } else if (argv[i][0] != '-' && !meshArg) {
+            meshArg = argv[i];
+        }
+    }
+
+    // The scene description is shared between the GPU and the CPU (--cpu) backends:
+    std::optional<InstanceIndex> spinningInstanceIdx;
+    const auto                   buildScene = [&]() {
+        SceneBuilder sceneBuilder;
+        if (generateAttributes) {
+            sceneBuilder.setAttributeGeneration({.normals = true, .tangents = true});
+        }
+        sceneBuilder.setMeshReordering(reorderMeshes);
+
+        const char* path = meshArg ? meshArg : "D:\\Dev\\vkprism\\test_files\\sphere.ply";
+
+        const auto meshIdx      = sceneBuilder.createMesh(path);
+        const auto meshGroupIdx = sceneBuilder.createMeshGroup(std::to_array({PlacedMesh{.meshIdx = meshIdx}}));
+        const auto instanceIdx  = sceneBuilder.createInstance(Instance{
+            .customId     = 0,
+            .mask         = 1,
+            .hitGroupId   = 1,
+            .meshGroupIdx = meshGroupIdx,
+            .transform    = Transform(glm::translate(glm::vec3(0, 1.0, 0.0))),
+        });
+        spinningInstanceIdx = instanceIdx;
+
+        return sceneBuilder;
+    };
+
+    const auto hasFlag = [&](const std::string_view flag) {
+        return std::any_of(argv + 1, argv + argc, [&](const char* arg) { return std::string_view(arg) == flag; });
+    };
+    const bool useCpu = hasFlag("--cpu");
+
+    // Has to happen before anything uses the task system:
+    initTaskSystem({.pinThreads = hasFlag("--pin-threads")});
+
+    // Warned about up front, so that it isn't missed after a long render:
+    if (!PROFILING_ENABLED && tracePath) {
+        spdlog::warn("Can't write a trace, vkprism was built without PRISM_ENABLE_PROFILING (reconfigure with "
+                     "-DPRISM_ENABLE_PROFILING=ON).");
+    }
+
+    // Called once the last frame has finished:
+    const auto reportProfile = [&]() {
+        if constexpr (!PROFILING_ENABLED) {
+            return;
+        }
+
+        profiler().logSummary();
+        if (tracePath) {
+            profiler().writeChromeTrace(*tracePath);
+            spdlog::info("Wrote the trace to: {}", *tracePath);
+        }
+    };
+
+    // The host entries are added here, the GPU ones come from the allocator (if there is one):
+    const auto reportMemory = [&](MemoryReport report, const SceneBuilder& sceneBuilder) {
+        const auto builderUsage = sceneBuilder.hostMemoryUsage();
+        report.host.insert(report.host.end(), builderUsage.begin(), builderUsage.end());
+        report.processPeakBytes = processPeakMemory();
+
+        logMemoryReport(report);
+        if (memoryReportPath) {
+            std::ofstream file(*memoryReportPath);
+            if (!file) {
+                throw std::runtime_error("Failed to open the memory report file: " + *memoryReportPath);
+            }
+            file << memoryReportJson(report) << '\n';
+            spdlog::info("Wrote the memory report to: {}", *memoryReportPath);
+        }
+    };
+
     ContextParam param{};
     param.enableCallback   = true;
     param.enableValidation = true;
 
     try {
+        AovSet aovs{};
+        aovs[aovDEPTH]  = true;
+        aovs[aovNORMAL] = true;
+
+        if (useCpu) {
+            // Logs every 10%:
+            const auto logProgress = [](const uint32_t finished, const uint32_t total) {
+                if (finished * 10 / total != (finished - 1) * 10 / total) {
+                    spdlog::info("Rendered {}%", finished * 100 / total);
+                }
+            };
+
+            const cpu::RenderParam renderParam{
+                .outputWidth      = 1920,
+                .outputHeight     = 1080,
+                .aovs             = aovs,
+                .progressCallback = logProgress,
+            };
+
+            const auto       sceneBuilder = buildScene();
+            const cpu::Scene scene(sceneBuilder);
+            const auto       output = cpu::render(scene, renderParam);
+            profiler().newFrame();
+
+            TaskGroup ldrWrite;
+            writeImageAsync(ldrWrite, "temp.png", toneMap(output.beauty, output.resolution));
+
+            std::array<const std::byte*, TOTAL_NUM_AOVS> aovData{};
+            for (uint32_t aov = 0; aov < TOTAL_NUM_AOVS; ++aov) {
+                if (aovs[aov]) {
+                    aovData[aov] = output.aovs[aov].data();
+                }
+            }
+            writeAovEXR("temp.exr", output.resolution, output.beauty, aovData);
+
+            ldrWrite.wait();
+            reportProfile();
+            reportMemory({}, sceneBuilder);
+            std::cout << "Done!\n";
+            return 0;
+        }
+
         const Context      ctx(param);
         const GPUAllocator allocator(ctx);
 
-        // Create a simple scene:
-        const auto scene = [&]() {
-            SceneBuilder sceneBuilder;
+        // Kept around for the memory report:
+        const auto sceneBuilder = buildScene();
+        Scene      scene({.compactVertices = compactVertices}, ctx, allocator, sceneBuilder);
 
-            const char* path = "D:\\Dev\\vkprism\\test_files\\sphere.ply";
+        const Pipelines pipeline(
+            {
+                .outputWidth       = 1920,
+                .outputHeight      = 1080,
+                .aovs              = aovs,
+                .beautyFormat      = BeautyFormat::eRGB9E5,
+                .accumulateInFloat = true,
+                .tileWidth         = tileSize ? tileSize->x : 0,
+                .tileHeight        = tileSize ? tileSize->y : 0,
+                .enableRayStats    = hasFlag("--stats"),
+            },
+            ctx, allocator, scene);
 
-            const auto meshIdx      = sceneBuilder.createMesh(path);
-            const auto meshGroupIdx = sceneBuilder.createMeshGroup(std::to_array({PlacedMesh{.meshIdx = meshIdx}}));
-            const auto instanceIdx  = sceneBuilder.createInstance(Instance{
-                .customId     = 0,
-                .mask         = 1,
-                .hitGroupId   = 1,
-                .meshGroupIdx = meshGroupIdx,
-                .transform    = Transform(glm::translate(glm::vec3(0, 1.0, 0.0))),
-            });
+        if (tileSize) {
+            if (numFrames > 0) {
+                throw std::runtime_error("--tile only renders a single frame, it can't be combined with --frames");
+            }
 
-            return Scene({}, ctx, allocator, sceneBuilder);
-        }();
+            renderTiled({.outputPath = "temp.exr"}, ctx, allocator, pipeline);
+            profiler().newFrame();
+            spdlog::info("Rendered in {}x{} tiles into temp.exr", tileSize->x, tileSize->y);
 
-        const Pipelines pipeline({.outputWidth = 1920, .outputHeight = 1080}, ctx, allocator, scene);
-        
-        const auto commandPool = ctx.device().createCommandPoolUnique(
-            vk::CommandPoolCreateInfo{
-                .flags = vk::CommandPoolCreateFlagBits::eTransient, // All of the command buffers will be short lived
-                .queueFamilyIndex = ctx.queueFamilyIndex()
-            });
+            reportProfile();
+            reportMemory(allocator.memoryReport(), sceneBuilder);
+            std::cout << "Done!\n";
+            return 0;
+        }
 
-        const auto commandBuffers = ctx.device().allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{
-            .commandPool        = *commandPool,
-            .level              = vk::CommandBufferLevel::ePrimary,
-            .commandBufferCount = 2,
-        });
+        if (numFrames > 0) {
+            // One full turn around the y axis every second (the keyframes are a third of a turn apart, so slerp always
+            // goes the right way around):
+            TransformTrack spinTrack;
+            for (int i = 0; i <= 3; ++i) {
+                spinTrack.addKeyframe(static_cast<float>(i) / 3.f,
+                                      Transform(glm::translate(glm::vec3(0, 1.0, 0.0)) *
+                                                glm::rotate(glm::radians(120.f * i), glm::vec3(0.0, 1.0, 0.0))));
+            }
+
+            Animation animation;
+            animation.setInstanceTrack(*spinningInstanceIdx, std::move(spinTrack));
 
-        commandBuffers[0]->begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-        
-        pipeline.addBindRTPipelineCmd(*commandBuffers[0], {.width = 1920, .height = 1080});
+            const auto stats = renderSequence({.numFrames = numFrames}, ctx, allocator, pipeline, scene, animation);
+            spdlog::info("Rendered {} frames in {:.1f} ms ({:.2f} ms per frame, {:.2f} ms of it updating the scene, {} "
+                         "rebuilds)",
+                         stats.numFrames, stats.totalMs, stats.totalMs / stats.numFrames,
+                         stats.updateMs / stats.numFrames, stats.numRebuilds);
 
-        submitAndWait(ctx, *commandBuffers[0], "Perform RT Pipeline Stuff construction");
+            reportProfile();
+            reportMemory(allocator.memoryReport(), sceneBuilder);
+            std::cout << "Done!\n";
+            return 0;
+        }
 
         //
-        // Copy Data Back to Us to Read:
+        // Render and read the results back. The buffers are decoded and written out by a task once the copies have
+        // finished, so the next pass could already be rendering at that point:
 
-        commandBuffers[1]->begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+        const glm::uvec2 resolution(1920, 1080);
+        const auto       numPixels = vk::DeviceSize(resolution.x) * resolution.y;
 
-        // Allocate a buffer to put the resulting image:
-        const auto stuffSize = sizeof(glm::vec3) * 1920 * 1080;
-        auto dstBuffer =
-            allocator.allocateBuffer(sizeof(glm::vec3) * 1920 * 1080, vk::BufferUsageFlagBits::eTransferDst, VMA_MEMORY_USAGE_CPU_ONLY);
+        // The beauty buffer is always the first buffer, followed by any enabled AOVs and the ray stats:
+        std::vector<vk::DeviceSize> readbackSizes{beautyPixelSize(pipeline.getBeautyFormat()) * numPixels};
+        std::vector<vk::Buffer>     readbackSrcs{pipeline.getBeautyBuffer()};
+        std::vector<AovType>        readbackAovs;
+        for (uint32_t aov = 0; aov < TOTAL_NUM_AOVS; ++aov) {
+            if (aovs[aov]) {
+                readbackSizes.push_back(aovPixelSize(AovType(aov)) * numPixels);
+                readbackSrcs.push_back(pipeline.getAovBuffer(AovType(aov)));
+                readbackAovs.push_back(AovType(aov));
+            }
+        }
+        if (pipeline.getRayStatsBuffer()) {
+            readbackSizes.push_back(sizeof(RayStats));
+            readbackSrcs.push_back(pipeline.getRayStatsBuffer());
+        }
 
-        commandBuffers[1]->copyBuffer(pipeline.getBeautyBuffer(), *dstBuffer,
-            vk::BufferCopy{
-                .size = stuffSize,
-            });
+        Readback readback(ctx, allocator, readbackSizes);
 
-        submitAndWait(ctx, *commandBuffers[1], "Copy Beauty to host");
+        const auto submitTime = std::chrono::steady_clock::now();
 
-        const auto dstData = dstBuffer.map<glm::vec3>();
+        readback.submit(
+            [&](const vk::CommandBuffer& commandBuffer) {
+                pipeline.addBindRTPipelineCmd(commandBuffer, {.width = resolution.x, .height = resolution.y});
+            },
+            readbackSrcs,
+            [&](std::span<const std::span<const std::byte>> data) {
+                // The throughput is based on the GPU time of the trace pass. Without the GPU profiler the time from
+                // the submission until the results are on the host is all there is, which includes the copies:
+                if (pipeline.getRayStatsBuffer()) {
+                    auto traceMs = ctx.gpuProfiler() ? ctx.gpuProfiler()->lastDurationMs("render/trace") : std::nullopt;
+                    if (!traceMs) {
+                        spdlog::warn("No GPU time for the trace pass (vkprism needs PRISM_ENABLE_PROFILING and "
+                                     "timestamp support), the throughput is based on the time until the readback.");
+                        const std::chrono::duration<double, std::milli> frameTime =
+                            std::chrono::steady_clock::now() - submitTime;
+                        traceMs = frameTime.count();
+                    }
+                    logRayStats(readRayStats(data.back()), *traceMs);
+                }
 
-        std::ofstream outputImage("temp.ppm");
-        outputImage << "P3\n";
-        outputImage << "1920 1080\n";
-        outputImage << "255\n";
+                // The beauty buffer is decoded from the packed format first, the PNG is then written while the EXR
+                // with all of the layers is written out:
+                std::vector<glm::vec3> beauty(numPixels);
+                decodeBeauty(data[0], pipeline.getBeautyFormat(), beauty);
 
-        for (int i = 0; i < 1920 * 1080; ++i) {
-            glm::uvec3 d = glm::uvec3(dstData[i] * 255.f);
-            outputImage << d.r << " " << d.g << " " << d.b << "\n";
-        }
+                TaskGroup ldrWrite;
+                writeImageAsync(ldrWrite, "temp.png", toneMap(beauty, resolution));
+
+                std::array<const std::byte*, TOTAL_NUM_AOVS> aovData{};
+                for (size_t i = 0; i < readbackAovs.size(); ++i) {
+                    aovData[readbackAovs[i]] = data[i + 1].data();
+                }
+                writeAovEXR("temp.exr", resolution, beauty, aovData);
+
+                ldrWrite.wait();
+            });
+
+        readback.wait();
+        profiler().newFrame();
 
-        dstBuffer.unmap();
+        reportProfile();
+        reportMemory(allocator.memoryReport(), sceneBuilder);
 
     } catch (const std::exception& e) {
         spdlog::error("Caught exception: {}", e.what());
     }
 
     std::cout << "Done!\n";
-}
+}
\ No newline at end of file
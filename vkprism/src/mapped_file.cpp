@@ -0,0 +1,96 @@
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace prism {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::filesystem::path& path, const size_t size) : m_path(path), m_size(size)
+{
+    m_fileHandle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_fileHandle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Could not create file for mapping at: " + path.string());
+    }
+
+    // Creating the mapping with the full size also grows the file:
+    m_mappingHandle = CreateFileMappingW(m_fileHandle, nullptr, PAGE_READWRITE,
+                                         static_cast<DWORD>(uint64_t(size) >> 32),
+                                         static_cast<DWORD>(size & 0xFFFFFFFF), nullptr);
+    if (!m_mappingHandle) {
+        CloseHandle(m_fileHandle);
+        throw std::runtime_error("Could not create file mapping for: " + path.string());
+    }
+
+    m_data = static_cast<std::byte*>(MapViewOfFile(m_mappingHandle, FILE_MAP_WRITE, 0, 0, size));
+    if (!m_data) {
+        CloseHandle(m_mappingHandle);
+        CloseHandle(m_fileHandle);
+        throw std::runtime_error("Could not map file: " + path.string());
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    FlushViewOfFile(m_data, 0);
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mappingHandle);
+    CloseHandle(m_fileHandle);
+}
+
+void MappedFile::flush() const
+{
+    if (!FlushViewOfFile(m_data, 0)) {
+        throw std::runtime_error("Could not flush mapped file: " + m_path.string());
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& path, const size_t size) : m_path(path), m_size(size)
+{
+    m_fileDescriptor = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fileDescriptor < 0) {
+        throw std::runtime_error("Could not create file for mapping at: " + path.string());
+    }
+
+    if (ftruncate(m_fileDescriptor, static_cast<off_t>(size)) != 0) {
+        close(m_fileDescriptor);
+        throw std::runtime_error("Could not resize file for mapping: " + path.string());
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fileDescriptor, 0);
+    if (data == MAP_FAILED) {
+        close(m_fileDescriptor);
+        throw std::runtime_error("Could not map file: " + path.string());
+    }
+    m_data = static_cast<std::byte*>(data);
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(m_data, m_size);
+    close(m_fileDescriptor);
+}
+
+void MappedFile::flush() const
+{
+    if (msync(m_data, m_size, MS_SYNC) != 0) {
+        throw std::runtime_error("Could not flush mapped file: " + m_path.string());
+    }
+}
+
+#endif
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace prism {
+
+// A file of a fixed size that is memory mapped for writing. Used for outputs that are too large to keep in memory, the
+// OS pages the data out to the file as it sees fit. Any existing file at the path is overwritten.
+class MappedFile
+{
+  public:
+    MappedFile(const std::filesystem::path& path, size_t size);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&&)      = delete;
+    ~MappedFile();
+
+    std::byte* data() const { return m_data; }
+    size_t     size() const { return m_size; }
+
+    // Writes any dirty pages back to the file (the destructor also takes care of this):
+    void flush() const;
+
+  private:
+    std::filesystem::path m_path;
+    std::byte*            m_data = nullptr;
+    size_t                m_size = 0;
+
+#ifdef _WIN32
+    void* m_fileHandle    = nullptr;
+    void* m_mappingHandle = nullptr;
+#else
+    int m_fileDescriptor = -1;
+#endif
+};
+
+} // namespace prism
\ No newline at end of file
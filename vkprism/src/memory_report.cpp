@@ -0,0 +1,182 @@
+#include "memory_report.hpp"
+
+#include <sstream>
+
+#include <spdlog/spdlog.h>
+
+#include <util.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+#include <Psapi.h>
+#elif defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace prism {
+
+std::string_view memoryCategoryName(const MemoryCategory category)
+{
+    switch (category) {
+    case MemoryCategory::eGeometry:
+        return "geometry";
+    case MemoryCategory::eBlas:
+        return "blas";
+    case MemoryCategory::eTlas:
+        return "tlas";
+    case MemoryCategory::eScratch:
+        return "scratch";
+    case MemoryCategory::eSbt:
+        return "sbt";
+    case MemoryCategory::eFramebuffer:
+        return "framebuffer";
+    case MemoryCategory::eStaging:
+        return "staging";
+    case MemoryCategory::eReadback:
+        return "readback";
+    case MemoryCategory::eOther:
+    default:
+        return "other";
+    }
+}
+
+//
+// MemoryTracker:
+
+static void updatePeak(std::atomic<uint64_t>& peak, const uint64_t value)
+{
+    uint64_t current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void MemoryTracker::add(const MemoryCategory category, const uint64_t bytes)
+{
+    const auto idx = static_cast<uint32_t>(category);
+    updatePeak(m_peak[idx], m_current[idx].fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    updatePeak(m_peakTotal, m_currentTotal.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void MemoryTracker::remove(const MemoryCategory category, const uint64_t bytes)
+{
+    m_current[static_cast<uint32_t>(category)].fetch_sub(bytes, std::memory_order_relaxed);
+    m_currentTotal.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+uint64_t MemoryTracker::current(const MemoryCategory category) const
+{
+    return m_current[static_cast<uint32_t>(category)].load(std::memory_order_relaxed);
+}
+
+uint64_t MemoryTracker::peak(const MemoryCategory category) const
+{
+    return m_peak[static_cast<uint32_t>(category)].load(std::memory_order_relaxed);
+}
+
+uint64_t MemoryTracker::currentTotal() const { return m_currentTotal.load(std::memory_order_relaxed); }
+
+uint64_t MemoryTracker::peakTotal() const { return m_peakTotal.load(std::memory_order_relaxed); }
+
+//
+// Reporting:
+
+uint64_t processPeakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#elif defined(__linux__) || defined(__APPLE__)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss); // Bytes
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // Kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
+
+static double toMiB(const uint64_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+void logMemoryReport(const MemoryReport& report)
+{
+    const auto logUsages = [](const std::string_view title, const std::vector<MemoryUsage>& usages) {
+        spdlog::info("{:<24} {:>14} {:>14}", title, "current (MiB)", "peak (MiB)");
+        for (const auto& usage : usages) {
+            spdlog::info("{:<24} {:>14.2f} {:>14.2f}", usage.name, toMiB(usage.currentBytes), toMiB(usage.peakBytes));
+        }
+    };
+
+    if (!report.gpu.empty()) {
+        logUsages("gpu", report.gpu);
+        spdlog::info("{} allocations in {} blocks, {:.2f} MiB of the blocks unused", report.gpuAllocationCount,
+                     report.gpuBlockCount, toMiB(report.gpuUnusedBytes));
+    }
+
+    if (!report.heaps.empty()) {
+        spdlog::info("{:<24} {:>14} {:>14} {:>14} {:>14}", "heap", "blocks (MiB)", "allocs (MiB)", "usage (MiB)",
+                     "budget (MiB)");
+        for (const auto& heap : report.heaps) {
+            spdlog::info("{:<24} {:>14.2f} {:>14.2f} {:>14.2f} {:>14.2f}",
+                         std::to_string(heap.heapIdx) + (heap.deviceLocal ? " (device local)" : " (host)"),
+                         toMiB(heap.blockBytes), toMiB(heap.allocationBytes), toMiB(heap.usage), toMiB(heap.budget));
+        }
+    }
+
+    if (!report.host.empty()) {
+        logUsages("host", report.host);
+    }
+    if (report.processPeakBytes > 0) {
+        spdlog::info("Peak resident memory of the process: {:.2f} MiB", toMiB(report.processPeakBytes));
+    }
+}
+
+static void writeUsagesJson(std::ostream& out, const std::vector<MemoryUsage>& usages)
+{
+    out << "[";
+    for (size_t i = 0; i < usages.size(); ++i) {
+        const auto& usage = usages[i];
+        out << (i > 0 ? ", " : "") << "{\"name\": " << jsonEscape(usage.name)
+            << ", \"currentBytes\": " << usage.currentBytes << ", \"peakBytes\": " << usage.peakBytes << "}";
+    }
+    out << "]";
+}
+
+std::string memoryReportJson(const MemoryReport& report)
+{
+    std::ostringstream out;
+
+    out << "{\"gpu\": ";
+    writeUsagesJson(out, report.gpu);
+
+    out << ", \"gpuBlockCount\": " << report.gpuBlockCount << ", \"gpuAllocationCount\": " << report.gpuAllocationCount
+        << ", \"gpuUnusedBytes\": " << report.gpuUnusedBytes;
+
+    out << ", \"heaps\": [";
+    for (size_t i = 0; i < report.heaps.size(); ++i) {
+        const auto& heap = report.heaps[i];
+        out << (i > 0 ? ", " : "") << "{\"heap\": " << heap.heapIdx
+            << ", \"deviceLocal\": " << (heap.deviceLocal ? "true" : "false") << ", \"blockBytes\": " << heap.blockBytes
+            << ", \"allocationBytes\": " << heap.allocationBytes << ", \"usage\": " << heap.usage
+            << ", \"budget\": " << heap.budget << "}";
+    }
+    out << "]";
+
+    out << ", \"host\": ";
+    writeUsagesJson(out, report.host);
+    out << ", \"processPeakBytes\": " << report.processPeakBytes << "}";
+
+    return out.str();
+}
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace prism {
+
+// What a device allocation is used for (see GPUAllocator::allocateBuffer):
+enum class MemoryCategory : uint32_t
+{
+    eGeometry,    // Vertices, faces and transforms, along with the records the hit shaders read
+    eBlas,        // Bottom level acceleration structures
+    eTlas,        // The top level acceleration structure and its instances
+    eScratch,     // Scratch space of the acceleration structure builds
+    eSbt,         // Shader binding tables
+    eFramebuffer, // Beauty, AOV and any other output buffers of the pipelines
+    eStaging,     // Host visible buffers used to upload data
+    eReadback,    // Host visible buffers the outputs are copied back to
+    eOther,
+};
+
+constexpr uint32_t NUM_MEMORY_CATEGORIES = static_cast<uint32_t>(MemoryCategory::eOther) + 1;
+
+std::string_view memoryCategoryName(MemoryCategory category);
+
+// Keeps track of the bytes allocated for every category and their peaks (can be used from any thread):
+class MemoryTracker
+{
+  public:
+    void add(MemoryCategory category, uint64_t bytes);
+    void remove(MemoryCategory category, uint64_t bytes);
+
+    uint64_t current(MemoryCategory category) const;
+    uint64_t peak(MemoryCategory category) const;
+    // The peak of the total isn't the sum of the peaks, as the categories usually peak at different times:
+    uint64_t currentTotal() const;
+    uint64_t peakTotal() const;
+
+  private:
+    std::array<std::atomic<uint64_t>, NUM_MEMORY_CATEGORIES> m_current{};
+    std::array<std::atomic<uint64_t>, NUM_MEMORY_CATEGORIES> m_peak{};
+    std::atomic<uint64_t>                                    m_currentTotal = 0;
+    std::atomic<uint64_t>                                    m_peakTotal    = 0;
+};
+
+struct MemoryUsage
+{
+    std::string name;
+    uint64_t    currentBytes;
+    uint64_t    peakBytes;
+};
+
+// As reported by VMA for every memory heap:
+struct MemoryHeapUsage
+{
+    uint32_t heapIdx;
+    bool     deviceLocal;
+    uint64_t blockBytes;      // Device memory allocated from the heap
+    uint64_t allocationBytes; // The part of blockBytes that is used by allocations
+    uint64_t usage;           // Estimated usage of the whole process (including memory not allocated through VMA)
+    uint64_t budget;          // Estimated amount of memory available to the process
+};
+
+struct MemoryReport
+{
+    // Allocations made through the GPUAllocator, by category (followed by the total):
+    std::vector<MemoryUsage>     gpu;
+    std::vector<MemoryHeapUsage> heaps;
+
+    uint32_t gpuBlockCount      = 0;
+    uint32_t gpuAllocationCount = 0;
+    uint64_t gpuUnusedBytes     = 0; // Allocated from the device but not used by any allocation (e.g. fragmentation)
+
+    // Anything the application keeps on the host (e.g. SceneBuilder::hostMemoryUsage):
+    std::vector<MemoryUsage> host;
+    // Peak resident memory of the whole process (0 if the platform doesn't report it):
+    uint64_t processPeakBytes = 0;
+};
+
+// Peak resident memory of the process (0 if unknown):
+uint64_t processPeakMemory();
+
+// Logs the report as a table:
+void logMemoryReport(const MemoryReport& report);
+// A JSON object with the same contents (sizes are in bytes):
+std::string memoryReportJson(const MemoryReport& report);
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "mesh_attributes.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <glm/geometric.hpp>
+
+#include <profiler.hpp>
+#include <util.hpp>
+
+namespace prism {
+
+// Vertices per range of the parallel loops:
+static constexpr size_t MIN_RANGE_SIZE = size_t(1) << 14;
+
+// The angle of the triangle at p0:
+static float cornerAngle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+{
+    const glm::vec3 e1 = p1 - p0;
+    const glm::vec3 e2 = p2 - p0;
+    // More accurate for small angles than the arc cosine of the dot product:
+    return std::atan2(glm::length(glm::cross(e1, e2)), glm::dot(e1, e2));
+}
+
+// Normalizes non-zero vectors and leaves zero vectors as they are:
+static glm::vec3 safeNormalize(const glm::vec3& v)
+{
+    const float length = glm::length(v);
+    return length > 0.f ? v / length : glm::vec3(0.f);
+}
+
+VertexCorners findVertexCorners(const uint32_t numVertices, const std::span<const glm::u32vec3> faces)
+{
+    PRISM_PROFILE_SCOPE("scene/vertex_corners");
+
+    if (3 * uint64_t(faces.size()) > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Can't find the corners of " + std::to_string(faces.size()) +
+                                 " faces, there would be more than 2^32 of them");
+    }
+
+    VertexCorners vertexCorners{.offsets = std::vector<uint32_t>(numVertices + 1, 0),
+                                .corners = std::vector<uint32_t>(3 * faces.size())};
+    auto& offsets = vertexCorners.offsets;
+
+    // Counting sort, the corners of every vertex are counted and turned into offsets, then the corners are written in
+    // order (so the corners of a vertex are sorted as well, which keeps the sums below deterministic):
+    for (size_t face = 0; face < faces.size(); ++face) {
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            const uint32_t vertexIdx = faces[face][corner];
+            if (vertexIdx >= numVertices) {
+                throw std::runtime_error("Face " + std::to_string(face) + " has the vertex index " +
+                                         std::to_string(vertexIdx) + ", but the mesh only has " +
+                                         std::to_string(numVertices) + " vertices");
+            }
+            ++offsets[vertexIdx + 1];
+        }
+    }
+    for (uint32_t i = 1; i <= numVertices; ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+
+    std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+    for (uint32_t corner = 0; corner < vertexCorners.corners.size(); ++corner) {
+        vertexCorners.corners[next[faces[corner / 3][corner % 3]]++] = corner;
+    }
+
+    return vertexCorners;
+}
+
+void generateNormals(const std::span<const glm::vec3> positions, const std::span<const glm::u32vec3> faces,
+                     const VertexCorners& vertexCorners, const NormalWeighting weighting,
+                     const std::span<glm::vec3> normals)
+{
+    PRISM_PROFILE_SCOPE("scene/generate_normals");
+
+    parallelFor(normals.size(), MIN_RANGE_SIZE, [&](const size_t begin, const size_t end) {
+        for (size_t vertexIdx = begin; vertexIdx < end; ++vertexIdx) {
+            glm::vec3 normal(0.f);
+            for (const uint32_t corner : vertexCorners[static_cast<uint32_t>(vertexIdx)]) {
+                const auto&     face = faces[corner / 3];
+                const uint32_t  i    = corner % 3;
+                const glm::vec3 p0   = positions[face[i]];
+                const glm::vec3 p1   = positions[face[(i + 1) % 3]];
+                const glm::vec3 p2   = positions[face[(i + 2) % 3]];
+
+                // The length of the cross product is twice the area of the face:
+                const glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+                normal += weighting == NormalWeighting::eArea
+                              ? faceNormal
+                              : safeNormalize(faceNormal) * cornerAngle(p0, p1, p2);
+            }
+            normals[vertexIdx] = safeNormalize(normal);
+        }
+    });
+}
+
+void generateTangents(const std::span<const glm::vec3> positions, const std::span<const glm::u32vec3> faces,
+                      const std::span<const glm::vec2> uvs, const std::span<const glm::vec3> normals,
+                      const VertexCorners& vertexCorners, const std::span<glm::vec3> tangents)
+{
+    PRISM_PROFILE_SCOPE("scene/generate_tangents");
+
+    parallelFor(tangents.size(), MIN_RANGE_SIZE, [&](const size_t begin, const size_t end) {
+        for (size_t vertexIdx = begin; vertexIdx < end; ++vertexIdx) {
+            const glm::vec3 normal = normals[vertexIdx];
+
+            glm::vec3 tangent(0.f);
+            for (const uint32_t corner : vertexCorners[static_cast<uint32_t>(vertexIdx)]) {
+                const auto&    face = faces[corner / 3];
+                const uint32_t i    = corner % 3;
+                const uint32_t i1   = face[(i + 1) % 3];
+                const uint32_t i2   = face[(i + 2) % 3];
+
+                const glm::vec3 e1  = positions[i1] - positions[face[i]];
+                const glm::vec3 e2  = positions[i2] - positions[face[i]];
+                const glm::vec2 d1  = uvs[i1] - uvs[face[i]];
+                const glm::vec2 d2  = uvs[i2] - uvs[face[i]];
+                const float     det = d1.x * d2.y - d2.x * d1.y;
+
+                // Faces without any uv area don't have a tangent:
+                if (det == 0.f) {
+                    continue;
+                }
+
+                // Like MikkTSpace only the sign of the uv determinant is used (the tangent is normalized after the
+                // projection), so that faces with tiny uvs don't dominate:
+                const glm::vec3 faceTangent = (e1 * d2.y - e2 * d1.y) * (det < 0.f ? -1.f : 1.f);
+
+                const glm::vec3 projected = safeNormalize(faceTangent - normal * glm::dot(normal, faceTangent));
+                tangent += projected * cornerAngle(positions[face[i]], positions[i1], positions[i2]);
+            }
+            tangents[vertexIdx] = safeNormalize(tangent);
+        }
+    });
+}
+
+} // namespace prism
\ No newline at end of file
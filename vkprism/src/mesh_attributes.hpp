@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+namespace prism {
+
+// How the normals of the faces around a vertex are weighted:
+enum class NormalWeighting
+{
+    eArea,  // By the area of the face, cheap but large faces dominate
+    eAngle, // By the angle of the face at the vertex, doesn't depend on how the faces around it are tessellated
+};
+
+// Vertex attributes that are generated for the meshes that don't have them:
+struct MeshAttributeParam
+{
+    bool            normals   = false;
+    bool            tangents  = false; // Only for meshes with uvs
+    NormalWeighting weighting = NormalWeighting::eAngle;
+};
+
+// The corners (3 * face + index of the vertex in the face) around every vertex, in a CSR layout. Gathering from these
+// lets every vertex be processed independently, without any atomics:
+struct VertexCorners
+{
+    std::vector<uint32_t> offsets; // One more than there are vertices
+    std::vector<uint32_t> corners;
+
+    std::span<const uint32_t> operator[](const uint32_t vertexIdx) const
+    {
+        return std::span(corners).subspan(offsets[vertexIdx], offsets[vertexIdx + 1] - offsets[vertexIdx]);
+    }
+};
+
+// Sorts the corners by their vertex (with a counting sort). Throws if a face has a vertex index out of range:
+VertexCorners findVertexCorners(uint32_t numVertices, std::span<const glm::u32vec3> faces);
+
+// Vertices that aren't part of any face with an area get a zero normal (like meshes without normals). Split across the
+// task system:
+void generateNormals(std::span<const glm::vec3> positions, std::span<const glm::u32vec3> faces,
+                     const VertexCorners& vertexCorners, NormalWeighting weighting, std::span<glm::vec3> normals);
+
+// Tangents along the u direction of the uvs, computed like MikkTSpace does for a vertex that doesn't have to be split:
+// the tangents of the faces are projected onto the plane of the vertex normal and averaged weighted by the angle of the
+// face at the vertex. Vertex doesn't have room for the bitangent sign, so that part of MikkTSpace is left out. Split
+// across the task system:
+void generateTangents(std::span<const glm::vec3> positions, std::span<const glm::u32vec3> faces,
+                      std::span<const glm::vec2> uvs, std::span<const glm::vec3> normals,
+                      const VertexCorners& vertexCorners, std::span<glm::vec3> tangents);
+
+} // namespace prism
\ No newline at end of file
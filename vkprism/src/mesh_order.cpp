@@ -0,0 +1,117 @@
+#include "mesh_order.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <bbox.hpp>
+#include <morton.hpp>
+#include <profiler.hpp>
+#include <util.hpp>
+
+namespace prism {
+
+// Faces per block of the parallel loops:
+static constexpr size_t BLOCK_SIZE = size_t(1) << 16;
+
+static size_t numBlocks(const size_t count) { return (count + BLOCK_SIZE - 1) / BLOCK_SIZE; }
+
+static glm::vec3 centroid(const std::span<const glm::vec3> positions, const glm::u32vec3& face)
+{
+    return (positions[face.x] + positions[face.y] + positions[face.z]) * (1.f / 3.f);
+}
+
+void sortFacesSpatially(const std::span<const glm::vec3> positions, const std::span<glm::u32vec3> faces)
+{
+    PRISM_PROFILE_SCOPE("scene/sort_faces");
+
+    if (faces.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Can't sort " + std::to_string(faces.size()) + " faces, the indices are 32 bit");
+    }
+    if (faces.size() < 2) {
+        return;
+    }
+
+    // The bounds of every block and then of all of them:
+    std::vector<BBox3f> blockBounds(numBlocks(faces.size()));
+    parallelFor(blockBounds.size(), 1, [&](const size_t begin, const size_t end) {
+        for (size_t block = begin; block < end; ++block) {
+            for (size_t i = block * BLOCK_SIZE; i < std::min(faces.size(), (block + 1) * BLOCK_SIZE); ++i) {
+                const auto& face = faces[i];
+                if (face.x >= positions.size() || face.y >= positions.size() || face.z >= positions.size()) {
+                    throw std::runtime_error("Face index out of range when sorting the faces of a mesh with " +
+                                             std::to_string(positions.size()) + " vertices");
+                }
+                blockBounds[block].extend(centroid(positions, face));
+            }
+        }
+    });
+    BBox3f bounds;
+    for (const auto& blockBound : blockBounds) {
+        bounds.extend(blockBound);
+    }
+    const glm::vec3 extent = bounds.diagonal();
+    const glm::vec3 scale(extent.x > 0.f ? 1023.f / extent.x : 0.f, extent.y > 0.f ? 1023.f / extent.y : 0.f,
+                          extent.z > 0.f ? 1023.f / extent.z : 0.f);
+
+    // The Morton code in the upper and the index of the face in the lower 32 bits:
+    std::vector<uint64_t> keys(faces.size());
+    parallelFor(faces.size(), BLOCK_SIZE, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const glm::vec3 relative = (centroid(positions, faces[i]) - bounds.pmin) * scale;
+
+            uint32_t morton = 0;
+            for (int axis = 0; axis < 3; ++axis) {
+                const auto quantized = static_cast<uint32_t>(std::clamp(relative[axis], 0.f, 1023.f));
+                morton |= expandBits(quantized) << (2 - axis);
+            }
+            keys[i] = (uint64_t(morton) << 32) | i;
+        }
+    });
+    radixSort(keys, 32, 30);
+
+    const std::vector<glm::u32vec3> unsorted(faces.begin(), faces.end());
+    parallelFor(faces.size(), BLOCK_SIZE, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            faces[i] = unsorted[static_cast<uint32_t>(keys[i])];
+        }
+    });
+}
+
+std::vector<uint32_t> orderVerticesByFirstUse(const uint32_t numVertices, const std::span<glm::u32vec3> faces)
+{
+    PRISM_PROFILE_SCOPE("scene/order_vertices");
+
+    constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+
+    // A single pass, as the first use of a vertex depends on every face before it:
+    std::vector<uint32_t> newIndices(numVertices, UNUSED);
+    std::vector<uint32_t> oldIndices;
+    oldIndices.reserve(numVertices);
+    for (size_t faceIdx = 0; faceIdx < faces.size(); ++faceIdx) {
+        auto& face = faces[faceIdx];
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            const uint32_t vertexIdx = face[corner];
+            if (vertexIdx >= numVertices) {
+                throw std::runtime_error("Face " + std::to_string(faceIdx) + " has the vertex index " +
+                                         std::to_string(vertexIdx) + ", but the mesh only has " +
+                                         std::to_string(numVertices) + " vertices");
+            }
+            if (newIndices[vertexIdx] == UNUSED) {
+                newIndices[vertexIdx] = static_cast<uint32_t>(oldIndices.size());
+                oldIndices.push_back(vertexIdx);
+            }
+            face[corner] = newIndices[vertexIdx];
+        }
+    }
+
+    for (uint32_t vertexIdx = 0; vertexIdx < numVertices; ++vertexIdx) {
+        if (newIndices[vertexIdx] == UNUSED) {
+            oldIndices.push_back(vertexIdx);
+        }
+    }
+    return oldIndices;
+}
+
+} // namespace prism
\ No newline at end of file
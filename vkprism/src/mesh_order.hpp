@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+namespace prism {
+
+// Sorts the faces along a Morton (Z-order) curve through their centroids (10 bits per axis within the bounds of the
+// centroids), so that faces that are close to each other are close in memory as well. Ties keep the order they had.
+// Uses a radix sort that's split across the task system. Throws if a face has a vertex index out of range:
+void sortFacesSpatially(std::span<const glm::vec3> positions, std::span<glm::u32vec3> faces);
+
+// Renumbers the vertices in the order the faces first use them, vertices that aren't part of any face go last (in the
+// order they had). Returns the old index of every new vertex, to reorder the vertex attributes with. Throws if a face
+// has a vertex index out of range:
+std::vector<uint32_t> orderVerticesByFirstUse(uint32_t numVertices, std::span<glm::u32vec3> faces);
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "morton.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <util.hpp>
+
+namespace prism {
+
+void radixSort(const std::span<uint64_t> keys, const uint32_t firstBit, const uint32_t numBits)
+{
+    // 8 bits per pass. Every pass counts the digits of each block in parallel and then scatters the blocks in parallel,
+    // each block to the offsets its counts were turned into (digit major, block minor, which keeps the sort stable):
+    constexpr uint32_t DIGIT_BITS = 8;
+    constexpr uint32_t RADIX      = 1 << DIGIT_BITS;
+    constexpr size_t   BLOCK_SIZE = size_t(1) << 16;
+
+    if (keys.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Can't sort " + std::to_string(keys.size()) + " keys, the offsets are 32 bit");
+    }
+
+    const size_t          blocks = (keys.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::vector<uint64_t> buffer(keys.size());
+    std::vector<uint32_t> offsets(blocks * RADIX);
+
+    // Every pass that moves anything swaps the two, so the keys may end up in the buffer:
+    std::span<uint64_t> src = keys;
+    std::span<uint64_t> dst = buffer;
+
+    for (uint32_t shift = firstBit; shift < firstBit + numBits; shift += DIGIT_BITS) {
+        const auto digit = [shift](const uint64_t key) { return static_cast<uint32_t>(key >> shift) & (RADIX - 1); };
+
+        parallelFor(blocks, 1, [&](const size_t begin, const size_t end) {
+            for (size_t block = begin; block < end; ++block) {
+                uint32_t* counts = offsets.data() + block * RADIX;
+                std::fill(counts, counts + RADIX, 0);
+                for (size_t i = block * BLOCK_SIZE; i < std::min(src.size(), (block + 1) * BLOCK_SIZE); ++i) {
+                    ++counts[digit(src[i])];
+                }
+            }
+        });
+
+        // Passes where every key has the same digit wouldn't move anything (e.g. the upper bits of small meshes):
+        bool     trivial = false;
+        uint32_t sum     = 0;
+        for (uint32_t d = 0; d < RADIX; ++d) {
+            const uint32_t digitBegin = sum;
+            for (size_t block = 0; block < blocks; ++block) {
+                const uint32_t count       = offsets[block * RADIX + d];
+                offsets[block * RADIX + d] = sum;
+                sum += count;
+            }
+            trivial |= sum - digitBegin == src.size();
+        }
+        if (trivial) {
+            continue;
+        }
+
+        parallelFor(blocks, 1, [&](const size_t begin, const size_t end) {
+            for (size_t block = begin; block < end; ++block) {
+                uint32_t* next = offsets.data() + block * RADIX;
+                for (size_t i = block * BLOCK_SIZE; i < std::min(src.size(), (block + 1) * BLOCK_SIZE); ++i) {
+                    dst[next[digit(src[i])]++] = src[i];
+                }
+            }
+        });
+        std::swap(src, dst);
+    }
+
+    if (src.data() != keys.data()) {
+        std::ranges::copy(src, keys.begin());
+    }
+}
+
+} // namespace prism
\ No newline at end of file
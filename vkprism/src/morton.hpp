@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+namespace prism {
+
+// Spreads the lower 10 bits out to every third bit, interleaving three of these gives a 30 bit Morton code:
+inline uint32_t expandBits(uint32_t value)
+{
+    value = (value * 0x00010001u) & 0xFF0000FFu;
+    value = (value * 0x00000101u) & 0x0F00F00Fu;
+    value = (value * 0x00000011u) & 0xC30C30C3u;
+    value = (value * 0x00000005u) & 0x49249249u;
+    return value;
+}
+
+// Stable LSD radix sort of the keys by the bits in [firstBit, firstBit + numBits), the other bits are carried along
+// (e.g. the index of what the key belongs to in the lower bits). Split across the task system:
+void radixSort(std::span<uint64_t> keys, uint32_t firstBit, uint32_t numBits);
+
+} // namespace prism
\ No newline at end of file
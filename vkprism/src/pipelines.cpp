@@ -4,64 +4,174 @@
 #include <array>
 #include <cstddef>
 #include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include <glm/common.hpp>
+
+#include <gpu_profiler.hpp>
 #include <util.hpp>
 
 namespace prism {
 
+bool Pipelines::packOnDevice(const PipelineParam& param)
+{
+    return param.accumulateInFloat && param.beautyFormat != BeautyFormat::eRGB32F;
+}
+
+glm::uvec2 Pipelines::bufferSize(const PipelineParam& param)
+{
+    const glm::uvec2 outputSize(param.outputWidth, param.outputHeight);
+    if (param.tileWidth == 0 || param.tileHeight == 0) {
+        return outputSize;
+    }
+    return glm::min(glm::uvec2(param.tileWidth, param.tileHeight), outputSize);
+}
+
+// The ray stats counters use subgroup operations in every ray tracing stage. The SPIR-V modules declare the ballot
+// capability whether or not the counters are enabled by their specialization constant, so this is always required:
+static void checkSubgroupSupport(const Context& context)
+{
+    const auto& subgroupProperties = context.properties().get<vk::PhysicalDeviceVulkan11Properties>();
+
+    const auto stages = vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eClosestHitKHR |
+                        vk::ShaderStageFlagBits::eMissKHR;
+    const auto operations = vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eBallot;
+    if ((subgroupProperties.subgroupSupportedStages & stages) != stages ||
+        (subgroupProperties.subgroupSupportedOperations & operations) != operations) {
+        throw std::runtime_error("The ray tracing shaders require subgroup ballot support in the raygen, closest hit "
+                                 "and miss stages, which the device doesn't have.");
+    }
+}
+
 Pipelines::Buffers Pipelines::createBuffers(const PipelineParam& param, const GPUAllocator& gpuAllocator)
 {
-    return Buffers{
-        .beautyOutput = gpuAllocator.allocateBuffer(
-            param.outputWidth * param.outputHeight * sizeof(glm::vec3),
-            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc,
-            VMA_MEMORY_USAGE_GPU_ONLY)
+    const auto   size      = bufferSize(param);
+    const size_t numPixels = size_t(size.x) * size.y;
+    const auto   usage     = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc;
+
+    Buffers buffers{
+        .beautyOutput = gpuAllocator.allocateBuffer(numPixels * beautyPixelSize(param.beautyFormat), usage,
+                                                    VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::eFramebuffer),
+        .beautyAccum  = packOnDevice(param)
+                            ? gpuAllocator.allocateBuffer(numPixels * sizeof(glm::vec3),
+                                                          vk::BufferUsageFlagBits::eStorageBuffer,
+                                                          VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::eFramebuffer)
+                            : UniqueBuffer{},
+        .placeholder  = gpuAllocator.allocateBuffer(sizeof(glm::vec4), vk::BufferUsageFlagBits::eStorageBuffer,
+                                                    VMA_MEMORY_USAGE_GPU_ONLY),
     };
+
+    for (uint32_t aov = 0; aov < TOTAL_NUM_AOVS; ++aov) {
+        if (param.aovs[aov]) {
+            buffers.aovOutputs[aov] =
+                gpuAllocator.allocateBuffer(numPixels * aovPixelSize(AovType(aov)), usage, VMA_MEMORY_USAGE_GPU_ONLY,
+                                            MemoryCategory::eFramebuffer);
+        }
+    }
+
+    // Cleared before every launch:
+    if (param.enableRayStats) {
+        buffers.rayStats = gpuAllocator.allocateBuffer(sizeof(RayStats), usage | vk::BufferUsageFlagBits::eTransferDst,
+                                                       VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::eFramebuffer);
+    }
+
+    return buffers;
+}
+
+// Writes a storage buffer to every binding, the bindings and buffers should line up:
+static void writeStorageBufferDescriptors(const Context& context, const vk::DescriptorSet& set,
+                                          std::span<const vk::DescriptorSetLayoutBinding> bindings,
+                                          std::span<const vk::Buffer>                     storageBuffers)
+{
+    std::vector<vk::DescriptorBufferInfo> bufferInfos;
+    bufferInfos.reserve(storageBuffers.size());
+    for (const auto& buffer : storageBuffers) {
+        bufferInfos.emplace_back(vk::DescriptorBufferInfo{.buffer = buffer, .range = VK_WHOLE_SIZE});
+    }
+
+    std::vector<vk::WriteDescriptorSet> writes;
+    writes.reserve(bufferInfos.size());
+    for (size_t i = 0; i < bufferInfos.size(); ++i) {
+        writes.emplace_back(vk::WriteDescriptorSet{
+            .dstSet          = set,
+            .dstBinding      = bindings[i].binding,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType  = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo     = &bufferInfos[i],
+        });
+    }
+
+    context.device().updateDescriptorSets(writes, {});
 }
 
 Pipelines::Descriptors Pipelines::createDescriptors(const Context& context, const Scene& scene, const Buffers& buffers)
 {
     // This contains the output buffers (final color image, other AOVs, etc.):
     auto outputBuffers = [&]() {
-        Descriptor descriptor(
-            context,
-            std::to_array({
-                // Beauty output buffer:
-                vk::DescriptorSetLayoutBinding{
-                    .binding         = 0,
-                    .descriptorType  = vk::DescriptorType::eStorageBuffer,
-                    .descriptorCount = 1,
-                    .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR}}));
-
-        const vk::DescriptorBufferInfo beautyOutputBufferInfo{
-            .buffer = *buffers.beautyOutput,
-            .range = VK_WHOLE_SIZE
-        };
+        std::array<vk::DescriptorSetLayoutBinding, 2 + TOTAL_NUM_AOVS> bindings;
+        std::array<vk::Buffer, 2 + TOTAL_NUM_AOVS>                     storageBuffers;
 
-        const vk::WriteDescriptorSet beautyOutputWrite{
-            .dstSet          = descriptor.set,
-            .dstBinding      = 0,
-            .dstArrayElement = 0,
+        // Beauty output buffer:
+        bindings[0] = vk::DescriptorSetLayoutBinding{
+            .binding         = 0,
+            .descriptorType  = vk::DescriptorType::eStorageBuffer,
             .descriptorCount = 1,
+            .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR,
+        };
+        storageBuffers[0] = buffers.beautyAccum ? *buffers.beautyAccum : *buffers.beautyOutput;
+
+        // AOV output buffers (the placeholder is bound if the AOV isn't used):
+        for (uint32_t aov = 0; aov < TOTAL_NUM_AOVS; ++aov) {
+            bindings[1 + aov] = vk::DescriptorSetLayoutBinding{
+                .binding         = aovBinding(AovType(aov)),
+                .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = 1,
+                .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR,
+            };
+            storageBuffers[1 + aov] = buffers.aovOutputs[aov] ? *buffers.aovOutputs[aov] : *buffers.placeholder;
+        }
+
+        // The ray stats are counted by every ray tracing stage:
+        bindings[1 + TOTAL_NUM_AOVS] = vk::DescriptorSetLayoutBinding{
+            .binding         = RAY_STATS_BINDING,
             .descriptorType  = vk::DescriptorType::eStorageBuffer,
-            .pBufferInfo     = &beautyOutputBufferInfo,
+            .descriptorCount = 1,
+            .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eClosestHitKHR |
+                               vk::ShaderStageFlagBits::eMissKHR,
         };
+        storageBuffers[1 + TOTAL_NUM_AOVS] = buffers.rayStats ? *buffers.rayStats : *buffers.placeholder;
 
-        context.device().updateDescriptorSets(beautyOutputWrite, {});
+        Descriptor descriptor(context, bindings);
+        writeStorageBufferDescriptors(context, descriptor.set, bindings, storageBuffers);
 
         return descriptor;
     }();
 
     // The scene info descriptor contains the TLAS, scene geometry, and scene material properties (to be added later):
     auto sceneInfo = [&]() {
-        Descriptor descriptor(context,
-                              std::to_array({// TLAS:
+        const auto geometryBinding = [](const uint32_t binding) {
+            return vk::DescriptorSetLayoutBinding{.binding         = binding,
+                                                  .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                                                  .descriptorCount = 1,
+                                                  .stageFlags      = vk::ShaderStageFlagBits::eClosestHitKHR};
+        };
+
+        const auto bindings = std::to_array({// TLAS:
                                              vk::DescriptorSetLayoutBinding{
                                                  .binding         = 0,
                                                  .descriptorType  = vk::DescriptorType::eAccelerationStructureKHR,
                                                  .descriptorCount = 1,
-                                                 .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR}}));
+                                                 .stageFlags      = vk::ShaderStageFlagBits::eRaygenKHR},
+                                             // Geometry used by the hit shaders (see raytrace.rchit):
+                                             geometryBinding(1), geometryBinding(2), geometryBinding(3),
+                                             geometryBinding(4), geometryBinding(5), geometryBinding(6),
+                                             geometryBinding(7)});
+
+        Descriptor descriptor(context, bindings);
 
         const vk::StructureChain<vk::WriteDescriptorSet, vk::WriteDescriptorSetAccelerationStructureKHR> tlasWrite{
             vk::WriteDescriptorSet{.dstSet          = descriptor.set,
@@ -77,6 +187,17 @@ Pipelines::Descriptors Pipelines::createDescriptors(const Context& context, cons
 
         context.device().updateDescriptorSets(tlasWrite.get<vk::WriteDescriptorSet>(), {});
 
+        const auto geometryBuffers = std::to_array({
+            scene.compactVertices() ? *buffers.placeholder : scene.gpuVertices(),
+            scene.gpuFaces() ? scene.gpuFaces() : *buffers.placeholder,
+            scene.gpuTransforms() ? scene.gpuTransforms() : *buffers.placeholder,
+            scene.gpuGeometryRecords(),
+            scene.gpuInstanceRecords(),
+            scene.gpuFaces16() ? scene.gpuFaces16() : *buffers.placeholder,
+            scene.compactVertices() ? scene.gpuVertices() : *buffers.placeholder,
+        });
+        writeStorageBufferDescriptors(context, descriptor.set, std::span(bindings).subspan(1), geometryBuffers);
+
         return descriptor;
     }();
 
@@ -87,9 +208,10 @@ Pipelines::Descriptors Pipelines::createDescriptors(const Context& context, cons
 }
 
 Pipelines::RTPipeline Pipelines::createRTPipeline(
-    const Context&      context,
-    const GPUAllocator& gpuAllocator,
-    const Descriptors&  descriptors)
+    const PipelineParam& param,
+    const Context&       context,
+    const GPUAllocator&  gpuAllocator,
+    const Descriptors&   descriptors)
 {
     //
     // Create the pipeline layout:
@@ -106,12 +228,18 @@ Pipelines::RTPipeline Pipelines::createRTPipeline(
                 *descriptors.outputBuffers.setLayout
             });
 
+        const vk::PushConstantRange pushConstRange{
+            .stageFlags = vk::ShaderStageFlagBits::eRaygenKHR,
+            .offset     = 0,
+            .size       = sizeof(RTPipeline::PushConst),
+        };
+
         return context.device().createPipelineLayoutUnique(
             vk::PipelineLayoutCreateInfo{
                 .setLayoutCount         = descriptorSetLayouts.size(),
                 .pSetLayouts            = descriptorSetLayouts.data(),
-                .pushConstantRangeCount = 0, // no push constants for now
-                .pPushConstantRanges    = nullptr
+                .pushConstantRangeCount = 1,
+                .pPushConstantRanges    = &pushConstRange
             });
     }();
 
@@ -119,24 +247,65 @@ Pipelines::RTPipeline Pipelines::createRTPipeline(
     // Set the shader stages and the groups up:
     //
 
+    checkSubgroupSupport(context);
+
+    // The AOVs, beauty format and ray stats are set through specialization constants (shared by all of the ray tracing
+    // shaders). The AOVs are followed by the beauty format and the ray stats:
+    std::array<vk::SpecializationMapEntry, TOTAL_NUM_AOVS + 2> specEntries;
+    std::array<uint32_t, TOTAL_NUM_AOVS + 2>                   specData;
+    for (uint32_t aov = 0; aov < TOTAL_NUM_AOVS; ++aov) {
+        specEntries[aov] = vk::SpecializationMapEntry{
+            .constantID = aovBinding(AovType(aov)),
+            .offset     = static_cast<uint32_t>(aov * sizeof(uint32_t)),
+            .size       = sizeof(vk::Bool32),
+        };
+        specData[aov] = param.aovs[aov] ? VK_TRUE : VK_FALSE;
+    }
+
+    // If we pack on the device then the raygen shader writes float:
+    specEntries[TOTAL_NUM_AOVS] = vk::SpecializationMapEntry{
+        .constantID = BEAUTY_FORMAT_ID,
+        .offset     = static_cast<uint32_t>(TOTAL_NUM_AOVS * sizeof(uint32_t)),
+        .size       = sizeof(uint32_t),
+    };
+    specData[TOTAL_NUM_AOVS] =
+        static_cast<uint32_t>(packOnDevice(param) ? BeautyFormat::eRGB32F : param.beautyFormat);
+
+    specEntries[TOTAL_NUM_AOVS + 1] = vk::SpecializationMapEntry{
+        .constantID = RAY_STATS_ID,
+        .offset     = static_cast<uint32_t>((TOTAL_NUM_AOVS + 1) * sizeof(uint32_t)),
+        .size       = sizeof(vk::Bool32),
+    };
+    specData[TOTAL_NUM_AOVS + 1] = param.enableRayStats ? VK_TRUE : VK_FALSE;
+
+    const vk::SpecializationInfo aovSpecInfo{
+        .mapEntryCount = static_cast<uint32_t>(specEntries.size()),
+        .pMapEntries   = specEntries.data(),
+        .dataSize      = sizeof(specData),
+        .pData         = specData.data(),
+    };
+
     // Load all of the shaders first:
 
     const auto shaderStages = [&]() {
         std::array<vk::PipelineShaderStageCreateInfo, TOTAL_NUM_SHADERS> shaderStages;
         shaderStages[sRAYGEN] = vk::PipelineShaderStageCreateInfo{
-            .stage  = vk::ShaderStageFlagBits::eRaygenKHR,
-            .module = loadShader(context, sRAYGEN),
-            .pName  = SHADER_ENTRY
+            .stage               = vk::ShaderStageFlagBits::eRaygenKHR,
+            .module              = loadShader(context, sRAYGEN),
+            .pName               = SHADER_ENTRY,
+            .pSpecializationInfo = &aovSpecInfo
         };
         shaderStages[sMISS] = vk::PipelineShaderStageCreateInfo{
-            .stage = vk::ShaderStageFlagBits::eMissKHR,
-            .module = loadShader(context, sMISS),
-            .pName = SHADER_ENTRY
+            .stage               = vk::ShaderStageFlagBits::eMissKHR,
+            .module              = loadShader(context, sMISS),
+            .pName               = SHADER_ENTRY,
+            .pSpecializationInfo = &aovSpecInfo
         };
         shaderStages[sCLOSEST_HIT] = vk::PipelineShaderStageCreateInfo{
-            .stage = vk::ShaderStageFlagBits::eClosestHitKHR,
-            .module = loadShader(context, sCLOSEST_HIT),
-            .pName  = SHADER_ENTRY
+            .stage               = vk::ShaderStageFlagBits::eClosestHitKHR,
+            .module              = loadShader(context, sCLOSEST_HIT),
+            .pName               = SHADER_ENTRY,
+            .pSpecializationInfo = &aovSpecInfo
         };
         return shaderStages;
     }();
@@ -261,14 +430,14 @@ Pipelines::RTPipeline Pipelines::createRTPipeline(
         vk::BufferUsageFlagBits::eTransferDst             |
             vk::BufferUsageFlagBits::eShaderDeviceAddress |
             vk::BufferUsageFlagBits::eShaderBindingTableKHR,
-        VMA_MEMORY_USAGE_CPU_TO_GPU);
+        VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::eSbt);
 
     // Assign the device addresses:
     const auto sbtAddress = sbtBuffer.deviceAddress(context.device());
 
     raygenAddrRegion.deviceAddress   = sbtAddress;
     missAddrRegion.deviceAddress     = sbtAddress + raygenAddrRegion.size;
-    hitAddrRegion.deviceAddress      = sbtAddress + raygenAddrRegion.size + hitAddrRegion.size;
+    hitAddrRegion.deviceAddress      = sbtAddress + raygenAddrRegion.size + missAddrRegion.size;
     callableAddrRegion.deviceAddress = 0; // no callables yet...
 
     //
@@ -318,21 +487,154 @@ Pipelines::RTPipeline Pipelines::createRTPipeline(
     };
 }
 
+std::optional<Pipelines::PackPipeline> Pipelines::createPackPipeline(const PipelineParam& param,
+                                                                     const Context&       context,
+                                                                     const Buffers&       buffers)
+{
+    if (!packOnDevice(param)) {
+        return std::nullopt;
+    }
+
+    const auto bindings = std::to_array({
+        vk::DescriptorSetLayoutBinding{.binding         = 0,
+                                       .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                                       .descriptorCount = 1,
+                                       .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+        vk::DescriptorSetLayoutBinding{.binding         = 1,
+                                       .descriptorType  = vk::DescriptorType::eStorageBuffer,
+                                       .descriptorCount = 1,
+                                       .stageFlags      = vk::ShaderStageFlagBits::eCompute},
+    });
+
+    Descriptor descriptor(context, bindings);
+    writeStorageBufferDescriptors(context, descriptor.set, bindings,
+                                  std::to_array({*buffers.beautyAccum, *buffers.beautyOutput}));
+
+    const vk::PushConstantRange pushConstRange{
+        .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        .offset     = 0,
+        .size       = sizeof(PackPipeline::PushConst),
+    };
+
+    auto pipelineLayout = context.device().createPipelineLayoutUnique(vk::PipelineLayoutCreateInfo{
+        .setLayoutCount         = 1,
+        .pSetLayouts            = &*descriptor.setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges    = &pushConstRange,
+    });
+
+    const auto                       beautyFormat = static_cast<uint32_t>(param.beautyFormat);
+    const vk::SpecializationMapEntry specEntry{
+        .constantID = BEAUTY_FORMAT_ID,
+        .offset     = 0,
+        .size       = sizeof(uint32_t),
+    };
+    const vk::SpecializationInfo specInfo{
+        .mapEntryCount = 1,
+        .pMapEntries   = &specEntry,
+        .dataSize      = sizeof(beautyFormat),
+        .pData         = &beautyFormat,
+    };
+
+    const auto shaderModule = loadShaderUnique(context, "pack_beauty.comp");
+
+    auto pipeline = context.device().createComputePipelineUnique({}, vk::ComputePipelineCreateInfo{
+        .stage =
+            vk::PipelineShaderStageCreateInfo{
+                .stage               = vk::ShaderStageFlagBits::eCompute,
+                .module              = *shaderModule,
+                .pName               = SHADER_ENTRY,
+                .pSpecializationInfo = &specInfo,
+            },
+        .layout = *pipelineLayout,
+    });
+    vkCall(pipeline.result);
+
+    return PackPipeline{
+        .descriptor     = std::move(descriptor),
+        .pipelineLayout = std::move(pipelineLayout),
+        .pipeline       = std::move(pipeline.value),
+    };
+}
+
 Pipelines::Pipelines(const PipelineParam& param, const Context& context, const GPUAllocator& gpuAllocator,
                      const Scene& scene) :
+    m_beautyFormat(param.beautyFormat),
+    m_outputSize(param.outputWidth, param.outputHeight),
+    m_bufferSize(bufferSize(param)),
     m_buffers(createBuffers(param, gpuAllocator)),
     m_descriptors(createDescriptors(context, scene, m_buffers)),
-    m_rtPipeline(createRTPipeline(context, gpuAllocator, m_descriptors))
+    m_rtPipeline(createRTPipeline(param, context, gpuAllocator, m_descriptors)),
+    m_packPipeline(createPackPipeline(param, context, m_buffers)),
+    m_gpuProfiler(context.gpuProfiler())
 {}
 
 void prism::Pipelines::addBindRTPipelineCmd(const vk::CommandBuffer& commandBuffer, const RTPipelineParam& param) const
 {
+    if (param.width > m_bufferSize.x || param.height > m_bufferSize.y || param.offsetX + param.width > m_outputSize.x ||
+        param.offsetY + param.height > m_outputSize.y) {
+        throw std::runtime_error("Ray tracing launch of " + std::to_string(param.width) + "x" +
+                                 std::to_string(param.height) + " at (" + std::to_string(param.offsetX) + ", " +
+                                 std::to_string(param.offsetY) + ") doesn't fit in the output buffers.");
+    }
+
+    // Every launch starts counting from zero:
+    if (m_buffers.rayStats) {
+        commandBuffer.fillBuffer(*m_buffers.rayStats, 0, VK_WHOLE_SIZE, 0);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                      vk::PipelineStageFlagBits::eRayTracingShaderKHR, vk::DependencyFlags{},
+                                      vk::MemoryBarrier{.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                                                        .dstAccessMask = vk::AccessFlagBits::eShaderRead |
+                                                                         vk::AccessFlagBits::eShaderWrite},
+                                      {}, {});
+    }
+
     commandBuffer.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, *m_rtPipeline.pipeline);
     commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, *m_rtPipeline.pipelineLayout, 0,
                                      m_rtPipeline.descriptorSets, {});
-    // commandBuffer.pushConstants(*m_layout, ...) <- add when appropriate
-    commandBuffer.traceRaysKHR(m_rtPipeline.raygenAddrRegion, m_rtPipeline.missAddrRegion, m_rtPipeline.hitAddrRegion,
-                               m_rtPipeline.callableAddrRegion, param.width, param.height, 1);
+    commandBuffer.pushConstants<RTPipeline::PushConst>(*m_rtPipeline.pipelineLayout,
+                                                       vk::ShaderStageFlagBits::eRaygenKHR, 0,
+                                                       RTPipeline::PushConst{
+                                                           .rasterOffset  = glm::uvec2(param.offsetX, param.offsetY),
+                                                           .outputSize    = m_outputSize,
+                                                           .cameraToWorld = param.cameraToWorld,
+                                                       });
+    {
+        PRISM_PROFILE_GPU_SCOPE(m_gpuProfiler, commandBuffer, "render/trace");
+        commandBuffer.traceRaysKHR(m_rtPipeline.raygenAddrRegion, m_rtPipeline.missAddrRegion,
+                                   m_rtPipeline.hitAddrRegion, m_rtPipeline.callableAddrRegion, param.width,
+                                   param.height, 1);
+    }
+
+    if (!m_packPipeline) {
+        return;
+    }
+
+    //
+    // Pack the accumulation buffer into the beauty output once tracing has finished:
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                                  vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags{},
+                                  vk::MemoryBarrier{.srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+                                                    .dstAccessMask = vk::AccessFlagBits::eShaderRead},
+                                  {}, {});
+
+    PRISM_PROFILE_GPU_SCOPE(m_gpuProfiler, commandBuffer, "render/pack");
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *m_packPipeline->pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *m_packPipeline->pipelineLayout, 0,
+                                     m_packPipeline->descriptor.set, {});
+    // Only the pixels of this launch have to be packed:
+    const PackPipeline::PushConst packPushConst{.numPixels = param.width * param.height};
+    commandBuffer.pushConstants<PackPipeline::PushConst>(*m_packPipeline->pipelineLayout,
+                                                         vk::ShaderStageFlagBits::eCompute, 0, packPushConst);
+    commandBuffer.dispatch((packPushConst.numPixels + PACK_BEAUTY_GROUP_SIZE - 1) / PACK_BEAUTY_GROUP_SIZE, 1, 1);
+
+    // Make sure the packed output is visible to the readback copy:
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+                                  vk::DependencyFlags{},
+                                  vk::MemoryBarrier{.srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+                                                    .dstAccessMask = vk::AccessFlagBits::eTransferRead},
+                                  {}, {});
 }
 
 } // namespace prism
\ No newline at end of file
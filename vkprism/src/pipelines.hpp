@@ -4,11 +4,16 @@
 #pragma once
 
 #include <array>
+#include <optional>
 
 #include <allocator.hpp>
+#include <aov.hpp>
 #include <context.hpp>
+#include <framebuffer.hpp>
+#include <ray_stats.hpp>
 #include <scene.hpp>
 #include <shaders.hpp>
+#include <shaders/raygen.hpp>
 
 #include <vulkan/vulkan.hpp>
 
@@ -18,13 +23,39 @@ struct PipelineParam
 {
     uint32_t outputWidth;
     uint32_t outputHeight;
+
+    // Any AOVs to output along with the beauty buffer:
+    AovSet aovs{};
+
+    // The format the beauty buffer is read back in:
+    BeautyFormat beautyFormat = BeautyFormat::eRGB32F;
+    // When using a packed format, the raygen shader can either write the packed format directly or accumulate in float
+    // and have a compute pass pack the result once tracing is done:
+    bool accumulateInFloat = false;
+
+    // When set, the output buffers only hold a single tile of this size and the output is rendered one tile at a time
+    // (see renderTiled). Device memory then no longer depends on the output resolution:
+    uint32_t tileWidth  = 0;
+    uint32_t tileHeight = 0;
+
+    // Has the shaders count the rays, hits and misses of every launch (see getRayStatsBuffer). The shaders require
+    // subgroup ballot support in the ray tracing stages either way, as the counters are only disabled at runtime:
+    bool enableRayStats = false;
 };
 
 // Any parameters when binding the RTPipeline:
 struct RTPipelineParam
 {
+    // The size of the launch (has to fit in the output buffers):
     uint32_t width;
     uint32_t height;
+
+    // Where the launch is placed in the full output when rendering in tiles:
+    uint32_t offsetX = 0;
+    uint32_t offsetY = 0;
+
+    // The (orthographic) camera looks down +z in camera space:
+    glm::mat4 cameraToWorld = glm::mat4(1.f);
 };
 
 // Function that checks if a pushconstant is valid:
@@ -42,13 +73,26 @@ class Pipelines
   public:
     Pipelines(const PipelineParam& param, const Context& context, const GPUAllocator& gpuAllocator, const Scene& scene);
 
-    // Binds the ray-tracing pipeline (when performing ray-tracing operations):
+    // Binds the ray-tracing pipeline (when performing ray-tracing operations). If the beauty output is packed on the
+    // device this also records the packing pass:
     void addBindRTPipelineCmd(const vk::CommandBuffer& commandBuffer, const RTPipelineParam& param) const;
 
+    // The beauty buffer in the format it's read back in:
     const vk::Buffer& getBeautyBuffer() const
     {
         return *m_buffers.beautyOutput;
     }
+    BeautyFormat getBeautyFormat() const { return m_beautyFormat; }
+
+    // The resolution of the full output and the resolution the output buffers can hold (equal unless tiled):
+    glm::uvec2 getOutputSize() const { return m_outputSize; }
+    glm::uvec2 getBufferSize() const { return m_bufferSize; }
+
+    // Returns a null handle if the AOV wasn't requested:
+    vk::Buffer getAovBuffer(AovType aov) const { return *m_buffers.aovOutputs[aov]; }
+
+    // The RayStats of the last launch (reset by every launch), a null handle if the stats weren't enabled:
+    vk::Buffer getRayStatsBuffer() const { return *m_buffers.rayStats; }
 
   private:
     // Defines a descriptor when given a set of bindings. Note that we only support 1 descriptor set at this moment.
@@ -95,6 +139,15 @@ class Pipelines
     struct Buffers
     {
         UniqueBuffer beautyOutput;
+        // Only allocated if the beauty output is accumulated in float and packed afterwards:
+        UniqueBuffer beautyAccum;
+
+        // Only the requested AOVs are allocated:
+        std::array<UniqueBuffer, TOTAL_NUM_AOVS> aovOutputs;
+        // Only allocated if the ray stats are enabled:
+        UniqueBuffer rayStats;
+        // Bound to every binding whose buffer wasn't allocated (descriptors can't be left empty):
+        UniqueBuffer placeholder;
     };
 
     // All of the descriptors the pipelines will use:
@@ -111,10 +164,7 @@ class Pipelines
 
     struct RTPipeline
     {
-        struct PushConst
-        {
-            std::array<std::byte, 4> data; // placeholder
-        };
+        using PushConst = shader::RaygenPushConst;
         static_assert(isValidPushConstSize<PushConst>(), "PushConst is not a valid size.");
 
         // The pipeline itself:
@@ -127,20 +177,54 @@ class Pipelines
         vk::StridedDeviceAddressRegionKHR hitAddrRegion;
         vk::StridedDeviceAddressRegionKHR callableAddrRegion;
         UniqueBuffer                      sbtBuffer;
+
+        // The scene info and the output buffers (in the order of their set indices):
+        std::array<vk::DescriptorSet, 2> descriptorSets;
+    };
+
+    //
+    // Compute pipeline that packs the float accumulation buffer into the beauty output format:
+
+    struct PackPipeline
+    {
+        struct PushConst
+        {
+            uint32_t numPixels;
+        };
+        static_assert(isValidPushConstSize<PushConst>(), "PushConst is not a valid size.");
+
+        Descriptor               descriptor;
+        vk::UniquePipelineLayout pipelineLayout;
+        vk::UniquePipeline       pipeline;
     };
 
   private:
+    // Whether the beauty output is accumulated in float and packed by the compute pass:
+    static bool packOnDevice(const PipelineParam& param);
+    // The resolution the output buffers are allocated with:
+    static glm::uvec2 bufferSize(const PipelineParam& param);
+
     static Buffers     createBuffers(const PipelineParam& param, const GPUAllocator& gpuAllocator);
     static Descriptors createDescriptors(const Context& context, const Scene& scene, const Buffers& buffers);
 
-    static RTPipeline createRTPipeline(const Context& context, const GPUAllocator& gpuAllocator,
-                                       const Descriptors& descriptors);
+    static RTPipeline createRTPipeline(const PipelineParam& param, const Context& context,
+                                       const GPUAllocator& gpuAllocator, const Descriptors& descriptors);
+    static std::optional<PackPipeline> createPackPipeline(const PipelineParam& param, const Context& context,
+                                                          const Buffers& buffers);
 
   private:
+    BeautyFormat m_beautyFormat;
+    glm::uvec2   m_outputSize;
+    glm::uvec2   m_bufferSize;
+
     Buffers     m_buffers;
     Descriptors m_descriptors;
 
-    RTPipeline m_rtPipeline;
+    RTPipeline                  m_rtPipeline;
+    std::optional<PackPipeline> m_packPipeline;
+
+    // The passes are timed if the context has a profiler (may be null):
+    GpuProfiler* m_gpuProfiler;
 };
 
 } // namespace prism
\ No newline at end of file
@@ -154,7 +154,7 @@ RayTracing::RayTracing(const Context& context, const Param& param, const GPUAllo
                                               vk::BufferUsageFlagBits::eTransferDst |
                                                   vk::BufferUsageFlagBits::eShaderDeviceAddress |
                                                   vk::BufferUsageFlagBits::eShaderBindingTableKHR,
-                                              VMA_MEMORY_USAGE_CPU_TO_GPU);
+                                              VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::eSbt);
 
     // Assign the device addresses:
     const auto sbtAddress = m_sbtBuffer.deviceAddress(context.device());
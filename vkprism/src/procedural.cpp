@@ -0,0 +1,254 @@
+#include "procedural.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include <glm/gtx/transform.hpp>
+
+#include <profiler.hpp>
+#include <util.hpp>
+
+namespace prism {
+
+// Both generators lay the vertices out as a (columns + 1) x (rows + 1) grid:
+static MeshData allocateGridMesh(const uint32_t columns, const uint32_t rows)
+{
+    const uint64_t numVertices = (uint64_t(columns) + 1) * (uint64_t(rows) + 1);
+    if (columns == 0 || rows == 0 || numVertices > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Can't generate a mesh with " + std::to_string(columns) + "x" +
+                                 std::to_string(rows) + " cells, the vertices have to be addressable with 32 bits");
+    }
+
+    MeshData mesh;
+    mesh.positions.resize(numVertices);
+    mesh.faces.resize(2 * uint64_t(columns) * rows);
+    return mesh;
+}
+
+static void generateGridFaces(const uint32_t columns, const uint32_t rows, MeshData& mesh)
+{
+    parallelFor(rows, 64, [&](const size_t begin, const size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            for (uint32_t column = 0; column < columns; ++column) {
+                const uint32_t i    = static_cast<uint32_t>(row * (columns + 1) + column);
+                const size_t   face = 2 * (row * columns + column);
+                mesh.faces[face]     = glm::u32vec3(i, i + 1, i + columns + 1);
+                mesh.faces[face + 1] = glm::u32vec3(i + 1, i + columns + 2, i + columns + 1);
+            }
+        }
+    });
+}
+
+MeshData generateSphere(const uint32_t rings, const uint32_t segments)
+{
+    auto mesh = allocateGridMesh(segments, rings);
+
+    parallelFor(rings + 1, 64, [&](const size_t begin, const size_t end) {
+        for (size_t ring = begin; ring < end; ++ring) {
+            for (uint32_t segment = 0; segment <= segments; ++segment) {
+                const float theta = std::numbers::pi_v<float> * ring / rings;
+                const float phi   = 2.f * std::numbers::pi_v<float> * segment / segments;
+
+                mesh.positions[ring * (segments + 1) + segment] = glm::vec3(
+                    std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+            }
+        }
+    });
+    generateGridFaces(segments, rings, mesh);
+
+    return mesh;
+}
+
+MeshData generateGrid(const uint32_t columns, const uint32_t rows)
+{
+    auto mesh = allocateGridMesh(columns, rows);
+
+    parallelFor(rows + 1, 64, [&](const size_t begin, const size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            for (uint32_t column = 0; column <= columns; ++column) {
+                mesh.positions[row * (columns + 1) + column] =
+                    glm::vec3(-1.f + 2.f * column / columns, -1.f + 2.f * row / rows, 0.f);
+            }
+        }
+    });
+    generateGridFaces(columns, rows, mesh);
+
+    return mesh;
+}
+
+MeshData generateMesh(const ProceduralShape shape, const uint64_t numTriangles)
+{
+    PRISM_PROFILE_SCOPE("procedural/mesh");
+
+    if (numTriangles == 0) {
+        throw std::runtime_error("A generated mesh needs at least one triangle");
+    }
+
+    if (shape == ProceduralShape::eSphere) {
+        // 2 * rings * (2 * rings) triangles:
+        const auto rings = static_cast<uint32_t>(std::max(2.0, std::round(std::sqrt(numTriangles / 4.0))));
+        return generateSphere(rings, 2 * rings);
+    }
+
+    // As square as possible, the triangles of the last row that aren't needed are dropped (their vertices are still
+    // there, which doesn't matter for anything that only goes through the faces):
+    const uint64_t numCells = (numTriangles + 1) / 2;
+    const auto     columns  = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(numCells))));
+    const auto     rows     = static_cast<uint32_t>((numCells + columns - 1) / columns);
+
+    auto mesh = generateGrid(columns, rows);
+    mesh.faces.resize(numTriangles);
+    return mesh;
+}
+
+void writePly(const std::filesystem::path& path, const MeshData& mesh, const bool binary)
+{
+    static_assert(std::endian::native == std::endian::little, "The binary PLY files are written as little endian");
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open the PLY file at: " + path.string());
+    }
+
+    file << "ply\n"
+         << (binary ? "format binary_little_endian 1.0\n" : "format ascii 1.0\n")
+         << "element vertex " << mesh.positions.size() << "\n"
+         << "property float x\nproperty float y\nproperty float z\n"
+         << "element face " << mesh.faces.size() << "\n"
+         << "property list uchar int vertex_indices\n"
+         << "end_header\n";
+
+    if (binary) {
+        file.write(reinterpret_cast<const char*>(mesh.positions.data()), mesh.positions.size() * sizeof(glm::vec3));
+
+        // Every face is the number of indices followed by the indices. Written in blocks, so that huge meshes don't
+        // need a second copy of the faces:
+        constexpr size_t FACE_SIZE   = 1 + sizeof(glm::u32vec3);
+        constexpr size_t BLOCK_FACES = 1 << 16;
+
+        std::vector<char> block(BLOCK_FACES * FACE_SIZE);
+        for (size_t first = 0; first < mesh.faces.size(); first += BLOCK_FACES) {
+            const size_t numFaces = std::min(BLOCK_FACES, mesh.faces.size() - first);
+            for (size_t i = 0; i < numFaces; ++i) {
+                char* const face = block.data() + i * FACE_SIZE;
+                face[0]          = 3;
+                std::memcpy(face + 1, &mesh.faces[first + i], sizeof(glm::u32vec3));
+            }
+            file.write(block.data(), numFaces * FACE_SIZE);
+        }
+    } else {
+        file << std::setprecision(std::numeric_limits<float>::max_digits10);
+        for (const auto& pos : mesh.positions) {
+            file << pos.x << " " << pos.y << " " << pos.z << "\n";
+        }
+        for (const auto& face : mesh.faces) {
+            file << "3 " << face.x << " " << face.y << " " << face.z << "\n";
+        }
+    }
+
+    if (!file) {
+        throw std::runtime_error("Failed to write the PLY file at: " + path.string());
+    }
+}
+
+ProceduralSceneInfo createProceduralScene(SceneBuilder& sceneBuilder, const ProceduralSceneParam& param)
+{
+    if (param.numMeshes == 0 || param.numMeshGroups == 0 || param.meshesPerGroup == 0) {
+        throw std::runtime_error("A procedural scene needs at least one mesh, mesh group and mesh per group");
+    }
+
+    const auto mesh = generateMesh(param.shape, param.numTriangles);
+    if (param.plyPath) {
+        writePly(*param.plyPath, mesh);
+    }
+
+    // The copies are the point of the scene (every one of them gets its own BLAS), so they mustn't be deduplicated:
+    const bool deduplication = sceneBuilder.deduplication();
+    sceneBuilder.setDeduplication(false);
+
+    std::vector<MeshIndex> meshIndices;
+    meshIndices.reserve(param.numMeshes);
+    for (uint32_t i = 0; i < param.numMeshes; ++i) {
+        meshIndices.push_back(sceneBuilder.createMesh(mesh.positions, mesh.faces));
+    }
+
+    //
+    // The meshes of a group are placed next to each other along x (scaled down so that the group still fits in the
+    // bounds of a single mesh):
+
+    std::vector<TransformIndex> placements(param.meshesPerGroup, TransformIndex::none());
+    if (param.meshesPerGroup > 1) {
+        const float scale = 1.f / param.meshesPerGroup;
+        for (uint32_t i = 0; i < param.meshesPerGroup; ++i) {
+            const float offset = -1.f + (2 * i + 1) * scale;
+            placements[i]      = sceneBuilder.createTransform(
+                Transform(glm::translate(glm::vec3(offset, 0.f, 0.f)) * glm::scale(glm::vec3(scale))));
+        }
+    }
+
+    std::vector<MeshGroupIndex> meshGroupIndices;
+    meshGroupIndices.reserve(param.numMeshGroups);
+
+    std::vector<PlacedMesh> placedMeshes;
+    for (uint64_t group = 0; group < param.numMeshGroups; ++group) {
+        placedMeshes.clear();
+        for (uint32_t i = 0; i < param.meshesPerGroup; ++i) {
+            const auto meshIdx = meshIndices[(group * param.meshesPerGroup + i) % param.numMeshes];
+            placedMeshes.push_back(PlacedMesh{.meshIdx = meshIdx, .transformIdx = placements[i]});
+        }
+        meshGroupIndices.push_back(sceneBuilder.createMeshGroup(placedMeshes));
+    }
+    sceneBuilder.setDeduplication(deduplication);
+
+    //
+    // Instances:
+
+    // The layouts fill a cube centered at the origin:
+    constexpr float SPACING   = 3.f;
+    const auto      cubeSize  = static_cast<uint64_t>(std::ceil(std::cbrt(static_cast<double>(param.numInstances))));
+    const float     cubeWidth = SPACING * cubeSize;
+
+    std::mt19937                          rng(param.seed);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    for (uint64_t i = 0; i < param.numInstances; ++i) {
+        glm::mat4 transform;
+        if (param.layout == InstanceLayout::eGrid) {
+            const glm::vec3 cell(static_cast<float>(i % cubeSize), static_cast<float>((i / cubeSize) % cubeSize),
+                                 static_cast<float>(i / (cubeSize * cubeSize)));
+            transform = glm::translate(SPACING * (cell + 0.5f) - 0.5f * cubeWidth);
+        } else {
+            const glm::vec3 pos(uniform(rng), uniform(rng), uniform(rng));
+            const glm::vec3 axis(2.f * uniform(rng) - 1.f, 2.f * uniform(rng) - 1.f, 1.f);
+            const float     angle = 2.f * std::numbers::pi_v<float> * uniform(rng);
+            transform = glm::translate(cubeWidth * (pos - 0.5f)) * glm::rotate(angle, glm::normalize(axis));
+        }
+
+        sceneBuilder.createInstance(Instance{
+            .customId     = static_cast<uint32_t>(i),
+            .mask         = 1,
+            .hitGroupId   = 1,
+            .meshGroupIdx = meshGroupIndices[i % param.numMeshGroups],
+            .transform    = Transform(param.sceneTransform * transform),
+        });
+    }
+
+    const uint64_t numTrianglesPerMesh = mesh.faces.size();
+    return ProceduralSceneInfo{
+        .numTrianglesPerMesh   = numTrianglesPerMesh,
+        .numUniqueTriangles    = numTrianglesPerMesh * param.numMeshes,
+        .numInstancedTriangles = numTrianglesPerMesh * param.meshesPerGroup * param.numInstances,
+    };
+}
+
+} // namespace prism
\ No newline at end of file
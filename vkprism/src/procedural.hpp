@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <scene.hpp>
+
+namespace prism {
+
+// Meshes and scenes generated in code, so that the renderer can be tested at any scale without having to find assets
+// of the right size.
+
+struct MeshData
+{
+    std::vector<glm::vec3>    positions;
+    std::vector<glm::u32vec3> faces;
+};
+
+enum class ProceduralShape
+{
+    eSphere, // UV sphere with a radius of 1 around the origin
+    eGrid,   // A 2x2 square in the xy plane around the origin
+};
+
+enum class InstanceLayout
+{
+    eGrid,   // A cube of instances with a spacing of 3 (so that neighbouring spheres don't touch)
+    eRandom, // Random positions and rotations with roughly the same density as the grid
+};
+
+// The triangles at the poles are degenerate (they are still part of the mesh, so that the number of triangles is easy
+// to predict: 2 * rings * segments).
+MeshData generateSphere(uint32_t rings, uint32_t segments);
+// Two triangles for every cell:
+MeshData generateGrid(uint32_t columns, uint32_t rows);
+
+// Grids have exactly numTriangles triangles, spheres have the closest number that fits (with twice as many segments as
+// rings) but at least 16:
+MeshData generateMesh(ProceduralShape shape, uint64_t numTriangles);
+
+// Only writes the positions and faces:
+void writePly(const std::filesystem::path& path, const MeshData& mesh, bool binary = true);
+
+struct ProceduralSceneParam
+{
+    ProceduralShape shape        = ProceduralShape::eSphere;
+    uint64_t        numTriangles = 1 << 16; // Of every mesh
+
+    // Every mesh is a separate copy of the same tessellation (so it gets its own BLAS). The mesh groups place
+    // meshesPerGroup of them (going through them round robin) and the instances go through the groups in the same way:
+    uint32_t numMeshes      = 1;
+    uint32_t numMeshGroups  = 1;
+    uint32_t meshesPerGroup = 1;
+    uint64_t numInstances   = 1;
+
+    InstanceLayout layout = InstanceLayout::eGrid;
+    uint32_t       seed   = 42; // For the random layout
+
+    // Applied on top of the layout (e.g. to fit the whole scene into the view of a camera):
+    glm::mat4 sceneTransform = glm::mat4(1.f);
+
+    // If set, the tessellation is also written to this path as a binary PLY file:
+    std::optional<std::filesystem::path> plyPath;
+};
+
+struct ProceduralSceneInfo
+{
+    uint64_t numTrianglesPerMesh;
+    uint64_t numUniqueTriangles;    // Summed over the meshes
+    uint64_t numInstancedTriangles; // Summed over the instances
+};
+
+// Adds the meshes, mesh groups and instances to the scene builder (without deduplicating them):
+ProceduralSceneInfo createProceduralScene(SceneBuilder& sceneBuilder, const ProceduralSceneParam& param);
+
+} // namespace prism
\ No newline at end of file
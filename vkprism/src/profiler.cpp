@@ -0,0 +1,200 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+#include <spdlog/spdlog.h>
+
+#include <util.hpp>
+
+namespace prism {
+
+static const auto g_profilerEpoch = std::chrono::steady_clock::now();
+
+// Small thread indices (instead of the OS ids) keep the trace readable:
+static uint32_t threadIdx()
+{
+    static std::atomic<uint32_t> nextIdx = 0;
+    static thread_local uint32_t idx     = nextIdx.fetch_add(1, std::memory_order_relaxed);
+    return idx;
+}
+
+Profiler::Profiler(const uint32_t maxFrames) : m_maxFrames(std::max(maxFrames, 1u)) { m_frames.emplace_back(); }
+
+int64_t Profiler::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_profilerEpoch)
+        .count();
+}
+
+uint64_t Profiler::frame() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_firstFrame + m_frames.size() - 1;
+}
+
+void Profiler::newFrame()
+{
+    collect();
+
+    std::lock_guard lock(m_mutex);
+    m_frames.emplace_back();
+    while (m_frames.size() > m_maxFrames) {
+        m_frames.pop_front();
+        ++m_firstFrame;
+    }
+}
+
+void Profiler::record(const ProfileEvent& event)
+{
+    std::lock_guard lock(m_mutex);
+    // GPU events usually arrive a frame (or more) after they were recorded:
+    if (event.frame < m_firstFrame) {
+        return;
+    }
+    const uint64_t frameIdx = std::min<uint64_t>(event.frame - m_firstFrame, m_frames.size() - 1);
+    m_frames[frameIdx].push_back(event);
+}
+
+void Profiler::recordCpu(const char* name, const int64_t startNs, const int64_t endNs)
+{
+    std::lock_guard lock(m_mutex);
+    m_frames.back().push_back(ProfileEvent{
+        .name       = name,
+        .track      = ProfileTrack::eCpu,
+        .threadIdx  = threadIdx(),
+        .frame      = m_firstFrame + m_frames.size() - 1,
+        .startNs    = startNs,
+        .durationNs = endNs - startNs,
+    });
+}
+
+uint64_t Profiler::addCollectFn(CollectFn collectFn)
+{
+    std::lock_guard lock(m_collectMutex);
+    m_collectFns.emplace_back(m_nextCollectId, std::move(collectFn));
+    return m_nextCollectId++;
+}
+
+void Profiler::removeCollectFn(const uint64_t id)
+{
+    std::lock_guard lock(m_collectMutex);
+    std::erase_if(m_collectFns, [id](const auto& collectFn) { return collectFn.first == id; });
+}
+
+void Profiler::collect()
+{
+    // The collect functions record events, so they can't be called while holding m_mutex:
+    std::lock_guard lock(m_collectMutex);
+    for (const auto& [id, collectFn] : m_collectFns) {
+        collectFn();
+    }
+}
+
+std::vector<ProfileEvent> Profiler::events()
+{
+    collect();
+
+    std::lock_guard           lock(m_mutex);
+    std::vector<ProfileEvent> events;
+    for (const auto& frameEvents : m_frames) {
+        events.insert(events.end(), frameEvents.begin(), frameEvents.end());
+    }
+    return events;
+}
+
+std::vector<ProfileSummary> Profiler::summary()
+{
+    // The names are string literals, but the same literal may have different addresses in different translation
+    // units, so they are grouped by their contents:
+    std::map<std::tuple<ProfileTrack, std::string>, ProfileSummary> groups;
+    for (const auto& event : events()) {
+        const double ms = event.durationNs * 1e-6;
+
+        auto [it, inserted] = groups.try_emplace(std::make_tuple(event.track, std::string(event.name)),
+                                                 ProfileSummary{
+                                                     .name    = event.name,
+                                                     .track   = event.track,
+                                                     .count   = 0,
+                                                     .totalMs = 0.0,
+                                                     .meanMs  = 0.0,
+                                                     .minMs   = ms,
+                                                     .maxMs   = ms,
+                                                 });
+        auto& summary = it->second;
+        summary.count += 1;
+        summary.totalMs += ms;
+        summary.minMs = std::min(summary.minMs, ms);
+        summary.maxMs = std::max(summary.maxMs, ms);
+    }
+
+    std::vector<ProfileSummary> summaries;
+    summaries.reserve(groups.size());
+    for (auto& [key, summary] : groups) {
+        summary.meanMs = summary.totalMs / summary.count;
+        summaries.push_back(summary);
+    }
+    std::sort(summaries.begin(), summaries.end(),
+              [](const ProfileSummary& a, const ProfileSummary& b) { return a.totalMs > b.totalMs; });
+
+    return summaries;
+}
+
+void Profiler::logSummary()
+{
+    const auto summaries = summary();
+    if (summaries.empty()) {
+        return;
+    }
+
+    spdlog::info("{:<4} {:<32} {:>8} {:>12} {:>10} {:>10} {:>10}", "", "scope", "count", "total (ms)", "mean (ms)",
+                 "min (ms)", "max (ms)");
+    for (const auto& summary : summaries) {
+        spdlog::info("{:<4} {:<32} {:>8} {:>12.3f} {:>10.3f} {:>10.3f} {:>10.3f}",
+                     summary.track == ProfileTrack::eCpu ? "cpu" : "gpu", summary.name, summary.count, summary.totalMs,
+                     summary.meanMs, summary.minMs, summary.maxMs);
+    }
+}
+
+void Profiler::writeChromeTrace(const std::filesystem::path& path)
+{
+    const auto events = this->events();
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open the trace file at: " + path.string());
+    }
+
+    // The CPU and the GPU are shown as separate processes:
+    file << "{\"traceEvents\":[\n"
+         << R"({"name":"process_name","ph":"M","pid":0,"tid":0,"args":{"name":"CPU"}},)" << "\n"
+         << R"({"name":"process_name","ph":"M","pid":1,"tid":0,"args":{"name":"GPU"}})";
+
+    file.precision(3);
+    file << std::fixed;
+    for (const auto& event : events) {
+        // Timestamps and durations are in microseconds:
+        file << ",\n{\"name\":" << jsonEscape(event.name) << ",\"ph\":\"X\""
+             << ",\"pid\":" << (event.track == ProfileTrack::eCpu ? 0 : 1) << ",\"tid\":" << event.threadIdx
+             << ",\"ts\":" << event.startNs * 1e-3 << ",\"dur\":" << event.durationNs * 1e-3
+             << ",\"args\":{\"frame\":" << event.frame << "}}";
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    if (!file) {
+        throw std::runtime_error("Failed to write the trace file at: " + path.string());
+    }
+}
+
+Profiler& profiler()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace prism {
+
+// Collects named CPU and GPU time ranges, grouped by frame. Only the last few frames are kept, so the profiler can be
+// left running for as long as the renderer does. The scopes are added through the PRISM_PROFILE_* macros, which
+// compile to nothing unless PRISM_ENABLE_PROFILING is defined (so the profiler costs nothing in builds without it).
+
+enum class ProfileTrack
+{
+    eCpu,
+    eGpu,
+};
+
+struct ProfileEvent
+{
+    const char*  name; // Has to outlive the profiler (all scopes use string literals)
+    ProfileTrack track;
+    uint32_t     threadIdx; // Small index of the recording thread (always 0 for the GPU)
+    uint64_t     frame;
+    int64_t      startNs; // Relative to the start of the program
+    int64_t      durationNs;
+};
+
+struct ProfileSummary
+{
+    const char*  name;
+    ProfileTrack track;
+    uint64_t     count;
+    double       totalMs;
+    double       meanMs;
+    double       minMs;
+    double       maxMs;
+};
+
+class Profiler
+{
+  public:
+    // Called before the events are read, so that the pending GPU timestamps can be turned into events:
+    using CollectFn = std::function<void()>;
+
+    explicit Profiler(uint32_t maxFrames = 64);
+
+    // Nanoseconds since the start of the program (the clock of every event):
+    int64_t now() const;
+
+    uint64_t frame() const;
+    // Ends the current frame (dropping the oldest frame once there are more than maxFrames):
+    void newFrame();
+
+    // Events of frames that already have been dropped are ignored:
+    void record(const ProfileEvent& event);
+    // Records an event of the current frame on the calling thread:
+    void recordCpu(const char* name, int64_t startNs, int64_t endNs);
+
+    // The returned id is used to remove the collect function again:
+    uint64_t addCollectFn(CollectFn collectFn);
+    void     removeCollectFn(uint64_t id);
+
+    // Every event of the frames in the ring (oldest first):
+    std::vector<ProfileEvent> events();
+
+    // Grouped by track and name, sorted by the total time:
+    std::vector<ProfileSummary> summary();
+    void                        logSummary();
+
+    // Writes the events in the Chrome trace event format (can be opened with chrome://tracing or Perfetto):
+    void writeChromeTrace(const std::filesystem::path& path);
+
+  private:
+    void collect();
+
+  private:
+    uint32_t m_maxFrames;
+
+    mutable std::mutex                    m_mutex;
+    uint64_t                              m_firstFrame = 0; // Frame of m_frames.front()
+    std::deque<std::vector<ProfileEvent>> m_frames;
+
+    std::mutex                                  m_collectMutex;
+    uint64_t                                    m_nextCollectId = 0;
+    std::vector<std::pair<uint64_t, CollectFn>> m_collectFns;
+};
+
+// The profiler that the macros record to:
+Profiler& profiler();
+
+// Records the time between its construction and destruction:
+class CpuProfileScope
+{
+  public:
+    explicit CpuProfileScope(const char* name) : m_name(name), m_startNs(profiler().now()) {}
+    CpuProfileScope(const CpuProfileScope&) = delete;
+    ~CpuProfileScope() { profiler().recordCpu(m_name, m_startNs, profiler().now()); }
+
+  private:
+    const char* m_name;
+    int64_t     m_startNs;
+};
+
+// Can't be turned off at runtime, only by compiling without PRISM_ENABLE_PROFILING:
+#ifdef PRISM_ENABLE_PROFILING
+constexpr bool PROFILING_ENABLED = true;
+#else
+constexpr bool PROFILING_ENABLED = false;
+#endif
+
+} // namespace prism
+
+#define PRISM_PROFILE_CONCAT_IMPL(a, b) a##b
+#define PRISM_PROFILE_CONCAT(a, b)      PRISM_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef PRISM_ENABLE_PROFILING
+#define PRISM_PROFILE_SCOPE(name) const ::prism::CpuProfileScope PRISM_PROFILE_CONCAT(prismProfileScope, __LINE__)(name)
+#else
+#define PRISM_PROFILE_SCOPE(name) ((void)0)
+#endif
\ No newline at end of file
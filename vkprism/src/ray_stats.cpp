@@ -0,0 +1,51 @@
+#include "ray_stats.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+namespace prism {
+
+RayStats readRayStats(const std::span<const std::byte> data)
+{
+    if (data.size() < sizeof(RayStats)) {
+        throw std::runtime_error("The ray stats buffer holds " + std::to_string(data.size()) + " bytes, expected " +
+                                 std::to_string(sizeof(RayStats)) + ".");
+    }
+
+    RayStats stats;
+    std::memcpy(&stats, data.data(), sizeof(RayStats));
+    return stats;
+}
+
+double mraysPerSecond(const RayStats& stats, const double milliseconds)
+{
+    return milliseconds > 0.0 ? stats.raysTraced / (milliseconds * 1e3) : 0.0;
+}
+
+double laneUtilization(const RayStats& stats)
+{
+    return stats.laneSlots > 0 ? static_cast<double>(stats.activeLanes) / stats.laneSlots : 0.0;
+}
+
+void logRayStats(const RayStats& stats, const double milliseconds)
+{
+    spdlog::info("Traced {} rays in {:.3f} ms ({:.1f} Mrays/s): {} hits, {} misses, {:.1f}% of the lanes active",
+                 stats.raysTraced, milliseconds, mraysPerSecond(stats, milliseconds), stats.hits, stats.misses,
+                 100.0 * laneUtilization(stats));
+
+    std::string histogram;
+    for (uint32_t i = 0; i < RAY_STATS_MAX_DEPTH; ++i) {
+        if (stats.pathDepths[i] > 0) {
+            histogram += (histogram.empty() ? "" : ", ") + std::to_string(i + 1) +
+                         (i + 1 == RAY_STATS_MAX_DEPTH ? "+: " : ": ") + std::to_string(stats.pathDepths[i]);
+        }
+    }
+    if (!histogram.empty()) {
+        spdlog::info("Path depths (segments: paths): {}", histogram);
+    }
+}
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+#include <shaders/stats.hpp>
+
+namespace prism {
+
+// The counters the shaders write when PipelineParam::enableRayStats is set (see shaders/stats.glsl):
+using RayStats = shader::RayStats;
+
+// Reads the counters of a stats buffer that was read back from the device:
+RayStats readRayStats(std::span<const std::byte> data);
+
+// Millions of rays per second, given the time it took to trace them:
+double mraysPerSecond(const RayStats& stats, double milliseconds);
+// The fraction of the raygen subgroup lanes that were active (in [0, 1]):
+double laneUtilization(const RayStats& stats);
+
+// Logs every counter along with the throughput:
+void logRayStats(const RayStats& stats, double milliseconds);
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "readback.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include <gpu_profiler.hpp>
+
+namespace prism {
+
+vk::UniqueCommandPool Readback::createCommandPool(const Context& context)
+{
+    // The command buffers are reused every time their slot comes around again:
+    return context.device().createCommandPoolUnique(vk::CommandPoolCreateInfo{
+        .flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+        .queueFamilyIndex = context.queueFamilyIndex(),
+    });
+}
+
+std::vector<Readback::Slot> Readback::createSlots(const Context& context, const GPUAllocator& gpuAllocator,
+                                                  const vk::CommandPool&          commandPool,
+                                                  std::span<const vk::DeviceSize> bufferSizes, uint32_t ringSize)
+{
+    if (ringSize == 0) {
+        throw std::runtime_error("Readback requires at least one slot.");
+    }
+
+    auto commandBuffers = context.device().allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{
+        .commandPool        = commandPool,
+        .level              = vk::CommandBufferLevel::ePrimary,
+        .commandBufferCount = ringSize,
+    });
+
+    std::vector<Slot> slots(ringSize);
+    for (uint32_t i = 0; i < ringSize; ++i) {
+        auto& slot = slots[i];
+
+        slot.pending       = std::make_unique<TaskGroup>();
+        slot.commandBuffer = std::move(commandBuffers[i]);
+        // Start signaled so that the first submission doesn't have to special case anything:
+        slot.fence = context.device().createFenceUnique(vk::FenceCreateInfo{
+            .flags = vk::FenceCreateFlagBits::eSignaled,
+        });
+
+        // GPU_TO_CPU prefers cached memory, which makes reading it back a lot faster (at the cost of having to
+        // invalidate it on some hardware):
+        for (const auto size : bufferSizes) {
+            auto buffer = gpuAllocator.allocateBuffer(size, vk::BufferUsageFlagBits::eTransferDst,
+                                                      VMA_MEMORY_USAGE_GPU_TO_CPU, MemoryCategory::eReadback);
+            slot.mappedData.emplace_back(buffer.map<const std::byte>(), size);
+            slot.buffers.push_back(std::move(buffer));
+        }
+    }
+
+    return slots;
+}
+
+void Readback::waitOnSlot(Slot& slot)
+{
+    try {
+        slot.pending->wait();
+    } catch (...) {
+        // A throwing task cancels its group for good, the slot gets a new one so that it can still be used afterwards:
+        slot.pending = std::make_unique<TaskGroup>();
+        throw;
+    }
+}
+
+Readback::Readback(const Context& context, const GPUAllocator& gpuAllocator,
+                   std::span<const vk::DeviceSize> bufferSizes, uint32_t ringSize) :
+    m_context(context),
+    m_bufferSizes(bufferSizes.begin(), bufferSizes.end()),
+    m_commandPool(createCommandPool(context)),
+    m_slots(createSlots(context, gpuAllocator, *m_commandPool, bufferSizes, ringSize))
+{}
+
+Readback::~Readback()
+{
+    // The device may still be copying into the buffers and the callbacks may still be reading them, so everything has
+    // to finish before we can unmap anything. Destroying the groups waits on them (any errors that weren't waited on
+    // are dropped):
+    for (auto& slot : m_slots) {
+        slot.pending.reset();
+        if (m_context.device().waitForFences(*slot.fence, VK_TRUE, FENCE_TIMEOUT) == vk::Result::eTimeout) {
+            continue;
+        }
+
+        for (const auto& buffer : slot.buffers) {
+            buffer.unmap();
+        }
+    }
+}
+
+void Readback::submit(const RecordFn& recordFn, std::span<const vk::Buffer> srcBuffers, Callback callback)
+{
+    if (srcBuffers.size() != m_bufferSizes.size()) {
+        throw std::runtime_error("Readback expected " + std::to_string(m_bufferSizes.size()) + " source buffers, got " +
+                                 std::to_string(srcBuffers.size()) + ".");
+    }
+
+    auto& slot = m_slots[m_nextSlot];
+    m_nextSlot = (m_nextSlot + 1) % m_slots.size();
+
+    // The host has to be done with the previous contents of this slot before we overwrite it:
+    waitOnSlot(slot);
+
+    const auto& device = m_context.device();
+
+    const auto& commandBuffer = *slot.commandBuffer;
+    commandBuffer.reset();
+    commandBuffer.begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+    recordFn(commandBuffer);
+
+    //
+    // Copy everything to the host once the work has finished:
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eRayTracingShaderKHR | vk::PipelineStageFlagBits::eComputeShader |
+            vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags{},
+        vk::MemoryBarrier{.srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite,
+                          .dstAccessMask = vk::AccessFlagBits::eTransferRead},
+        {}, {});
+
+    {
+        PRISM_PROFILE_GPU_SCOPE(m_context.gpuProfiler(), commandBuffer, "readback/copy");
+        for (size_t i = 0; i < srcBuffers.size(); ++i) {
+            commandBuffer.copyBuffer(srcBuffers[i], *slot.buffers[i], vk::BufferCopy{.size = m_bufferSizes[i]});
+        }
+    }
+
+    // The next submission will write to the same source buffers, so it can't start before the copies have read them.
+    // The host read is made available by the fence:
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eRayTracingShaderKHR | vk::PipelineStageFlagBits::eComputeShader |
+            vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags{}, {}, {}, {});
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags{},
+        vk::MemoryBarrier{.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                          .dstAccessMask = vk::AccessFlagBits::eHostRead},
+        {}, {});
+
+    commandBuffer.end();
+
+    // Only reset once everything was recorded, so a throwing recordFn doesn't leave the fence unsignaled:
+    device.resetFences(*slot.fence);
+    m_context.queue().submit(
+        vk::SubmitInfo{
+            .commandBufferCount = 1,
+            .pCommandBuffers    = &commandBuffer,
+        },
+        *slot.fence);
+
+    //
+    // Wait on the fence and process the data in a task:
+
+    slot.pending->run([&device, &slot, callback = std::move(callback)]() {
+        if (device.waitForFences(*slot.fence, VK_TRUE, FENCE_TIMEOUT) == vk::Result::eTimeout) {
+            throw std::runtime_error("Fence timed out waiting on readback.");
+        }
+
+        for (const auto& buffer : slot.buffers) {
+            buffer.invalidate();
+        }
+
+        if (callback) {
+            PRISM_PROFILE_SCOPE("readback/callback");
+            callback(slot.mappedData);
+        }
+    });
+}
+
+void Readback::wait()
+{
+    // Every slot is waited on before rethrowing, so that nothing is still running when the caller handles the error:
+    std::exception_ptr exception;
+    for (auto& slot : m_slots) {
+        try {
+            waitOnSlot(slot);
+        } catch (...) {
+            if (!exception) {
+                exception = std::current_exception();
+            }
+        }
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include <allocator.hpp>
+#include <context.hpp>
+#include <task_system.hpp>
+
+namespace prism {
+
+// Copies device buffers back to the host without stalling the render loop. The readback buffers are kept in a ring of
+// slots (double buffered by default) that are persistently mapped. Each submission records the work (i.e. the trace)
+// followed by the copies into a single command buffer, so the host can process pass N while the device renders N+1.
+class Readback
+{
+  public:
+    // Called from a task of the task system once the copies have finished, with one span per source buffer (in the same
+    // order as they were passed to submit). The spans are only valid until the callback returns.
+    using Callback = std::function<void(std::span<const std::span<const std::byte>> data)>;
+    // Records the commands that produce the data (the copies are added after it):
+    using RecordFn = std::function<void(const vk::CommandBuffer& commandBuffer)>;
+
+    // The size of every buffer that will be read back, the source buffers passed to submit must match these:
+    Readback(const Context& context, const GPUAllocator& gpuAllocator, std::span<const vk::DeviceSize> bufferSizes,
+             uint32_t ringSize = 2);
+    Readback(const Readback&) = delete;
+    Readback(Readback&&)      = delete;
+    ~Readback();
+
+    // Waits for the next slot in the ring to become available (only blocks if the host has fallen behind by more than
+    // ringSize submissions), then submits the work and the copies. Any exception thrown by the callback (or a timeout)
+    // is rethrown by wait, or by the submit that reuses its slot.
+    void submit(const RecordFn& recordFn, std::span<const vk::Buffer> srcBuffers, Callback callback);
+
+    // Waits for every pending submission (and its callback) to finish, then rethrows the first exception any of them
+    // threw:
+    void wait();
+
+  private:
+    struct Slot
+    {
+        vk::UniqueCommandBuffer commandBuffer;
+        vk::UniqueFence         fence;
+
+        std::vector<UniqueBuffer>               buffers;
+        std::vector<std::span<const std::byte>> mappedData;
+
+        // Waits on the fence and runs the callback (a group per slot, so that a slot can be reused while the others
+        // are still pending):
+        std::unique_ptr<TaskGroup> pending;
+    };
+
+  private:
+    static vk::UniqueCommandPool createCommandPool(const Context& context);
+    static std::vector<Slot>     createSlots(const Context& context, const GPUAllocator& gpuAllocator,
+                                             const vk::CommandPool& commandPool,
+                                             std::span<const vk::DeviceSize> bufferSizes, uint32_t ringSize);
+    static void                  waitOnSlot(Slot& slot);
+
+  private:
+    const Context& m_context;
+
+    std::vector<vk::DeviceSize> m_bufferSizes;
+    vk::UniqueCommandPool       m_commandPool;
+    std::vector<Slot>           m_slots;
+    uint32_t                    m_nextSlot = 0;
+};
+
+} // namespace prism
\ No newline at end of file
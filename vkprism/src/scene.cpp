@@ -1,17 +1,30 @@
 #include "scene.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <format>
+#include <limits>
 #include <ranges>
 #include <span>
 #include <string>
+#include <tuple>
 #include <vector>
 
+#include <glm/common.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <miniply.h>
 
 #include <context.hpp>
+#include <gpu_profiler.hpp>
+#include <hash.hpp>
+#include <mesh_order.hpp>
+#include <profiler.hpp>
+#include <shaders/scene.hpp>
 #include <util.hpp>
+#include <vertex_encoding.hpp>
 
 namespace prism {
 
@@ -21,8 +34,106 @@ namespace prism {
 
 void SceneBuilder::addCamera(std::unique_ptr<Camera> camera) { m_camera = std::move(camera); }
 
-MeshIndex SceneBuilder::createMesh(const std::string_view filePath)
+// The contents of a PLY file before they are added to the scene builder:
+struct SceneBuilder::LoadedMesh
+{
+    uint32_t                        numVertices, numFaces;
+    std::unique_ptr<glm::vec3[]>    pos, nrm, tan;
+    std::unique_ptr<glm::vec2[]>    uvs;
+    std::unique_ptr<glm::u32vec3[]> faces;
+
+    uint64_t hash; // Of everything above (see hashMesh)
+};
+
+// Throws if a polygon has a vertex index out of range. Every polygon is checked before being split (miniply silently
+// skips polygons with invalid indices, which would leave their triangles undefined), as are meshes that are loaded
+// already triangulated:
+static void checkPolygonIndices(const size_t polygonIdx, const int32_t* polygon, const uint32_t count,
+                                const size_t numVertices)
+{
+    for (uint32_t j = 0; j < count; ++j) {
+        if (polygon[j] < 0 || static_cast<size_t>(polygon[j]) >= numVertices) {
+            throw std::runtime_error("Polygon " + std::to_string(polygonIdx) + " has a vertex index out of range");
+        }
+    }
+}
+
+// Splits polygons into triangles, the polygons are given by their number of vertices and their concatenated indices.
+// Triangles and quads are split directly, larger polygons are ear clipped by miniply (which needs the positions).
+// Polygons with less than 3 vertices are skipped. Large meshes are split in parallel:
+static std::pair<std::unique_ptr<glm::u32vec3[]>, uint32_t>
+triangulatePolygons(const std::span<const uint32_t> counts, const std::span<const int32_t> indices,
+                    const std::span<const glm::vec3> positions)
+{
+    PRISM_PROFILE_SCOPE("scene/triangulate");
+
+    constexpr size_t MIN_RANGE_SIZE = size_t(1) << 14; // Polygons
+
+    // Quads don't need any offsets, which is what most of the meshes that aren't already triangulated consist of:
+    const bool allQuads = std::ranges::all_of(counts, [](const uint32_t count) { return count == 4; });
+    if (allQuads) {
+        if (2 * uint64_t(counts.size()) > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Can't triangulate " + std::to_string(counts.size()) +
+                                     " quads, that's more than 2^32 triangles");
+        }
+
+        const auto                      numTriangles = static_cast<uint32_t>(2 * counts.size());
+        std::unique_ptr<glm::u32vec3[]> triangles(new glm::u32vec3[numTriangles]);
+        parallelFor(counts.size(), MIN_RANGE_SIZE, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const int32_t* quad = indices.data() + 4 * i;
+                checkPolygonIndices(i, quad, 4, positions.size());
+                triangles[2 * i]     = glm::u32vec3(quad[0], quad[1], quad[3]);
+                triangles[2 * i + 1] = glm::u32vec3(quad[2], quad[3], quad[1]);
+            }
+        });
+        return {std::move(triangles), numTriangles};
+    }
+
+    //
+    // Where the indices of every polygon start and where its triangles go:
+
+    std::vector<uint64_t> indicesOffsets(counts.size()), trianglesOffsets(counts.size());
+    uint64_t              numIndices = 0, numTriangles = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        indicesOffsets[i]   = numIndices;
+        trianglesOffsets[i] = numTriangles;
+        numIndices += counts[i];
+        numTriangles += counts[i] >= 3 ? counts[i] - 2 : 0;
+    }
+
+    if (numTriangles > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Can't triangulate " + std::to_string(counts.size()) + " polygons into " +
+                                 std::to_string(numTriangles) + " triangles, that's more than 2^32");
+    }
+
+    std::unique_ptr<glm::u32vec3[]> triangles(new glm::u32vec3[numTriangles]);
+    parallelFor(counts.size(), MIN_RANGE_SIZE, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t count   = counts[i];
+            const int32_t* polygon = indices.data() + indicesOffsets[i];
+            glm::u32vec3*  dst     = triangles.get() + trianglesOffsets[i];
+            checkPolygonIndices(i, polygon, count, positions.size());
+
+            if (count == 3) {
+                *dst = glm::u32vec3(polygon[0], polygon[1], polygon[2]);
+            } else if (count == 4) {
+                dst[0] = glm::u32vec3(polygon[0], polygon[1], polygon[3]);
+                dst[1] = glm::u32vec3(polygon[2], polygon[3], polygon[1]);
+            } else if (count > 4) {
+                miniply::triangulate_polygon(count, reinterpret_cast<const float*>(positions.data()),
+                                             static_cast<uint32_t>(positions.size()), polygon,
+                                             reinterpret_cast<int*>(dst));
+            }
+        }
+    });
+    return {std::move(triangles), static_cast<uint32_t>(numTriangles)};
+}
+
+SceneBuilder::LoadedMesh SceneBuilder::loadMesh(const std::string_view filePath)
 {
+    PRISM_PROFILE_SCOPE("scene/load_mesh");
+
     const std::string  cstrFilepath(filePath);
     miniply::PLYReader plyReader(cstrFilepath.c_str());
 
@@ -31,60 +142,76 @@ MeshIndex SceneBuilder::createMesh(const std::string_view filePath)
         throw std::runtime_error("Could not open or parse PLY file at: " + std::string(filePath));
     }
 
-    // The data we want to work with:
-    const uint32_t facesOffset    = m_faces.size();
-    const uint32_t verticesOffset = m_vertices.size();
-
-    uint32_t                        numVertices, numFaces;
-    std::unique_ptr<glm::vec3[]>    pos, nrm, tan;
-    std::unique_ptr<glm::vec2[]>    uvs;
-    std::unique_ptr<glm::u32vec3[]> faces;
+    LoadedMesh mesh{};
     {
         // Store the position information used by ply reader to load values:
-        std::array<uint32_t, 3> triIdx, vrtIdx;
+        std::array<uint32_t, 3> vrtIdx;
 
-        const auto faceElement = plyReader.get_element(plyReader.find_element(miniply::kPLYFaceElement));
-        if (!faceElement) {
+        if (plyReader.find_element(miniply::kPLYFaceElement) == miniply::kInvalidIndex) {
             // TODO: replace with std::format
             throw std::runtime_error("Could not find face elements for PLY file at: " + std::string(filePath));
         }
-        faceElement->convert_list_to_fixed_size(faceElement->find_property("vertex_indices"), 3, triIdx.data());
+
+        // The faces can be polygons of any size, which can only be triangulated once the positions are loaded (the
+        // faces may come first):
+        std::vector<uint32_t> polygonCounts;
+        std::vector<int32_t>  polygonIndices;
 
         bool hasVertices = false, hasFaces = false;
         for (; plyReader.has_element() && (!hasVertices || !hasFaces); plyReader.next_element()) {
             // If it's a vertex element:
             if (plyReader.element_is(miniply::kPLYVertexElement) && plyReader.load_element()) {
-                numVertices = plyReader.num_rows();
+                mesh.numVertices = plyReader.num_rows();
 
                 // Check for position data:
                 if (!plyReader.find_pos(vrtIdx.data())) {
                     // TODO: replace with std::format
                     throw std::runtime_error("Missing position data in PLY file at: " + std::string(filePath));
                 }
-                pos.reset(new glm::vec3[numVertices]);
-                plyReader.extract_properties(vrtIdx.data(), 3, miniply::PLYPropertyType::Float, pos.get());
+                mesh.pos.reset(new glm::vec3[mesh.numVertices]);
+                plyReader.extract_properties(vrtIdx.data(), 3, miniply::PLYPropertyType::Float, mesh.pos.get());
 
                 // Check for normals:
                 if (plyReader.find_normal(vrtIdx.data())) {
-                    nrm.reset(new glm::vec3[numVertices]);
-                    plyReader.extract_properties(vrtIdx.data(), 3, miniply::PLYPropertyType::Float, nrm.get());
+                    mesh.nrm.reset(new glm::vec3[mesh.numVertices]);
+                    plyReader.extract_properties(vrtIdx.data(), 3, miniply::PLYPropertyType::Float, mesh.nrm.get());
                 }
                 // Check for tangents:
                 if (plyReader.find_properties(vrtIdx.data(), 3, "tx", "ty", "tz")) {
-                    tan.reset(new glm::vec3[numVertices]);
-                    plyReader.extract_properties(vrtIdx.data(), 3, miniply::PLYPropertyType::Float, tan.get());
+                    mesh.tan.reset(new glm::vec3[mesh.numVertices]);
+                    plyReader.extract_properties(vrtIdx.data(), 3, miniply::PLYPropertyType::Float, mesh.tan.get());
                 }
                 // Check for texture coordinates:
                 if (plyReader.find_texcoord(vrtIdx.data())) {
-                    uvs.reset(new glm::vec2[numVertices]);
-                    plyReader.extract_properties(vrtIdx.data(), 2, miniply::PLYPropertyType::Float, uvs.get());
+                    mesh.uvs.reset(new glm::vec2[mesh.numVertices]);
+                    plyReader.extract_properties(vrtIdx.data(), 2, miniply::PLYPropertyType::Float, mesh.uvs.get());
                 }
 
                 hasVertices = true;
             } else if (plyReader.element_is(miniply::kPLYFaceElement) && plyReader.load_element()) {
-                numFaces = plyReader.num_rows();
-                faces.reset(new glm::u32vec3[numFaces]);
-                plyReader.extract_properties(triIdx.data(), 3, miniply::PLYPropertyType::Int, faces.get());
+                uint32_t indicesIdx;
+                if (!plyReader.find_indices(&indicesIdx)) {
+                    // TODO: replace with std::format
+                    throw std::runtime_error("Missing vertex indices in PLY file at: " + std::string(filePath));
+                }
+
+                // Meshes that are already triangulated are extracted directly:
+                const uint32_t  numPolygons = plyReader.num_rows();
+                const uint32_t* counts      = plyReader.get_list_counts(indicesIdx);
+                if (!counts) {
+                    // TODO: replace with std::format
+                    throw std::runtime_error("Vertex indices that aren't a list in PLY file at: " +
+                                             std::string(filePath));
+                }
+                if (std::all_of(counts, counts + numPolygons, [](const uint32_t count) { return count == 3; })) {
+                    mesh.numFaces = numPolygons;
+                    mesh.faces.reset(new glm::u32vec3[mesh.numFaces]);
+                    plyReader.extract_list_property(indicesIdx, miniply::PLYPropertyType::Int, mesh.faces.get());
+                } else {
+                    polygonCounts.assign(counts, counts + numPolygons);
+                    polygonIndices.resize(plyReader.sum_of_list_counts(indicesIdx));
+                    plyReader.extract_list_property(indicesIdx, miniply::PLYPropertyType::Int, polygonIndices.data());
+                }
 
                 hasFaces = true;
             }
@@ -94,33 +221,263 @@ MeshIndex SceneBuilder::createMesh(const std::string_view filePath)
             // TODO: replace with std::format
             throw std::runtime_error("Poorly formed PLY file at: " + std::string(filePath));
         }
+
+        if (!mesh.faces) {
+            std::tie(mesh.faces, mesh.numFaces) = triangulatePolygons(
+                polygonCounts, polygonIndices, std::span(mesh.pos.get(), mesh.numVertices));
+        } else {
+            // Meshes that were already triangulated skipped triangulatePolygons, so their indices are checked here
+            // (they end up in the BLAS builds, which don't check them):
+            constexpr size_t MIN_RANGE_SIZE = size_t(1) << 14; // Faces
+            parallelFor(mesh.numFaces, MIN_RANGE_SIZE, [&](const size_t begin, const size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    checkPolygonIndices(i, reinterpret_cast<const int32_t*>(&mesh.faces[i]), 3, mesh.numVertices);
+                }
+            });
+        }
+    }
+
+    return mesh;
+}
+
+// Replaces the values (if there are any) with values[oldIndices[i]]:
+template <typename T>
+static void reorderVertices(std::unique_ptr<T[]>& values, const std::span<const uint32_t> oldIndices)
+{
+    if (!values) {
+        return;
+    }
+
+    std::unique_ptr<T[]> reordered(new T[oldIndices.size()]);
+    parallelFor(oldIndices.size(), size_t(1) << 16, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            reordered[i] = values[oldIndices[i]];
+        }
+    });
+    values = std::move(reordered);
+}
+
+void SceneBuilder::prepareMesh(LoadedMesh& mesh) const
+{
+    // Reordered first, so that generating the attributes benefits from it as well:
+    if (m_reorderMeshes) {
+        const auto faces = std::span(mesh.faces.get(), mesh.numFaces);
+        sortFacesSpatially(std::span(mesh.pos.get(), mesh.numVertices), faces);
+
+        const std::vector<uint32_t> oldIndices = orderVerticesByFirstUse(mesh.numVertices, faces);
+        reorderVertices(mesh.pos, oldIndices);
+        reorderVertices(mesh.nrm, oldIndices);
+        reorderVertices(mesh.tan, oldIndices);
+        reorderVertices(mesh.uvs, oldIndices);
+    }
+
+    const auto& param = m_attributeGeneration;
+
+    // Tangents are projected onto the normals, so meshes without normals get them as well:
+    const bool needsTangents = param.tangents && mesh.uvs && !mesh.tan;
+    const bool needsNormals  = (param.normals || needsTangents) && !mesh.nrm;
+
+    if (needsNormals || needsTangents) {
+        const auto positions     = std::span<const glm::vec3>(mesh.pos.get(), mesh.numVertices);
+        const auto faces         = std::span<const glm::u32vec3>(mesh.faces.get(), mesh.numFaces);
+        const auto vertexCorners = findVertexCorners(mesh.numVertices, faces);
+
+        if (needsNormals) {
+            mesh.nrm.reset(new glm::vec3[mesh.numVertices]);
+            generateNormals(positions, faces, vertexCorners, param.weighting,
+                            std::span(mesh.nrm.get(), mesh.numVertices));
+        }
+        if (needsTangents) {
+            mesh.tan.reset(new glm::vec3[mesh.numVertices]);
+            generateTangents(positions, faces, std::span<const glm::vec2>(mesh.uvs.get(), mesh.numVertices),
+                             std::span<const glm::vec3>(mesh.nrm.get(), mesh.numVertices), vertexCorners,
+                             std::span(mesh.tan.get(), mesh.numVertices));
+        }
+    }
+
+    // Hashed here, so that createMeshes hashes the files in parallel as well:
+    mesh.hash = hashMesh(mesh);
+}
+
+uint64_t SceneBuilder::hashMesh(const LoadedMesh& mesh)
+{
+    PRISM_PROFILE_SCOPE("scene/hash_mesh");
+
+    const auto layout = std::to_array<uint32_t>({mesh.numVertices, mesh.numFaces, mesh.nrm ? 1u : 0u,
+                                                 mesh.tan ? 1u : 0u, mesh.uvs ? 1u : 0u});
+
+    uint64_t hash = hash64(std::as_bytes(std::span(layout)));
+    hash          = hashValues(std::span(mesh.pos.get(), mesh.numVertices), hash);
+    if (mesh.nrm) {
+        hash = hashValues(std::span(mesh.nrm.get(), mesh.numVertices), hash);
+    }
+    if (mesh.tan) {
+        hash = hashValues(std::span(mesh.tan.get(), mesh.numVertices), hash);
+    }
+    if (mesh.uvs) {
+        hash = hashValues(std::span(mesh.uvs.get(), mesh.numVertices), hash);
+    }
+    return hashValues(std::span(mesh.faces.get(), mesh.numFaces), hash);
+}
+
+bool SceneBuilder::meshEquals(const Mesh& mesh, const LoadedMesh& loadedMesh) const
+{
+    if (mesh.numVertices != loadedMesh.numVertices || mesh.numFaces != loadedMesh.numFaces ||
+        mesh.nrm != static_cast<bool>(loadedMesh.nrm) || mesh.tan != static_cast<bool>(loadedMesh.tan) ||
+        mesh.uvs != static_cast<bool>(loadedMesh.uvs)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < mesh.numFaces; ++i) {
+        if (face(mesh, i) != loadedMesh.faces[i]) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < mesh.numVertices; ++i) {
+        const auto& vertex = m_vertices[mesh.verticesOffset + i];
+        if (vertex.pos != loadedMesh.pos[i] || (loadedMesh.nrm && vertex.nrm != loadedMesh.nrm[i]) ||
+            (loadedMesh.tan && vertex.tan != loadedMesh.tan[i]) ||
+            (loadedMesh.uvs && vertex.uvs != loadedMesh.uvs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+MeshIndex SceneBuilder::addMesh(const LoadedMesh& mesh)
+{
+    // Dynamic meshes are skipped, as their positions are going to change:
+    if (m_deduplicate) {
+        const auto [first, last] = m_meshHashes.equal_range(mesh.hash);
+        for (auto itr = first; itr != last; ++itr) {
+            const auto& existingMesh = m_meshes[itr->second];
+            if (!existingMesh.dynamic && meshEquals(existingMesh, mesh)) {
+                const uint64_t faceSize = existingMesh.indices16 ? sizeof(glm::u16vec3) : sizeof(glm::u32vec3);
+                ++m_deduplicationStats.meshes;
+                m_deduplicationStats.savedBytes +=
+                    sizeof(Vertex) * uint64_t(mesh.numVertices) + faceSize * uint64_t(mesh.numFaces);
+                return MeshIndex(itr->second);
+            }
+        }
     }
 
-    std::copy(faces.get(), faces.get() + numFaces, std::back_inserter(m_faces));
+    // Halves the size of the faces, most meshes of a typical scene are small enough:
+    const bool indices16 = mesh.numVertices <= std::numeric_limits<uint16_t>::max();
 
-    for (size_t i = 0; i < numVertices; ++i) {
+    // The offsets into the vertices and faces are stored as 32 bit values (in the geometry records as well):
+    const size_t numPoolFaces = indices16 ? m_faces16.size() : m_faces.size();
+    if (m_vertices.size() + mesh.numVertices > std::numeric_limits<uint32_t>::max() ||
+        numPoolFaces + mesh.numFaces > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Can't add a mesh with " + std::to_string(mesh.numVertices) + " vertices and " +
+                                 std::to_string(mesh.numFaces) + " faces, the scene would exceed 2^32 of either");
+    }
+
+    // The data we want to work with:
+    const uint32_t facesOffset    = static_cast<uint32_t>(numPoolFaces);
+    const uint32_t verticesOffset = m_vertices.size();
+
+    if (indices16) {
+        std::transform(mesh.faces.get(), mesh.faces.get() + mesh.numFaces, std::back_inserter(m_faces16),
+                       [](const glm::u32vec3& face) { return glm::u16vec3(face); });
+    } else {
+        std::copy(mesh.faces.get(), mesh.faces.get() + mesh.numFaces, std::back_inserter(m_faces));
+    }
+
+    for (size_t i = 0; i < mesh.numVertices; ++i) {
         m_vertices.emplace_back(Vertex{
-            .pos = pos[i],
-            .nrm = nrm ? nrm[i] : glm::vec3(0.f),
-            .tan = tan ? tan[i] : glm::vec3(0.f),
-            .uvs = uvs ? uvs[i] : glm::vec2(0.f),
+            .pos = mesh.pos[i],
+            .nrm = mesh.nrm ? mesh.nrm[i] : glm::vec3(0.f),
+            .tan = mesh.tan ? mesh.tan[i] : glm::vec3(0.f),
+            .uvs = mesh.uvs ? mesh.uvs[i] : glm::vec2(0.f),
         });
     }
 
+    glm::vec2 uvsMin(0.f), uvsMax(0.f);
+    if (mesh.uvs && mesh.numVertices > 0) {
+        uvsMin = uvsMax = mesh.uvs[0];
+        for (uint32_t i = 1; i < mesh.numVertices; ++i) {
+            uvsMin = glm::min(uvsMin, mesh.uvs[i]);
+            uvsMax = glm::max(uvsMax, mesh.uvs[i]);
+        }
+    }
+
     const uint32_t meshId = m_meshes.size();
     m_meshes.emplace_back(Mesh{
-        .nrm            = static_cast<bool>(nrm),
-        .tan            = static_cast<bool>(tan),
-        .uvs            = static_cast<bool>(uvs),
+        .nrm            = static_cast<bool>(mesh.nrm),
+        .tan            = static_cast<bool>(mesh.tan),
+        .uvs            = static_cast<bool>(mesh.uvs),
         .verticesOffset = verticesOffset,
-        .numVertices    = numVertices,
+        .numVertices    = mesh.numVertices,
+        .uvsMin         = uvsMin,
+        .uvsMax         = uvsMax,
+        .indices16      = indices16,
         .facesOffset    = facesOffset,
-        .numFaces       = numFaces,
+        .numFaces       = mesh.numFaces,
     });
+    m_meshHashes.emplace(mesh.hash, meshId);
 
     return MeshIndex(meshId);
 }
 
+MeshIndex SceneBuilder::createMesh(const std::string_view filePath)
+{
+    LoadedMesh mesh = loadMesh(filePath);
+    prepareMesh(mesh);
+    return addMesh(mesh);
+}
+
+MeshIndex SceneBuilder::createMesh(const std::span<const glm::vec3> positions,
+                                   const std::span<const glm::u32vec3> faces)
+{
+    for (const auto& face : faces) {
+        if (face.x >= positions.size() || face.y >= positions.size() || face.z >= positions.size()) {
+            throw std::runtime_error("Face index out of range when creating a mesh with " +
+                                     std::to_string(positions.size()) + " vertices");
+        }
+    }
+
+    LoadedMesh mesh{};
+    mesh.numVertices = static_cast<uint32_t>(positions.size());
+    mesh.numFaces    = static_cast<uint32_t>(faces.size());
+    mesh.pos.reset(new glm::vec3[mesh.numVertices]);
+    mesh.faces.reset(new glm::u32vec3[mesh.numFaces]);
+    std::copy(positions.begin(), positions.end(), mesh.pos.get());
+    std::copy(faces.begin(), faces.end(), mesh.faces.get());
+    prepareMesh(mesh);
+
+    return addMesh(mesh);
+}
+
+std::vector<MeshIndex> SceneBuilder::createMeshes(const std::span<const std::string_view> filePaths)
+{
+    // Parsing (and generating attributes) is what takes the time, adding the meshes happens in order afterwards so that
+    // the indices are the same as when calling createMesh for every file:
+    std::vector<LoadedMesh> meshes(filePaths.size());
+    parallelFor(filePaths.size(), 1, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            meshes[i] = loadMesh(filePaths[i]);
+            prepareMesh(meshes[i]);
+        }
+    });
+
+    std::vector<MeshIndex> meshIndices;
+    meshIndices.reserve(meshes.size());
+    for (const auto& mesh : meshes) {
+        meshIndices.push_back(addMesh(mesh));
+    }
+    return meshIndices;
+}
+
+void SceneBuilder::setMeshDynamic(const MeshIndex meshIdx)
+{
+    if (meshIdx >= m_meshes.size()) {
+        throw std::runtime_error("Can't make mesh " + std::to_string(meshIdx) + " dynamic, the builder only has " +
+                                 std::to_string(m_meshes.size()) + " meshes");
+    }
+    m_meshes[meshIdx].dynamic = true;
+}
+
 TransformIndex SceneBuilder::createTransform(const Transform& transform)
 {
     const uint32_t id = m_transforms.size();
@@ -128,10 +485,56 @@ TransformIndex SceneBuilder::createTransform(const Transform& transform)
     return TransformIndex(id);
 }
 
+uint64_t SceneBuilder::hashMeshGroup(const std::span<const PlacedMesh> placedMeshes) const
+{
+    uint64_t hash = placedMeshes.size();
+    for (const auto& [meshIdx, transformIdx] : placedMeshes) {
+        const uint32_t idx = meshIdx;
+        hash               = hash64(std::as_bytes(std::span(&idx, 1)), hash);
+        if (!transformIdx.isNone()) {
+            hash = hash64(std::as_bytes(std::span(&m_transforms[transformIdx], 1)), hash);
+        }
+    }
+    return hash;
+}
+
+bool SceneBuilder::meshGroupEquals(const uint32_t groupIdx, const std::span<const PlacedMesh> placedMeshes) const
+{
+    const auto meshGroup = meshGroups()[groupIdx];
+    return std::ranges::equal(meshGroup, placedMeshes, [&](const PlacedMesh& lhs, const PlacedMesh& rhs) {
+        if (lhs.meshIdx != rhs.meshIdx || lhs.transformIdx.isNone() != rhs.transformIdx.isNone()) {
+            return false;
+        }
+        return lhs.transformIdx.isNone() ||
+               std::memcmp(&m_transforms[lhs.transformIdx], &m_transforms[rhs.transformIdx],
+                           sizeof(vk::TransformMatrixKHR)) == 0;
+    });
+}
+
 MeshGroupIndex SceneBuilder::createMeshGroup(const std::span<const PlacedMesh> placedMeshes)
 {
-    const uint32_t id = m_meshGroups.size();
-    m_meshGroups.emplace_back(placedMeshes.begin(), placedMeshes.end());
+    for (const auto& [meshIdx, transformIdx] : placedMeshes) {
+        if (meshIdx >= m_meshes.size() || (!transformIdx.isNone() && transformIdx >= m_transforms.size())) {
+            throw std::runtime_error("Can't create a mesh group with a mesh or a transform that doesn't exist");
+        }
+    }
+
+    const uint64_t hash = hashMeshGroup(placedMeshes);
+
+    if (m_deduplicate) {
+        const auto [first, last] = m_meshGroupHashes.equal_range(hash);
+        for (auto itr = first; itr != last; ++itr) {
+            if (meshGroupEquals(itr->second, placedMeshes)) {
+                ++m_deduplicationStats.meshGroups;
+                return MeshGroupIndex(itr->second);
+            }
+        }
+    }
+
+    const uint32_t id = static_cast<uint32_t>(m_meshGroupOffsets.size() - 1);
+    m_placedMeshes.insert(m_placedMeshes.end(), placedMeshes.begin(), placedMeshes.end());
+    m_meshGroupOffsets.emplace_back(static_cast<uint32_t>(m_placedMeshes.size()));
+    m_meshGroupHashes.emplace(hash, id);
     return MeshGroupIndex(id);
 }
 
@@ -142,6 +545,35 @@ InstanceIndex SceneBuilder::createInstance(const Instance& instance)
     return InstanceIndex(id);
 }
 
+std::vector<MemoryUsage> SceneBuilder::hostMemoryUsage() const
+{
+    // The arrays only ever grow, so their current size is also their peak:
+    const auto usage = [](const char* name, const auto& array) {
+        const uint64_t bytes = array.capacity() * sizeof(array[0]);
+        return MemoryUsage{.name = name, .currentBytes = bytes, .peakBytes = bytes};
+    };
+    // An estimate, the nodes are allocated separately (a value and the pointer to the next node) along with an array of
+    // buckets:
+    const auto hashTableUsage = [](const char* name, const std::unordered_multimap<uint64_t, uint32_t>& table) {
+        const uint64_t bytes = table.size() * (sizeof(std::pair<uint64_t, uint32_t>) + sizeof(void*)) +
+                               table.bucket_count() * sizeof(void*);
+        return MemoryUsage{.name = name, .currentBytes = bytes, .peakBytes = bytes};
+    };
+
+    return {
+        usage("builder/meshes", m_meshes),
+        usage("builder/vertices", m_vertices),
+        usage("builder/faces", m_faces),
+        usage("builder/faces 16", m_faces16),
+        usage("builder/transforms", m_transforms),
+        usage("builder/placed meshes", m_placedMeshes),
+        usage("builder/mesh group offsets", m_meshGroupOffsets),
+        usage("builder/instances", m_instances),
+        hashTableUsage("builder/mesh hashes", m_meshHashes),
+        hashTableUsage("builder/mesh group hashes", m_meshGroupHashes),
+    };
+}
+
 //
 // Scene
 //
@@ -149,18 +581,100 @@ InstanceIndex SceneBuilder::createInstance(const Instance& instance)
 Scene::Scene(const SceneParam& param, const Context& context, const GPUAllocator& allocator,
              const SceneBuilder& sceneBuilder)
 {
-    const auto commandPool = context.device().createCommandPoolUnique(vk::CommandPoolCreateInfo{
-        .flags            = vk::CommandPoolCreateFlagBits::eTransient, // All of the command buffers will be short lived
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    PRISM_PROFILE_SCOPE("scene/build");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // All of the command buffers are short lived, apart from the one for the TLAS, which is recorded again by every
+    // update (beginning it resets it):
+    m_commandPool = context.device().createCommandPoolUnique(vk::CommandPoolCreateInfo{
+        .flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
         .queueFamilyIndex = context.queueFamilyIndex()});
+    m_tlasCommandBuffer = std::move(context.device().allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{
+        .commandPool        = *m_commandPool,
+        .level              = vk::CommandBufferLevel::ePrimary,
+        .commandBufferCount = 1,
+    })[0]);
+
+    m_meshGpuData = transferMeshData(context, allocator, *m_commandPool, sceneBuilder.m_meshes, sceneBuilder.m_vertices,
+                                     sceneBuilder.m_faces, sceneBuilder.m_faces16, sceneBuilder.m_transforms,
+                                     param.compactVertices);
+    createDynamicMeshes(context, allocator, sceneBuilder);
+    const auto uploadEnd = std::chrono::steady_clock::now();
+
+    m_blases = createBlas(context, allocator, *m_commandPool, m_meshGpuData, sceneBuilder.m_meshes, m_dynamicMeshes,
+                          sceneBuilder.meshGroups(), param.enableCompaction);
+    createDynamicBlases(context, allocator, sceneBuilder);
+    const auto blasEnd = std::chrono::steady_clock::now();
+
+    //
+    // Everything the instance slots need to know about the mesh groups:
+
+    m_blasAddresses.reserve(m_blases.size());
+    for (const auto& blas : m_blases) {
+        m_blasAddresses.emplace_back(
+            context.device().getAccelerationStructureAddressKHR(vk::AccelerationStructureDeviceAddressInfoKHR{
+                .accelerationStructure = *blas.accelStruct,
+            }));
+    }
+
+    // The records are stored in the same order as the placed meshes:
+    m_geometryRecordsOffsets.assign(sceneBuilder.m_meshGroupOffsets.begin(), sceneBuilder.m_meshGroupOffsets.end() - 1);
+
+    m_meshGroupBounds = computeMeshGroupBounds(sceneBuilder.m_meshes, sceneBuilder.m_vertices,
+                                               sceneBuilder.m_transforms, sceneBuilder.meshGroups());
+    m_meshGroupBoundsChanged.resize(m_meshGroupBounds.size(), 0);
+
+    //
+    // The instances of the builder are followed by the (inactive) free slots:
+
+    const uint32_t numBuilderInstances = static_cast<uint32_t>(sceneBuilder.m_instances.size());
+    m_instances.resize(numBuilderInstances + param.extraInstanceCapacity,
+                       InstanceSlot{.meshGroupIdx = MeshGroupIndex(0), .alive = false, .visible = false});
+    m_changedSlots.resize(m_instances.size());
+
+    for (uint32_t i = 0; i < numBuilderInstances; ++i) {
+        setInstance(i, sceneBuilder.m_instances[i]);
+    }
+    // The free slots are written to the instance buffers once as well, as inactive instances:
+    for (uint32_t i = numBuilderInstances; i < m_instances.size(); ++i) {
+        markSlotChanged(i);
+    }
+    // Handed out from the back, so the lowest indices are used first:
+    for (uint32_t i = static_cast<uint32_t>(m_instances.size()); i > numBuilderInstances; --i) {
+        m_freeInstances.push_back(i - 1);
+    }
+
+    m_tlas = createTlas(context, allocator, static_cast<uint32_t>(m_instances.size()));
+    m_tlasCommandBuffer->begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    recordTlasBuild(*m_tlasCommandBuffer, context, false);
+    submitAndWait(context, *m_tlasCommandBuffer, "TLAS construction");
+    const auto tlasEnd = std::chrono::steady_clock::now();
 
-    m_meshGpuData = transferMeshData(context, allocator, *commandPool, sceneBuilder.m_meshes, sceneBuilder.m_vertices,
-                                     sceneBuilder.m_faces, sceneBuilder.m_transforms);
-    m_blases      = createBlas(context, allocator, *commandPool, m_meshGpuData, sceneBuilder.m_meshes,
-                          sceneBuilder.m_meshGroups, param.enableCompaction);
-    m_tlas        = createTlas(context, allocator, *commandPool, sceneBuilder.m_instances, m_blases);
+    m_geometryRecords =
+        transferGeometryRecords(context, allocator, *m_commandPool, sceneBuilder.m_meshes, sceneBuilder.meshGroups(),
+                                param.compactVertices);
 
-    m_cameraData       = transferCamera(context, *commandPool, allocator, sceneBuilder.m_camera.get());
-    m_cameraShaderName = sceneBuilder.m_camera->getShaderName();
+    // Scenes that are only used for tracing rays (like the benchmarks) don't need a camera:
+    if (sceneBuilder.m_camera) {
+        m_cameraData       = transferCamera(context, *m_commandPool, allocator, sceneBuilder.m_camera.get());
+        m_cameraShaderName = sceneBuilder.m_camera->getShaderName();
+    }
+
+    const size_t vertexSize = param.compactVertices ? sizeof(CompactVertex) : sizeof(Vertex);
+
+    m_buildTimings = SceneBuildTimings{
+        .uploadMs   = Milliseconds(uploadEnd - start).count(),
+        .blasMs     = Milliseconds(blasEnd - uploadEnd).count(),
+        .tlasMs     = Milliseconds(tlasEnd - blasEnd).count(),
+        .totalMs    = Milliseconds(std::chrono::steady_clock::now() - start).count(),
+        .uploadSize = sceneBuilder.m_vertices.size() * vertexSize +
+                      sceneBuilder.m_faces.size() * sizeof(glm::u32vec3) +
+                      sceneBuilder.m_faces16.size() * sizeof(glm::u16vec3) +
+                      sceneBuilder.m_transforms.size() * sizeof(vk::TransformMatrixKHR),
+    };
 }
 
 Scene::MeshGpuData Scene::transferMeshData(const Context& context, const GPUAllocator& gpuAllocator,
@@ -168,7 +682,9 @@ Scene::MeshGpuData Scene::transferMeshData(const Context& context, const GPUAllo
                                            const std::span<const SceneBuilder::Mesh>     meshes,
                                            const std::span<const Vertex>                 vertices,
                                            const std::span<const glm::u32vec3>           faces,
-                                           const std::span<const vk::TransformMatrixKHR> transforms)
+                                           const std::span<const glm::u16vec3>           faces16,
+                                           const std::span<const vk::TransformMatrixKHR> transforms,
+                                           const bool                                    compactVertices)
 {
     //
     // Allocate the command buffer (not very efficient to get vector invovled, but unless this becomes a problem I won't
@@ -181,27 +697,55 @@ Scene::MeshGpuData Scene::transferMeshData(const Context& context, const GPUAllo
     })[0]);
 
     commandBuffer->begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    PRISM_PROFILE_GPU_BEGIN(uploadScope, context.gpuProfiler(), *commandBuffer, "scene/upload");
 
     //
     // Transfer mesh vertices and faces:
 
     //
-    // Allocate buffers on the GPU where we'll send the data:
+    // Allocate buffers on the GPU where we'll send the data (the hit shaders also read them as storage buffers):
     const auto blasUsage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress |
-                           vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR;
-    auto gpuVertices =
-        gpuAllocator.allocateBuffer(sizeof(Vertex) * vertices.size(), blasUsage, VMA_MEMORY_USAGE_GPU_ONLY);
-    auto gpuFaces =
-        gpuAllocator.allocateBuffer(sizeof(glm::u32vec3) * faces.size(), blasUsage, VMA_MEMORY_USAGE_GPU_ONLY);
-
-    const auto stagingVertices = addCopyToBufferCommand(*commandBuffer, gpuAllocator, gpuVertices, vertices);
-    const auto stagingFaces    = addCopyToBufferCommand(*commandBuffer, gpuAllocator, gpuFaces, faces);
+                           vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR |
+                           vk::BufferUsageFlagBits::eStorageBuffer;
+
+    // Either of the face pools can be empty (if every mesh is small or if none of them are), the staging buffers have
+    // to stay alive until the submission finished as well:
+    const auto transferArray = [&]<typename T>(const std::span<const T> data) {
+        if (!data.empty()) {
+            auto gpuData = gpuAllocator.allocateBuffer(sizeof(T) * data.size(), blasUsage, VMA_MEMORY_USAGE_GPU_ONLY,
+                                                       MemoryCategory::eGeometry);
+            auto staging = addCopyToBufferCommand(*commandBuffer, gpuAllocator, gpuData, data);
+
+            return std::make_tuple(std::move(staging), std::move(gpuData));
+        }
+        return std::make_tuple(UniqueBuffer{}, UniqueBuffer{});
+    };
+    auto [stagingFaces, gpuFaces]     = transferArray(faces);
+    auto [stagingFaces16, gpuFaces16] = transferArray(faces16);
+
+    // Compact vertices are encoded relative to the uv bounds of their mesh, the meshes are encoded in parallel:
+    std::vector<CompactVertex> encodedVertices;
+    if (compactVertices) {
+        PRISM_PROFILE_SCOPE("scene/encode_vertices");
+
+        encodedVertices.resize(vertices.size());
+        parallelFor(meshes.size(), 1, [&](const size_t begin, const size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const auto& mesh = meshes[i];
+                encodeVertices(vertices.subspan(mesh.verticesOffset, mesh.numVertices), mesh.uvsMin, mesh.uvsMax,
+                               std::span(encodedVertices).subspan(mesh.verticesOffset, mesh.numVertices));
+            }
+        });
+    }
+    auto [stagingVertices, gpuVertices] =
+        compactVertices ? transferArray(std::span<const CompactVertex>(encodedVertices)) : transferArray(vertices);
 
     // Transforms are optional, so we check for them, but we need to keep staging transforms on the stack:
     auto [stagingTransforms, gpuTransforms] = [&]() {
         if (!transforms.empty()) {
-            auto gpuTransforms     = gpuAllocator.allocateBuffer(sizeof(vk::TransformMatrixKHR) * transforms.size(),
-                                                             blasUsage, VMA_MEMORY_USAGE_GPU_ONLY);
+            auto gpuTransforms =
+                gpuAllocator.allocateBuffer(sizeof(vk::TransformMatrixKHR) * transforms.size(), blasUsage,
+                                            VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::eGeometry);
             auto stagingTransforms = addCopyToBufferCommand(*commandBuffer, gpuAllocator, gpuTransforms, transforms);
 
             return std::make_tuple(std::move(stagingTransforms), std::move(gpuTransforms));
@@ -209,73 +753,117 @@ Scene::MeshGpuData Scene::transferMeshData(const Context& context, const GPUAllo
         return std::make_tuple(UniqueBuffer{}, UniqueBuffer{});
     }();
 
+    PRISM_PROFILE_GPU_END(uploadScope, context.gpuProfiler(), *commandBuffer);
     submitAndWait(context, *commandBuffer, "sending mesh data to the GPU");
 
     return MeshGpuData{
-        .vertices   = std::move(gpuVertices),
-        .faces      = std::move(gpuFaces),
-        .transforms = std::move(gpuTransforms),
+        .vertices        = std::move(gpuVertices),
+        .faces           = std::move(gpuFaces),
+        .faces16         = std::move(gpuFaces16),
+        .transforms      = std::move(gpuTransforms),
+        .compactVertices = compactVertices,
     };
 }
 
+// Mesh groups with a dynamic mesh, see createBlas:
+static constexpr vk::BuildAccelerationStructureFlagsKHR DYNAMIC_BLAS_BUILD_FLAGS =
+    vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastBuild |
+    vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate;
+
+std::pair<vk::AccelerationStructureGeometryKHR, vk::AccelerationStructureBuildRangeInfoKHR>
+Scene::blasGeometry(const Context& context, const MeshGpuData& meshGpuData, const SceneBuilder::Mesh& mesh,
+                    const DynamicMesh* dynamicMesh, const TransformIndex transformIdx)
+{
+    // Dynamic meshes only have their positions in the dynamic buffer:
+    const vk::DeviceSize vertexStride = dynamicMesh                   ? sizeof(glm::vec3)
+                                        : meshGpuData.compactVertices ? sizeof(CompactVertex)
+                                                                      : sizeof(Vertex);
+    const auto           vertexData =
+        dynamicMesh ? dynamicMesh->positionsAddrs[dynamicMesh->current]
+                    : meshGpuData.vertices.deviceAddress(context.device()) + vertexStride * mesh.verticesOffset;
+    const auto           indexData =
+        mesh.indices16
+            ? meshGpuData.faces16.deviceAddress(context.device()) + sizeof(glm::u16vec3) * mesh.facesOffset
+            : meshGpuData.faces.deviceAddress(context.device()) + sizeof(glm::u32vec3) * mesh.facesOffset;
+
+    const vk::AccelerationStructureGeometryKHR geometry{
+        .geometryType = vk::GeometryTypeKHR::eTriangles,
+        .geometry =
+            vk::AccelerationStructureGeometryTrianglesDataKHR{
+                .vertexFormat = vk::Format::eR32G32B32Sfloat, // glm::vec3
+                .vertexData   = vk::DeviceOrHostAddressConstKHR{.deviceAddress = vertexData},
+                .vertexStride = vertexStride,
+                .maxVertex    = mesh.numVertices - 1,
+                .indexType    = mesh.indices16 ? vk::IndexType::eUint16 : vk::IndexType::eUint32,
+                .indexData    = vk::DeviceOrHostAddressConstKHR{.deviceAddress = indexData},
+
+                // We specify the offset in the build range info:
+                .transformData =
+                    transformIdx.isNone()
+                        ? vk::DeviceOrHostAddressConstKHR{}
+                        : vk::DeviceOrHostAddressConstKHR{.deviceAddress =
+                                                              meshGpuData.transforms.deviceAddress(context.device())},
+            },
+
+        .flags = vk::GeometryFlagBitsKHR::eOpaque};
+
+    const vk::AccelerationStructureBuildRangeInfoKHR buildRangeInfo{
+        .primitiveCount  = static_cast<uint32_t>(mesh.numFaces),
+        .transformOffset =
+            transformIdx.isNone() ? 0u : static_cast<uint32_t>(transformIdx * sizeof(vk::TransformMatrixKHR)),
+    };
+
+    return {geometry, buildRangeInfo};
+}
+
 std::vector<Scene::AccelStructInfo> Scene::createBlas(const Context& context, const GPUAllocator& allocator,
-                                                      const vk::CommandPool&                         commandPool,
-                                                      const MeshGpuData&                             meshGpuData,
-                                                      const std::span<const SceneBuilder::Mesh>      meshes,
-                                                      const std::span<const std::vector<PlacedMesh>> meshGroups,
-                                                      const bool                                     enableCompaction)
+                                                      const vk::CommandPool&                            commandPool,
+                                                      const MeshGpuData&                                meshGpuData,
+                                                      const std::span<const SceneBuilder::Mesh>         meshes,
+                                                      const std::span<const std::optional<DynamicMesh>> dynamicMeshes,
+                                                      const MeshGroupsView                              meshGroups,
+                                                      const bool enableCompaction)
 {
-    const auto gpuVerticesAddr = meshGpuData.vertices.deviceAddress(context.device());
-    const auto gpuFacesAddr    = meshGpuData.faces.deviceAddress(context.device());
-    const auto gpuTransformsAddr =
-        meshGpuData.transforms ? meshGpuData.transforms.deviceAddress(context.device()) : vk::DeviceAddress{};
+    // Nothing to record (Vulkan doesn't allow allocating 0 command buffers or an empty scratch buffer, and the profiler
+    // scope below is opened in the first command buffer and closed in the last):
+    if (meshGroups.size() == 0) {
+        return {};
+    }
 
     // Stores structures required for the mesh acceleration structure:
     std::vector<vk::AccelerationStructureGeometryKHR>       geometries;
     std::vector<vk::AccelerationStructureBuildRangeInfoKHR> buildRangeInfos;
+    std::vector<bool>                                       dynamicMeshGroups;
 
-    for (const auto& meshGroup : meshGroups) {
-        for (const auto& [meshIdx, transformIdx] : meshGroup) {
-            const auto& mesh = meshes[meshIdx];
-
-            geometries.emplace_back(
-                vk::AccelerationStructureGeometryKHR{
-                    .geometryType = vk::GeometryTypeKHR::eTriangles,
-                    .geometry =
-                        vk::AccelerationStructureGeometryTrianglesDataKHR{
-                            .vertexFormat = vk::Format::eR32G32B32A32Sfloat, // glm::vec3
-                            .vertexData =
-                                vk::DeviceOrHostAddressConstKHR{.deviceAddress = gpuVerticesAddr +
-                                                                                 sizeof(Vertex) * mesh.verticesOffset},
-                            .vertexStride = sizeof(Vertex),
-                            .maxVertex    = mesh.numVertices - 1,
-                            .indexType    = vk::IndexType::eUint32,
-                            .indexData =
-                                vk::DeviceOrHostAddressConstKHR{.deviceAddress = gpuFacesAddr + sizeof(glm::u32vec3) *
-                                                                                                    mesh.facesOffset},
-
-                            // We specify the offset in buildRangeInfos:
-                            .transformData = transformIdx
-                                                 ? vk::DeviceOrHostAddressConstKHR{.deviceAddress = gpuTransformsAddr}
-                                                 : vk::DeviceOrHostAddressConstKHR{},
-                        },
-
-                    .flags = vk::GeometryFlagBitsKHR::eOpaque});
-            buildRangeInfos.emplace_back(vk::AccelerationStructureBuildRangeInfoKHR{
-                .primitiveCount  = static_cast<uint32_t>(mesh.numFaces),
-                .transformOffset = transformIdx ? *transformIdx : 0u,
-            });
+    for (size_t i = 0; i < meshGroups.size(); ++i) {
+        bool dynamic = false;
+        for (const auto& [meshIdx, transformIdx] : meshGroups[i]) {
+            const auto& dynamicMesh = dynamicMeshes[meshIdx];
+
+            const auto [geometry, buildRangeInfo] = blasGeometry(context, meshGpuData, meshes[meshIdx],
+                                                                 dynamicMesh ? &*dynamicMesh : nullptr, transformIdx);
+            geometries.emplace_back(geometry);
+            buildRangeInfos.emplace_back(buildRangeInfo);
+
+            dynamic = dynamic || dynamicMesh.has_value();
         }
+        dynamicMeshGroups.push_back(dynamic);
     }
 
     std::vector<vk::AccelerationStructureBuildGeometryInfoKHR> buildGeometryInfos;
     buildGeometryInfos.reserve(meshGroups.size());
 
     size_t currGeometryOffset = 0;
-    for (const auto& meshGroup : meshGroups) {
-        const auto flags = enableCompaction ? vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace |
-                                                  vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction
-                                            : vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace;
+    for (size_t i = 0; i < meshGroups.size(); ++i) {
+        const auto& meshGroup = meshGroups[i];
+
+        // Dynamic mesh groups are refitted every time their meshes change, so they have to be quick to build instead:
+        vk::BuildAccelerationStructureFlagsKHR flags = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace;
+        if (dynamicMeshGroups[i]) {
+            flags = DYNAMIC_BLAS_BUILD_FLAGS;
+        } else if (enableCompaction) {
+            flags |= vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction;
+        }
 
         buildGeometryInfos.emplace_back(vk::AccelerationStructureBuildGeometryInfoKHR{
             .type          = vk::AccelerationStructureTypeKHR::eBottomLevel,
@@ -313,7 +901,7 @@ std::vector<Scene::AccelStructInfo> Scene::createBlas(const Context& context, co
         auto accelStructBuff = allocator.allocateBuffer(buildSizeInfo.accelerationStructureSize,
                                                         vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR |
                                                             vk::BufferUsageFlagBits::eShaderDeviceAddress,
-                                                        VMA_MEMORY_USAGE_GPU_ONLY);
+                                                        VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::eBlas);
 
         auto accelStruct = context.device().createAccelerationStructureKHRUnique(vk::AccelerationStructureCreateInfoKHR{
             //.createFlags, TODO: figure out if this is required or not... (I don't think it is).
@@ -352,19 +940,23 @@ std::vector<Scene::AccelStructInfo> Scene::createBlas(const Context& context, co
     // Allocate enough scratch space to construct the acceleration structure:
     const auto scratchBuffer = allocator.allocateBuffer(
         maxScratchSize, vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eStorageBuffer,
-        VMA_MEMORY_USAGE_GPU_ONLY);
+        VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::eScratch);
     const auto scratchBufferAddr = scratchBuffer.deviceAddress(context.device());
 
+    // Start recording (all of them up front, so that the profiler scope can start in the first one and end in the last
+    // one):
+    for (const auto& commandBuffer : commandBuffers) {
+        commandBuffer.begin(vk::CommandBufferBeginInfo{
+            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+        });
+    }
+    PRISM_PROFILE_GPU_BEGIN(blasScope, context.gpuProfiler(), commandBuffers.front(), "scene/blas");
+
     for (size_t i = 0, currGeometryOffset = 0; i < meshGroups.size(); ++i) {
         auto&       buildGeometryInfo = buildGeometryInfos[i];
         const auto& meshGroup         = meshGroups[i];
         const auto& commandBuffer     = commandBuffers[i];
 
-        // Start recording:
-        commandBuffer.begin(vk::CommandBufferBeginInfo{
-            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
-        });
-
         buildGeometryInfo.scratchData.deviceAddress = scratchBufferAddr;
 
         // Apparently we need an array of pointers to the range info, so we make sure to add that here:
@@ -389,6 +981,7 @@ std::vector<Scene::AccelStructInfo> Scene::createBlas(const Context& context, co
         currGeometryOffset += meshGroup.size();
     }
 
+    PRISM_PROFILE_GPU_END(blasScope, context.gpuProfiler(), commandBuffers.back());
     submitAndWait(context, commandBuffers, "BLAS construction");
 
     // If we turned compaction on, then we can move the values over:
@@ -399,98 +992,579 @@ std::vector<Scene::AccelStructInfo> Scene::createBlas(const Context& context, co
     return blases;
 }
 
-Scene::AccelStructInfo Scene::createTlas(const Context& context, const GPUAllocator& gpuAllocator,
-                                         const vk::CommandPool& commandPool, const std::span<const Instance> instances,
-                                         const std::span<const AccelStructInfo> blases)
+//
+// Bounds of the instances (for the update heuristic):
+
+static glm::vec3 transformPoint(const vk::TransformMatrixKHR& transform, const glm::vec3& p)
 {
-    //
-    // Convert instances to vulkan instances.
-
-    std::vector<vk::AccelerationStructureInstanceKHR> vkInstances;
-    vkInstances.reserve(instances.size());
-
-    for (const auto& instance : instances) {
-        vkInstances.emplace_back(vk::AccelerationStructureInstanceKHR{
-            .transform                              = static_cast<vk::TransformMatrixKHR>(instance.transform),
-            .instanceCustomIndex                    = instance.customId,
-            .mask                                   = instance.mask,
-            .instanceShaderBindingTableRecordOffset = instance.hitGroupId,
-            .flags                                  = static_cast<vk::GeometryInstanceFlagsKHR::MaskType>(
-                vk::GeometryInstanceFlagBitsKHR::eTriangleFacingCullDisable),
-            .accelerationStructureReference =
-                context.device().getAccelerationStructureAddressKHR(vk::AccelerationStructureDeviceAddressInfoKHR{
-                    .accelerationStructure = *blases[instance.meshGroupIdx].accelStruct,
-                }),
+    const auto& m = transform.matrix;
+    return glm::vec3(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+                     m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+                     m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+}
+
+// The bounds of the transformed corners:
+static BBox3f transformBounds(const vk::TransformMatrixKHR& transform, const BBox3f& bounds)
+{
+    BBox3f result;
+    if (!bounds.empty()) {
+        for (int corner = 0; corner < 8; ++corner) {
+            result.extend(transformPoint(transform, glm::vec3((corner & 1) ? bounds.pmax.x : bounds.pmin.x,
+                                                              (corner & 2) ? bounds.pmax.y : bounds.pmin.y,
+                                                              (corner & 4) ? bounds.pmax.z : bounds.pmin.z)));
+        }
+    }
+    return result;
+}
+
+std::vector<BBox3f> Scene::computeMeshGroupBounds(const std::span<const SceneBuilder::Mesh>      meshes,
+                                                  const std::span<const Vertex>                  vertices,
+                                                  const std::span<const vk::TransformMatrixKHR>  transforms,
+                                                  const MeshGroupsView                           meshGroups)
+{
+    std::vector<BBox3f> meshBounds;
+    meshBounds.reserve(meshes.size());
+    for (const auto& mesh : meshes) {
+        BBox3f bounds;
+        for (const auto& vertex : vertices.subspan(mesh.verticesOffset, mesh.numVertices)) {
+            bounds.extend(vertex.pos);
+        }
+        meshBounds.emplace_back(bounds);
+    }
+
+    std::vector<BBox3f> groupBounds;
+    groupBounds.reserve(meshGroups.size());
+    for (size_t i = 0; i < meshGroups.size(); ++i) {
+        BBox3f bounds;
+        for (const auto& [meshIdx, transformIdx] : meshGroups[i]) {
+            bounds.extend(transformIdx.isNone() ? meshBounds[meshIdx]
+                                                : transformBounds(transforms[transformIdx], meshBounds[meshIdx]));
+        }
+        groupBounds.emplace_back(bounds);
+    }
+
+    return groupBounds;
+}
+
+//
+// Dynamic instances:
+
+Scene::InstanceSlot& Scene::instanceSlot(const InstanceIndex instanceIdx)
+{
+    if (instanceIdx >= m_instances.size() || !m_instances[instanceIdx].alive) {
+        throw std::runtime_error("Instance " + std::to_string(instanceIdx) + " isn't in the scene.");
+    }
+    return m_instances[instanceIdx];
+}
+
+void Scene::setInstance(const uint32_t slotIdx, const Instance& instance)
+{
+    if (instance.meshGroupIdx >= m_blasAddresses.size()) {
+        throw std::runtime_error("Can't add an instance of mesh group " + std::to_string(instance.meshGroupIdx) +
+                                 ", the scene only has " + std::to_string(m_blasAddresses.size()) + " mesh groups.");
+    }
+
+    auto& slot = m_instances[slotIdx];
+
+    // A refit can't change which instances are active, so a slot that wasn't in the last build needs a rebuild:
+    if (!slot.vkInstance.accelerationStructureReference) {
+        m_needsRebuild = true;
+    }
+
+    const auto transform = static_cast<vk::TransformMatrixKHR>(instance.transform);
+
+    slot = InstanceSlot{
+        .vkInstance =
+            vk::AccelerationStructureInstanceKHR{
+                .transform                              = transform,
+                .instanceCustomIndex                    = instance.customId,
+                .mask                                   = instance.mask,
+                .instanceShaderBindingTableRecordOffset = instance.hitGroupId,
+                .flags                                  = static_cast<vk::GeometryInstanceFlagsKHR::MaskType>(
+                    vk::GeometryInstanceFlagBitsKHR::eTriangleFacingCullDisable),
+                .accelerationStructureReference = m_blasAddresses[instance.meshGroupIdx],
+            },
+        .meshGroupIdx = instance.meshGroupIdx,
+        .mask         = instance.mask,
+        .alive           = true,
+        .visible         = true,
+        .changed         = slot.changed,
+        .bounds          = transformBounds(transform, m_meshGroupBounds[instance.meshGroupIdx]),
+        .buildBounds     = slot.buildBounds,
+        .boundsArea      = slot.boundsArea,
+        .grownBoundsArea = slot.grownBoundsArea,
+    };
+    markSlotChanged(slotIdx);
+}
+
+void Scene::markSlotChanged(const uint32_t slotIdx)
+{
+    auto& slot = m_instances[slotIdx];
+    if (!slot.changed) {
+        slot.changed = true;
+        m_changedSlots[std::atomic_ref(m_numChangedSlots).fetch_add(1)] = slotIdx;
+    }
+}
+
+void Scene::updateSlotAreas(InstanceSlot& slot)
+{
+    m_boundsArea -= slot.boundsArea;
+    m_grownBoundsArea -= slot.grownBoundsArea;
+
+    // Removed slots stay in the TLAS with an empty mask, but where they are doesn't matter anymore:
+    if (slot.alive) {
+        BBox3f grownBounds = slot.bounds;
+        grownBounds.extend(slot.buildBounds);
+
+        slot.boundsArea      = slot.bounds.surfaceArea();
+        slot.grownBoundsArea = grownBounds.surfaceArea();
+    } else {
+        slot.boundsArea      = 0.f;
+        slot.grownBoundsArea = 0.f;
+    }
+
+    m_boundsArea += slot.boundsArea;
+    m_grownBoundsArea += slot.grownBoundsArea;
+}
+
+InstanceIndex Scene::addInstance(const Instance& instance)
+{
+    if (m_freeInstances.empty()) {
+        throw std::runtime_error("Can't add more than " + std::to_string(m_instances.size()) +
+                                 " instances to the scene (see SceneParam::extraInstanceCapacity).");
+    }
+
+    const uint32_t slotIdx = m_freeInstances.back();
+    setInstance(slotIdx, instance);
+    m_freeInstances.pop_back();
+
+    return InstanceIndex(slotIdx);
+}
+
+void Scene::removeInstance(const InstanceIndex instanceIdx)
+{
+    auto& slot = instanceSlot(instanceIdx);
+
+    // The slot stays active in the TLAS (with an empty mask) until it's used again, so removing only needs a refit:
+    slot.alive           = false;
+    slot.visible         = false;
+    slot.vkInstance.mask = 0;
+    markSlotChanged(instanceIdx);
+
+    m_freeInstances.push_back(instanceIdx);
+}
+
+void Scene::setInstanceTransform(const InstanceIndex instanceIdx, const Transform& transform)
+{
+    auto& slot = instanceSlot(instanceIdx);
+
+    slot.vkInstance.transform = static_cast<vk::TransformMatrixKHR>(transform);
+    slot.bounds               = transformBounds(slot.vkInstance.transform, m_meshGroupBounds[slot.meshGroupIdx]);
+    markSlotChanged(instanceIdx);
+}
+
+void Scene::setInstanceVisible(const InstanceIndex instanceIdx, const bool visible)
+{
+    auto& slot = instanceSlot(instanceIdx);
+
+    slot.visible         = visible;
+    slot.vkInstance.mask = visible ? slot.mask : 0;
+    markSlotChanged(instanceIdx);
+}
+
+//
+// Dynamic meshes:
+
+void Scene::createDynamicMeshes(const Context& context, const GPUAllocator& allocator, const SceneBuilder& sceneBuilder)
+{
+    const auto& meshes = sceneBuilder.m_meshes;
+
+    m_dynamicMeshes.resize(meshes.size());
+
+    uint32_t numDynamicVertices = 0;
+    for (const auto& mesh : meshes) {
+        numDynamicVertices += mesh.dynamic ? mesh.numVertices : 0;
+    }
+    if (numDynamicVertices == 0) {
+        return;
+    }
+
+    // Both copies are stored in one buffer (the first copy of every mesh followed by the second one). It stays mapped,
+    // so that the new positions can be written without a staging buffer:
+    m_dynamicPositions = allocator.allocateBuffer(
+        vk::BufferCreateInfo{
+            .size  = 2 * sizeof(glm::vec3) * numDynamicVertices,
+            .usage = vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR |
+                     vk::BufferUsageFlagBits::eShaderDeviceAddress,
+        },
+        VmaAllocationCreateInfo{
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            .usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+        },
+        MemoryCategory::eGeometry);
+
+    const auto positionsAddr = m_dynamicPositions.deviceAddress(context.device());
+    auto*      positions     = m_dynamicPositions.map<glm::vec3>();
+
+    // Both copies start out with the positions of the builder:
+    for (uint32_t i = 0, offset = 0; i < meshes.size(); ++i) {
+        const auto& mesh = meshes[i];
+        if (!mesh.dynamic) {
+            continue;
+        }
+
+        DynamicMesh dynamicMesh{
+            .positionsOffsets = {offset, numDynamicVertices + offset},
+            .numVertices      = mesh.numVertices,
+            .current          = 0,
+            .changed          = false,
+        };
+        for (uint32_t copy = 0; copy < 2; ++copy) {
+            dynamicMesh.positionsAddrs[copy] = positionsAddr + sizeof(glm::vec3) * dynamicMesh.positionsOffsets[copy];
+
+            for (uint32_t v = 0; v < mesh.numVertices; ++v) {
+                positions[dynamicMesh.positionsOffsets[copy] + v] =
+                    sceneBuilder.m_vertices[mesh.verticesOffset + v].pos;
+            }
+        }
+
+        m_dynamicMeshes[i] = dynamicMesh;
+        offset += mesh.numVertices;
+    }
+
+    m_dynamicPositions.flush();
+    m_dynamicPositions.unmap();
+}
+
+void Scene::createDynamicBlases(const Context& context, const GPUAllocator& allocator, const SceneBuilder& sceneBuilder)
+{
+    const auto meshGroups = sceneBuilder.meshGroups();
+
+    // Every BLAS gets its own part of the scratch buffer, so that they can all be refitted by a single command:
+    const vk::DeviceSize scratchAlignment =
+        context.properties()
+            .get<vk::PhysicalDeviceAccelerationStructurePropertiesKHR>()
+            .minAccelerationStructureScratchOffsetAlignment;
+
+    vk::DeviceSize scratchSize = 0;
+    for (uint32_t groupIdx = 0; groupIdx < meshGroups.size(); ++groupIdx) {
+        const auto& meshGroup = meshGroups[groupIdx];
+
+        const bool dynamic = std::ranges::any_of(
+            meshGroup, [&](const PlacedMesh& placedMesh) { return m_dynamicMeshes[placedMesh.meshIdx].has_value(); });
+        if (!dynamic) {
+            continue;
+        }
+
+        DynamicBlas dynamicBlas{.meshGroupIdx = MeshGroupIndex(groupIdx)};
+
+        std::vector<uint32_t> maxPrimitiveCounts;
+        maxPrimitiveCounts.reserve(meshGroup.size());
+        for (const auto& [meshIdx, transformIdx] : meshGroup) {
+            const auto& mesh        = sceneBuilder.m_meshes[meshIdx];
+            const auto& dynamicMesh = m_dynamicMeshes[meshIdx];
+
+            const auto [geometry, buildRangeInfo] =
+                blasGeometry(context, m_meshGpuData, mesh, dynamicMesh ? &*dynamicMesh : nullptr, transformIdx);
+            dynamicBlas.geometries.emplace_back(geometry);
+            dynamicBlas.buildRangeInfos.emplace_back(buildRangeInfo);
+            dynamicBlas.geometryMeshes.emplace_back(meshIdx);
+            maxPrimitiveCounts.emplace_back(mesh.numFaces);
+
+            // Kept to recompute the bounds of the mesh group when the positions of its dynamic meshes change:
+            BBox3f meshBounds;
+            for (uint32_t v = 0; v < mesh.numVertices; ++v) {
+                meshBounds.extend(sceneBuilder.m_vertices[mesh.verticesOffset + v].pos);
+            }
+            if (transformIdx.isNone()) {
+                dynamicBlas.geometryTransforms.emplace_back(std::nullopt);
+                dynamicBlas.geometryBounds.emplace_back(meshBounds);
+            } else {
+                dynamicBlas.geometryTransforms.emplace_back(sceneBuilder.m_transforms[transformIdx]);
+                dynamicBlas.geometryBounds.emplace_back(
+                    transformBounds(sceneBuilder.m_transforms[transformIdx], meshBounds));
+            }
+        }
+
+        const auto buildSizeInfo = context.device().getAccelerationStructureBuildSizesKHR(
+            vk::AccelerationStructureBuildTypeKHR::eDevice,
+            vk::AccelerationStructureBuildGeometryInfoKHR{
+                .type          = vk::AccelerationStructureTypeKHR::eBottomLevel,
+                .flags         = DYNAMIC_BLAS_BUILD_FLAGS,
+                .mode          = vk::BuildAccelerationStructureModeKHR::eUpdate,
+                .geometryCount = static_cast<uint32_t>(dynamicBlas.geometries.size()),
+                .pGeometries   = dynamicBlas.geometries.data(),
+            },
+            maxPrimitiveCounts);
+
+        dynamicBlas.scratchOffset = scratchSize;
+        scratchSize += alignUp(buildSizeInfo.updateScratchSize, scratchAlignment);
+
+        m_dynamicBlases.emplace_back(std::move(dynamicBlas));
+    }
+
+    // The start of the buffer is aligned when the refits are recorded, hence the extra space:
+    if (scratchSize > 0) {
+        m_dynamicScratch = allocator.allocateBuffer(
+            scratchSize + scratchAlignment,
+            vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eStorageBuffer,
+            VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::eScratch);
+    }
+}
+
+uint32_t Scene::recordBlasRefits(const vk::CommandBuffer& commandBuffer, const Context& context)
+{
+    const vk::DeviceSize scratchAlignment =
+        context.properties()
+            .get<vk::PhysicalDeviceAccelerationStructurePropertiesKHR>()
+            .minAccelerationStructureScratchOffsetAlignment;
+    const auto scratchAddr = alignUp(m_dynamicScratch.deviceAddress(context.device()), scratchAlignment);
+
+    std::vector<vk::AccelerationStructureBuildGeometryInfoKHR>     buildGeometryInfos;
+    std::vector<const vk::AccelerationStructureBuildRangeInfoKHR*> buildRangeInfoPtrs;
+
+    for (auto& dynamicBlas : m_dynamicBlases) {
+        const bool changed = std::ranges::any_of(dynamicBlas.geometryMeshes, [&](const uint32_t meshIdx) {
+            return m_dynamicMeshes[meshIdx] && m_dynamicMeshes[meshIdx]->changed;
+        });
+        if (!changed) {
+            continue;
+        }
+
+        // The changed meshes are read from the copy with the new positions, the others from the one they were last
+        // built from:
+        for (size_t i = 0; i < dynamicBlas.geometries.size(); ++i) {
+            const auto& dynamicMesh = m_dynamicMeshes[dynamicBlas.geometryMeshes[i]];
+            if (dynamicMesh) {
+                dynamicBlas.geometries[i].geometry.triangles.vertexData.deviceAddress =
+                    dynamicMesh->positionsAddrs[dynamicMesh->changed ? dynamicMesh->current ^ 1 : dynamicMesh->current];
+            }
+        }
+
+        const auto& blas = *m_blases[dynamicBlas.meshGroupIdx].accelStruct;
+        buildGeometryInfos.emplace_back(vk::AccelerationStructureBuildGeometryInfoKHR{
+            .type                     = vk::AccelerationStructureTypeKHR::eBottomLevel,
+            .flags                    = DYNAMIC_BLAS_BUILD_FLAGS,
+            .mode                     = vk::BuildAccelerationStructureModeKHR::eUpdate,
+            .srcAccelerationStructure = blas,
+            .dstAccelerationStructure = blas,
+            .geometryCount            = static_cast<uint32_t>(dynamicBlas.geometries.size()),
+            .pGeometries              = dynamicBlas.geometries.data(),
+            .scratchData = vk::DeviceOrHostAddressKHR{.deviceAddress = scratchAddr + dynamicBlas.scratchOffset},
         });
+        buildRangeInfoPtrs.emplace_back(dynamicBlas.buildRangeInfos.data());
     }
 
-    const uint32_t numInstances = instances.size();
+    if (!buildGeometryInfos.empty()) {
+        PRISM_PROFILE_GPU_BEGIN(refitScope, context.gpuProfiler(), commandBuffer, "scene/blas_refit");
+        commandBuffer.buildAccelerationStructuresKHR(buildGeometryInfos, buildRangeInfoPtrs);
+        PRISM_PROFILE_GPU_END(refitScope, context.gpuProfiler(), commandBuffer);
+    }
 
-    const auto commandBuffer = std::move(context.device().allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{
-        .commandPool        = commandPool,
-        .level              = vk::CommandBufferLevel::ePrimary,
-        .commandBufferCount = 1,
-    })[0]);
+    // The copies with the new positions are now the ones the BLASes were built from:
+    for (auto& dynamicMesh : m_dynamicMeshes) {
+        if (dynamicMesh && dynamicMesh->changed) {
+            dynamicMesh->current ^= 1;
+            dynamicMesh->changed = false;
+        }
+    }
 
-    commandBuffer->begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    return static_cast<uint32_t>(buildGeometryInfos.size());
+}
 
-    //
-    // Record the command to copy the instance data to the GPU.
+void Scene::setMeshPositions(const MeshIndex meshIdx, const std::span<const glm::vec3> positions)
+{
+    if (meshIdx >= m_dynamicMeshes.size() || !m_dynamicMeshes[meshIdx]) {
+        throw std::runtime_error("Mesh " + std::to_string(meshIdx) +
+                                 " isn't dynamic (see SceneBuilder::setMeshDynamic)");
+    }
 
-    const auto gpuInstances = gpuAllocator.allocateBuffer(
-        sizeof(vk::AccelerationStructureInstanceKHR) * instances.size(),
-        vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eTransferDst |
-            vk::BufferUsageFlagBits::eShaderDeviceAddress,
-        VMA_MEMORY_USAGE_GPU_ONLY);
+    auto& dynamicMesh = *m_dynamicMeshes[meshIdx];
+    if (positions.size() != dynamicMesh.numVertices) {
+        throw std::runtime_error("Mesh " + std::to_string(meshIdx) + " has " +
+                                 std::to_string(dynamicMesh.numVertices) + " vertices, but " +
+                                 std::to_string(positions.size()) + " positions were provided");
+    }
 
-    const auto stagingInstances = addCopyToBufferCommand(*commandBuffer, gpuAllocator, gpuInstances, vkInstances);
+    // The other copy isn't used by the device (see update), so it can be written right away:
+    const auto offset = dynamicMesh.positionsOffsets[dynamicMesh.current ^ 1];
+    std::ranges::copy(positions, m_dynamicPositions.map<glm::vec3>() + offset);
+    m_dynamicPositions.flush(sizeof(glm::vec3) * offset, sizeof(glm::vec3) * positions.size());
+    m_dynamicPositions.unmap();
+
+    dynamicMesh.changed = true;
 
     //
-    // Make sure the instances data is copied to the GPU before we start constructing the TLAS:
+    // The mesh groups with the mesh get new bounds, their instances are refreshed by update:
 
-    commandBuffer->pipelineBarrier(
-        vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
-        vk::DependencyFlags{},
-        vk::MemoryBarrier{.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
-                          .dstAccessMask = vk::AccessFlagBits::eAccelerationStructureWriteKHR},
-        {}, {});
+    BBox3f meshBounds;
+    for (const auto& position : positions) {
+        meshBounds.extend(position);
+    }
 
-    //
-    // Allocate the required memory for constructing the TLAS:
+    for (auto& dynamicBlas : m_dynamicBlases) {
+        bool hasMesh = false;
+        for (size_t i = 0; i < dynamicBlas.geometryMeshes.size(); ++i) {
+            if (dynamicBlas.geometryMeshes[i] == meshIdx) {
+                const auto& transform         = dynamicBlas.geometryTransforms[i];
+                dynamicBlas.geometryBounds[i] = transform ? transformBounds(*transform, meshBounds) : meshBounds;
+                hasMesh                       = true;
+            }
+        }
+        if (!hasMesh) {
+            continue;
+        }
 
-    const vk::AccelerationStructureGeometryKHR geometry{
+        BBox3f groupBounds;
+        for (const auto& geometryBounds : dynamicBlas.geometryBounds) {
+            groupBounds.extend(geometryBounds);
+        }
+        m_meshGroupBounds[dynamicBlas.meshGroupIdx] = groupBounds;
+
+        if (!m_meshGroupBoundsChanged[dynamicBlas.meshGroupIdx]) {
+            m_meshGroupBoundsChanged[dynamicBlas.meshGroupIdx] = 1;
+            m_changedMeshGroups.push_back(dynamicBlas.meshGroupIdx);
+        }
+    }
+}
+
+SceneUpdateInfo Scene::update(const Context& context, const SceneUpdateParam& param)
+{
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    PRISM_PROFILE_SCOPE("scene/update");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // The instances of the mesh groups whose bounds changed with their dynamic meshes (see setMeshPositions):
+    if (!m_changedMeshGroups.empty()) {
+        for (uint32_t slotIdx = 0; slotIdx < m_instances.size(); ++slotIdx) {
+            auto& slot = m_instances[slotIdx];
+            if (slot.alive && m_meshGroupBoundsChanged[slot.meshGroupIdx]) {
+                slot.bounds = transformBounds(slot.vkInstance.transform, m_meshGroupBounds[slot.meshGroupIdx]);
+                markSlotChanged(slotIdx);
+            }
+        }
+        for (const auto meshGroupIdx : m_changedMeshGroups) {
+            m_meshGroupBoundsChanged[meshGroupIdx] = 0;
+        }
+        m_changedMeshGroups.clear();
+    }
+
+    // A refit keeps every instance in the leaf it had at the last build, and the boxes above it have to grow to contain
+    // wherever it is now. So the more the bounds of the instances grew compared to the bounds at the last build, the
+    // more the boxes of the TLAS overlap. The sums are kept up to date, so only the slots that changed are visited:
+    const uint32_t changedInstances = m_numChangedSlots;
+    for (const uint32_t slotIdx : std::span(m_changedSlots).first(changedInstances)) {
+        updateSlotAreas(m_instances[slotIdx]);
+    }
+
+    SceneUpdateInfo info{
+        .rebuilt          = false,
+        .changedInstances = changedInstances,
+        .refittedBlases   = 0,
+        .boundsGrowth     = m_boundsArea > 0.0 ? static_cast<float>(m_grownBoundsArea / m_boundsArea) : 1.0f,
+        .ms               = 0.0,
+    };
+
+    const bool meshesChanged = std::ranges::any_of(m_dynamicMeshes, [](const std::optional<DynamicMesh>& dynamicMesh) {
+        return dynamicMesh && dynamicMesh->changed;
+    });
+
+    if (meshesChanged || changedInstances > 0 || param.forceRebuild) {
+        info.rebuilt = param.forceRebuild || m_needsRebuild || m_numRefits >= param.maxRefits ||
+                       info.boundsGrowth > param.maxBoundsGrowth;
+
+        // The previous update has finished (see submitAndWait), so its command buffer can be recorded again:
+        const auto& commandBuffer = m_tlasCommandBuffer;
+
+        commandBuffer->begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+        // The TLAS has to be refitted after the BLASes even if no instance changed, as the bounds of the BLASes did:
+        if (meshesChanged) {
+            info.refittedBlases = recordBlasRefits(*commandBuffer, context);
+            commandBuffer->pipelineBarrier(
+                vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+                vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, vk::DependencyFlags{},
+                vk::MemoryBarrier{.srcAccessMask = vk::AccessFlagBits::eAccelerationStructureWriteKHR,
+                                  .dstAccessMask = vk::AccessFlagBits::eAccelerationStructureReadKHR},
+                {}, {});
+        }
+        recordTlasBuild(*commandBuffer, context, !info.rebuilt);
+
+        submitAndWait(context, *commandBuffer, "Updating the scene");
+    }
+
+    info.ms = Milliseconds(std::chrono::steady_clock::now() - start).count();
+    return info;
+}
+
+// Every instance slot is in the TLAS, see TlasGpuData:
+static constexpr vk::BuildAccelerationStructureFlagsKHR TLAS_BUILD_FLAGS =
+    vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace |
+    vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate;
+
+static vk::AccelerationStructureGeometryKHR tlasGeometry(const vk::DeviceAddress instancesAddr)
+{
+    return vk::AccelerationStructureGeometryKHR{
         .geometryType = vk::GeometryTypeKHR::eInstances,
         .geometry =
             vk::AccelerationStructureGeometryDataKHR{.instances = vk::AccelerationStructureGeometryInstancesDataKHR{
                                                          .arrayOfPointers = VK_FALSE,
-                                                         .data = gpuInstances.deviceAddress(context.device()),
+                                                         .data            = instancesAddr,
                                                      }}};
+}
+
+Scene::TlasGpuData Scene::createTlas(const Context& context, const GPUAllocator& gpuAllocator,
+                                     const uint32_t numInstanceSlots)
+{
+    //
+    // The instances and their records stay mapped, so that they can be written without a staging buffer:
+
+    const auto allocateMapped = [&](const vk::DeviceSize size, const vk::BufferUsageFlags usage,
+                                    const MemoryCategory category) {
+        return gpuAllocator.allocateBuffer(vk::BufferCreateInfo{.size = size, .usage = usage},
+                                           VmaAllocationCreateInfo{
+                                               .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                                               .usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                           },
+                                           category);
+    };
+
+    auto gpuInstances       = allocateMapped(sizeof(vk::AccelerationStructureInstanceKHR) * numInstanceSlots,
+                                             vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR |
+                                                 vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                                             MemoryCategory::eTlas);
+    auto gpuInstanceRecords = allocateMapped(sizeof(shader::InstanceRecord) * numInstanceSlots,
+                                             vk::BufferUsageFlagBits::eStorageBuffer, MemoryCategory::eGeometry);
+
+    //
+    // Allocate the required memory for constructing the TLAS:
+
+    const auto geometry = tlasGeometry(gpuInstances.deviceAddress(context.device()));
 
-    vk::AccelerationStructureBuildGeometryInfoKHR buildGeometryInfo{
+    const vk::AccelerationStructureBuildGeometryInfoKHR buildGeometryInfo{
         .type          = vk::AccelerationStructureTypeKHR::eTopLevel,
-        .flags         = vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace,
+        .flags         = TLAS_BUILD_FLAGS,
         .mode          = vk::BuildAccelerationStructureModeKHR::eBuild,
-        .geometryCount = numInstances,
+        .geometryCount = 1,
         .pGeometries   = &geometry,
     };
 
     const auto buildSizeInfo = context.device().getAccelerationStructureBuildSizesKHR(
-        vk::AccelerationStructureBuildTypeKHR::eDevice, buildGeometryInfo, numInstances);
+        vk::AccelerationStructureBuildTypeKHR::eDevice, buildGeometryInfo, numInstanceSlots);
 
-    // Allocate the scratch buffer:
-    const auto scratchBuffer = gpuAllocator.allocateBuffer(buildSizeInfo.buildScratchSize,
-                                                           vk::BufferUsageFlagBits::eShaderDeviceAddress |
-                                                               vk::BufferUsageFlagBits::eStorageBuffer,
-                                                           VMA_MEMORY_USAGE_GPU_ONLY);
+    // Kept around for the updates, so it has to be large enough for a refit too:
+    auto scratchBuffer = gpuAllocator.allocateBuffer(
+        std::max(buildSizeInfo.buildScratchSize, buildSizeInfo.updateScratchSize),
+        vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eStorageBuffer,
+        VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::eScratch);
 
     // Allocate the buffer where we will store the tlas:
     auto tlasBuffer = gpuAllocator.allocateBuffer(buildSizeInfo.accelerationStructureSize,
                                                   vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR |
                                                       vk::BufferUsageFlagBits::eShaderDeviceAddress,
-                                                  VMA_MEMORY_USAGE_GPU_ONLY);
-
-    //
-    // Record the creation of the TLAS in the command buffer:
+                                                  VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::eTlas);
 
     auto tlasAccelStruct = context.device().createAccelerationStructureKHRUnique(vk::AccelerationStructureCreateInfoKHR{
         //.createFlags, TODO: figure out if this is required or not... (I don't think it is).
@@ -499,15 +1573,150 @@ Scene::AccelStructInfo Scene::createTlas(const Context& context, const GPUAlloca
         .type   = vk::AccelerationStructureTypeKHR::eTopLevel,
     });
 
-    buildGeometryInfo.dstAccelerationStructure  = *tlasAccelStruct;
-    buildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress(context.device());
+    return TlasGpuData{
+        .tlas            = AccelStructInfo{.buffer = std::move(tlasBuffer), .accelStruct = std::move(tlasAccelStruct)},
+        .instances       = std::move(gpuInstances),
+        .instanceRecords = std::move(gpuInstanceRecords),
+        .scratch         = std::move(scratchBuffer),
+    };
+}
+
+void Scene::recordTlasBuild(const vk::CommandBuffer& commandBuffer, const Context& context, const bool refit)
+{
+    const uint32_t numSlots = static_cast<uint32_t>(m_instances.size());
+
+    //
+    // Write the slots that changed to the mapped buffers (the device isn't using them, see update). The other slots
+    // are still in the buffers from earlier updates:
+
+    const auto changedSlots = std::span(m_changedSlots).first(m_numChangedSlots);
+    std::ranges::sort(changedSlots);
+
+    auto* vkInstances     = m_tlas.instances.map<vk::AccelerationStructureInstanceKHR>();
+    auto* instanceRecords = m_tlas.instanceRecords.map<shader::InstanceRecord>();
+
+    for (const uint32_t slotIdx : changedSlots) {
+        auto& slot = m_instances[slotIdx];
+
+        vkInstances[slotIdx]     = slot.vkInstance;
+        instanceRecords[slotIdx] = shader::InstanceRecord{
+            .geometryRecordsOffset =
+                slot.vkInstance.accelerationStructureReference ? m_geometryRecordsOffsets[slot.meshGroupIdx] : 0,
+        };
+        slot.changed = false;
+    }
+
+    // Consecutive slots are flushed together:
+    for (size_t begin = 0; begin < changedSlots.size();) {
+        size_t end = begin + 1;
+        while (end < changedSlots.size() && changedSlots[end] == changedSlots[end - 1] + 1) {
+            ++end;
+        }
+
+        const vk::DeviceSize firstSlot = changedSlots[begin];
+        const vk::DeviceSize numRange  = end - begin;
+        m_tlas.instances.flush(sizeof(vk::AccelerationStructureInstanceKHR) * firstSlot,
+                               sizeof(vk::AccelerationStructureInstanceKHR) * numRange);
+        m_tlas.instanceRecords.flush(sizeof(shader::InstanceRecord) * firstSlot,
+                                     sizeof(shader::InstanceRecord) * numRange);
+        begin = end;
+    }
+    m_numChangedSlots = 0;
+
+    m_tlas.instances.unmap();
+    m_tlas.instanceRecords.unmap();
+
+    //
+    // Record the build (or the refit, which updates the TLAS in place). The host writes are visible to the device once
+    // the command buffer is submitted, so no barrier is needed:
+
+    PRISM_PROFILE_GPU_BEGIN(tlasScope, context.gpuProfiler(), commandBuffer, refit ? "scene/tlas_refit" : "scene/tlas");
+
+    const auto geometry = tlasGeometry(m_tlas.instances.deviceAddress(context.device()));
+
+    const vk::AccelerationStructureBuildGeometryInfoKHR buildGeometryInfo{
+        .type                     = vk::AccelerationStructureTypeKHR::eTopLevel,
+        .flags                    = TLAS_BUILD_FLAGS,
+        .mode                     = refit ? vk::BuildAccelerationStructureModeKHR::eUpdate
+                                          : vk::BuildAccelerationStructureModeKHR::eBuild,
+        .srcAccelerationStructure = refit ? *m_tlas.tlas.accelStruct : vk::AccelerationStructureKHR{},
+        .dstAccelerationStructure = *m_tlas.tlas.accelStruct,
+        .geometryCount            = 1,
+        .pGeometries              = &geometry,
+        .scratchData = vk::DeviceOrHostAddressKHR{.deviceAddress = m_tlas.scratch.deviceAddress(context.device())},
+    };
+
+    const vk::AccelerationStructureBuildRangeInfoKHR buildRangeInfo{.primitiveCount = numSlots};
+    commandBuffer.buildAccelerationStructuresKHR(buildGeometryInfo, &buildRangeInfo);
+
+    PRISM_PROFILE_GPU_END(tlasScope, context.gpuProfiler(), commandBuffer);
+
+    // The bookkeeping is done as the build is recorded, the caller submits it right away:
+    if (refit) {
+        ++m_numRefits;
+    } else {
+        // The bounds at the build are the current ones, so nothing has grown yet:
+        m_boundsArea      = 0.0;
+        m_grownBoundsArea = 0.0;
+        for (auto& slot : m_instances) {
+            slot.buildBounds     = slot.bounds;
+            slot.boundsArea      = 0.f;
+            slot.grownBoundsArea = 0.f;
+            updateSlotAreas(slot);
+        }
+        m_numRefits    = 0;
+        m_needsRebuild = false;
+    }
+}
+
+UniqueBuffer Scene::transferGeometryRecords(const Context& context, const GPUAllocator& gpuAllocator,
+                                            const vk::CommandPool&                         commandPool,
+                                            const std::span<const SceneBuilder::Mesh>      meshes,
+                                            const MeshGroupsView                           meshGroups,
+                                            const bool                                     compactVertices)
+{
+    //
+    // The geometry records are stored in the same order as the geometries of the BLASes, so the record of a hit is
+    // at the mesh group's offset (see m_geometryRecordsOffsets) plus gl_GeometryIndexEXT.
+
+    std::vector<shader::GeometryRecord> geometryRecords;
+    geometryRecords.reserve(meshGroups.placedMeshes.size());
+    for (const auto& [meshIdx, transformIdx] : meshGroups.placedMeshes) {
+        const auto&    mesh  = meshes[meshIdx];
+        const uint32_t flags = (mesh.indices16 ? GEOMETRY_INDICES_16 : 0u) |
+                               (compactVertices ? GEOMETRY_COMPACT_VERTICES : 0u) |
+                               (mesh.nrm ? GEOMETRY_NORMALS : 0u) | (mesh.tan ? GEOMETRY_TANGENTS : 0u);
+        geometryRecords.emplace_back(shader::GeometryRecord{
+            .verticesOffset = mesh.verticesOffset,
+            .facesOffset    = mesh.facesOffset,
+            .transformIdx   = transformIdx.isNone() ? NO_TRANSFORM : static_cast<uint32_t>(transformIdx),
+            .flags          = flags,
+            .uvsOffset      = mesh.uvsMin,
+            .uvsScale       = mesh.uvsMax - mesh.uvsMin,
+        });
+    }
+
+    const auto commandBuffer = std::move(context.device().allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{
+        .commandPool        = commandPool,
+        .level              = vk::CommandBufferLevel::ePrimary,
+        .commandBufferCount = 1,
+    })[0]);
+
+    commandBuffer->begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    PRISM_PROFILE_GPU_BEGIN(recordsScope, context.gpuProfiler(), *commandBuffer, "scene/records");
+
+    auto gpuGeometryRecords = gpuAllocator.allocateBuffer(
+        sizeof(shader::GeometryRecord) * geometryRecords.size(),
+        vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY,
+        MemoryCategory::eGeometry);
 
-    const vk::AccelerationStructureBuildRangeInfoKHR buildRangeInfo{.primitiveCount = numInstances};
-    commandBuffer->buildAccelerationStructuresKHR(buildGeometryInfo, &buildRangeInfo);
+    const auto stagingGeometryRecords =
+        addCopyToBufferCommand(*commandBuffer, gpuAllocator, gpuGeometryRecords, geometryRecords);
 
-    submitAndWait(context, *commandBuffer, "TLAS construction");
+    PRISM_PROFILE_GPU_END(recordsScope, context.gpuProfiler(), *commandBuffer);
+    submitAndWait(context, *commandBuffer, "Transfering geometry records");
 
-    return AccelStructInfo{.buffer = std::move(tlasBuffer), .accelStruct = std::move(tlasAccelStruct)};
+    return gpuGeometryRecords;
 }
 
 UniqueBuffer Scene::transferCamera(const Context& context, const vk::CommandPool& commandPool,
@@ -535,4 +1744,4 @@ UniqueBuffer Scene::transferCamera(const Context& context, const vk::CommandPool
     return gpuShaderData;
 }
 
-} // namespace prism
+} // namespace prism
\ No newline at end of file
@@ -1,13 +1,20 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <limits>
 #include <optional>
 #include <span>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <allocator.hpp>
+#include <bbox.hpp>
 #include <camera.hpp>
 #include <context.hpp>
+#include <mesh_attributes.hpp>
 #include <transform.hpp>
 
 #include <glm/gtx/quaternion.hpp>
@@ -16,14 +23,30 @@
 
 namespace prism {
 
+class Animation;
+
+namespace cpu {
+class Scene;
+} // namespace cpu
+
+// Every index type can hold this value as a sentinel (see none()), which doesn't refer to anything:
+constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
 #define MAKE_INDEX(name)                                                                                               \
     class name                                                                                                         \
     {                                                                                                                  \
+      public:                                                                                                          \
+        static name none() { return name(NO_INDEX); }                                                                  \
+        bool        isNone() const { return idx == NO_INDEX; }                                                         \
+                                                                                                                       \
+      private:                                                                                                         \
         explicit name(uint32_t idx) : idx(idx) {}                                                                      \
         operator uint32_t() const { return idx; }                                                                      \
                                                                                                                        \
         friend class SceneBuilder;                                                                                     \
         friend class Scene;                                                                                            \
+        friend class cpu::Scene;                                                                                       \
+        friend class Animation;                                                                                        \
         uint32_t idx;                                                                                                  \
     }
 
@@ -42,8 +65,25 @@ struct Vertex
 
 struct PlacedMesh
 {
-    MeshIndex                     meshIdx;
-    std::optional<TransformIndex> transformIdx;
+    MeshIndex      meshIdx;
+    TransformIndex transformIdx = TransformIndex::none(); // Not transformed if none
+};
+// Kept small, as scenes can have millions of them:
+static_assert(sizeof(PlacedMesh) == 8);
+
+// The mesh groups of a builder, which are stored as one array with the placed meshes of every group after each other
+// and the offset of every group into it (i.e. CSR):
+struct MeshGroupsView
+{
+    std::span<const PlacedMesh> placedMeshes;
+    std::span<const uint32_t>   offsets; // One more than there are mesh groups, the last one is the end of the array
+
+    size_t size() const { return offsets.size() - 1; }
+
+    std::span<const PlacedMesh> operator[](const size_t groupIdx) const
+    {
+        return placedMeshes.subspan(offsets[groupIdx], offsets[groupIdx + 1] - offsets[groupIdx]);
+    }
 };
 
 struct Instance
@@ -56,6 +96,14 @@ struct Instance
     Transform      transform;
 };
 
+// How many of the created meshes and mesh groups turned out to be identical to an existing one:
+struct DeduplicationStats
+{
+    uint32_t meshes;
+    uint32_t meshGroups;
+    uint64_t savedBytes; // Vertex and face data that wasn't stored a second time
+};
+
 class SceneBuilder
 {
   public:
@@ -63,13 +111,45 @@ class SceneBuilder
 
     void addCamera(std::unique_ptr<Camera> camera);
 
+    // Meshes and mesh groups are deduplicated by their content: creating one that is identical to an existing one
+    // returns the index of the existing one instead (so that it's only stored, uploaded and built once). Mesh groups
+    // compare the matrices of their transforms, not their indices:
     MeshIndex      createMesh(std::string_view path);
     TransformIndex createTransform(const Transform& transform);
     MeshGroupIndex createMeshGroup(std::span<const PlacedMesh> placedMeshes);
     InstanceIndex  createInstance(const Instance& instance);
 
+    // Same as calling createMesh for every path, but the files are loaded in parallel:
+    std::vector<MeshIndex> createMeshes(std::span<const std::string_view> paths);
+    // A mesh generated in code instead of loaded from a file (only has positions, apart from generated attributes):
+    MeshIndex              createMesh(std::span<const glm::vec3> positions, std::span<const glm::u32vec3> faces);
+
+    // The positions of dynamic meshes can be changed on the built scene (see Scene::setMeshPositions). The BLASes of
+    // the mesh groups with a dynamic mesh are built for fast refits instead of fast tracing. Note that a deduplicated
+    // mesh is shared by everything that created it, identical meshes created afterwards get a mesh of their own though:
+    void setMeshDynamic(MeshIndex meshIdx);
+
+    // On by default, changing it only affects the meshes and mesh groups that are created afterwards:
+    void                      setDeduplication(bool enabled) { m_deduplicate = enabled; }
+    bool                      deduplication() const { return m_deduplicate; }
+    const DeduplicationStats& deduplicationStats() const { return m_deduplicationStats; }
+
+    // Off by default, generates the attributes when meshes that don't have them are created. The generated attributes
+    // are stored like loaded ones (so they're part of the deduplication as well):
+    void setAttributeGeneration(const MeshAttributeParam& param) { m_attributeGeneration = param; }
+
+    // Off by default, sorts the faces of the meshes that are created afterwards along a Morton curve and the vertices
+    // by their first use (see mesh_order.hpp), so that BLAS builds and the hit shaders access memory more coherently.
+    // This changes the order of the vertices that Scene::setMeshPositions expects, so it's best left off for meshes
+    // that are made dynamic:
+    void setMeshReordering(bool enabled) { m_reorderMeshes = enabled; }
+
+    // Bytes reserved by every array of the builder (its capacity, as that's what is actually allocated):
+    std::vector<MemoryUsage> hostMemoryUsage() const;
+
   private:
     friend class Scene;
+    friend class cpu::Scene;
 
     struct Mesh
     {
@@ -78,21 +158,66 @@ class SceneBuilder
         uint32_t verticesOffset;
         uint32_t numVertices;
 
-        uint32_t facesOffset;
+        // Bounds of the uvs (zero if there aren't any), compact vertices store the uvs relative to them:
+        glm::vec2 uvsMin, uvsMax;
+
+        // Meshes with few enough vertices have their faces stored with 16 bit indices (in m_faces16):
+        bool     indices16;
+        uint32_t facesOffset; // Into m_faces or m_faces16
         uint32_t numFaces;
+
+        bool dynamic;
     };
 
+    struct LoadedMesh;
+
+    static LoadedMesh loadMesh(std::string_view path);
+    // Reorders the mesh (see setMeshReordering), generates the missing attributes (see setAttributeGeneration) and
+    // hashes it, called before addMesh:
+    void              prepareMesh(LoadedMesh& mesh) const;
+    MeshIndex         addMesh(const LoadedMesh& mesh);
+
+    // Whichever pool the face is stored in:
+    glm::u32vec3 face(const Mesh& mesh, uint32_t faceIdx) const
+    {
+        return mesh.indices16 ? glm::u32vec3(m_faces16[mesh.facesOffset + faceIdx])
+                              : m_faces[mesh.facesOffset + faceIdx];
+    }
+
+    // Used to deduplicate meshes and mesh groups (see createMesh):
+    static uint64_t hashMesh(const LoadedMesh& mesh);
+    bool            meshEquals(const Mesh& mesh, const LoadedMesh& loadedMesh) const;
+    uint64_t        hashMeshGroup(std::span<const PlacedMesh> placedMeshes) const;
+    bool            meshGroupEquals(uint32_t groupIdx, std::span<const PlacedMesh> placedMeshes) const;
+
+    MeshGroupsView meshGroups() const
+    {
+        return MeshGroupsView{.placedMeshes = m_placedMeshes, .offsets = m_meshGroupOffsets};
+    }
+
   private:
     // Raw mesh data:
     std::vector<Mesh> m_meshes;
 
     std::vector<Vertex>                 m_vertices;
     std::vector<glm::u32vec3>           m_faces;
+    std::vector<glm::u16vec3>           m_faces16;
     std::vector<vk::TransformMatrixKHR> m_transforms;
 
-    // Collection of mesh groups:
-    std::vector<std::vector<PlacedMesh>> m_meshGroups;
-    std::vector<Instance>                m_instances;
+    // Collection of mesh groups (see MeshGroupsView):
+    std::vector<PlacedMesh> m_placedMeshes;
+    std::vector<uint32_t>   m_meshGroupOffsets{0};
+    std::vector<Instance>   m_instances;
+
+    // The indices of the meshes and mesh groups by the hash of their content (hashes can collide, so the content of
+    // every candidate is compared as well):
+    std::unordered_multimap<uint64_t, uint32_t> m_meshHashes;
+    std::unordered_multimap<uint64_t, uint32_t> m_meshGroupHashes;
+    DeduplicationStats                          m_deduplicationStats{};
+    bool                                        m_deduplicate = true;
+
+    MeshAttributeParam m_attributeGeneration{};
+    bool               m_reorderMeshes = false;
 
     std::unique_ptr<Camera> m_camera;
 };
@@ -100,6 +225,44 @@ class SceneBuilder
 struct SceneParam
 {
     bool enableCompaction;
+    // Uploads the vertices with quantized normals, tangents and uvs (see CompactVertex), which are about a third of the
+    // size. The positions and with them the BLASes are the same either way:
+    bool compactVertices = false;
+    // How many instances can be added on top of the ones of the builder (see Scene::addInstance):
+    uint32_t extraInstanceCapacity = 0;
+};
+
+// When Scene::update refits the TLAS instead of rebuilding it. A refit keeps the tree of the last build and only grows
+// its boxes, so it's much cheaper, but the boxes get looser the further the instances move away from where they were:
+struct SceneUpdateParam
+{
+    // Rebuilds once the bounds of the instances, grown to also contain where they were at the last build, have this
+    // many times the surface area of their current bounds (summed over every instance):
+    float maxBoundsGrowth = 1.5f;
+    // Rebuilds after this many refits in a row regardless of the bounds:
+    uint32_t maxRefits    = 64;
+    bool     forceRebuild = false;
+};
+
+struct SceneUpdateInfo
+{
+    bool     rebuilt; // False if the TLAS was refitted (or nothing changed)
+    uint32_t changedInstances;
+    uint32_t refittedBlases; // Of the mesh groups with a dynamic mesh that changed
+    float    boundsGrowth;   // The heuristic of SceneUpdateParam::maxBoundsGrowth before the update
+    double   ms;
+};
+
+// How long the different stages of building a scene took. Every stage waits for the device to finish, so these are
+// the times as seen by the host:
+struct SceneBuildTimings
+{
+    double uploadMs = 0.0; // Vertices, faces and transforms
+    double blasMs   = 0.0; // Including the compaction
+    double tlasMs   = 0.0;
+    double totalMs  = 0.0;
+
+    vk::DeviceSize uploadSize = 0; // In bytes
 };
 
 class Scene
@@ -111,18 +274,57 @@ class Scene
     Scene(Scene&&)      = default;
 
     const vk::Buffer&                   gpuVertices() const { return *m_meshGpuData.vertices; }
-    const vk::AccelerationStructureKHR& tlas() const { return *m_tlas.accelStruct; }
+    bool                                compactVertices() const { return m_meshGpuData.compactVertices; }
+    const vk::AccelerationStructureKHR& tlas() const { return *m_tlas.tlas.accelStruct; }
+
+    // Transforms are optional and either of the face pools can be empty, so these may be null handles:
+    vk::Buffer gpuFaces() const { return *m_meshGpuData.faces; }
+    vk::Buffer gpuFaces16() const { return *m_meshGpuData.faces16; }
+    vk::Buffer gpuTransforms() const { return *m_meshGpuData.transforms; }
+
+    // Records used by the hit shaders to find the geometry that was hit (see shaders/scene.hpp):
+    const vk::Buffer& gpuGeometryRecords() const { return *m_geometryRecords; }
+    const vk::Buffer& gpuInstanceRecords() const { return *m_tlas.instanceRecords; }
 
     const vk::Buffer& gpuCameraData() const { return *m_cameraData; }
     // The SPV path is the path to the camera's raygen module:
     std::string_view cameraShaderName() const { return m_cameraShaderName; }
 
+    const SceneBuildTimings& buildTimings() const { return m_buildTimings; }
+
+    //
+    // Instances can be changed after the scene was built. The changes are only applied to the TLAS (and the instance
+    // records) by update, which has to be called while the device isn't using the scene:
+
+    // Throws if there's no capacity left (see SceneParam::extraInstanceCapacity). Removed instances free up their
+    // index, so it can be returned again:
+    InstanceIndex addInstance(const Instance& instance);
+    void          removeInstance(InstanceIndex instanceIdx);
+    // Only touches the instance itself, so different instances can be set from different threads at the same time:
+    void          setInstanceTransform(InstanceIndex instanceIdx, const Transform& transform);
+    // Hidden instances stay in the TLAS with an empty mask, so hiding and showing them only needs a refit:
+    void          setInstanceVisible(InstanceIndex instanceIdx, bool visible);
+
+    uint32_t numInstances() const { return static_cast<uint32_t>(m_instances.size() - m_freeInstances.size()); }
+
+    // Takes a position for every vertex of a dynamic mesh (see SceneBuilder::setMeshDynamic). Every dynamic mesh has
+    // two copies of its positions, the new ones are written to the copy that the last refit didn't read from. The hit
+    // shaders keep reading the original vertices (e.g. for the normals), while the bounds of the mesh groups (and so of
+    // their instances, for the update heuristic) are recomputed from the new positions:
+    void setMeshPositions(MeshIndex meshIdx, std::span<const glm::vec3> positions);
+
+    // Refits the BLASes of the dynamic meshes that changed, and refits or rebuilds the TLAS (see SceneUpdateParam). All
+    // of it is done in a single submission, which this waits for:
+    SceneUpdateInfo update(const Context& context, const SceneUpdateParam& param = {});
+
   private:
     struct MeshGpuData
     {
-        UniqueBuffer vertices;
+        UniqueBuffer vertices; // Either Vertex or CompactVertex
         UniqueBuffer faces;
+        UniqueBuffer faces16;
         UniqueBuffer transforms;
+        bool         compactVertices;
     };
 
     struct AccelStructInfo
@@ -131,30 +333,141 @@ class Scene
         vk::UniqueAccelerationStructureKHR accelStruct;
     };
 
+    // The TLAS is always built for every slot of m_instances, so that it never has to be reallocated. The instance
+    // buffers stay mapped, update writes to them directly:
+    struct TlasGpuData
+    {
+        AccelStructInfo tlas;
+        UniqueBuffer    instances;
+        UniqueBuffer    instanceRecords;
+        UniqueBuffer    scratch; // Large enough for a build and for an update
+    };
+
+    struct DynamicMesh
+    {
+        std::array<uint32_t, 2>          positionsOffsets; // In vertices, from the start of m_dynamicPositions
+        uint32_t                         numVertices;
+        std::array<vk::DeviceAddress, 2> positionsAddrs;
+        uint32_t                         current; // The copy that the BLASes were last built from
+        bool                             changed; // The other copy has new positions
+    };
+
+    // Everything needed to refit the BLAS of a mesh group with a dynamic mesh:
+    struct DynamicBlas
+    {
+        MeshGroupIndex                                          meshGroupIdx;
+        std::vector<vk::AccelerationStructureGeometryKHR>       geometries;
+        std::vector<vk::AccelerationStructureBuildRangeInfoKHR> buildRangeInfos;
+        std::vector<uint32_t>                                   geometryMeshes; // The mesh of every geometry
+        std::vector<std::optional<vk::TransformMatrixKHR>>      geometryTransforms;
+        std::vector<BBox3f>                                     geometryBounds; // Transformed, see setMeshPositions
+        vk::DeviceSize                                          scratchOffset;
+    };
+
+    struct InstanceSlot
+    {
+        // Free slots that were never used have a null acceleration structure reference, which makes them inactive:
+        vk::AccelerationStructureInstanceKHR vkInstance;
+        MeshGroupIndex                       meshGroupIdx;
+        uint32_t                             mask; // vkInstance.mask is 0 while hidden
+
+        bool alive;
+        bool visible;
+        bool changed; // Since the last update, the slot is in m_changedSlots
+
+        BBox3f bounds;      // In world space
+        BBox3f buildBounds; // Bounds at the last build of the TLAS
+
+        // What the slot adds to the sums of the update heuristic (zero while it isn't alive):
+        float boundsArea;
+        float grownBoundsArea;
+    };
+
   private:
     static MeshGpuData                  transferMeshData(const Context& context, const GPUAllocator& allocator,
                                                          const vk::CommandPool& commandPool, std::span<const SceneBuilder::Mesh> meshes,
                                                          std::span<const Vertex> vertices, std::span<const glm::u32vec3> faces,
-                                                         std::span<const vk::TransformMatrixKHR> transforms);
+                                                         std::span<const glm::u16vec3>           faces16,
+                                                         std::span<const vk::TransformMatrixKHR> transforms,
+                                                         bool                                    compactVertices);
     static std::vector<AccelStructInfo> createBlas(const Context& context, const GPUAllocator& allocator,
                                                    const vk::CommandPool& commandPool, const MeshGpuData& meshGpuData,
-                                                   std::span<const SceneBuilder::Mesh>      meshes,
-                                                   std::span<const std::vector<PlacedMesh>> meshGroups,
-                                                   bool                                     enableCompaction);
-    static AccelStructInfo              createTlas(const Context& context, const GPUAllocator& allocator,
-                                                   const vk::CommandPool& commandPool, std::span<const Instance> instances,
-                                                   std::span<const AccelStructInfo> blases);
+                                                   std::span<const SceneBuilder::Mesh>         meshes,
+                                                   std::span<const std::optional<DynamicMesh>> dynamicMeshes,
+                                                   MeshGroupsView                              meshGroups,
+                                                   bool                                        enableCompaction);
+    // The geometry of a placed mesh in a BLAS (dynamic meshes read their current positions):
+    static std::pair<vk::AccelerationStructureGeometryKHR, vk::AccelerationStructureBuildRangeInfoKHR>
+    blasGeometry(const Context& context, const MeshGpuData& meshGpuData, const SceneBuilder::Mesh& mesh,
+                 const DynamicMesh* dynamicMesh, TransformIndex transformIdx);
+    static TlasGpuData                  createTlas(const Context& context, const GPUAllocator& allocator,
+                                                   uint32_t numInstanceSlots);
+    static UniqueBuffer                 transferGeometryRecords(const Context& context, const GPUAllocator& allocator,
+                                                                const vk::CommandPool&              commandPool,
+                                                                std::span<const SceneBuilder::Mesh> meshes,
+                                                                MeshGroupsView meshGroups, bool compactVertices);
+    static std::vector<BBox3f>          computeMeshGroupBounds(std::span<const SceneBuilder::Mesh>      meshes,
+                                                               std::span<const Vertex>                  vertices,
+                                                               std::span<const vk::TransformMatrixKHR>  transforms,
+                                                               MeshGroupsView                           meshGroups);
     static UniqueBuffer                 transferCamera(const Context& context, const vk::CommandPool& commandPool,
                                                        const GPUAllocator& allocator, const Camera* camera);
 
+    void createDynamicMeshes(const Context& context, const GPUAllocator& allocator, const SceneBuilder& sceneBuilder);
+    void createDynamicBlases(const Context& context, const GPUAllocator& allocator, const SceneBuilder& sceneBuilder);
+    // Records a single build with the refits of every BLAS with a changed dynamic mesh, returning how many there are:
+    uint32_t recordBlasRefits(const vk::CommandBuffer& commandBuffer, const Context& context);
+
+    InstanceSlot& instanceSlot(InstanceIndex instanceIdx);
+    void          setInstance(uint32_t slotIdx, const Instance& instance);
+    // Adds the slot to m_changedSlots (once), safe to call for different slots from different threads:
+    void          markSlotChanged(uint32_t slotIdx);
+    // Replaces what the slot adds to the sums of the update heuristic with its current areas:
+    void          updateSlotAreas(InstanceSlot& slot);
+    // Writes the changed slots to the instance buffers and records the build or refit of the TLAS from them:
+    void          recordTlasBuild(const vk::CommandBuffer& commandBuffer, const Context& context, bool refit);
+
   private:
-    MeshGpuData m_meshGpuData;
+    // Created once for the construction and all of the updates:
+    vk::UniqueCommandPool   m_commandPool;
+    vk::UniqueCommandBuffer m_tlasCommandBuffer; // Records the TLAS builds and the refits of every update
+
+    MeshGpuData  m_meshGpuData;
+    UniqueBuffer m_geometryRecords;
 
     std::vector<AccelStructInfo> m_blases; // All of the instances of an object
-    AccelStructInfo              m_tlas;
+    TlasGpuData                  m_tlas;
+
+    // Indexed by MeshIndex (empty for meshes that aren't dynamic):
+    std::vector<std::optional<DynamicMesh>> m_dynamicMeshes;
+    std::vector<DynamicBlas>                m_dynamicBlases;
+    UniqueBuffer                            m_dynamicPositions; // Both copies of the positions, stays mapped
+    UniqueBuffer                            m_dynamicScratch;   // Large enough to refit every dynamic BLAS at once
+
+    // Per mesh group, used to fill in the instance slots:
+    std::vector<vk::DeviceAddress> m_blasAddresses;
+    std::vector<uint32_t>          m_geometryRecordsOffsets;
+    std::vector<BBox3f>            m_meshGroupBounds;
+    // The mesh groups whose bounds changed with a dynamic mesh since the last update (once each, see the flags):
+    std::vector<MeshGroupIndex>    m_changedMeshGroups;
+    std::vector<uint8_t>           m_meshGroupBoundsChanged;
+
+    std::vector<InstanceSlot> m_instances;
+    std::vector<uint32_t>     m_freeInstances;
+    bool                      m_needsRebuild = false; // A free slot that was inactive in the TLAS was used
+    uint32_t                  m_numRefits    = 0;
+
+    // Has room for every slot, only the first m_numChangedSlots are used (incremented atomically, see markSlotChanged):
+    std::vector<uint32_t> m_changedSlots;
+    uint32_t              m_numChangedSlots = 0;
+    // The sums over every slot of the update heuristic (see SceneUpdateParam::maxBoundsGrowth):
+    double m_boundsArea      = 0.0;
+    double m_grownBoundsArea = 0.0;
 
     UniqueBuffer     m_cameraData;
     std::string_view m_cameraShaderName;
+
+    SceneBuildTimings m_buildTimings;
 };
 
 } // namespace prism
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "sequence.hpp"
+
+#include <array>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <spdlog/fmt/fmt.h>
+
+#include <framebuffer.hpp>
+#include <profiler.hpp>
+#include <readback.hpp>
+
+namespace prism {
+
+// The pattern comes from the command line, so it's checked before the first frame is submitted:
+static std::string framePath(const std::string& pattern, const uint32_t frame)
+{
+    try {
+        return fmt::format(fmt::runtime(pattern), frame);
+    } catch (const fmt::format_error& e) {
+        throw std::runtime_error("Invalid output pattern for the frames \"" + pattern + "\": " + e.what());
+    }
+}
+
+SequenceStats renderSequence(const SequenceParam& param, const Context& context, const GPUAllocator& gpuAllocator,
+                             const Pipelines& pipelines, Scene& scene, const Animation& animation)
+{
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    const auto outputSize = pipelines.getOutputSize();
+    if (pipelines.getBufferSize() != outputSize) {
+        throw std::runtime_error("Sequences can't be rendered with tiled pipelines");
+    }
+
+    const auto beautyFormat = pipelines.getBeautyFormat();
+    const auto numPixels    = vk::DeviceSize(outputSize.x) * outputSize.y;
+
+    SequenceStats stats{.numFrames = param.numFrames, .numRebuilds = 0, .updateMs = 0.0, .totalMs = 0.0};
+    const auto    start = std::chrono::steady_clock::now();
+
+    // The frames that are still being written, this has to outlive the readback since its callbacks add to it:
+    TaskGroup writes;
+
+    {
+        Readback   readback(context, gpuAllocator, std::to_array({beautyPixelSize(beautyFormat) * numPixels}));
+        const auto readbackSrcs = std::to_array({pipelines.getBeautyBuffer()});
+
+        for (uint32_t frame = 0; frame < param.numFrames; ++frame) {
+            const float time = param.startTime + static_cast<float>(frame) / param.frameRate;
+
+            // Only changes the instances on the host, so the previous frame can still be rendering:
+            animation.applyInstances(time, scene);
+
+            // The TLAS and the instance records are updated in place, which can't happen while they are being used:
+            readback.wait();
+
+            const auto updateInfo = scene.update(context, param.update);
+            stats.updateMs += updateInfo.ms;
+            stats.numRebuilds += updateInfo.rebuilt ? 1 : 0;
+
+            const auto cameraToWorld = animation.cameraToWorld(time);
+            auto       path          = framePath(param.outputPattern, frame);
+
+            readback.submit(
+                [&](const vk::CommandBuffer& commandBuffer) {
+                    pipelines.addBindRTPipelineCmd(commandBuffer, {
+                                                                      .width         = outputSize.x,
+                                                                      .height        = outputSize.y,
+                                                                      .cameraToWorld = cameraToWorld,
+                                                                  });
+                },
+                readbackSrcs,
+                [&, path = std::move(path)](std::span<const std::span<const std::byte>> data) {
+                    std::vector<glm::vec3> beauty(numPixels);
+                    decodeBeauty(data[0], beautyFormat, beauty);
+
+                    writeImageAsync(writes, path, toneMap(beauty, outputSize, param.toneMap));
+                });
+
+            profiler().newFrame();
+        }
+
+        readback.wait();
+    }
+
+    // Rethrow any error that happened while writing the frames:
+    writes.wait();
+
+    stats.totalMs = Milliseconds(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+} // namespace prism
\ No newline at end of file
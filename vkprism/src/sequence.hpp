@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <allocator.hpp>
+#include <animation.hpp>
+#include <context.hpp>
+#include <image.hpp>
+#include <pipelines.hpp>
+#include <scene.hpp>
+
+namespace prism {
+
+struct SequenceParam
+{
+    uint32_t numFrames;
+    float    startTime = 0.f;  // In seconds
+    float    frameRate = 24.f; // Frames per second
+
+    // The path of every frame, formatted with the frame number (with fmt, e.g. {:04} pads it to 4 digits):
+    std::string outputPattern = "frame_{:04}.png";
+
+    ToneMapParam     toneMap{};
+    SceneUpdateParam update{};
+};
+
+struct SequenceStats
+{
+    uint32_t numFrames;
+    uint32_t numRebuilds; // Frames where the TLAS was rebuilt instead of refitted
+
+    double updateMs; // Spent in Scene::update over all of the frames
+    double totalMs;
+};
+
+// Renders an animation one frame at a time. The context, the pipelines and the BLASes are reused for every frame, so
+// the only work per frame is evaluating the tracks, updating the TLAS and tracing. Evaluating the tracks of a frame
+// overlaps with the previous frame rendering, and a frame is written to disk while the next ones render.
+//
+// The pipelines have to be created for the scene and can't be tiled. Only the beauty output is written (as an LDR
+// image).
+SequenceStats renderSequence(const SequenceParam& param, const Context& context, const GPUAllocator& gpuAllocator,
+                             const Pipelines& pipelines, Scene& scene, const Animation& animation);
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef _AOV_GLSL_
+#define _AOV_GLSL_
+
+#include "aov.hpp"
+
+// Every AOV is gated by a specialization constant so that the disabled ones are compiled out of the pipeline:
+layout(constant_id = AOV_DEPTH)        const bool ENABLE_AOV_DEPTH        = false;
+layout(constant_id = AOV_NORMAL)       const bool ENABLE_AOV_NORMAL       = false;
+layout(constant_id = AOV_ALBEDO)       const bool ENABLE_AOV_ALBEDO       = false;
+layout(constant_id = AOV_INSTANCE_ID)  const bool ENABLE_AOV_INSTANCE_ID  = false;
+layout(constant_id = AOV_PRIMITIVE_ID) const bool ENABLE_AOV_PRIMITIVE_ID = false;
+layout(constant_id = AOV_SAMPLE_COUNT) const bool ENABLE_AOV_SAMPLE_COUNT = false;
+
+#endif // _AOV_GLSL_
\ No newline at end of file
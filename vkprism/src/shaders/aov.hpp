@@ -0,0 +1,17 @@
+// clang-format off
+
+#pragma once
+
+// The specialization constant ids used to enable each of the AOVs. These also double as the binding of the AOV's
+// output buffer in the output buffer descriptor set (the beauty buffer is at binding 0).
+
+#define AOV_DEPTH        1 // float, distance along the camera ray (-1 if nothing was hit)
+#define AOV_NORMAL       2 // uint, octahedral encoded world space shading normal (packSnorm2x16)
+#define AOV_ALBEDO       3 // uvec2, RGBA16F (packHalf2x16)
+#define AOV_INSTANCE_ID  4 // uint, index of the instance in the TLAS (NO_HIT_ID if nothing was hit)
+#define AOV_PRIMITIVE_ID 5 // uint, index of the triangle in the geometry (NO_HIT_ID if nothing was hit)
+#define AOV_SAMPLE_COUNT 6 // uint, number of samples taken for the pixel
+
+#define NO_HIT_ID 0xFFFFFFFF
+
+// clang-format on
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef _FRAMEBUFFER_GLSL_
+#define _FRAMEBUFFER_GLSL_
+
+#include "framebuffer.hpp"
+
+layout(constant_id = BEAUTY_FORMAT_ID) const uint BEAUTY_FORMAT = BEAUTY_FORMAT_RGB32F;
+
+// Largest value representable by RGB9E5 ((2^9 - 1) / 2^9 * 2^16):
+const float MAX_RGB9E5 = 65408.0;
+
+// Packs the color into the shared exponent format (see EXT_texture_shared_exponent):
+uint framebuffer_packRGB9E5(vec3 rgb)
+{
+	// Written this way so that NaNs end up as 0:
+	rgb = min(max(rgb, vec3(0.0)), vec3(MAX_RGB9E5));
+
+	const float maxChannel = max(rgb.r, max(rgb.g, rgb.b));
+	int         exponent   = max(-16, int(floor(log2(max(maxChannel, 1.0e-30))))) + 16;
+	float       denom      = exp2(float(exponent - 24));
+
+	// Rounding may push the largest mantissa out of range:
+	if (uint(floor(maxChannel / denom + 0.5)) == 512) {
+		denom *= 2.0;
+		exponent += 1;
+	}
+
+	const uvec3 mantissa = uvec3(floor(rgb / denom + 0.5));
+	return mantissa.r | (mantissa.g << 9) | (mantissa.b << 18) | (uint(exponent) << 27);
+}
+
+uvec2 framebuffer_packRGBA16F(vec3 rgb)
+{
+	return uvec2(packHalf2x16(rgb.rg), packHalf2x16(vec2(rgb.b, 1.0)));
+}
+
+#endif // _FRAMEBUFFER_GLSL_
\ No newline at end of file
@@ -0,0 +1,16 @@
+// clang-format off
+
+#pragma once
+
+// The formats the beauty output can be stored in (selected with the BEAUTY_FORMAT_ID specialization constant):
+#define BEAUTY_FORMAT_RGB32F  0 // vec3, 12 bytes per pixel
+#define BEAUTY_FORMAT_RGBA16F 1 // 2x packHalf2x16, 8 bytes per pixel
+#define BEAUTY_FORMAT_RGB9E5  2 // Shared exponent, 4 bytes per pixel
+
+// Specialization constant ids (the AOVs use the ids right after the beauty buffer's binding):
+#define BEAUTY_FORMAT_ID 16
+
+// Work group size of the packing compute shader:
+#define PACK_BEAUTY_GROUP_SIZE 256
+
+// clang-format on
\ No newline at end of file
@@ -0,0 +1,83 @@
+// clang-format off
+
+#pragma once
+
+// The octahedral encoding of unit vectors, shared by the shaders and the host so that the shading normals of compact
+// vertices and the normal AOV are encoded and decoded in exactly the same way everywhere. The C++ side also gets the
+// SNORM packing GLSL has built in.
+
+#ifdef __cplusplus
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+namespace prism {
+namespace shader {
+
+using uint = uint32_t;
+using vec2 = glm::vec2;
+using vec3 = glm::vec3;
+using glm::abs;
+using glm::max;
+using glm::normalize;
+
+#define OCTAHEDRAL_FN inline
+#else
+#define OCTAHEDRAL_FN
+#endif
+
+// Lower bound on the L1 norm, zero vectors end up at the origin of the octahedron (i.e. +z) instead of becoming NaNs:
+const float OCTAHEDRAL_MIN_L1 = 1.0e-30f;
+
+// Folds the lower hemisphere over the diagonals of the octahedron (and unfolds it again):
+OCTAHEDRAL_FN vec2 octahedral_fold(vec2 p)
+{
+	return vec2((1.0f - abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f), (1.0f - abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+// Octahedral encoding of a direction (Cigolle et al. 2014), the result is in [-1, 1]:
+OCTAHEDRAL_FN vec2 octahedral_encode(vec3 v)
+{
+	const vec2 p = vec2(v.x, v.y) / max(abs(v.x) + abs(v.y) + abs(v.z), OCTAHEDRAL_MIN_L1);
+	return v.z < 0.0f ? octahedral_fold(p) : p;
+}
+
+OCTAHEDRAL_FN vec3 octahedral_decode(vec2 p)
+{
+	const float z = 1.0f - abs(p.x) - abs(p.y);
+	return normalize(z < 0.0f ? vec3(octahedral_fold(p), z) : vec3(p, z));
+}
+
+#undef OCTAHEDRAL_FN
+
+#ifdef __cplusplus
+
+// Same as the GLSL builtins, ties are rounded to even (which is what the SIMD encoders do as well):
+inline uint packSnorm2x16(vec2 v)
+{
+	const auto packSnorm = [](const float x) {
+		const auto snorm = static_cast<int32_t>(std::nearbyint(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+		return static_cast<uint>(snorm) & 0xFFFF;
+	};
+	return packSnorm(v.x) | (packSnorm(v.y) << 16);
+}
+
+inline vec2 unpackSnorm2x16(uint bits)
+{
+	const auto unpackSnorm = [](const uint x) {
+		return std::clamp(static_cast<float>(static_cast<int16_t>(x & 0xFFFF)) / 32767.0f, -1.0f, 1.0f);
+	};
+	return vec2(unpackSnorm(bits), unpackSnorm(bits >> 16));
+}
+
+}
+}
+#endif
+
+// clang-format on
\ No newline at end of file
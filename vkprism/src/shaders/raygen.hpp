@@ -0,0 +1,32 @@
+// clang-format off
+
+#pragma once
+
+#ifdef __cplusplus
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+
+namespace prism { 
+namespace shader {
+
+using mat4  = glm::mat4;
+using uvec2 = glm::uvec2;
+#endif
+
+// Push constants of the raygen shader. When rendering in tiles the launch only covers a single tile, the raster offset
+// places it in the full output (the output buffers only ever hold the current tile). The camera is moved around by
+// cameraToWorld (e.g. by an animation) without having to rebuild anything:
+struct RaygenPushConst
+{
+    uvec2 rasterOffset;
+    uvec2 outputSize;
+    mat4  cameraToWorld; // Starts 16 byte aligned in both layouts
+};
+
+#ifdef __cplusplus
+}
+}
+#endif
+
+// clang-format on
\ No newline at end of file
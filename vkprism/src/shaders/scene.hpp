@@ -0,0 +1,52 @@
+// clang-format off
+
+#pragma once
+
+#ifdef __cplusplus
+
+#include <cstdint>
+
+#include <glm/vec2.hpp>
+
+namespace prism { 
+namespace shader {
+
+using uint = uint32_t;
+using vec2 = glm::vec2;
+#endif
+
+// Marks a geometry without a transform of its own:
+#define NO_TRANSFORM 0xFFFFFFFF
+
+// GeometryRecord flags:
+#define GEOMETRY_INDICES_16       0x1 // The faces are in the 16 bit face buffer
+#define GEOMETRY_COMPACT_VERTICES 0x2 // The vertices are in the compact vertex buffer (see CompactVertex)
+#define GEOMETRY_NORMALS          0x4 // The mesh has normals (compact vertices can't encode a zero normal)
+#define GEOMETRY_TANGENTS         0x8 // The mesh has tangents (same as GEOMETRY_NORMALS)
+
+// One record for every geometry (placed mesh) of every mesh group, the records of a mesh group are stored
+// contiguously so that a hit can be resolved with the instance's first record and gl_GeometryIndexEXT:
+struct GeometryRecord
+{
+    uint verticesOffset;
+    uint facesOffset;  // Into the 32 or the 16 bit face buffer (see flags)
+    uint transformIdx; // NO_TRANSFORM if the placed mesh isn't transformed
+    uint flags;
+
+    // Compact vertices store their uvs relative to the uv bounds of the mesh (uvs = uvsOffset + unorm * uvsScale):
+    vec2 uvsOffset;
+    vec2 uvsScale;
+};
+
+// One record for every instance in the TLAS (indexed with gl_InstanceID):
+struct InstanceRecord
+{
+    uint geometryRecordsOffset;
+};
+
+#ifdef __cplusplus
+}
+}
+#endif
+
+// clang-format on
\ No newline at end of file
@@ -2,4 +2,11 @@
 struct HitPayload
 {
 	vec3 hitValue;
+
+	// Only written when the respective AOV is enabled:
+	float hitT;
+	vec3  normal;
+	vec3  albedo;
+	uint  instanceId;
+	uint  primitiveId;
 };
\ No newline at end of file
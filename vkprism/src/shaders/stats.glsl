@@ -0,0 +1,84 @@
+#ifndef _STATS_GLSL_
+#define _STATS_GLSL_
+
+// Requires GL_KHR_shader_subgroup_ballot and GL_EXT_scalar_block_layout (extensions can't be enabled in here, as they
+// have to come before any declarations).
+
+#include "stats.hpp"
+
+layout(constant_id = RAY_STATS_ID) const bool ENABLE_RAY_STATS = false;
+
+// Reset before every launch:
+layout(set = 1, binding = RAY_STATS_BINDING, scalar) buffer RayStatsBuffer { RayStats rayStats; };
+
+// Every function only adds to the counters if they are enabled and may be called from divergent code (the counts are
+// reduced over the invocations that are active at that point).
+
+uint stats_numActiveLanes()
+{
+	return subgroupBallotBitCount(subgroupBallot(true));
+}
+
+// Called by the raygen shader once every invocation has started:
+void stats_countLanes()
+{
+	if (ENABLE_RAY_STATS) {
+		const uint count = stats_numActiveLanes();
+		if (subgroupElect()) {
+			atomicAdd(rayStats.activeLanes, count);
+			atomicAdd(rayStats.laneSlots, gl_SubgroupSize);
+		}
+	}
+}
+
+// Called right before every traceRayEXT:
+void stats_countRay()
+{
+	if (ENABLE_RAY_STATS) {
+		const uint count = stats_numActiveLanes();
+		if (subgroupElect()) {
+			atomicAdd(rayStats.raysTraced, count);
+		}
+	}
+}
+
+void stats_countHit()
+{
+	if (ENABLE_RAY_STATS) {
+		const uint count = stats_numActiveLanes();
+		if (subgroupElect()) {
+			atomicAdd(rayStats.hits, count);
+		}
+	}
+}
+
+void stats_countMiss()
+{
+	if (ENABLE_RAY_STATS) {
+		const uint count = stats_numActiveLanes();
+		if (subgroupElect()) {
+			atomicAdd(rayStats.misses, count);
+		}
+	}
+}
+
+// Called by the raygen shader once a path has ended. The lanes with the same depth are counted together, which only
+// takes a few iterations as most of the subgroup usually ends up at the same depth:
+void stats_countPathDepth(const uint numSegments)
+{
+	if (ENABLE_RAY_STATS) {
+		const uint bucket = clamp(numSegments, 1u, uint(RAY_STATS_MAX_DEPTH)) - 1u;
+		while (true) {
+			const uint current = subgroupBroadcastFirst(bucket);
+			if (bucket == current) {
+				const uint count = stats_numActiveLanes();
+				if (subgroupElect()) {
+					atomicAdd(rayStats.pathDepths[current], count);
+				}
+				break;
+			}
+		}
+	}
+}
+
+#endif // _STATS_GLSL_
\ No newline at end of file
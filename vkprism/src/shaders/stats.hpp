@@ -0,0 +1,40 @@
+// clang-format off
+
+#pragma once
+
+#ifdef __cplusplus
+
+#include <cstdint>
+
+namespace prism { 
+namespace shader {
+
+using uint = uint32_t;
+#endif
+
+// Specialization constant that enables the counters (shared by the raygen, closest hit and miss shaders):
+#define RAY_STATS_ID 17
+// Binding of the counters in the output buffer descriptor set (kept clear of the AOV bindings):
+#define RAY_STATS_BINDING 16
+
+// Paths that are deeper than this are counted in the last bucket of the histogram:
+#define RAY_STATS_MAX_DEPTH 8
+
+// The counters of a single launch. Every shader sums its counts over the subgroup first, so there is only a single
+// atomic per subgroup and counter:
+struct RayStats
+{
+    uint raysTraced;
+    uint hits;        // Invocations of the closest hit shader
+    uint misses;      // Invocations of the miss shader
+    uint activeLanes; // Raygen invocations, summed over every subgroup
+    uint laneSlots;   // Size of those subgroups, so that activeLanes / laneSlots is the lane utilization
+    uint pathDepths[RAY_STATS_MAX_DEPTH]; // pathDepths[i] counts the paths with i + 1 segments
+};
+
+#ifdef __cplusplus
+}
+}
+#endif
+
+// clang-format on
\ No newline at end of file
@@ -0,0 +1,378 @@
+#include "task_system.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#elif defined(__linux__)
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace prism {
+
+//
+// Thread pinning:
+
+// A logical core that a worker can be pinned to:
+struct LogicalCore
+{
+    uint32_t numaNode;
+    uint32_t group; // Processor group on Windows, always 0 otherwise
+    uint32_t idx;   // Within the group
+};
+
+#ifdef _WIN32
+
+// Ordered by NUMA node:
+static std::vector<LogicalCore> queryLogicalCores()
+{
+    std::vector<LogicalCore> cores;
+
+    ULONG highestNode = 0;
+    if (!GetNumaHighestNodeNumber(&highestNode)) {
+        return cores;
+    }
+
+    for (USHORT node = 0; node <= highestNode; ++node) {
+        GROUP_AFFINITY affinity{};
+        if (!GetNumaNodeProcessorMaskEx(node, &affinity)) {
+            continue;
+        }
+        for (uint32_t i = 0; i < sizeof(KAFFINITY) * 8; ++i) {
+            if (affinity.Mask & (KAFFINITY(1) << i)) {
+                cores.push_back({.numaNode = node, .group = affinity.Group, .idx = i});
+            }
+        }
+    }
+
+    return cores;
+}
+
+static void pinThread(std::thread& thread, const LogicalCore& core)
+{
+    GROUP_AFFINITY affinity{};
+    affinity.Group = static_cast<WORD>(core.group);
+    affinity.Mask  = KAFFINITY(1) << core.idx;
+
+    // Pinning is only an optimization, so failures are ignored:
+    SetThreadGroupAffinity(thread.native_handle(), &affinity, nullptr);
+}
+
+#elif defined(__linux__)
+
+// Parses lists like "0-3,8-11":
+static std::vector<uint32_t> parseCpuList(const std::string& list)
+{
+    std::vector<uint32_t> cpus;
+
+    std::stringstream ss(list);
+    std::string       range;
+    while (std::getline(ss, range, ',')) {
+        const auto     dash  = range.find('-');
+        const uint32_t first = std::stoul(range.substr(0, dash));
+        const uint32_t last  = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+        for (uint32_t cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+// Ordered by NUMA node:
+static std::vector<LogicalCore> queryLogicalCores()
+{
+    std::vector<LogicalCore> cores;
+
+    // Every node directory (node0, node1, ...) lists the CPUs that belong to it:
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec)) {
+        const auto name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+            !std::all_of(name.begin() + 4, name.end(), [](const char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+
+        std::ifstream file(entry.path() / "cpulist");
+        std::string   list;
+        if (!std::getline(file, list) || list.empty()) {
+            continue;
+        }
+
+        const auto node = static_cast<uint32_t>(std::stoul(name.substr(4)));
+        for (const uint32_t cpu : parseCpuList(list)) {
+            cores.push_back({.numaNode = node, .group = 0, .idx = cpu});
+        }
+    }
+
+    std::sort(cores.begin(), cores.end(), [](const LogicalCore& a, const LogicalCore& b) {
+        return a.numaNode != b.numaNode ? a.numaNode < b.numaNode : a.idx < b.idx;
+    });
+
+    // Systems without NUMA support don't have the node directories:
+    if (cores.empty()) {
+        for (uint32_t cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu) {
+            cores.push_back({.numaNode = 0, .group = 0, .idx = cpu});
+        }
+    }
+
+    return cores;
+}
+
+static void pinThread(std::thread& thread, const LogicalCore& core)
+{
+    if (core.idx >= CPU_SETSIZE) {
+        return;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core.idx, &cpus);
+
+    // Pinning is only an optimization, so failures are ignored:
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+}
+
+#else
+
+static std::vector<LogicalCore> queryLogicalCores() { return {}; }
+
+static void pinThread(std::thread&, const LogicalCore&) {}
+
+#endif
+
+//
+// TaskSystem:
+
+// Which task system the current thread is a worker of and the index of its queue:
+static thread_local const TaskSystem* t_taskSystem = nullptr;
+static thread_local uint32_t          t_workerIdx  = 0;
+
+TaskSystem::TaskSystem(const TaskSystemParam& param)
+{
+    const uint32_t numThreads =
+        param.numThreads > 0 ? param.numThreads : std::max(1u, std::thread::hardware_concurrency());
+    const uint32_t numWorkers = numThreads - 1;
+
+    // The last queue is for the threads that aren't workers:
+    for (uint32_t i = 0; i <= numWorkers; ++i) {
+        m_queues.push_back(std::make_unique<TaskQueue>());
+    }
+
+    // The first core is left to the thread creating the task system (usually the main thread):
+    const auto cores = param.pinThreads ? queryLogicalCores() : std::vector<LogicalCore>{};
+
+    std::vector<uint32_t>           workerNodes(numWorkers, 0);
+    std::vector<const LogicalCore*> workerCores(numWorkers, nullptr);
+    if (!cores.empty()) {
+        for (uint32_t i = 0; i < numWorkers; ++i) {
+            workerCores[i] = &cores[(i + 1) % cores.size()];
+            workerNodes[i] = workerCores[i]->numaNode;
+        }
+    }
+
+    // Workers steal from the workers on their own node first (starting with their neighbours, so that they don't all
+    // go after the same victim), threads that aren't workers just go through all of them:
+    m_stealOrders.resize(numWorkers + 1);
+    for (uint32_t i = 0; i < numWorkers; ++i) {
+        for (const bool sameNode : {true, false}) {
+            for (uint32_t offset = 1; offset < numWorkers; ++offset) {
+                const uint32_t victim = (i + offset) % numWorkers;
+                if ((workerNodes[victim] == workerNodes[i]) == sameNode) {
+                    m_stealOrders[i].push_back(victim);
+                }
+            }
+        }
+    }
+    for (uint32_t i = 0; i < numWorkers; ++i) {
+        m_stealOrders[numWorkers].push_back(i);
+    }
+
+    m_workers.reserve(numWorkers);
+    for (uint32_t i = 0; i < numWorkers; ++i) {
+        m_workers.emplace_back(&TaskSystem::workerLoop, this, i);
+        if (workerCores[i]) {
+            pinThread(m_workers.back(), *workerCores[i]);
+        }
+    }
+}
+
+TaskSystem::~TaskSystem()
+{
+    {
+        std::lock_guard lock(m_wakeMutex);
+        m_stop = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void TaskSystem::submit(Task task)
+{
+    const uint32_t queueIdx = t_taskSystem == this ? t_workerIdx : static_cast<uint32_t>(m_workers.size());
+    auto&          queue    = *m_queues[queueIdx];
+    {
+        std::lock_guard lock(queue.mutex);
+        m_numQueuedTasks.fetch_add(1, std::memory_order_relaxed);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    // Going through the mutex makes sure that a thread that is about to sleep can't miss the new task:
+    { std::lock_guard lock(m_wakeMutex); }
+    m_wakeCondition.notify_one();
+}
+
+bool TaskSystem::runPendingTask()
+{
+    if (m_numQueuedTasks.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+
+    const uint32_t externalIdx = static_cast<uint32_t>(m_workers.size());
+    const uint32_t queueIdx    = t_taskSystem == this ? t_workerIdx : externalIdx;
+
+    const auto tryPop = [&](const uint32_t idx, const bool fromBack, Task& task) {
+        auto&           queue = *m_queues[idx];
+        std::lock_guard lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        if (fromBack) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    };
+
+    // The newest task of our own queue first, then the oldest of the external queue and finally the oldest of the
+    // other workers (which tend to be the biggest pieces of work):
+    Task task;
+    bool found = queueIdx != externalIdx && tryPop(queueIdx, true, task);
+    found      = found || tryPop(externalIdx, false, task);
+    for (size_t i = 0; !found && i < m_stealOrders[queueIdx].size(); ++i) {
+        found = tryPop(m_stealOrders[queueIdx][i], false, task);
+    }
+    if (!found) {
+        return false;
+    }
+    m_numQueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+
+    TaskGroup& group = *task.group;
+    if (!group.isCancelled()) {
+        try {
+            task.func();
+        } catch (...) {
+            std::lock_guard lock(group.m_exceptionMutex);
+            if (!group.m_exception) {
+                group.m_exception = std::current_exception();
+            }
+            group.cancel();
+        }
+    }
+
+    // Anything the task captured has to be gone by the time the group is done:
+    task.func = nullptr;
+
+    if (group.m_numPendingTasks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        { std::lock_guard lock(m_wakeMutex); }
+        m_wakeCondition.notify_all();
+    }
+
+    return true;
+}
+
+void TaskSystem::waitUntilDone(const TaskGroup& group)
+{
+    while (group.m_numPendingTasks.load(std::memory_order_acquire) != 0) {
+        if (runPendingTask()) {
+            continue;
+        }
+
+        // The remaining tasks of the group are running on other threads:
+        std::unique_lock lock(m_wakeMutex);
+        m_wakeCondition.wait(lock, [&]() {
+            return group.m_numPendingTasks.load(std::memory_order_acquire) == 0 ||
+                   m_numQueuedTasks.load(std::memory_order_relaxed) != 0;
+        });
+    }
+}
+
+void TaskSystem::workerLoop(const uint32_t workerIdx)
+{
+    t_taskSystem = this;
+    t_workerIdx  = workerIdx;
+
+    while (true) {
+        if (runPendingTask()) {
+            continue;
+        }
+
+        std::unique_lock lock(m_wakeMutex);
+        m_wakeCondition.wait(lock, [&]() { return m_stop || m_numQueuedTasks.load(std::memory_order_relaxed) != 0; });
+        if (m_stop) {
+            return;
+        }
+    }
+}
+
+static std::mutex                  g_taskSystemMutex;
+static std::unique_ptr<TaskSystem> g_taskSystem;
+static std::atomic<TaskSystem*>    g_taskSystemPtr = nullptr;
+
+void initTaskSystem(const TaskSystemParam& param)
+{
+    std::lock_guard lock(g_taskSystemMutex);
+    if (g_taskSystem) {
+        throw std::runtime_error("The task system has already been initialized");
+    }
+
+    g_taskSystem = std::make_unique<TaskSystem>(param);
+    g_taskSystemPtr.store(g_taskSystem.get(), std::memory_order_release);
+}
+
+TaskSystem& taskSystem()
+{
+    if (const auto system = g_taskSystemPtr.load(std::memory_order_acquire)) {
+        return *system;
+    }
+
+    std::lock_guard lock(g_taskSystemMutex);
+    if (!g_taskSystem) {
+        g_taskSystem = std::make_unique<TaskSystem>(TaskSystemParam{});
+        g_taskSystemPtr.store(g_taskSystem.get(), std::memory_order_release);
+    }
+    return *g_taskSystem;
+}
+
+//
+// TaskGroup:
+
+TaskGroup::~TaskGroup() { taskSystem().waitUntilDone(*this); }
+
+void TaskGroup::wait()
+{
+    taskSystem().waitUntilDone(*this);
+
+    std::lock_guard lock(m_exceptionMutex);
+    if (m_exception) {
+        std::rethrow_exception(std::exchange(m_exception, nullptr));
+    }
+}
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace prism {
+
+struct TaskSystemParam
+{
+    uint32_t numThreads = 0;     // Including the threads that wait on tasks, 0 uses all of the hardware threads
+    bool     pinThreads = false; // Pins every worker to one logical core, filling up one NUMA node at a time
+};
+
+class TaskGroup;
+
+// A pool of worker threads with one deque per worker. Workers push and pop their own tasks at the back (so nested
+// tasks run depth first and stay in cache) and steal from the front of the other deques when they run out of work,
+// preferring workers on the same NUMA node. Tasks submitted from other threads go into a separate queue.
+//
+// There is a single task system for the whole process (see taskSystem()), which everything that runs on more than one
+// thread should use, so that we never end up with several thread pools fighting over the cores.
+class TaskSystem
+{
+  public:
+    TaskSystem(const TaskSystemParam& param);
+    TaskSystem(const TaskSystem&) = delete;
+    ~TaskSystem();
+
+    // Number of threads that execute tasks (the workers and whichever thread waits on a group):
+    uint32_t numThreads() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+  private:
+    friend class TaskGroup;
+
+    struct Task
+    {
+        std::function<void()> func;
+        TaskGroup*            group;
+    };
+
+    struct alignas(64) TaskQueue
+    {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    void submit(Task task);
+    bool runPendingTask();
+    void waitUntilDone(const TaskGroup& group);
+    void workerLoop(uint32_t workerIdx);
+
+  private:
+    // One queue per worker, followed by the queue for tasks submitted from other threads:
+    std::vector<std::unique_ptr<TaskQueue>> m_queues;
+    std::atomic<uint64_t>                   m_numQueuedTasks = 0;
+
+    // The order in which every worker tries to steal from the other workers (the same NUMA node first):
+    std::vector<std::vector<uint32_t>> m_stealOrders;
+
+    // Idle threads sleep on this until new tasks are submitted or a group finishes:
+    std::mutex              m_wakeMutex;
+    std::condition_variable m_wakeCondition;
+    bool                    m_stop = false;
+
+    std::vector<std::thread> m_workers;
+};
+
+// Has to be called before the task system is used for the first time, throws otherwise:
+void initTaskSystem(const TaskSystemParam& param);
+
+// Created with the default parameters on first use unless initTaskSystem was called:
+TaskSystem& taskSystem();
+
+// A set of tasks that are waited on together. Waiting threads execute pending tasks (of any group) instead of blocking,
+// so groups can be nested arbitrarily deep (i.e. tasks may create groups of their own and wait on them).
+class TaskGroup
+{
+  public:
+    TaskGroup() = default;
+    TaskGroup(const TaskGroup&) = delete;
+    // Waits for the remaining tasks but drops their exceptions (use wait() to get them):
+    ~TaskGroup();
+
+    template <typename F>
+    void run(F&& func)
+    {
+        m_numPendingTasks.fetch_add(1, std::memory_order_relaxed);
+        taskSystem().submit(TaskSystem::Task{.func = std::forward<F>(func), .group = this});
+    }
+
+    // Blocks until every task has finished and rethrows the first exception any of them threw:
+    void wait();
+
+    // Tasks that haven't started yet are skipped, running tasks can check isCancelled() to stop early. A task throwing
+    // an exception also cancels the group.
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+  private:
+    friend class TaskSystem;
+
+    std::atomic<uint32_t> m_numPendingTasks = 0;
+    std::atomic<bool>     m_cancelled       = false;
+
+    std::mutex         m_exceptionMutex;
+    std::exception_ptr m_exception;
+};
+
+} // namespace prism
\ No newline at end of file
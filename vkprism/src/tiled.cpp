@@ -0,0 +1,91 @@
+#include "tiled.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include <glm/common.hpp>
+
+#include <aov.hpp>
+#include <framebuffer.hpp>
+#include <image.hpp>
+#include <readback.hpp>
+
+namespace prism {
+
+void renderTiled(const TiledRenderParam& param, const Context& context, const GPUAllocator& gpuAllocator,
+                 const Pipelines& pipelines)
+{
+    const auto outputSize   = pipelines.getOutputSize();
+    const auto tileSize     = pipelines.getBufferSize();
+    const auto beautyFormat = pipelines.getBeautyFormat();
+    const auto numTilePixels = vk::DeviceSize(tileSize.x) * tileSize.y;
+
+    // The beauty buffer is always the first buffer that is read back, followed by any enabled AOVs:
+    AovSet                      aovs{};
+    std::vector<vk::DeviceSize> readbackSizes{beautyPixelSize(beautyFormat) * numTilePixels};
+    std::vector<vk::Buffer>     readbackSrcs{pipelines.getBeautyBuffer()};
+    std::vector<AovType>        readbackAovs;
+    for (uint32_t aov = 0; aov < TOTAL_NUM_AOVS; ++aov) {
+        if (const auto buffer = pipelines.getAovBuffer(AovType(aov))) {
+            aovs[aov] = true;
+            readbackSizes.push_back(aovPixelSize(AovType(aov)) * numTilePixels);
+            readbackSrcs.push_back(buffer);
+            readbackAovs.push_back(AovType(aov));
+        }
+    }
+
+    MappedEXR output(param.outputPath, outputSize, aovExrChannels(aovs));
+
+    // The readback has to be destroyed (waiting on every tile) before the output is flushed:
+    {
+        Readback readback(context, gpuAllocator, readbackSizes, param.readbackRingSize);
+
+        for (uint32_t y = 0; y < outputSize.y; y += tileSize.y) {
+            for (uint32_t x = 0; x < outputSize.x; x += tileSize.x) {
+                // Tiles along the right and bottom edges may be smaller, they are still stored densely in the buffers:
+                const glm::uvec2 offset(x, y);
+                const glm::uvec2 size = glm::min(tileSize, outputSize - offset);
+
+                readback.submit(
+                    [&, offset, size](const vk::CommandBuffer& commandBuffer) {
+                        pipelines.addBindRTPipelineCmd(commandBuffer, {
+                                                                          .width   = size.x,
+                                                                          .height  = size.y,
+                                                                          .offsetX = offset.x,
+                                                                          .offsetY = offset.y,
+                                                                      });
+                    },
+                    readbackSrcs,
+                    [&, offset, size](std::span<const std::span<const std::byte>> data) {
+                        const size_t numPixels = size_t(size.x) * size.y;
+
+                        std::vector<glm::vec3> beauty(numPixels);
+                        decodeBeauty(data[0].first(numPixels * beautyPixelSize(beautyFormat)), beautyFormat, beauty);
+
+                        std::array<const std::byte*, TOTAL_NUM_AOVS> aovData{};
+                        for (size_t i = 0; i < readbackAovs.size(); ++i) {
+                            aovData[readbackAovs[i]] = data[i + 1].data();
+                        }
+
+                        std::vector<glm::vec3> normals;
+                        if (aovs[aovNORMAL]) {
+                            normals.resize(numPixels);
+                            decodeOctahedralNormals(std::span(aovData[aovNORMAL], numPixels * aovPixelSize(aovNORMAL)),
+                                                    normals);
+                            aovData[aovNORMAL] = reinterpret_cast<const std::byte*>(normals.data());
+                        }
+
+                        output.writeRegion(offset, size, aovExrChannels(aovs, beauty.data(), aovData));
+                    });
+            }
+        }
+
+        // Rethrow any error that happened while writing the tiles:
+        readback.wait();
+    }
+
+    output.flush();
+}
+
+} // namespace prism
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <filesystem>
+
+#include <allocator.hpp>
+#include <context.hpp>
+#include <pipelines.hpp>
+
+namespace prism {
+
+struct TiledRenderParam
+{
+    // Where the beauty output and every enabled AOV are written to as a multi-layer EXR:
+    std::filesystem::path outputPath;
+    // Number of tiles that can be in flight (rendering on the device or being written on the host):
+    uint32_t readbackRingSize = 2;
+};
+
+// Renders the full output one tile at a time, where the tile size is the size of the pipeline's output buffers (see
+// PipelineParam::tileWidth). Finished tiles are read back while the next tile renders and are written directly into a
+// memory mapped EXR file, so neither the device nor the host ever holds the full image.
+void renderTiled(const TiledRenderParam& param, const Context& context, const GPUAllocator& gpuAllocator,
+                 const Pipelines& pipelines);
+
+} // namespace prism
\ No newline at end of file
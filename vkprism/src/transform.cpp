@@ -2,11 +2,62 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <stdexcept>
 
+#include <glm/geometric.hpp>
 #include <glm/gtc/matrix_access.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/matrix.hpp>
 
 namespace prism {
 
+// The largest cosine allowed between two of the (normalized) axes before it's considered a shear:
+static constexpr float SHEAR_TOLERANCE = 1e-4f;
+
+Transform::Transform(const TRS& trs) :
+    m_matrix(glm::mat4(glm::mat3_cast(glm::normalize(trs.rotation)) *
+                       glm::mat3(glm::vec3(trs.scale.x, 0.f, 0.f), glm::vec3(0.f, trs.scale.y, 0.f),
+                                 glm::vec3(0.f, 0.f, trs.scale.z))))
+{
+    m_matrix[3] = glm::vec4(trs.translation, 1.f);
+}
+
+TRS Transform::decompose() const
+{
+    if (m_matrix[0][3] != 0.f || m_matrix[1][3] != 0.f || m_matrix[2][3] != 0.f || m_matrix[3][3] != 1.f) {
+        throw std::runtime_error("Can't decompose a transform with a projection into TRS");
+    }
+
+    // The columns of the upper 3x3 are the scaled axes of the rotation:
+    glm::mat3 rotation(m_matrix);
+    glm::vec3 scale(glm::length(rotation[0]), glm::length(rotation[1]), glm::length(rotation[2]));
+    if (scale.x == 0.f || scale.y == 0.f || scale.z == 0.f) {
+        throw std::runtime_error("Can't decompose a transform with a zero scale into TRS");
+    }
+    for (int i = 0; i < 3; ++i) {
+        rotation[i] /= scale[i];
+    }
+
+    if (std::abs(glm::dot(rotation[0], rotation[1])) > SHEAR_TOLERANCE ||
+        std::abs(glm::dot(rotation[0], rotation[2])) > SHEAR_TOLERANCE ||
+        std::abs(glm::dot(rotation[1], rotation[2])) > SHEAR_TOLERANCE) {
+        throw std::runtime_error("Can't decompose a transform with a shear into TRS");
+    }
+
+    // A mirrored transform is stored as a negative scale along x, the rest has to be a proper rotation:
+    if (glm::determinant(rotation) < 0.f) {
+        scale.x     = -scale.x;
+        rotation[0] = -rotation[0];
+    }
+
+    return TRS{
+        .translation = glm::vec3(m_matrix[3]),
+        .rotation    = glm::normalize(glm::quat_cast(rotation)),
+        .scale       = scale,
+    };
+}
+
 Transform::operator vk::TransformMatrixKHR() const
 {
     // GLM stores their matrices column wise while (for some reason) Vulkan's transform matrix is row-wise. So, we
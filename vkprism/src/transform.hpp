@@ -1,15 +1,32 @@
 #pragma once
 
+#include <glm/gtc/quaternion.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
 #include <vulkan/vulkan.hpp>
 
 namespace prism {
 
+// A transform split into a translation, a rotation and a (possibly non-uniform) scale, which are applied in the reverse
+// order. Unlike matrices, these can be interpolated:
+struct TRS
+{
+    glm::vec3 translation{0.f};
+    glm::quat rotation{1.f, 0.f, 0.f, 0.f};
+    glm::vec3 scale{1.f};
+};
+
 class Transform
 {
   public:
-    // TODO: check that the matrix can be decomposed into TRS:
+    // Any affine matrix can be used, decompose checks that the matrix can be decomposed into TRS:
     Transform(const glm::mat4& mat) : m_matrix(mat) {}
+    Transform(const TRS& trs);
+
+    const glm::mat4& matrix() const { return m_matrix; }
+
+    // Throws if the matrix has a shear or a projection (neither can be represented by TRS):
+    TRS decompose() const;
 
     explicit operator vk::TransformMatrixKHR() const;
 
@@ -6,4 +6,25 @@
 
 namespace prism {
 
+std::string jsonEscape(const std::string_view str)
+{
+    constexpr std::string_view hexDigits = "0123456789abcdef";
+
+    std::string result = "\"";
+    for (const char c : str) {
+        const auto byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (byte < 0x20) {
+            result += "\\u00";
+            result += hexDigits[byte >> 4];
+            result += hexDigits[byte & 0xF];
+        } else {
+            result += c;
+        }
+    }
+    return result + "\"";
+}
+
 } // namespace prism
\ No newline at end of file
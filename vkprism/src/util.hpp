@@ -1,16 +1,20 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <format>
 #include <memory>
 #include <source_location>
 #include <stdexcept>
+#include <string>
 #include <string_view>
 #include <type_traits>
 #include <vector>
 
 #include <vulkan/vulkan.hpp>
 
+#include <task_system.hpp>
+
 namespace prism {
 
 #ifdef _MSC_VER
@@ -27,6 +31,25 @@ namespace prism {
 #define FORCEINLINE inline
 #endif
 
+// SSE2 is part of the x86-64 baseline, so we only have to check for it when building 32-bit binaries:
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PRISM_SSE2
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PRISM_X86
+#endif
+
+// Functions using instruction sets beyond the build's baseline have to be marked with these (MSVC allows any intrinsic
+// without extra flags). Code using them must only be called after checking cpuFeatures():
+#if defined(_MSC_VER) && !defined(__clang__)
+#define PRISM_TARGET_SSE42
+#define PRISM_TARGET_AVX2
+#else
+#define PRISM_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define PRISM_TARGET_AVX2  __attribute__((target("avx2,fma")))
+#endif
+
 // Allows for wrapping a function pointer to be a functor (so we don't have to copy around function pointers everywhere.
 template <typename T, auto F>
 using CustomUniquePtr = std::unique_ptr<T, std::integral_constant<decltype(F), F>>;
@@ -76,4 +99,33 @@ T alignUp(T size, T alignment)
     return (size + (alignment - 1)) & ~(alignment - 1);
 }
 
+// Quotes the string for a JSON file, escaping quotes and backslashes and writing control characters as \u00XX:
+std::string jsonEscape(std::string_view str);
+
+// Splits [0, count) into contiguous ranges of at least minRangeSize elements and calls func(begin, end) on each range
+// using the task system. Blocks until every range has been processed and rethrows the first exception.
+template <typename F>
+void parallelFor(size_t count, size_t minRangeSize, F&& func)
+{
+    // A few ranges per thread, so that threads that finish early can steal some of the remaining work:
+    const size_t numThreads = taskSystem().numThreads();
+    const size_t maxRanges  = numThreads > 1 ? 4 * numThreads : 1;
+    const size_t numRanges  = std::min(maxRanges, (count + minRangeSize - 1) / std::max<size_t>(1, minRangeSize));
+    if (numRanges <= 1) {
+        func(size_t{0}, count);
+        return;
+    }
+
+    const size_t rangeSize = (count + numRanges - 1) / numRanges;
+
+    TaskGroup group;
+    for (size_t begin = rangeSize; begin < count; begin += rangeSize) {
+        group.run([&func, begin, end = std::min(count, begin + rangeSize)]() { func(begin, end); });
+    }
+    // The calling thread takes care of the first range and then helps out with the others:
+    func(size_t{0}, rangeSize);
+
+    group.wait();
+}
+
 } // namespace prism
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "vertex_encoding.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#include <glm/common.hpp>
+
+#include <shaders/octahedral.hpp>
+#include <util.hpp>
+
+#ifdef PRISM_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace prism {
+
+static constexpr float UNORM16_SCALE = 65535.f;
+
+// Rounds both values (already scaled to the range of the 16 bit integer) to the nearest integer (ties to even, like
+// the SIMD path and shader::packSnorm2x16) and packs x into the low and y into the high 16 bits:
+static uint32_t pack2x16(const float x, const float y)
+{
+    const auto ix = static_cast<int32_t>(std::nearbyint(x));
+    const auto iy = static_cast<int32_t>(std::nearbyint(y));
+    return (static_cast<uint32_t>(ix) & 0xFFFF) | (static_cast<uint32_t>(iy) << 16);
+}
+
+#ifdef PRISM_SSE2
+
+// Same as pack2x16 for 4 pairs of values (cvtps rounds ties to even with the default rounding mode):
+static __m128i pack2x16SSE2(const __m128 x, const __m128 y)
+{
+    const __m128i lowMask = _mm_set1_epi32(0xFFFF);
+    return _mm_or_si128(_mm_and_si128(_mm_cvtps_epi32(x), lowMask), _mm_slli_epi32(_mm_cvtps_epi32(y), 16));
+}
+
+// Same as packSnorm2x16(octahedral_encode(v)) for 4 vectors (see shaders/octahedral.hpp):
+static __m128i encodeOctahedralSSE2(const __m128 x, const __m128 y, const __m128 z)
+{
+    const __m128 absMask  = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    const __m128 zero     = _mm_setzero_ps();
+    const __m128 one      = _mm_set1_ps(1.f);
+
+    const __m128 absX  = _mm_and_ps(x, absMask);
+    const __m128 absY  = _mm_and_ps(y, absMask);
+    const __m128 l1    = _mm_max_ps(_mm_add_ps(_mm_add_ps(absX, absY), _mm_and_ps(z, absMask)),
+                                    _mm_set1_ps(shader::OCTAHEDRAL_MIN_L1));
+    __m128       px    = _mm_div_ps(x, l1);
+    __m128       py    = _mm_div_ps(y, l1);
+
+    // 1 - |p| is never negative, so setting the sign bit negates it:
+    const __m128 negX    = _mm_and_ps(_mm_cmplt_ps(px, zero), signMask);
+    const __m128 negY    = _mm_and_ps(_mm_cmplt_ps(py, zero), signMask);
+    const __m128 foldedX = _mm_or_ps(_mm_sub_ps(one, _mm_and_ps(py, absMask)), negX);
+    const __m128 foldedY = _mm_or_ps(_mm_sub_ps(one, _mm_and_ps(px, absMask)), negY);
+    const __m128 lower   = _mm_cmplt_ps(z, zero);
+    px                   = _mm_or_ps(_mm_and_ps(lower, foldedX), _mm_andnot_ps(lower, px));
+    py                   = _mm_or_ps(_mm_and_ps(lower, foldedY), _mm_andnot_ps(lower, py));
+
+    const __m128 scale = _mm_set1_ps(32767.f);
+    px                 = _mm_mul_ps(_mm_min_ps(_mm_max_ps(px, _mm_set1_ps(-1.f)), one), scale);
+    py                 = _mm_mul_ps(_mm_min_ps(_mm_max_ps(py, _mm_set1_ps(-1.f)), one), scale);
+    return pack2x16SSE2(px, py);
+}
+
+// A Vertex is made of 11 floats, this loads the same float of 4 consecutive vertices into the lanes:
+static_assert(sizeof(Vertex) == 11 * sizeof(float));
+static __m128 loadComponentSSE2(const Vertex* vertices, const size_t offset)
+{
+    const auto* floats = reinterpret_cast<const float*>(vertices) + offset / sizeof(float);
+    return _mm_set_ps(floats[33], floats[22], floats[11], floats[0]);
+}
+
+#endif
+
+void encodeVertices(const std::span<const Vertex> vertices, const glm::vec2 uvsMin, const glm::vec2 uvsMax,
+                    const std::span<CompactVertex> compactVertices)
+{
+    if (compactVertices.size() != vertices.size()) {
+        throw std::runtime_error("Can't encode " + std::to_string(vertices.size()) + " vertices into " +
+                                 std::to_string(compactVertices.size()) + " compact vertices");
+    }
+
+    // Meshes where every vertex has the same uvs (or that don't have any) encode them as zero:
+    const glm::vec2 extent = uvsMax - uvsMin;
+    const glm::vec2 uvsScale(extent.x > 0.f ? 1.f / extent.x : 0.f, extent.y > 0.f ? 1.f / extent.y : 0.f);
+
+    size_t i = 0;
+#ifdef PRISM_SSE2
+    const __m128 zero       = _mm_setzero_ps();
+    const __m128 one        = _mm_set1_ps(1.f);
+    const __m128 unormScale = _mm_set1_ps(UNORM16_SCALE);
+    const __m128 uMin       = _mm_set1_ps(uvsMin.x);
+    const __m128 vMin       = _mm_set1_ps(uvsMin.y);
+    const __m128 uInvExtent = _mm_set1_ps(uvsScale.x);
+    const __m128 vInvExtent = _mm_set1_ps(uvsScale.y);
+
+    // Maps the lanes from [min, min + extent] to the range of the UNORMs:
+    const auto unormLanes = [&](const __m128 value, const __m128 min, const __m128 invExtent) {
+        const __m128 unit = _mm_mul_ps(_mm_sub_ps(value, min), invExtent);
+        return _mm_mul_ps(_mm_min_ps(_mm_max_ps(unit, zero), one), unormScale);
+    };
+
+    alignas(16) std::array<uint32_t, 4> nrmBits, tanBits, uvsBits;
+    for (; i + 4 <= vertices.size(); i += 4) {
+        const Vertex* v = vertices.data() + i;
+
+        _mm_store_si128(reinterpret_cast<__m128i*>(nrmBits.data()),
+                        encodeOctahedralSSE2(loadComponentSSE2(v, offsetof(Vertex, nrm)),
+                                             loadComponentSSE2(v, offsetof(Vertex, nrm) + sizeof(float)),
+                                             loadComponentSSE2(v, offsetof(Vertex, nrm) + 2 * sizeof(float))));
+        _mm_store_si128(reinterpret_cast<__m128i*>(tanBits.data()),
+                        encodeOctahedralSSE2(loadComponentSSE2(v, offsetof(Vertex, tan)),
+                                             loadComponentSSE2(v, offsetof(Vertex, tan) + sizeof(float)),
+                                             loadComponentSSE2(v, offsetof(Vertex, tan) + 2 * sizeof(float))));
+        _mm_store_si128(
+            reinterpret_cast<__m128i*>(uvsBits.data()),
+            pack2x16SSE2(unormLanes(loadComponentSSE2(v, offsetof(Vertex, uvs)), uMin, uInvExtent),
+                         unormLanes(loadComponentSSE2(v, offsetof(Vertex, uvs) + sizeof(float)), vMin, vInvExtent)));
+
+        for (size_t lane = 0; lane < 4; ++lane) {
+            compactVertices[i + lane] =
+                CompactVertex{.pos = v[lane].pos, .nrm = nrmBits[lane], .tan = tanBits[lane], .uvs = uvsBits[lane]};
+        }
+    }
+#endif
+    for (; i < vertices.size(); ++i) {
+        const auto&     vertex = vertices[i];
+        const glm::vec2 uvs    = glm::clamp((vertex.uvs - uvsMin) * uvsScale, 0.f, 1.f) * UNORM16_SCALE;
+
+        compactVertices[i] = CompactVertex{
+            .pos = vertex.pos,
+            .nrm = shader::packSnorm2x16(shader::octahedral_encode(vertex.nrm)),
+            .tan = shader::packSnorm2x16(shader::octahedral_encode(vertex.tan)),
+            .uvs = pack2x16(uvs.x, uvs.y),
+        };
+    }
+}
+
+} // namespace prism
\ No newline at end of file
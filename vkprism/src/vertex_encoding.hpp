@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <scene.hpp>
+
+namespace prism {
+
+// A Vertex with quantized shading attributes, 24 instead of 44 bytes (12 instead of 32 for the attributes). The
+// position is kept as is, as it's what the BLASes are built from. Decoded by the hit shaders (see raytrace.rchit):
+struct CompactVertex
+{
+    glm::vec3 pos;
+    uint32_t  nrm; // Octahedral, 2x16 bit SNORM
+    uint32_t  tan; // Octahedral, 2x16 bit SNORM
+    uint32_t  uvs; // 2x16 bit UNORM, relative to the uv bounds of the mesh
+};
+static_assert(sizeof(CompactVertex) == 24);
+
+// Encodes the vertices of a single mesh, 4 at a time with SSE2 if possible. The normals and tangents are encoded like
+// the normal AOV (see shaders/octahedral.hpp), zero vectors (e.g. the normals of meshes without any) end up as +z. The
+// uvs are mapped from [uvsMin, uvsMax] to the full range of the UNORMs:
+void encodeVertices(std::span<const Vertex> vertices, glm::vec2 uvsMin, glm::vec2 uvsMax,
+                    std::span<CompactVertex> compactVertices);
+
+} // namespace prism
\ No newline at end of file